@@ -195,6 +195,7 @@ LOCAL_SRC_FILES := \
 	../../../src/tileanimation.cpp                 \
 	../../../src/tool.cpp                          \
 	../../../src/touchscreengui.cpp                \
+	../../../src/tracer.cpp                        \
 	../../../src/treegen.cpp                       \
 	../../../src/version.cpp                       \
     ../../../src/voxel.cpp                         \
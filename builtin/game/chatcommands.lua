@@ -792,6 +792,82 @@ core.register_chatcommand("status", {
 	end
 })
 
+core.register_chatcommand("trace", {
+	params = "[stats [<seconds>] | dump | reset]",
+	description = "Show server phase timings or save them as Chrome trace",
+	privs = {server = true},
+	func = function(name, param)
+		local cmd, arg = param:match("^(%S*)%s*(.-)$")
+		if cmd == "" or cmd == "stats" then
+			local stats = core.get_trace_stats(tonumber(arg))
+			if #stats == 0 then
+				return true, "No trace events recorded."
+			end
+			local lines = {"Phase: count, p50 / p99 / max (ms)"}
+			for i = 1, math.min(#stats, 15) do
+				local s = stats[i]
+				lines[#lines + 1] = string.format("%s: %d, %.2f / %.2f / %.2f",
+						s.name, s.count, s.p50 / 1000, s.p99 / 1000, s.max / 1000)
+			end
+			return true, table.concat(lines, "\n")
+		elseif cmd == "dump" then
+			local path = core.write_trace()
+			if not path then
+				return false, "Failed to write trace."
+			end
+			core.log("action", name .. " saved trace to " .. path)
+			return true, "Trace saved to " .. path
+		elseif cmd == "reset" then
+			core.clear_trace()
+			return true, "Trace history cleared."
+		end
+		return false, "Invalid usage, see /help trace."
+	end
+})
+
+core.register_chatcommand("callbacks", {
+	params = "[<mod> | reset]",
+	description = "Show the time spent in Lua callbacks, per mod",
+	privs = {server = true},
+	func = function(name, param)
+		if param == "reset" then
+			core.clear_callback_costs()
+			return true, "Callback statistics cleared."
+		end
+
+		local costs = core.get_callback_costs()
+		local by_mod = {}
+		local list = {}
+		for _, c in ipairs(costs) do
+			if param == "" then
+				local m = by_mod[c.mod]
+				if not m then
+					m = {mod = c.mod, calls = 0, total = 0, max = 0}
+					by_mod[c.mod] = m
+					list[#list + 1] = m
+				end
+				m.calls = m.calls + c.calls
+				m.total = m.total + c.total
+				m.max = math.max(m.max, c.max)
+			elseif c.mod == param then
+				list[#list + 1] = c
+			end
+		end
+		if #list == 0 then
+			return true, "No callbacks recorded."
+		end
+
+		table.sort(list, function(a, b) return a.total > b.total end)
+		local lines = {"Callback: calls, total / max (ms)"}
+		for i = 1, math.min(#list, 15) do
+			local c = list[i]
+			lines[#lines + 1] = string.format("%s: %d, %.1f / %.2f",
+					c.callback or c.mod, c.calls, c.total / 1000, c.max / 1000)
+		end
+		return true, table.concat(lines, "\n")
+	end
+})
+
 core.register_chatcommand("settime", {
 	params = "<0..23>:<0..59> | <0..24000>",
 	description = "Set time of day",
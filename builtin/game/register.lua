@@ -414,6 +414,9 @@ end
 
 core.callback_origins = {}
 
+local get_callback_cost_start = core.get_callback_cost_start
+local add_callback_cost = core.add_callback_cost
+
 function core.run_callbacks(callbacks, mode, ...)
 	assert(type(callbacks) == "table")
 	local cb_len = #callbacks
@@ -434,7 +437,16 @@ function core.run_callbacks(callbacks, mode, ...)
 		else
 			--print("No data associated with callback")
 		end
+		local start, accounted = get_callback_cost_start()
 		local cb_ret = callbacks[i](...)
+		if origin then
+			local slot = origin.cost_slot
+			if not slot then
+				slot = core.get_callback_cost_slot(origin.mod, origin.name)
+				origin.cost_slot = slot
+			end
+			add_callback_cost(slot, start, accounted)
+		end
 
 		if mode == 0 and i == 1 then
 			ret = cb_ret
@@ -0,0 +1,259 @@
+/*
+MultiCraft
+Copyright (C) 2026 MultiCraft Development Team
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark/benchmark.h"
+#include <algorithm>
+#include <iomanip>
+#include "benchmark/bot_client.h"
+#include "exceptions.h"
+#include "filesys.h"
+#include "log.h"
+#include "porting.h"
+#include "server.h"
+#include "settings.h"
+#include "subgame.h"
+#include "tracer.h"
+#include "util/string.h"
+
+#define BENCHMARK_DEFAULT_BOTS 10
+#define BENCHMARK_DEFAULT_DURATION 60
+#define BENCHMARK_DEFAULT_SEED "13107"
+// Maximum time to wait for all bots to join, in seconds
+#define BENCHMARK_JOIN_TIMEOUT 60.0f
+
+static void print_phase(const char *label, const TracePhaseStats *stats)
+{
+	rawstream << std::left << std::setw(24) << label << std::right;
+	if (!stats) {
+		rawstream << "no samples" << std::endl;
+		return;
+	}
+	rawstream << "p50 " << std::setw(8) << stats->p50_us / 1000.0f << " ms"
+		<< "  p99 " << std::setw(8) << stats->p99_us / 1000.0f << " ms"
+		<< "  max " << std::setw(8) << stats->max_us / 1000.0f << " ms"
+		<< "  (" << stats->count << " samples)" << std::endl;
+}
+
+static const TracePhaseStats *find_phase(
+		const std::vector<TracePhaseStats> &stats, const char *name)
+{
+	for (size_t i = 0; i < stats.size(); i++) {
+		if (stats[i].name == name)
+			return &stats[i];
+	}
+	return NULL;
+}
+
+static void print_report(const std::vector<BotClient *> &bots, float duration)
+{
+	std::vector<TracePhaseStats> stats;
+	g_tracer->getPhaseStats(stats);
+
+	std::vector<u32> block_latencies;
+	std::vector<u64> join_times;
+	u64 bytes_min = U64_MAX, bytes_max = 0, bytes_total = 0;
+	u32 blocks_total = 0;
+	for (size_t i = 0; i < bots.size(); i++) {
+		const std::vector<u32> &l = bots[i]->getBlockLatencies();
+		block_latencies.insert(block_latencies.end(), l.begin(), l.end());
+		join_times.push_back(bots[i]->getJoinTime());
+
+		u64 bytes = bots[i]->getBytesReceived();
+		bytes_min = MYMIN(bytes_min, bytes);
+		bytes_max = MYMAX(bytes_max, bytes);
+		bytes_total += bytes;
+		blocks_total += bots[i]->getBlocksReceived();
+	}
+
+	// Block latencies are reported like the traced phases
+	TracePhaseStats block_stats;
+	TracePhaseStats *block_stats_p = NULL;
+	if (!block_latencies.empty()) {
+		std::sort(block_latencies.begin(), block_latencies.end());
+		size_t n = block_latencies.size();
+		block_stats.count = n;
+		block_stats.p50_us = block_latencies[(n - 1) * 50 / 100];
+		block_stats.p99_us = block_latencies[(n - 1) * 99 / 100];
+		block_stats.max_us = block_latencies.back();
+		block_stats_p = &block_stats;
+	}
+	std::sort(join_times.begin(), join_times.end());
+
+	rawstream << std::fixed << std::setprecision(2);
+	rawstream << "Benchmark results (" << bots.size() << " clients, "
+		<< duration << " s)" << std::endl;
+	print_phase("Server tick", find_phase(stats, "Server::AsyncRunStep"));
+	print_phase("Environment step", find_phase(stats, "ServerEnvironment::step"));
+	print_phase("Emerge latency", find_phase(stats, "EmergeThread: request latency"));
+	print_phase("Block delivery latency", block_stats_p);
+	rawstream << std::left << std::setw(24) << "Join time" << std::right
+		<< "min " << join_times.front() / 1000.0f << " ms"
+		<< "  max " << join_times.back() / 1000.0f << " ms" << std::endl;
+	rawstream << std::left << std::setw(24) << "Received per client"
+		<< std::right
+		<< "avg " << bytes_total / bots.size() / duration / 1024 << " KiB/s"
+		<< "  min " << bytes_min / duration / 1024 << " KiB/s"
+		<< "  max " << bytes_max / duration / 1024 << " KiB/s"
+		<< "  (" << blocks_total / bots.size() << " blocks)" << std::endl;
+}
+
+static bool run_benchmark_server(Server &server, const Address &address,
+		u32 bot_count, float duration)
+{
+	bool &kill = *porting::signal_handler_killstatus();
+	const float steplen = g_settings->getFloat("dedicated_server_step");
+
+	std::vector<BotClient *> bots;
+	for (u32 i = 0; i < bot_count; i++) {
+		BotClient *bot = new BotClient("Bot" + itos(i + 1),
+			2 * M_PI * i / bot_count);
+		bot->connect(address);
+		bots.push_back(bot);
+	}
+
+	/*
+		Wait until every bot has joined, then measure for the given duration
+	*/
+	bool measuring = false;
+	bool success = true;
+	float timer = 0;
+	while (!kill && !server.getShutdownRequested()) {
+		sleep_ms((int)(steplen * 1000.0f));
+		server.step(steplen);
+		for (size_t i = 0; i < bots.size(); i++)
+			bots[i]->step(steplen);
+		timer += steplen;
+
+		if (measuring) {
+			if (timer >= duration)
+				break;
+			continue;
+		}
+
+		u32 joined = 0;
+		for (size_t i = 0; i < bots.size(); i++) {
+			if (bots[i]->getState() == BOT_DENIED) {
+				success = false;
+				break;
+			}
+			if (bots[i]->getState() == BOT_JOINED)
+				joined++;
+		}
+		if (!success)
+			break;
+
+		if (joined == bots.size()) {
+			actionstream << "Benchmark: all clients joined after "
+				<< timer << " s, measuring" << std::endl;
+			g_tracer->clear();
+			for (size_t i = 0; i < bots.size(); i++)
+				bots[i]->resetStats();
+			measuring = true;
+			timer = 0;
+		} else if (timer >= BENCHMARK_JOIN_TIMEOUT) {
+			errorstream << "Benchmark: only " << joined << " of "
+				<< bots.size() << " clients joined" << std::endl;
+			success = false;
+			break;
+		}
+	}
+
+	if (success && measuring && timer >= duration)
+		print_report(bots, timer);
+	else
+		success = false;
+
+	for (size_t i = 0; i < bots.size(); i++)
+		delete bots[i];
+	return success;
+}
+
+bool create_benchmark_world(const Settings &cmd_args, SubgameSpec &gamespec,
+		std::string &world_path)
+{
+	std::string gameid = cmd_args.exists("gameid") ?
+		cmd_args.get("gameid") : g_settings->get("default_game");
+	gamespec = findSubgame(gameid);
+	if (!gamespec.isValid()) {
+		errorstream << "Benchmark: game [" << gameid << "] not found"
+			<< std::endl;
+		return false;
+	}
+
+	// Always start with a freshly generated world
+	world_path = fs::TempPath() + DIR_DELIM + "multicraft_benchmark";
+	fs::RecursiveDelete(world_path);
+	if (!loadGameConfAndInitWorld(world_path, gamespec)) {
+		errorstream << "Benchmark: failed to create world in "
+			<< world_path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool run_benchmark(const Settings &cmd_args)
+{
+	u32 bot_count = cmd_args.exists("benchmark-clients") ?
+		cmd_args.getU16("benchmark-clients") : BENCHMARK_DEFAULT_BOTS;
+	float duration = cmd_args.exists("benchmark-duration") ?
+		cmd_args.getFloat("benchmark-duration") : BENCHMARK_DEFAULT_DURATION;
+	std::string seed = cmd_args.exists("benchmark-seed") ?
+		cmd_args.get("benchmark-seed") : BENCHMARK_DEFAULT_SEED;
+	u16 port = cmd_args.exists("port") ?
+		cmd_args.getU16("port") : g_settings->getU16("port");
+	if (bot_count == 0 || duration <= 0) {
+		errorstream << "Benchmark: invalid number of clients or duration"
+			<< std::endl;
+		return false;
+	}
+
+	SubgameSpec gamespec;
+	std::string world_path;
+	if (!create_benchmark_world(cmd_args, gamespec, world_path))
+		return false;
+
+	// Settings are not written back when running the benchmark
+	g_settings->set("fixed_map_seed", seed);
+	g_settings->setBool("disable_anticheat", true);
+	g_settings->set("default_privs", "interact, shout, fly, fast");
+	g_settings->setU16("max_users", MYMAX(bot_count,
+		(u32) g_settings->getU16("max_users")));
+	g_settings->setBool("server_announce", false);
+	g_settings->setBool("profiler.trace", true);
+
+	actionstream << "Benchmark: " << bot_count << " clients for " << duration
+		<< " s, game " << gamespec.id << ", seed " << seed << std::endl;
+
+	bool success;
+	try {
+		Server server(world_path, gamespec, false, false, true);
+		server.start(Address(0, 0, 0, 0, port));
+		success = run_benchmark_server(server, Address(127, 0, 0, 1, port),
+			bot_count, duration);
+	} catch (const ModError &e) {
+		errorstream << "ModError: " << e.what() << std::endl;
+		success = false;
+	} catch (const ServerError &e) {
+		errorstream << "ServerError: " << e.what() << std::endl;
+		success = false;
+	}
+
+	fs::RecursiveDelete(world_path);
+	return success;
+}
@@ -0,0 +1,60 @@
+/*
+MultiCraft
+Copyright (C) 2026 MultiCraft Development Team
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef BENCHMARK_HEADER
+#define BENCHMARK_HEADER
+
+#include <string>
+
+class Settings;
+struct SubgameSpec;
+
+/*
+	Headless server benchmark
+
+	Generates a fresh world with a fixed seed, connects a number of bot
+	clients over loopback and lets them walk, dig and place for a while.
+	Prints server tick, emerge and block delivery latencies as well as the
+	bandwidth used per client.
+*/
+bool run_benchmark(const Settings &cmd_args);
+
+/*
+	MapBlock serialization benchmark
+
+	Serializes and deserializes a fixed set of typical blocks in the disk
+	and network formats, through streams and through reused buffers.
+	Prints the throughput in blocks per second.
+*/
+bool run_serialize_benchmark(const Settings &cmd_args);
+
+/*
+	Pathfinder benchmark
+
+	Looks for paths between fixed pairs of positions on flat, hilly and
+	walled terrains with each algorithm. Prints the paths per second and
+	the share of queries that found a path.
+*/
+bool run_pathfinder_benchmark(const Settings &cmd_args);
+
+// Creates a new world for the game given by --gameid or default_game
+bool create_benchmark_world(const Settings &cmd_args, SubgameSpec &gamespec,
+		std::string &world_path);
+
+#endif
@@ -0,0 +1,249 @@
+/*
+MultiCraft
+Copyright (C) 2026 MultiCraft Development Team
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark/benchmark.h"
+#include <cmath>
+#include <iomanip>
+#include "exceptions.h"
+#include "filesys.h"
+#include "log.h"
+#include "map.h"
+#include "mapblock.h"
+#include "nodedef.h"
+#include "noise.h"
+#include "pathfinder.h"
+#include "porting.h"
+#include "server.h"
+#include "serverenvironment.h"
+#include "subgame.h"
+
+// Size of the terrain in nodes, along X and Z
+#define PATHFINDER_BENCHMARK_SIZE 128
+#define PATHFINDER_BENCHMARK_QUERIES 200
+#define PATHFINDER_BENCHMARK_SEARCHDISTANCE 8
+// Long routes cross most of the terrain
+#define PATHFINDER_BENCHMARK_LONG_QUERIES 20
+#define PATHFINDER_BENCHMARK_LONG_SEARCHDISTANCE 16
+// Minimum measured time per terrain and algorithm, in seconds
+#define PATHFINDER_BENCHMARK_TIME 1.0f
+
+/*
+	Terrains are described by the height of the topmost solid node of
+	each column. Walls are higher than a mob can jump.
+*/
+enum BenchmarkTerrain {
+	TERRAIN_FLAT,
+	TERRAIN_HILLS,
+	TERRAIN_ROOMS,
+	TERRAIN_ENCLOSED,
+	TERRAIN_COUNT
+};
+
+static const char *terrain_names[TERRAIN_COUNT] = {
+	"Flat",
+	"Hills",
+	"Rooms with doors",
+	"Enclosed target",
+};
+
+static s16 terrain_height(BenchmarkTerrain terrain, s16 x, s16 z)
+{
+	switch (terrain) {
+	case TERRAIN_HILLS:
+		return floor(3 * sin(x / 6.0f) + 3 * cos(z / 8.0f) + 0.5f);
+	case TERRAIN_ROOMS: {
+		// 7x7 rooms, some of the doors in the middle of the walls are shut
+		bool wall_x = x % 8 == 0, wall_z = z % 8 == 0;
+		if (!wall_x && !wall_z)
+			return 0;
+		if (wall_x && wall_z)
+			return 3;
+		s16 along = wall_x ? z : x;
+		bool shut = ((x / 8) * 7 + (z / 8) * 3) % 4 == 0;
+		return along % 8 == 4 && !shut ? 0 : 3;
+	}
+	case TERRAIN_ENCLOSED: {
+		// A ring of walls around every 16th column
+		s16 dx = abs(x % 16 - 8), dz = abs(z % 16 - 8);
+		return MYMAX(dx, dz) == 2 ? 3 : 0;
+	}
+	default:
+		return 0;
+	}
+}
+
+static void fill_terrain(ServerMap &map, INodeDefManager *ndef,
+		BenchmarkTerrain terrain)
+{
+	content_t c_stone = ndef->getId("mapgen_stone");
+	MapEditEvent event;
+	event.type = MEET_OTHER;
+	for (s16 bz = 0; bz < PATHFINDER_BENCHMARK_SIZE / MAP_BLOCKSIZE; bz++)
+	for (s16 bx = 0; bx < PATHFINDER_BENCHMARK_SIZE / MAP_BLOCKSIZE; bx++)
+	for (s16 by = -1; by <= 1; by++) {
+		v3s16 blockpos(bx, by, bz);
+		MapBlock *block = map.getBlockNoCreateNoEx(blockpos);
+		if (!block)
+			block = map.createBlock(blockpos);
+		v3s16 p0 = blockpos * MAP_BLOCKSIZE;
+		for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+		for (s16 x = 0; x < MAP_BLOCKSIZE; x++) {
+			s16 height = terrain_height(terrain, p0.X + x, p0.Z + z);
+			for (s16 y = 0; y < MAP_BLOCKSIZE; y++) {
+				MapNode n(p0.Y + y <= height ? c_stone : CONTENT_AIR);
+				block->setNodeNoCheck(x, y, z, n);
+			}
+		}
+		event.modified_blocks.insert(blockpos);
+	}
+	// Updates the navigation cache
+	map.dispatchEvent(&event);
+}
+
+struct PathQuery
+{
+	v3s16 source;
+	v3s16 destination;
+};
+
+static v3s16 random_surface_pos(BenchmarkTerrain terrain, PseudoRandom &pr,
+		bool target)
+{
+	const s16 margin = PATHFINDER_BENCHMARK_SEARCHDISTANCE + 1;
+	for (;;) {
+		s16 x = pr.range(margin, PATHFINDER_BENCHMARK_SIZE - margin);
+		s16 z = pr.range(margin, PATHFINDER_BENCHMARK_SIZE - margin);
+		if (terrain == TERRAIN_ENCLOSED && target) {
+			// Inside one of the rings
+			x = x / 16 * 16 + 8;
+			z = z / 16 * 16 + 8;
+		}
+		s16 height = terrain_height(terrain, x, z);
+		if (height < 3)
+			return v3s16(x, height + 1, z);
+	}
+}
+
+static void make_queries(BenchmarkTerrain terrain, u32 count,
+		int min_distance, int max_distance, std::vector<PathQuery> &queries)
+{
+	PseudoRandom pr(13107 + terrain);
+	while (queries.size() < count) {
+		PathQuery q;
+		q.source = random_surface_pos(terrain, pr, false);
+		q.destination = random_surface_pos(terrain, pr, true);
+		v3s16 d = q.destination - q.source;
+		int distance = abs(d.X) + abs(d.Z);
+		if (distance >= min_distance && distance <= max_distance &&
+				q.source != q.destination)
+			queries.push_back(q);
+	}
+}
+
+static void measure_paths(ServerEnvironment *env,
+		const std::vector<PathQuery> &queries, int searchdistance,
+		PathAlgorithm algo, const char *label, bool cold_cache = false)
+{
+	u32 count = 0, found = 0, nodes = 0;
+	u64 start = porting::getTimeUs();
+	u64 elapsed;
+	do {
+		for (size_t i = 0; i < queries.size(); i++) {
+			if (cold_cache)
+				env->getNavigationCache().clear();
+			std::vector<v3s16> path = get_path(env, queries[i].source,
+				queries[i].destination, searchdistance, 1, 2, algo);
+			if (!path.empty()) {
+				found++;
+				nodes += path.size();
+			}
+		}
+		count += queries.size();
+		elapsed = porting::getTimeUs() - start;
+	} while (elapsed < PATHFINDER_BENCHMARK_TIME * 1000000);
+
+	rawstream << "  " << std::left << std::setw(22) << label << std::right
+		<< std::setw(10) << count * 1000000.0f / elapsed << " paths/s"
+		<< std::setw(8) << elapsed / (float)count << " us/path"
+		<< "  found " << std::setw(3) << 100 * found / count << " %";
+	if (found > 0)
+		rawstream << ", avg length " << nodes / found;
+	rawstream << std::endl;
+}
+
+static void benchmark_paths(Server *server)
+{
+	ServerEnvironment *env = &server->getEnv();
+	ServerMap &map = env->getServerMap();
+	INodeDefManager *ndef = server->ndef();
+
+	rawstream << std::fixed << std::setprecision(1);
+	rawstream << "Pathfinder benchmark (" << PATHFINDER_BENCHMARK_QUERIES
+		<< " queries, search distance " << PATHFINDER_BENCHMARK_SEARCHDISTANCE
+		<< ")" << std::endl;
+	for (int t = 0; t < TERRAIN_COUNT; t++) {
+		BenchmarkTerrain terrain = (BenchmarkTerrain)t;
+		fill_terrain(map, ndef, terrain);
+		// Mobs mostly look for paths of a few dozen nodes
+		std::vector<PathQuery> queries;
+		make_queries(terrain, PATHFINDER_BENCHMARK_QUERIES, 0, 48, queries);
+		std::vector<PathQuery> long_queries;
+		make_queries(terrain, PATHFINDER_BENCHMARK_LONG_QUERIES, 128, 256,
+			long_queries);
+
+		const int distance = PATHFINDER_BENCHMARK_SEARCHDISTANCE;
+		const int long_distance = PATHFINDER_BENCHMARK_LONG_SEARCHDISTANCE;
+		rawstream << terrain_names[t] << std::endl;
+		measure_paths(env, queries, distance, PA_PLAIN_NP, "A* (default)");
+		measure_paths(env, queries, distance, PA_PLAIN, "A* (prefetch)");
+		measure_paths(env, queries, distance, PA_DIJKSTRA, "Dijkstra");
+		measure_paths(env, queries, distance, PA_HIERARCHICAL, "Hierarchical");
+		measure_paths(env, queries, distance, PA_HIERARCHICAL,
+			"Hierarchical (cold)", true);
+		measure_paths(env, long_queries, long_distance, PA_PLAIN_NP,
+			"Long A*");
+		measure_paths(env, long_queries, long_distance, PA_HIERARCHICAL,
+			"Long hierarchical");
+		measure_paths(env, long_queries, long_distance, PA_HIERARCHICAL,
+			"Long hier. (cold)", true);
+	}
+}
+
+bool run_pathfinder_benchmark(const Settings &cmd_args)
+{
+	SubgameSpec gamespec;
+	std::string world_path;
+	if (!create_benchmark_world(cmd_args, gamespec, world_path))
+		return false;
+
+	bool success = true;
+	try {
+		Server server(world_path, gamespec, false, false, true);
+		benchmark_paths(&server);
+	} catch (const ModError &e) {
+		errorstream << "ModError: " << e.what() << std::endl;
+		success = false;
+	} catch (const ServerError &e) {
+		errorstream << "ServerError: " << e.what() << std::endl;
+		success = false;
+	}
+
+	fs::RecursiveDelete(world_path);
+	return success;
+}
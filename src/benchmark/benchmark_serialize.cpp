@@ -0,0 +1,218 @@
+/*
+MultiCraft
+Copyright (C) 2026 MultiCraft Development Team
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark/benchmark.h"
+#include <iomanip>
+#include <sstream>
+#include "exceptions.h"
+#include "filesys.h"
+#include "log.h"
+#include "mapblock.h"
+#include "nodedef.h"
+#include "noise.h"
+#include "porting.h"
+#include "server.h"
+#include "subgame.h"
+
+#define SERIALIZE_BENCHMARK_BLOCKS 1000
+// Minimum measured time per format and method, in seconds
+#define SERIALIZE_BENCHMARK_TIME 1.0f
+
+/*
+	A mix of blocks like the ones that are loaded on a server: open air,
+	underground with ores and caves, and surface blocks with water.
+*/
+static void fill_block(MapBlock *block, INodeDefManager *ndef,
+		PseudoRandom &pr)
+{
+	content_t c_stone = ndef->getId("mapgen_stone");
+	content_t c_water = ndef->getId("mapgen_water_source");
+	content_t c_dirt = ndef->getId("mapgen_dirt");
+	content_t c_ore = ndef->getId("mapgen_stone_with_coal");
+	if (c_dirt == CONTENT_IGNORE)
+		c_dirt = c_stone;
+	if (c_ore == CONTENT_IGNORE)
+		c_ore = c_dirt;
+	if (c_water == CONTENT_IGNORE)
+		c_water = CONTENT_AIR;
+
+	int kind = pr.range(0, 9);
+	s16 base = pr.range(0, MAP_BLOCKSIZE - 1);
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+	for (s16 x = 0; x < MAP_BLOCKSIZE; x++) {
+		s16 height = kind < 4 ? -1 : kind < 7 ? MAP_BLOCKSIZE :
+			base + (x + z) / 8;
+		for (s16 y = 0; y < MAP_BLOCKSIZE; y++) {
+			MapNode n(CONTENT_AIR, LIGHT_SUN);
+			if (y < height - 3) {
+				n = MapNode(c_stone);
+				if (pr.range(0, 99) < 3)
+					n = MapNode(c_ore);
+				else if (kind >= 4 && kind < 7 && pr.range(0, 99) < 5)
+					n = MapNode(CONTENT_AIR);
+			} else if (y < height) {
+				n = MapNode(c_dirt);
+			} else if (y < 4) {
+				n = MapNode(c_water, 0xaa);
+			}
+			block->setNode(x, y, z, n);
+		}
+	}
+}
+
+typedef void (*SerializeMethod)(MapBlock *block, std::string &data,
+	bool disk, BlockSerializeBuffers &buffers);
+typedef void (*DeSerializeMethod)(MapBlock *block, const std::string &data,
+	bool disk, BlockSerializeBuffers &buffers);
+
+static void serialize_stream(MapBlock *block, std::string &data, bool disk,
+		BlockSerializeBuffers &buffers)
+{
+	std::ostringstream os(std::ios_base::binary);
+	block->serialize(os, SER_FMT_VER_HIGHEST_WRITE, disk);
+	if (!disk)
+		block->serializeNetworkSpecific(os);
+	data = os.str();
+}
+
+static void serialize_buffer(MapBlock *block, std::string &data, bool disk,
+		BlockSerializeBuffers &buffers)
+{
+	data.clear();
+	block->serialize(data, SER_FMT_VER_HIGHEST_WRITE, disk, buffers);
+	if (!disk)
+		block->serializeNetworkSpecific(data);
+}
+
+static void deserialize_stream(MapBlock *block, const std::string &data,
+		bool disk, BlockSerializeBuffers &buffers)
+{
+	std::istringstream is(data, std::ios_base::binary);
+	block->deSerialize(is, SER_FMT_VER_HIGHEST_WRITE, disk);
+}
+
+static void deserialize_buffer(MapBlock *block, const std::string &data,
+		bool disk, BlockSerializeBuffers &buffers)
+{
+	block->deSerialize((const u8 *)data.c_str(), data.size(),
+		SER_FMT_VER_HIGHEST_WRITE, disk, buffers);
+}
+
+// Returns blocks per second
+static float measure_serialize(std::vector<MapBlock *> &blocks, bool disk,
+		SerializeMethod method)
+{
+	BlockSerializeBuffers buffers;
+	std::string data;
+	u64 start = porting::getTimeUs();
+	u64 count = 0;
+	u64 elapsed;
+	do {
+		for (size_t i = 0; i < blocks.size(); i++)
+			method(blocks[i], data, disk, buffers);
+		count += blocks.size();
+		elapsed = porting::getTimeUs() - start;
+	} while (elapsed < SERIALIZE_BENCHMARK_TIME * 1000000);
+	return count * 1000000.0f / elapsed;
+}
+
+static float measure_deserialize(MapBlock *block,
+		const std::vector<std::string> &datas, bool disk,
+		DeSerializeMethod method)
+{
+	BlockSerializeBuffers buffers;
+	u64 start = porting::getTimeUs();
+	u64 count = 0;
+	u64 elapsed;
+	do {
+		for (size_t i = 0; i < datas.size(); i++)
+			method(block, datas[i], disk, buffers);
+		count += datas.size();
+		elapsed = porting::getTimeUs() - start;
+	} while (elapsed < SERIALIZE_BENCHMARK_TIME * 1000000);
+	return count * 1000000.0f / elapsed;
+}
+
+static void print_result(const char *label, float stream, float buffer)
+{
+	rawstream << std::left << std::setw(24) << label << std::right
+		<< std::setw(10) << stream << " blocks/s"
+		<< std::setw(12) << buffer << " blocks/s" << std::endl;
+}
+
+static void benchmark_blocks(IGameDef *gamedef)
+{
+	PseudoRandom pr(13107);
+	std::vector<MapBlock *> blocks;
+	for (u32 i = 0; i < SERIALIZE_BENCHMARK_BLOCKS; i++) {
+		MapBlock *block = new MapBlock(NULL, v3s16(i, 0, 0), gamedef);
+		fill_block(block, gamedef->ndef(), pr);
+		block->compact();
+		blocks.push_back(block);
+	}
+
+	rawstream << std::fixed << std::setprecision(0);
+	rawstream << "Serialization benchmark (" << blocks.size()
+		<< " blocks)" << std::endl;
+	rawstream << std::left << std::setw(24) << "" << std::right
+		<< std::setw(19) << "Stream" << std::setw(21) << "Buffer"
+		<< std::endl;
+
+	MapBlock target(NULL, v3s16(0, 0, 0), gamedef);
+	for (int disk = 1; disk >= 0; disk--) {
+		std::vector<std::string> datas(blocks.size());
+		BlockSerializeBuffers buffers;
+		for (size_t i = 0; i < blocks.size(); i++)
+			serialize_buffer(blocks[i], datas[i], disk, buffers);
+
+		print_result(disk ? "Save" : "Network send",
+			measure_serialize(blocks, disk, serialize_stream),
+			measure_serialize(blocks, disk, serialize_buffer));
+		print_result(disk ? "Load" : "Network receive",
+			measure_deserialize(&target, datas, disk, deserialize_stream),
+			measure_deserialize(&target, datas, disk, deserialize_buffer));
+	}
+
+	for (size_t i = 0; i < blocks.size(); i++)
+		delete blocks[i];
+}
+
+bool run_serialize_benchmark(const Settings &cmd_args)
+{
+	SubgameSpec gamespec;
+	std::string world_path;
+	if (!create_benchmark_world(cmd_args, gamespec, world_path))
+		return false;
+
+	bool success = true;
+	try {
+		// The server provides the node definitions of the game
+		Server server(world_path, gamespec, false, false, true);
+		benchmark_blocks(&server);
+	} catch (const ModError &e) {
+		errorstream << "ModError: " << e.what() << std::endl;
+		success = false;
+	} catch (const ServerError &e) {
+		errorstream << "ServerError: " << e.what() << std::endl;
+		success = false;
+	}
+
+	fs::RecursiveDelete(world_path);
+	return success;
+}
@@ -0,0 +1,287 @@
+/*
+MultiCraft
+Copyright (C) 2026 MultiCraft Development Team
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark/bot_client.h"
+#include <cmath>
+#include <sstream>
+#include "config.h"
+#include "constants.h"
+#include "log.h"
+#include "mapblock.h"
+#include "porting.h"
+#include "serialization.h"
+#include "version.h"
+#include "network/networkpacket.h"
+#include "network/networkprotocol.h"
+#include "util/auth.h"
+#include "util/numeric.h"
+
+// Walking speed of the bots, in nodes per second
+#define BOT_SPEED 5.0f
+// Interval of position updates, in seconds
+#define BOT_SEND_INTERVAL 0.1f
+// Interval of dig/place actions, in seconds
+#define BOT_ACTION_INTERVAL 1.0f
+// Requested view range, in mapblocks
+#define BOT_WANTED_RANGE 8
+
+BotClient::BotClient(const std::string &name, float heading) :
+	m_name(name),
+	m_con(PROTOCOL_ID, 512, CONNECTION_TIMEOUT, false, NULL),
+	m_state(BOT_CONNECTING),
+	m_init_timer(0),
+	m_connect_us(0),
+	m_join_time_us(0),
+	m_position(0, 0, 0),
+	m_yaw(heading * core::RADTODEG),
+	m_send_timer(0),
+	m_action_timer(0),
+	m_action_count(0),
+	m_current_block(0, -MAX_MAP_GENERATION_LIMIT, 0),
+	m_waiting_since_us(0),
+	m_bytes_received(0),
+	m_blocks_received(0)
+{
+	m_speed = v3f(std::cos(heading), 0, std::sin(heading)) * BOT_SPEED * BS;
+	m_con.SetTimeoutMs(0);
+}
+
+BotClient::~BotClient()
+{
+	m_con.Disconnect();
+}
+
+void BotClient::connect(const Address &address)
+{
+	m_connect_us = porting::getTimeUs();
+	m_con.Connect(address);
+	sendInit();
+}
+
+void BotClient::resetStats()
+{
+	m_bytes_received = 0;
+	m_blocks_received = 0;
+	m_block_latencies.clear();
+	m_waiting_since_us = 0;
+}
+
+void BotClient::send(NetworkPacket *pkt, u8 channel, bool reliable)
+{
+	m_con.Send(PEER_ID_SERVER, channel, pkt, reliable);
+}
+
+void BotClient::step(float dtime)
+{
+	for (;;) {
+		NetworkPacket pkt;
+		try {
+			m_con.Receive(&pkt);
+		} catch (con::NoIncomingDataException &e) {
+			break;
+		} catch (con::InvalidIncomingDataException &e) {
+			continue;
+		}
+		handlePacket(&pkt);
+	}
+
+	if (m_state == BOT_CONNECTING) {
+		// TOSERVER_INIT is unreliable, repeat it until the server answers
+		m_init_timer += dtime;
+		if (m_init_timer >= 1.0f) {
+			m_init_timer = 0;
+			sendInit();
+		}
+		return;
+	}
+
+	if (m_state == BOT_JOINED)
+		act(dtime);
+}
+
+void BotClient::act(float dtime)
+{
+	m_position += m_speed * dtime;
+
+	v3s16 blockpos = getNodeBlockPos(floatToInt(m_position, BS));
+	if (blockpos != m_current_block) {
+		m_current_block = blockpos;
+		if (m_received_blocks.count(blockpos) == 0) {
+			m_waiting_since_us = porting::getTimeUs();
+		} else {
+			m_waiting_since_us = 0;
+			m_block_latencies.push_back(0);
+		}
+	}
+
+	m_send_timer += dtime;
+	if (m_send_timer >= BOT_SEND_INTERVAL) {
+		m_send_timer = 0;
+		NetworkPacket pkt(TOSERVER_PLAYERPOS, 12 + 12 + 4 + 4 + 4 + 1 + 1);
+		sendPosition(&pkt);
+	}
+
+	m_action_timer += dtime;
+	if (m_action_timer < BOT_ACTION_INTERVAL)
+		return;
+	m_action_timer = 0;
+
+	// Alternate between digging and placing right below the bot
+	v3s16 p = floatToInt(m_position, BS);
+	PointedThing pointed;
+	pointed.type = POINTEDTHING_NODE;
+	pointed.node_undersurface = p - v3s16(0, 1, 0);
+	pointed.node_abovesurface = p;
+	pointed.node_real_undersurface = pointed.node_undersurface;
+
+	if (m_action_count++ % 2 == 0) {
+		sendInteract(0, pointed); // start digging
+		sendInteract(2, pointed); // digging completed
+	} else {
+		sendInteract(3, pointed); // place
+	}
+}
+
+void BotClient::sendInit()
+{
+	NetworkPacket pkt(TOSERVER_INIT, 1 + 2 + 2 + 2 + (2 + m_name.size()));
+	pkt << (u8) SER_FMT_VER_HIGHEST_READ << (u16) NETPROTO_COMPRESSION_NONE;
+	pkt << (u16) CLIENT_PROTOCOL_VERSION_MIN << (u16) CLIENT_PROTOCOL_VERSION_MAX;
+	pkt << m_name;
+	send(&pkt, 1, false);
+}
+
+void BotClient::sendPosition(NetworkPacket *pkt)
+{
+	v3f pf = m_position * 100;
+	v3f sf = m_speed * 100;
+	*pkt << v3s32(pf.X, pf.Y, pf.Z) << v3s32(sf.X, sf.Y, sf.Z);
+	*pkt << (s32) 0 << (s32) (m_yaw * 100);
+	*pkt << (u32) 0 << (u8) (72.0f * core::DEGTORAD * 80)
+		<< (u8) BOT_WANTED_RANGE;
+
+	if (pkt->getCommand() == TOSERVER_PLAYERPOS)
+		send(pkt, 0, false);
+	else
+		send(pkt, 0, true);
+}
+
+void BotClient::sendInteract(u8 action, const PointedThing &pointed)
+{
+	NetworkPacket pkt(TOSERVER_INTERACT, 1 + 2 + 0);
+	pkt << action << (u16) 0;
+
+	std::ostringstream os(std::ios::binary);
+	pointed.serialize(os);
+	pkt.putLongString(os.str());
+
+	sendPosition(&pkt);
+}
+
+void BotClient::handlePacket(NetworkPacket *pkt)
+{
+	m_bytes_received += pkt->getSize() + 2;
+
+	switch (pkt->getCommand()) {
+	case TOCLIENT_HELLO: {
+		if (m_state != BOT_CONNECTING)
+			break;
+		u8 ser_ver;
+		u16 compression, proto_ver;
+		u32 auth_mechs;
+		*pkt >> ser_ver >> compression >> proto_ver >> auth_mechs;
+
+		// Bots only ever register; an existing account needs a password
+		if (!(auth_mechs & AUTH_MECHANISM_FIRST_SRP)) {
+			errorstream << "Benchmark bot " << m_name
+				<< ": account already exists" << std::endl;
+			m_state = BOT_DENIED;
+			break;
+		}
+
+		std::string verifier, salt;
+		generate_srp_verifier_and_salt(m_name, "", &verifier, &salt);
+		NetworkPacket resp(TOSERVER_FIRST_SRP, 0);
+		resp << salt << verifier << (u8) 1;
+		send(&resp, 1, true);
+		m_state = BOT_AUTHENTICATING;
+		break;
+	}
+	case TOCLIENT_AUTH_ACCEPT: {
+		*pkt >> m_position;
+		m_position -= v3f(0, BS / 2, 0);
+
+		NetworkPacket resp(TOSERVER_INIT2, 0);
+		send(&resp, 1, true);
+		break;
+	}
+	case TOCLIENT_ANNOUNCE_MEDIA: {
+		// Sent after the definitions; media is not needed by bots
+		if (m_state != BOT_AUTHENTICATING)
+			break;
+		NetworkPacket resp(TOSERVER_CLIENT_READY,
+			1 + 1 + 1 + 1 + 2 + strlen(g_version_hash));
+		resp << (u8) VERSION_MAJOR << (u8) VERSION_MINOR
+			<< (u8) VERSION_PATCH << (u8) 0
+			<< (u16) strlen(g_version_hash);
+		resp.putRawString(g_version_hash, (u16) strlen(g_version_hash));
+		send(&resp, 0, true);
+
+		m_state = BOT_JOINED;
+		m_join_time_us = porting::getTimeUs() - m_connect_us;
+		break;
+	}
+	case TOCLIENT_MOVE_PLAYER: {
+		*pkt >> m_position;
+		break;
+	}
+	case TOCLIENT_BLOCKDATA: {
+		if (pkt->getSize() < 6)
+			break;
+		v3s16 p;
+		*pkt >> p;
+
+		NetworkPacket resp(TOSERVER_GOTBLOCKS, 1 + 6);
+		resp << (u8) 1 << p;
+		send(&resp, 2, true);
+
+		m_blocks_received++;
+		m_received_blocks.insert(p);
+		if (p == m_current_block && m_waiting_since_us != 0) {
+			m_block_latencies.push_back(MYMIN(
+				porting::getTimeUs() - m_waiting_since_us, (u64) U32_MAX));
+			m_waiting_since_us = 0;
+		}
+		break;
+	}
+	case TOCLIENT_DEATHSCREEN: {
+		NetworkPacket resp(TOSERVER_RESPAWN, 0);
+		send(&resp, 0, true);
+		break;
+	}
+	case TOCLIENT_ACCESS_DENIED:
+	case TOCLIENT_ACCESS_DENIED_LEGACY:
+		errorstream << "Benchmark bot " << m_name
+			<< ": access denied" << std::endl;
+		m_state = BOT_DENIED;
+		break;
+	default:
+		break;
+	}
+}
@@ -0,0 +1,107 @@
+/*
+MultiCraft
+Copyright (C) 2026 MultiCraft Development Team
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef BOT_CLIENT_HEADER
+#define BOT_CLIENT_HEADER
+
+#include "irrlichttypes_bloated.h"
+#include "network/connection.h"
+#include "util/pointedthing.h"
+#include <set>
+#include <string>
+#include <vector>
+
+class NetworkPacket;
+
+enum BotState
+{
+	BOT_CONNECTING,
+	BOT_AUTHENTICATING,
+	BOT_JOINED,
+	BOT_DENIED
+};
+
+/*
+	Minimal scripted client for the server benchmark.
+
+	Speaks the real protocol over a loopback connection, but keeps no map:
+	it only acknowledges blocks and measures how long it takes until the
+	block it is standing in arrives. After joining it walks away from the
+	spawn point in the given direction, digging and placing below itself.
+*/
+
+class BotClient
+{
+public:
+	BotClient(const std::string &name, float heading);
+	~BotClient();
+
+	void connect(const Address &address);
+	void step(float dtime);
+
+	BotState getState() const { return m_state; }
+	const std::string &getName() const { return m_name; }
+
+	// Resets the statistics, e.g. after warming up
+	void resetStats();
+	u64 getBytesReceived() const { return m_bytes_received; }
+	u32 getBlocksReceived() const { return m_blocks_received; }
+	// Time between entering a mapblock and receiving it, in microseconds;
+	// zero for blocks that were received in advance
+	const std::vector<u32> &getBlockLatencies() const
+	{
+		return m_block_latencies;
+	}
+	// Time between connecting and being able to act, in microseconds
+	u64 getJoinTime() const { return m_join_time_us; }
+
+private:
+	void send(NetworkPacket *pkt, u8 channel, bool reliable);
+	void handlePacket(NetworkPacket *pkt);
+	void sendInit();
+	void sendPosition(NetworkPacket *pkt);
+	void sendInteract(u8 action, const PointedThing &pointed);
+	void act(float dtime);
+
+	std::string m_name;
+	con::Connection m_con;
+	BotState m_state;
+
+	float m_init_timer;
+	u64 m_connect_us;
+	u64 m_join_time_us;
+
+	v3f m_position;
+	v3f m_speed;
+	float m_yaw;
+	float m_send_timer;
+	float m_action_timer;
+	u32 m_action_count;
+
+	v3s16 m_current_block;
+	// Zero unless the current block hasn't been received yet
+	u64 m_waiting_since_us;
+	std::set<v3s16> m_received_blocks;
+
+	u64 m_bytes_received;
+	u32 m_blocks_received;
+	std::vector<u32> m_block_latencies;
+};
+
+#endif
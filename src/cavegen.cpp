@@ -70,11 +70,41 @@ void CavesNoiseIntersection::generateCaves(MMVManip *vm,
 	assert(vm);
 	assert(biomemap);
 
+	v3s16 em = vm->m_area.getExtent();
+	u32 index2d = 0;  // Biomemap index
+
+	// Noise is only sampled at ground nodes, so rows above the highest one
+	// are left out of the noise volume.  The volume keeps its origin, which
+	// gives the same values as computing all of it.
+	s16 ground_max_y = nmin.Y - 2;
+	for (s16 z = nmin.Z; z <= nmax.Z; z++)
+	for (s16 x = nmin.X; x <= nmax.X; x++, index2d++) {
+		Biome *biome = (Biome *)m_bmgr->getRaw(biomemap[index2d]);
+		u32 vi = vm->m_area.index(x, nmax.Y, z);
+		for (s16 y = nmax.Y; y > ground_max_y; y--,
+				vm->m_area.add_y(em, vi, -1)) {
+			content_t c = vm->m_data[vi].getContent();
+			if (c != CONTENT_AIR && c != biome->c_water_top &&
+					c != biome->c_water && c != biome->c_river_water) {
+				ground_max_y = y;
+				break;
+			}
+		}
+	}
+	if (ground_max_y < nmin.Y - 1)
+		return;
+
+	u32 rows = ground_max_y - nmin.Y + 2;
+	if (noise_cave1->sy != rows) {
+		noise_cave1->setSize(m_csize.X, rows, m_csize.Z);
+		noise_cave2->setSize(m_csize.X, rows, m_csize.Z);
+	}
+	m_zstride_1d = m_csize.X * rows;
+
 	noise_cave1->perlinMap3D(nmin.X, nmin.Y - 1, nmin.Z);
 	noise_cave2->perlinMap3D(nmin.X, nmin.Y - 1, nmin.Z);
 
-	v3s16 em = vm->m_area.getExtent();
-	u32 index2d = 0;  // Biomemap index
+	index2d = 0;
 
 	for (s16 z = nmin.Z; z <= nmax.Z; z++)
 	for (s16 x = nmin.X; x <= nmax.X; x++, index2d++) {
@@ -95,6 +125,8 @@ void CavesNoiseIntersection::generateCaves(MMVManip *vm,
 		// this creates a 'roof' over the tunnel, preventing light in
 		// tunnels at mapchunk borders when generating mapchunks upwards.
 		// This 'roof' is removed when the mapchunk above is generated.
+		// index3d is only valid from ground_max_y down, where the first
+		// ground node of a column is found.
 		for (s16 y = nmax.Y; y >= nmin.Y - 1; y--,
 				index3d -= m_ystride,
 				vm->m_area.add_y(em, vi, -1)) {
@@ -195,13 +227,30 @@ bool CavernsNoise::generateCaverns(MMVManip *vm, v3s16 nmin, v3s16 nmax)
 {
 	assert(vm);
 
+	// Nodes at and above cavern_limit have no amplitude and can neither be
+	// excavated nor be near a cavern, unless the threshold is that low.
+	// Rows above them are left out of the noise volume, which keeps its
+	// origin and so gives the same values as computing all of it.
+	s16 y_top = nmax.Y;
+	if (m_cavern_taper > 0 && m_cavern_threshold - 0.1f >= 0.0f &&
+			m_cavern_limit <= nmax.Y) {
+		y_top = (s16)ceil(m_cavern_limit) - 1;
+		if (y_top < nmin.Y - 1)
+			return false;
+	}
+
+	u32 rows = y_top - nmin.Y + 2;
+	if (noise_cavern->sy != rows)
+		noise_cavern->setSize(m_csize.X, rows, m_csize.Z);
+	m_zstride_1d = m_csize.X * rows;
+
 	// Calculate noise
 	noise_cavern->perlinMap3D(nmin.X, nmin.Y - 1, nmin.Z);
 
 	// Cache cavern_amp values
-	float *cavern_amp = new float[m_csize.Y + 1];
+	float *cavern_amp = new float[rows];
 	u8 cavern_amp_index = 0;  // Index zero at column top
-	for (s16 y = nmax.Y; y >= nmin.Y - 1; y--, cavern_amp_index++) {
+	for (s16 y = y_top; y >= nmin.Y - 1; y--, cavern_amp_index++) {
 		cavern_amp[cavern_amp_index] =
 			MYMIN((m_cavern_limit - y) / (float)m_cavern_taper, 1.0f);
 	}
@@ -216,15 +265,15 @@ bool CavernsNoise::generateCaverns(MMVManip *vm, v3s16 nmin, v3s16 nmax)
 		// Reset cave_amp index to column top
 		cavern_amp_index = 0;
 		// Initial voxelmanip index at column top
-		u32 vi = vm->m_area.index(x, nmax.Y, z);
+		u32 vi = vm->m_area.index(x, y_top, z);
 		// Initial 3D noise index at column top
-		u32 index3d = (z - nmin.Z) * m_zstride_1d + m_csize.Y * m_ystride +
+		u32 index3d = (z - nmin.Z) * m_zstride_1d + (rows - 1) * m_ystride +
 			(x - nmin.X);
 		// Don't excavate the overgenerated stone at node_max.Y + 1,
 		// this creates a 'roof' over the cavern, preventing light in
 		// caverns at mapchunk borders when generating mapchunks upwards.
 		// This 'roof' is excavated when the mapchunk above is generated.
-		for (s16 y = nmax.Y; y >= nmin.Y - 1; y--,
+		for (s16 y = y_top; y >= nmin.Y - 1; y--,
 				index3d -= m_ystride,
 				vm->m_area.add_y(em, vi, -1),
 				cavern_amp_index++) {
@@ -123,6 +123,7 @@ Client::Client(
 	m_recommended_send_interval(0.1),
 	m_removed_sounds_check_timer(0),
 	m_state(LC_Created),
+	m_block_buffers(new BlockSerializeBuffers),
 	m_localdb(NULL),
 	m_script(NULL),
 	m_mod_storage_save_timer(10.0f),
@@ -271,6 +272,7 @@ Client::~Client()
 
 	delete m_minimap;
 	delete m_media_downloader;
+	delete m_block_buffers;
 }
 
 void Client::connect(Address address, bool is_local_server)
@@ -1291,7 +1293,7 @@ void Client::sendReady()
 			1 + 1 + 1 + 1 + 2 + sizeof(char) * strlen(g_version_hash));
 
 	pkt << (u8) VERSION_MAJOR << (u8) VERSION_MINOR << (u8) VERSION_PATCH
-		<< (u8) 0 << (u16) strlen(g_version_hash);
+		<< (u8) CLIENT_FEATURE_INVENTORY_DELTA << (u16) strlen(g_version_hash);
 
 	pkt.putRawString(g_version_hash, (u16) strlen(g_version_hash));
 	Send(&pkt);
@@ -1721,6 +1723,7 @@ void Client::afterContentReceived(IrrlichtDevice *device)
 	// Rebuild inherited images and recreate textures
 	infostream<<"- Rebuilding images and textures"<<std::endl;
 	draw_load_screen(text,device, guienv, m_tsrc, 0, 70);
+	m_tsrc->loadCompositeImages(m_media_set_digest);
 	m_tsrc->rebuildImagesAndTextures();
 	delete[] text;
 
@@ -1754,6 +1757,7 @@ void Client::afterContentReceived(IrrlichtDevice *device)
 	tu_args.tsrc = m_tsrc;
 	m_nodedef->updateTextures(this, texture_update_progress, &tu_args);
 	delete[] tu_args.text_base;
+	m_tsrc->saveCompositeImages();
 
 	// Start mesh update thread after setting up content definitions
 	infostream<<"- Starting mesh update thread"<<std::endl;
@@ -52,6 +52,7 @@ struct MapDrawControl;
 class MtEventManager;
 struct PointedThing;
 class MapDatabase;
+struct BlockSerializeBuffers;
 class Minimap;
 struct MinimapMapblock;
 class Camera;
@@ -315,6 +316,7 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	void handleCommand_AddNode(NetworkPacket* pkt);
 	void handleCommand_BlockData(NetworkPacket* pkt);
 	void handleCommand_Inventory(NetworkPacket* pkt);
+	void handleCommand_InventoryDelta(NetworkPacket* pkt);
 	void handleCommand_TimeOfDay(NetworkPacket* pkt);
 	void handleCommand_ChatMessage(NetworkPacket* pkt);
 	void handleCommand_ActiveObjectRemoveAdd(NetworkPacket* pkt);
@@ -643,6 +645,8 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	bool m_itemdef_received;
 	bool m_nodedef_received;
 	ClientMediaDownloader *m_media_downloader;
+	// Identifies the media of the server, see getMediaSetDigest()
+	std::string m_media_set_digest;
 
 	// time_of_day speed approximation for old protocol
 	bool m_time_of_day_set;
@@ -674,6 +678,9 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	// own state
 	LocalClientState m_state;
 
+	// Reused for every received block
+	BlockSerializeBuffers *m_block_buffers;
+
 	// Used for saving server map to disk client-side
 	MapDatabase *m_localdb;
 	IntervalLimiter m_localdb_save_interval;
@@ -20,6 +20,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "tile.h"
 
 #include <ICameraSceneNode.h>
+#include <fstream>
+#include <sstream>
 #include "util/string.h"
 #include "util/container.h"
 #include "util/thread.h"
@@ -36,6 +38,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "imagefilters.h"
 #include "guiscalingfilter.h"
 #include "nodedef.h"
+#include "porting.h"
+#include "serialization.h"
+#include "version.h"
+#include "util/hex.h"
+#include "util/serialize.h"
+#include "util/sha1.h"
 
 
 #ifdef __ANDROID__
@@ -269,6 +277,67 @@ class SourceImageCache
 	std::map<std::string, video::IImage*> m_images;
 };
 
+/*
+	GeneratedImageCache: A cache of the intermediate images of texture
+	modifier strings, e.g. "default_stone.png^[colorize:red" is generated
+	only once for all the textures that are built on top of it.
+*/
+
+// Memory used for intermediate images before the cache is emptied, in bytes
+#define GENERATED_IMAGE_CACHE_SIZE (16 * 1024 * 1024)
+
+class GeneratedImageCache
+{
+public:
+	GeneratedImageCache(): m_size(0) {}
+	~GeneratedImageCache() { clear(); }
+
+	// Returns a copy of the cached image that may be modified, or NULL
+	video::IImage *getCopy(const std::string &name, video::IVideoDriver *driver)
+	{
+		std::map<std::string, video::IImage*>::iterator n = m_images.find(name);
+		if (n == m_images.end())
+			return NULL;
+		return copyImage(n->second, driver);
+	}
+
+	void insert(const std::string &name, video::IImage *img,
+			video::IVideoDriver *driver)
+	{
+		assert(img); // Pre-condition
+		if (m_images.find(name) != m_images.end())
+			return;
+		u32 size = img->getPitch() * img->getDimension().Height;
+		if (m_size + size > GENERATED_IMAGE_CACHE_SIZE)
+			clear();
+		m_images[name] = copyImage(img, driver);
+		m_size += size;
+	}
+
+	void clear()
+	{
+		for (std::map<std::string, video::IImage*>::iterator iter = m_images.begin();
+				iter != m_images.end(); ++iter) {
+			iter->second->drop();
+		}
+		m_images.clear();
+		m_size = 0;
+	}
+
+private:
+	static video::IImage *copyImage(video::IImage *img,
+			video::IVideoDriver *driver)
+	{
+		video::IImage *copy = driver->createImage(img->getColorFormat(),
+				img->getDimension());
+		img->copyTo(copy);
+		return copy;
+	}
+
+	std::map<std::string, video::IImage*> m_images;
+	u32 m_size;
+};
+
 /*
 	TextureSource
 */
@@ -375,6 +444,15 @@ class TextureSource : public IWritableTextureSource
 	// Shall be called from the main thread.
 	void rebuildImagesAndTextures();
 
+	// Makes the composite images generated in an earlier session with the
+	// same media available, until saveCompositeImages() is called.
+	// Shall be called from the main thread.
+	void loadCompositeImages(const std::string &media_digest);
+
+	// Stores the composite images for the next session.
+	// Shall be called from the main thread.
+	void saveCompositeImages();
+
 	// Render a mesh to a texture.
 	// Returns NULL if render-to-texture failed.
 	// Shall be called from the main thread.
@@ -396,6 +474,10 @@ class TextureSource : public IWritableTextureSource
 	// This should be only accessed from the main thread
 	SourceImageCache m_sourcecache;
 
+	// Cache of intermediate generated images
+	// This should be only accessed from the main thread
+	GeneratedImageCache m_generated_images;
+
 	// Generate a texture
 	u32 generateTexture(const std::string &name);
 
@@ -410,6 +492,9 @@ class TextureSource : public IWritableTextureSource
 	 */
 	video::IImage* generateImage(const std::string &name);
 
+	// Like generateImage, but uses and fills the composite image cache
+	video::IImage* generateOrLoadImage(const std::string &name);
+
 	// Thread-safe cache of what source images are known (true = known)
 	MutexedMap<std::string, bool> m_source_image_existence;
 
@@ -431,6 +516,17 @@ class TextureSource : public IWritableTextureSource
 	// Maps image file names to loaded palettes.
 	UNORDERED_MAP<std::string, Palette> m_palettes;
 
+	// Composite images by texture name, each as u16 width, u16 height and
+	// A8R8G8B8 pixels. Only used while loading.
+	std::map<std::string, std::string> m_composite_images;
+	u32 m_composite_images_size;
+	bool m_composite_images_changed;
+	// Cache file of the current media, empty when not loading
+	std::string m_composite_images_file;
+	std::string m_composite_images_path;
+	// Size of the cache file on disk, 0 if there is none
+	u32 m_composite_images_file_size;
+
 	// Cached settings needed for making textures from meshes
 	bool m_setting_trilinear_filter;
 	bool m_setting_bilinear_filter;
@@ -443,7 +539,10 @@ IWritableTextureSource* createTextureSource(IrrlichtDevice *device)
 }
 
 TextureSource::TextureSource(IrrlichtDevice *device):
-		m_device(device)
+		m_device(device),
+		m_composite_images_size(0),
+		m_composite_images_changed(false),
+		m_composite_images_file_size(0)
 {
 	assert(m_device); // Pre-condition
 
@@ -627,7 +726,7 @@ u32 TextureSource::generateTexture(const std::string &name)
 	video::IVideoDriver *driver = m_device->getVideoDriver();
 	sanity_check(driver);
 
-	video::IImage *img = generateImage(name);
+	video::IImage *img = generateOrLoadImage(name);
 
 	video::ITexture *tex = NULL;
 
@@ -777,6 +876,8 @@ void TextureSource::insertSourceImage(const std::string &name, video::IImage *im
 
 	m_sourcecache.insert(name, img, true, m_device->getVideoDriver());
 	m_source_image_existence.set(name, true);
+	// Images generated from the old source image are outdated
+	m_generated_images.clear();
 }
 
 void TextureSource::rebuildImagesAndTextures()
@@ -786,10 +887,12 @@ void TextureSource::rebuildImagesAndTextures()
 	video::IVideoDriver* driver = m_device->getVideoDriver();
 	sanity_check(driver);
 
+	m_generated_images.clear();
+
 	// Recreate textures
 	for (u32 i=0; i<m_textureinfo_cache.size(); i++){
 		TextureInfo *ti = &m_textureinfo_cache[i];
-		video::IImage *img = generateImage(ti->name);
+		video::IImage *img = generateOrLoadImage(ti->name);
 #if defined(__ANDROID__) || defined(__IOS__)
 		img = Align2Npot2(img, driver);
 #endif
@@ -809,6 +912,223 @@ void TextureSource::rebuildImagesAndTextures()
 	}
 }
 
+/*
+	Composite images are cached on disk for each set of server media,
+	so reconnecting to a server doesn't generate them again.
+*/
+
+#define COMPOSITE_IMAGES_SIGNATURE 0x4d544349 // 'MTCI'
+// Maximum amount of pixel data that is cached, in bytes
+#define COMPOSITE_IMAGES_MAX_SIZE (32 * 1024 * 1024)
+// Lists the cache files as "<name> <size>", most recently used first
+#define COMPOSITE_IMAGES_INDEX "index.txt"
+
+static std::string getCompositeImageCacheDir()
+{
+	return porting::path_cache + DIR_DELIM + "textures";
+}
+
+/*
+	Moves the given cache file to the front of the index and deletes the
+	least recently used files that don't fit into texture_cache_size.
+	The file in use is always kept.
+*/
+static void trimCompositeImageCache(const std::string &used_file, u32 used_size)
+{
+	std::string dir = getCompositeImageCacheDir();
+	std::string index_path = dir + DIR_DELIM + COMPOSITE_IMAGES_INDEX;
+	u64 limit = g_settings->getU64("texture_cache_size") * 1024 * 1024;
+
+	std::vector<std::pair<std::string, u64> > files;
+	files.push_back(std::make_pair(used_file, (u64)used_size));
+	std::ifstream is(index_path.c_str());
+	std::string line;
+	while (std::getline(is, line)) {
+		std::istringstream line_is(line);
+		std::string name;
+		u64 size;
+		if ((line_is >> name >> size) && name != used_file)
+			files.push_back(std::make_pair(name, size));
+	}
+	is.close();
+
+	std::set<std::string> kept;
+	std::ostringstream index_os;
+	u64 total = 0;
+	for (size_t i = 0; i < files.size(); i++) {
+		total += files[i].second;
+		if (i > 0 && total > limit)
+			break;
+		kept.insert(files[i].first);
+		index_os << files[i].first << " " << files[i].second << "\n";
+	}
+
+	// Also removes files that were never listed, e.g. after a crash
+	std::vector<fs::DirListNode> list = fs::GetDirListing(dir);
+	for (size_t i = 0; i < list.size(); i++) {
+		if (list[i].dir || list[i].name == COMPOSITE_IMAGES_INDEX ||
+				kept.count(list[i].name) != 0)
+			continue;
+		infostream << "TextureSource: Removing composite image cache \""
+			<< list[i].name << "\"" << std::endl;
+		fs::DeleteSingleFileOrEmptyDirectory(dir + DIR_DELIM + list[i].name);
+	}
+
+	if (!fs::safeWriteToFile(index_path, index_os.str()))
+		errorstream << "TextureSource: Failed to write \"" << index_path
+			<< "\"" << std::endl;
+}
+
+// Only images that are built from parts or modified are worth caching
+static bool is_composite_image(const std::string &name)
+{
+	return name.find_first_of("^[(") != std::string::npos;
+}
+
+void TextureSource::loadCompositeImages(const std::string &media_digest)
+{
+	sanity_check(thr_is_current_thread(m_main_thread));
+
+	m_composite_images.clear();
+	m_composite_images_size = 0;
+	m_composite_images_changed = false;
+	m_composite_images_file = "";
+	m_composite_images_path = "";
+	m_composite_images_file_size = 0;
+	if (media_digest.empty() || g_settings->getU64("texture_cache_size") == 0)
+		return;
+
+	// The images also depend on the local textures and texture settings
+	std::ostringstream key_os(std::ios_base::binary);
+	key_os << media_digest << '\0' << g_version_hash << '\0'
+		<< g_settings->get("texture_path") << '\0'
+		<< g_settings->getBool("texture_clean_transparent")
+		<< g_settings->getS32("texture_min_size")
+		<< m_setting_trilinear_filter << m_setting_bilinear_filter;
+	std::string key = key_os.str();
+	SHA1 sha1;
+	sha1.addBytes(key.c_str(), key.size());
+	unsigned char *digest = sha1.getDigest();
+	m_composite_images_file = hex_encode((char*)digest, 20);
+	m_composite_images_path = getCompositeImageCacheDir() + DIR_DELIM
+		+ m_composite_images_file;
+	free(digest);
+
+	std::ifstream is(m_composite_images_path.c_str(), std::ios_base::binary);
+	if (!is.good())
+		return;
+	is.seekg(0, std::ios_base::end);
+	m_composite_images_file_size = is.tellg();
+	is.seekg(0, std::ios_base::beg);
+	try {
+		std::ostringstream os(std::ios_base::binary);
+		decompressZlib(is, os);
+		std::istringstream data_is(os.str(), std::ios_base::binary);
+		if (readU32(data_is) != COMPOSITE_IMAGES_SIGNATURE)
+			throw SerializationError("invalid signature");
+		u32 count = readU32(data_is);
+		for (u32 i = 0; i < count; i++) {
+			std::string name = deSerializeString(data_is);
+			std::string image = deSerializeLongString(data_is);
+			m_composite_images_size += image.size();
+			m_composite_images[name] = image;
+		}
+	} catch (SerializationError &e) {
+		warningstream << "TextureSource: Ignoring composite image cache \""
+			<< m_composite_images_path << "\": " << e.what() << std::endl;
+		m_composite_images.clear();
+		m_composite_images_size = 0;
+	}
+	infostream << "TextureSource: Loaded " << m_composite_images.size()
+		<< " cached composite images" << std::endl;
+}
+
+void TextureSource::saveCompositeImages()
+{
+	sanity_check(thr_is_current_thread(m_main_thread));
+
+	if (m_composite_images_changed) {
+		std::ostringstream os(std::ios_base::binary);
+		writeU32(os, COMPOSITE_IMAGES_SIGNATURE);
+		writeU32(os, m_composite_images.size());
+		for (std::map<std::string, std::string>::iterator
+				it = m_composite_images.begin();
+				it != m_composite_images.end(); ++it) {
+			os << serializeString(it->first);
+			os << serializeLongString(it->second);
+		}
+		std::ostringstream compressed(std::ios_base::binary);
+		compressZlib(os.str(), compressed);
+
+		if (fs::CreateAllDirs(getCompositeImageCacheDir()) &&
+				fs::safeWriteToFile(m_composite_images_path,
+					compressed.str())) {
+			m_composite_images_file_size = compressed.str().size();
+		} else {
+			errorstream << "TextureSource: Failed to write composite image "
+				"cache \"" << m_composite_images_path << "\"" << std::endl;
+		}
+	}
+
+	if (m_composite_images_file_size > 0)
+		trimCompositeImageCache(m_composite_images_file,
+			m_composite_images_file_size);
+
+	m_composite_images.clear();
+	m_composite_images_size = 0;
+	m_composite_images_changed = false;
+	m_composite_images_file = "";
+	m_composite_images_path = "";
+	m_composite_images_file_size = 0;
+}
+
+video::IImage* TextureSource::generateOrLoadImage(const std::string &name)
+{
+	if (m_composite_images_path.empty() || !is_composite_image(name))
+		return generateImage(name);
+
+	video::IVideoDriver *driver = m_device->getVideoDriver();
+	sanity_check(driver);
+
+	std::map<std::string, std::string>::iterator it =
+		m_composite_images.find(name);
+	if (it != m_composite_images.end() && it->second.size() >= 4) {
+		const std::string &record = it->second;
+		core::dimension2d<u32> dim(readU16((const u8 *)&record[0]),
+			readU16((const u8 *)&record[2]));
+		if (record.size() == 4 + dim.Width * dim.Height * 4) {
+			video::IImage *img = driver->createImage(video::ECF_A8R8G8B8, dim);
+			memcpy(img->lock(), &record[4], record.size() - 4);
+			img->unlock();
+			return img;
+		}
+	}
+
+	video::IImage *img = generateImage(name);
+	if (img == NULL || img->getColorFormat() != video::ECF_A8R8G8B8 ||
+			name.size() > STRING_MAX_LEN)
+		return img;
+
+	core::dimension2d<u32> dim = img->getDimension();
+	u32 size = dim.Width * dim.Height * 4;
+	if (dim.Width > U16_MAX || dim.Height > U16_MAX ||
+			img->getPitch() != dim.Width * 4 ||
+			m_composite_images_size + size > COMPOSITE_IMAGES_MAX_SIZE)
+		return img;
+
+	std::string record(4 + size, '\0');
+	writeU16((u8 *)&record[0], dim.Width);
+	writeU16((u8 *)&record[2], dim.Height);
+	memcpy(&record[4], img->lock(), size);
+	img->unlock();
+
+	std::string &stored = m_composite_images[name];
+	m_composite_images_size += record.size() - stored.size();
+	stored = record;
+	m_composite_images_changed = true;
+	return img;
+}
+
 video::ITexture* TextureSource::generateTextureFromMesh(
 		const TextureFromMeshParams &params)
 {
@@ -937,18 +1257,27 @@ video::IImage* TextureSource::generateImage(const std::string &name)
 
 	video::IImage *baseimg = NULL;
 
+	video::IVideoDriver* driver = m_device->getVideoDriver();
+	sanity_check(driver);
+
 	/*
 		If separator was found, make the base image
-		using a recursive call.
+		using a recursive call. Bases that are shared by many textures
+		(e.g. a stone with different ores) are generated only once.
 	*/
 	if (last_separator_pos != -1) {
-		baseimg = generateImage(name.substr(0, last_separator_pos));
+		std::string base_name = name.substr(0, last_separator_pos);
+		// Plain source images are cached by m_sourcecache already
+		bool is_generated = base_name.find_first_of("^[(") != std::string::npos;
+		if (is_generated)
+			baseimg = m_generated_images.getCopy(base_name, driver);
+		if (baseimg == NULL) {
+			baseimg = generateImage(base_name);
+			if (is_generated && baseimg)
+				m_generated_images.insert(base_name, baseimg, driver);
+		}
 	}
 
-
-	video::IVideoDriver* driver = m_device->getVideoDriver();
-	sanity_check(driver);
-
 	/*
 		Parse out the last part of the name of the image and act
 		according to it
@@ -840,7 +840,22 @@ u16 ClientInterface::getProtocolVersion(u16 peer_id)
 	return n->second->net_proto_version;
 }
 
-void ClientInterface::setClientVersion(u16 peer_id, u8 major, u8 minor, u8 patch, std::string full)
+u8 ClientInterface::getClientFeatures(u16 peer_id)
+{
+	MutexAutoLock conlock(m_clients_mutex);
+
+	// Error check
+	UNORDERED_MAP<u16, RemoteClient*>::iterator n = m_clients.find(peer_id);
+
+	// No client to get features
+	if (n == m_clients.end())
+		return 0;
+
+	return n->second->getFeatures();
+}
+
+void ClientInterface::setClientVersion(u16 peer_id, u8 major, u8 minor, u8 patch, std::string full,
+		u8 features)
 {
 	MutexAutoLock conlock(m_clients_mutex);
 
@@ -851,5 +866,5 @@ void ClientInterface::setClientVersion(u16 peer_id, u8 major, u8 minor, u8 patch
 	if (n == m_clients.end())
 		return;
 
-	n->second->setVersionInfo(major,minor,patch,full);
+	n->second->setVersionInfo(major,minor,patch,full,features);
 }
@@ -265,6 +265,7 @@ class RemoteClient
 		m_version_minor(0),
 		m_version_patch(0),
 		m_full_version("unknown"),
+		m_features(0),
 		m_deployed_compression(0),
 		m_connection_time(porting::getTimeS())
 	{
@@ -348,18 +349,22 @@ class RemoteClient
 	u64 uptime() const;
 
 	/* set version information */
-	void setVersionInfo(u8 major, u8 minor, u8 patch, const std::string &full)
+	void setVersionInfo(u8 major, u8 minor, u8 patch, const std::string &full,
+			u8 features)
 	{
 		m_version_major = major;
 		m_version_minor = minor;
 		m_version_patch = patch;
 		m_full_version = full;
+		m_features = features;
 	}
 
 	/* read version information */
 	u8 getMajor() const { return m_version_major; }
 	u8 getMinor() const { return m_version_minor; }
 	u8 getPatch() const { return m_version_patch; }
+	// ClientFeature flags
+	u8 getFeatures() const { return m_features; }
 private:
 	// Version is stored in here after INIT before INIT2
 	u8 m_pending_serialization_version;
@@ -427,6 +432,8 @@ class RemoteClient
 
 	std::string m_full_version;
 
+	u8 m_features;
+
 	u16 m_deployed_compression;
 
 	/*
@@ -482,8 +489,12 @@ class ClientInterface {
 	/* get protocol version of client */
 	u16 getProtocolVersion(u16 peer_id);
 
+	/* get ClientFeature flags of client */
+	u8 getClientFeatures(u16 peer_id);
+
 	/* set client version */
-	void setClientVersion(u16 peer_id, u8 major, u8 minor, u8 patch, std::string full);
+	void setClientVersion(u16 peer_id, u8 major, u8 minor, u8 patch, std::string full,
+			u8 features);
 
 	/* event to update client state */
 	void event(u16 peer_id, ClientStateEvent event);
@@ -69,6 +69,23 @@ ClientMediaDownloader::~ClientMediaDownloader()
 		delete m_remotes[i];
 }
 
+std::string ClientMediaDownloader::getMediaSetDigest() const
+{
+	// m_files is sorted by name, the announcement order doesn't matter
+	SHA1 sha1;
+	for (std::map<std::string, FileStatus*>::const_iterator
+			it = m_files.begin();
+			it != m_files.end(); ++it) {
+		// Names can't contain a NUL, so it separates them
+		sha1.addBytes(it->first.c_str(), it->first.size() + 1);
+		sha1.addBytes(it->second->sha1.c_str(), it->second->sha1.size());
+	}
+	unsigned char *digest = sha1.getDigest();
+	std::string digest_hex = hex_encode((char*)digest, 20);
+	free(digest);
+	return digest_hex;
+}
+
 void ClientMediaDownloader::addFile(const std::string &name, const std::string &sha1)
 {
 	assert(!m_initial_step_done); // pre-condition
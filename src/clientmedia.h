@@ -64,6 +64,10 @@ class ClientMediaDownloader
 	// Add a remote server to the list; ignored if not built with cURL
 	void addRemoteServer(const std::string &baseurl);
 
+	// Hex-encoded SHA1 over the names and hashes of all files added,
+	// identifies the media set of a server
+	std::string getMediaSetDigest() const;
+
 	// Steps the media downloader:
 	// - May load media into client by calling client->loadMedia()
 	// - May check media cache for files
@@ -29,6 +29,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "serverobject.h"
 #include "util/timetaker.h"
 #include "profiler.h"
+#include "threading/atomic.h"
 
 // float error is 10 - 9.96875 = 0.03125
 //#define COLL_ZERO 0.032 // broken unit tests
@@ -204,8 +205,52 @@ bool wouldCollideWithCeiling(
 	return false;
 }
 
+/*
+	Node lookups for collisionMoveSimple(). The last used block is cached
+	here instead of in the Map, so that collisions can be computed on
+	several threads at once (see ServerEnvironment::stepObjectPhysics)
+	as long as the map is not modified meanwhile.
+*/
+class CollisionNodeGetter
+{
+public:
+	CollisionNodeGetter(Map *map):
+		m_map(map),
+		m_block(NULL),
+		m_block_cached(false)
+	{}
+
+	MapNode getNodeNoEx(v3s16 p, bool *is_valid_position = NULL)
+	{
+		v3s16 blockpos = getNodeBlockPos(p);
+		if (!m_block_cached || blockpos != m_blockpos) {
+			m_block = m_map->getBlockNoCreateNoExUnbuffered(blockpos);
+			m_blockpos = blockpos;
+			m_block_cached = true;
+		}
+		if (m_block == NULL) {
+			if (is_valid_position != NULL)
+				*is_valid_position = false;
+			return MapNode(CONTENT_IGNORE);
+		}
+
+		bool is_valid_p;
+		MapNode n = m_block->getNodeNoCheck(p - blockpos * MAP_BLOCKSIZE,
+			&is_valid_p);
+		if (is_valid_position != NULL)
+			*is_valid_position = is_valid_p;
+		return n;
+	}
+
+private:
+	Map *m_map;
+	MapBlock *m_block;
+	v3s16 m_blockpos;
+	bool m_block_cached;
+};
+
 static inline void getNeighborConnectingFace(v3s16 p, INodeDefManager *nodedef,
-		Map *map, MapNode n, int v, int *neighbors)
+		CollisionNodeGetter *map, MapNode n, int v, int *neighbors)
 {
 	MapNode n2 = map->getNodeNoEx(p);
 	if (nodedef->nodeboxConnects(n, n2, v))
@@ -217,12 +262,13 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 		f32 stepheight, f32 dtime,
 		v3f *pos_f, v3f *speed_f,
 		v3f accel_f, ActiveObject *self,
-		bool collideWithObjects)
+		bool collideWithObjects, bool profile)
 {
-	static bool time_notification_done = false;
-	Map *map = &env->getMap();
+	static Atomic<bool> time_notification_done(false);
+	CollisionNodeGetter map(&env->getMap());
+	Profiler *profiler = profile ? g_profiler : NULL;
 	//TimeTaker tt("collisionMoveSimple");
-	ScopeProfiler sp(g_profiler, "collisionMoveSimple avg", SPT_AVG);
+	ScopeProfiler sp(profiler, "collisionMoveSimple avg", SPT_AVG);
 
 	collisionMoveResult result;
 
@@ -256,7 +302,7 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 	std::vector<NearbyCollisionInfo> cinfo;
 	{
 	//TimeTaker tt2("collisionMoveSimple collect boxes");
-	ScopeProfiler sp(g_profiler, "collisionMoveSimple collect boxes avg", SPT_AVG);
+	ScopeProfiler sp(profiler, "collisionMoveSimple collect boxes avg", SPT_AVG);
 
 	v3f newpos_f = *pos_f + *speed_f * dtime;
 	v3f minpos_f(
@@ -281,7 +327,7 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 		v3s16 p(x,y,z);
 
 		bool is_position_valid;
-		MapNode n = map->getNodeNoEx(p, &is_position_valid);
+		MapNode n = map.getNodeNoEx(p, &is_position_valid);
 
 		if (is_position_valid && n.getContent() != CONTENT_IGNORE) {
 			// Object collides into walkable nodes
@@ -298,27 +344,27 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 				v3s16 p2 = p;
 
 				p2.Y++;
-				getNeighborConnectingFace(p2, nodedef, map, n, 1, &neighbors);
+				getNeighborConnectingFace(p2, nodedef, &map, n, 1, &neighbors);
 
 				p2 = p;
 				p2.Y--;
-				getNeighborConnectingFace(p2, nodedef, map, n, 2, &neighbors);
+				getNeighborConnectingFace(p2, nodedef, &map, n, 2, &neighbors);
 
 				p2 = p;
 				p2.Z--;
-				getNeighborConnectingFace(p2, nodedef, map, n, 4, &neighbors);
+				getNeighborConnectingFace(p2, nodedef, &map, n, 4, &neighbors);
 
 				p2 = p;
 				p2.X--;
-				getNeighborConnectingFace(p2, nodedef, map, n, 8, &neighbors);
+				getNeighborConnectingFace(p2, nodedef, &map, n, 8, &neighbors);
 
 				p2 = p;
 				p2.Z++;
-				getNeighborConnectingFace(p2, nodedef, map, n, 16, &neighbors);
+				getNeighborConnectingFace(p2, nodedef, &map, n, 16, &neighbors);
 
 				p2 = p;
 				p2.X++;
-				getNeighborConnectingFace(p2, nodedef, map, n, 32, &neighbors);
+				getNeighborConnectingFace(p2, nodedef, &map, n, 32, &neighbors);
 			}
 			std::vector<aabb3f> nodeboxes;
 			n.getCollisionBoxes(gamedef->ndef(), &nodeboxes, neighbors);
@@ -353,7 +399,7 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 
 	if(collideWithObjects)
 	{
-		ScopeProfiler sp(g_profiler, "collisionMoveSimple objects avg", SPT_AVG);
+		ScopeProfiler sp(profiler, "collisionMoveSimple objects avg", SPT_AVG);
 		//TimeTaker tt3("collisionMoveSimple collect object boxes");
 
 		/* add object boxes to cinfo */
@@ -421,7 +467,7 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 
 	while(dtime > BS * 1e-10) {
 		//TimeTaker tt3("collisionMoveSimple dtime loop");
-        	ScopeProfiler sp(g_profiler, "collisionMoveSimple dtime loop avg", SPT_AVG);
+        	ScopeProfiler sp(profiler, "collisionMoveSimple dtime loop avg", SPT_AVG);
 
 		// Avoid infinite loop
 		loopcount++;
@@ -70,12 +70,13 @@ struct collisionMoveResult
 };
 
 // Moves using a single iteration; speed should not exceed pos_max_d/dtime
+// Worker threads pass profile=false, so they don't contend on g_profiler.
 collisionMoveResult collisionMoveSimple(Environment *env,IGameDef *gamedef,
 		f32 pos_max_d, const aabb3f &box_0,
 		f32 stepheight, f32 dtime,
 		v3f *pos_f, v3f *speed_f,
 		v3f accel_f, ActiveObject *self=NULL,
-		bool collideWithObjects=true);
+		bool collideWithObjects=true, bool profile=true);
 
 // Helper function:
 // Checks for collision of a moving aabbox with a static aabbox
@@ -28,6 +28,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "server.h"
 #include "scripting_server.h"
 #include "genericobject.h"
+#include "porting.h"
+#include "profiler.h"
 
 std::map<u16, ServerActiveObject::Factory> ServerActiveObject::m_types;
 
@@ -243,6 +245,9 @@ LuaEntitySAO::LuaEntitySAO(ServerEnvironment *env, v3f pos,
 	m_registered(false),
 	m_velocity(0,0,0),
 	m_acceleration(0,0,0),
+	m_physics_stepped(false),
+	m_physics_position(0,0,0),
+	m_physics_collision_us(0),
 	m_last_sent_yaw(0),
 	m_last_sent_position(0,0,0),
 	m_last_sent_velocity(0,0,0),
@@ -291,6 +296,13 @@ void LuaEntitySAO::addedToEnvironment(u32 dtime_s)
 	}
 }
 
+void LuaEntitySAO::removingFromEnvironment()
+{
+	ServerActiveObject::removingFromEnvironment();
+	// Objects removed after stepPhysics() are not stepped anymore
+	m_physics_stepped = false;
+}
+
 ServerActiveObject* LuaEntitySAO::create(ServerEnvironment *env, v3f pos,
 		const std::string &data)
 {
@@ -349,6 +361,10 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 
 	m_last_sent_position_timer += dtime;
 
+	// Movement may already have been done by stepPhysics()
+	bool physics_stepped = m_physics_stepped;
+	m_physics_stepped = false;
+
 	// Each frame, parent position is copied if the object is attached, otherwise it's calculated normally
 	// If the object gets detached this comes into effect automatically from the last known origin
 	if(isAttached())
@@ -358,48 +374,11 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 		m_velocity = v3f(0,0,0);
 		m_acceleration = v3f(0,0,0);
 	}
-	else
+	else if (!physics_stepped)
 	{
-		if(m_prop.physical){
-			aabb3f box = m_prop.collisionbox;
-			box.MinEdge *= BS;
-			box.MaxEdge *= BS;
-			collisionMoveResult moveresult;
-			f32 pos_max_d = BS*0.25; // Distance per iteration
-			v3f p_pos = m_base_position;
-			v3f p_velocity = m_velocity;
-			v3f p_acceleration = m_acceleration;
-			moveresult = collisionMoveSimple(m_env, m_env->getGameDef(),
-					pos_max_d, box, m_prop.stepheight, dtime,
-					&p_pos, &p_velocity, p_acceleration,
-					this, m_prop.collideWithObjects);
-
-			// Apply results
-			m_base_position = p_pos;
-			m_velocity = p_velocity;
-			m_acceleration = p_acceleration;
-		} else {
-			m_base_position += dtime * m_velocity + 0.5 * dtime
-					* dtime * m_acceleration;
-			m_velocity += dtime * m_acceleration;
-		}
-
-		if((m_prop.automatic_face_movement_dir) &&
-				(fabs(m_velocity.Z) > 0.001 || fabs(m_velocity.X) > 0.001))
-		{
-			float optimal_yaw = atan2(m_velocity.Z,m_velocity.X) * 180 / M_PI
-					+ m_prop.automatic_face_movement_dir_offset;
-			float max_rotation_delta =
-					dtime * m_prop.automatic_face_movement_max_rotation_per_sec;
-
-			if ((m_prop.automatic_face_movement_max_rotation_per_sec > 0) &&
-				(fabs(m_yaw - optimal_yaw) > max_rotation_delta)) {
-
-				m_yaw = optimal_yaw < m_yaw ? m_yaw - max_rotation_delta : m_yaw + max_rotation_delta;
-			} else {
-				m_yaw = optimal_yaw;
-			}
-		}
+		v3f pos;
+		stepMovement(dtime, &pos);
+		m_base_position = pos;
 	}
 
 	if(m_registered){
@@ -466,6 +445,82 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 	}
 }
 
+bool LuaEntitySAO::stepPhysics(float dtime)
+{
+	// Attachments depend on the parent object, and non-physical
+	// movement is too cheap to be worth it; step() does these.
+	if (m_attachment_parent_id || !m_prop.physical)
+		return false;
+
+	m_physics_collision_us = 0;
+	stepMovement(dtime, &m_physics_position, &m_physics_collision_us);
+	m_physics_stepped = true;
+	return true;
+}
+
+void LuaEntitySAO::finishPhysics()
+{
+	if (!m_physics_stepped)
+		return;
+	m_base_position = m_physics_position;
+	g_profiler->avg("collisionMoveSimple avg",
+		m_physics_collision_us / 1000000.0f);
+}
+
+/*
+	Moves the object according to its velocity and acceleration, colliding
+	with nodes and other objects if physical. m_base_position is only read,
+	the new position is written to *pos.
+	If collision_us is given, the collision time is stored there instead of
+	being profiled, which would contend on g_profiler from worker threads.
+*/
+void LuaEntitySAO::stepMovement(float dtime, v3f *pos, u64 *collision_us)
+{
+	*pos = m_base_position;
+
+	if(m_prop.physical){
+		aabb3f box = m_prop.collisionbox;
+		box.MinEdge *= BS;
+		box.MaxEdge *= BS;
+		collisionMoveResult moveresult;
+		f32 pos_max_d = BS*0.25; // Distance per iteration
+		v3f p_velocity = m_velocity;
+		v3f p_acceleration = m_acceleration;
+		u64 start_us = collision_us ? porting::getTimeUs() : 0;
+		moveresult = collisionMoveSimple(m_env, m_env->getGameDef(),
+				pos_max_d, box, m_prop.stepheight, dtime,
+				pos, &p_velocity, p_acceleration,
+				this, m_prop.collideWithObjects, collision_us == NULL);
+		if (collision_us)
+			*collision_us = porting::getTimeUs() - start_us;
+
+		// Apply results
+		m_velocity = p_velocity;
+		m_acceleration = p_acceleration;
+	} else {
+		*pos += dtime * m_velocity + 0.5 * dtime
+				* dtime * m_acceleration;
+		m_velocity += dtime * m_acceleration;
+	}
+
+	if((m_prop.automatic_face_movement_dir) &&
+			(fabs(m_velocity.Z) > 0.001 || fabs(m_velocity.X) > 0.001))
+	{
+		float optimal_yaw = atan2(m_velocity.Z,m_velocity.X) * 180 / M_PI
+				+ m_prop.automatic_face_movement_dir_offset;
+		float max_rotation_delta =
+				dtime * m_prop.automatic_face_movement_max_rotation_per_sec;
+
+		if ((m_prop.automatic_face_movement_max_rotation_per_sec > 0) &&
+			(fabs(m_yaw - optimal_yaw) > max_rotation_delta)) {
+
+			m_yaw = optimal_yaw < m_yaw ? m_yaw - max_rotation_delta : m_yaw + max_rotation_delta;
+		} else {
+			m_yaw = optimal_yaw;
+		}
+	}
+}
+
 std::string LuaEntitySAO::getClientInitializationData(u16 protocol_version)
 {
 	std::ostringstream os(std::ios::binary);
@@ -770,6 +825,7 @@ PlayerSAO::PlayerSAO(ServerEnvironment *env_, RemotePlayer *player_, u16 peer_id
 	m_player(player_),
 	m_peer_id(peer_id_),
 	m_inventory(NULL),
+	m_sent_inventory(NULL),
 	m_damage(0),
 	m_last_good_position(0,0,0),
 	m_time_from_last_teleport(0),
@@ -818,6 +874,7 @@ PlayerSAO::~PlayerSAO()
 {
 	if(m_inventory != &m_player->inventory)
 		delete m_inventory;
+	delete m_sent_inventory;
 }
 
 void PlayerSAO::finalize(RemotePlayer *player, const std::set<std::string> &privs)
@@ -1288,6 +1345,14 @@ const Inventory* PlayerSAO::getInventory() const
 	return m_inventory;
 }
 
+void PlayerSAO::setSentInventory(const Inventory &inventory)
+{
+	if (m_sent_inventory)
+		*m_sent_inventory = inventory;
+	else
+		m_sent_inventory = new Inventory(inventory);
+}
+
 InventoryLocation PlayerSAO::getInventoryLocation() const
 {
 	InventoryLocation loc;
@@ -98,9 +98,12 @@ class LuaEntitySAO : public UnitSAO
 	ActiveObjectType getSendType() const
 	{ return ACTIVEOBJECT_TYPE_GENERIC; }
 	virtual void addedToEnvironment(u32 dtime_s);
+	void removingFromEnvironment();
 	static ServerActiveObject* create(ServerEnvironment *env, v3f pos,
 			const std::string &data);
 	void step(float dtime, bool send_recommended);
+	bool stepPhysics(float dtime);
+	void finishPhysics();
 	std::string getClientInitializationData(u16 protocol_version);
 	void getStaticData(std::string *result) const;
 	int punch(v3f dir,
@@ -130,6 +133,7 @@ class LuaEntitySAO : public UnitSAO
 private:
 	std::string getPropertyPacket();
 	void sendPosition(bool do_interpolate, bool is_movement_end);
+	void stepMovement(float dtime, v3f *pos, u64 *collision_us = NULL);
 
 	std::string m_init_name;
 	std::string m_init_state;
@@ -138,6 +142,12 @@ class LuaEntitySAO : public UnitSAO
 	v3f m_velocity;
 	v3f m_acceleration;
 
+	// Set by stepPhysics(), the position is applied by finishPhysics()
+	bool m_physics_stepped;
+	v3f m_physics_position;
+	// Collision time of stepPhysics(), added to g_profiler serially
+	u64 m_physics_collision_us;
+
 	float m_last_sent_yaw;
 	v3f m_last_sent_position;
 	v3f m_last_sent_velocity;
@@ -252,6 +262,9 @@ class PlayerSAO : public UnitSAO
 	Inventory* getInventory();
 	const Inventory* getInventory() const;
 	InventoryLocation getInventoryLocation() const;
+	// The inventory as last sent to the client, NULL if not sent yet
+	const Inventory* getSentInventory() const { return m_sent_inventory; }
+	void setSentInventory(const Inventory &inventory);
 	std::string getWieldList() const;
 	ItemStack getWieldedItem() const;
 	ItemStack getWieldedItemOrHand() const;
@@ -371,6 +384,7 @@ class PlayerSAO : public UnitSAO
 	RemotePlayer *m_player;
 	u16 m_peer_id;
 	Inventory *m_inventory;
+	Inventory *m_sent_inventory;
 	s16 m_damage;
 
 	// Cheat prevention
@@ -179,6 +179,7 @@ void set_default_settings(Settings *settings) {
 	settings->setDefault("show_entity_selectionbox", "false");
 	settings->setDefault("texture_clean_transparent", "false");
 	settings->setDefault("texture_min_size", "32");
+	settings->setDefault("texture_cache_size", "64");
 	settings->setDefault("ambient_occlusion_gamma", "2.2");
 	settings->setDefault("enable_shaders", "true");
 	settings->setDefault("enable_particles", "true");
@@ -305,6 +306,7 @@ void set_default_settings(Settings *settings) {
 	settings->setDefault("kamikaze", "false");
 
 	settings->setDefault("profiler_print_interval", "0");
+	settings->setDefault("profiler.trace", "false");
 	settings->setDefault("active_object_send_range_blocks", "4");
 	settings->setDefault("active_block_range", "3");
 	//settings->setDefault("max_simultaneous_block_sends_per_client", "1");
@@ -325,9 +327,12 @@ void set_default_settings(Settings *settings) {
 	settings->setDefault("dedicated_server_step", "0.1");
 	settings->setDefault("active_block_mgmt_interval", "2.0");
 	settings->setDefault("abm_interval", "1.0");
+	settings->setDefault("abm_time_budget", "0.2");
 	settings->setDefault("nodetimer_interval", "0.2");
+	settings->setDefault("num_object_physics_threads", "0");
 	settings->setDefault("ignore_world_load_errors", "false");
 	settings->setDefault("remote_media", "");
+	settings->setDefault("media_cache_size", "256");
 	settings->setDefault("debug_log_level", "warning");
 	settings->setDefault("emergequeue_limit_total", "512");
 	settings->setDefault("emergequeue_limit_diskonly", "64");
@@ -397,6 +402,8 @@ void set_default_settings(Settings *settings) {
 	settings->setDefault("doubletap_jump", "true");
 	settings->setDefault("emergequeue_limit_diskonly", "16");
 	settings->setDefault("emergequeue_limit_generate", "16");
+	settings->setDefault("media_cache_size", "32");
+	settings->setDefault("texture_cache_size", "16");
 	settings->setDefault("curl_verify_cert", "false");
 	settings->setDefault("gui_scaling_filter_txr2img", "false");
 	settings->setDefault("autosave_screensize", "false");
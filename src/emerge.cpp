@@ -40,11 +40,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "mg_schematic.h"
 #include "nodedef.h"
 #include "profiler.h"
+#include "tracer.h"
 #include "scripting_server.h"
 #include "server.h"
 #include "serverobject.h"
 #include "settings.h"
 #include "voxel.h"
+#include "voxelalgorithms.h"
 
 class EmergeThread : public Thread {
 public:
@@ -85,6 +87,26 @@ class EmergeThread : public Thread {
 	friend class EmergeManager;
 };
 
+class BulkEditThread : public Thread {
+public:
+	BulkEditThread(Server *server);
+
+	void *run();
+	void signal();
+
+	void pushEdit(BulkEdit *edit);
+	void cancelPendingEdits();
+
+private:
+	Server *m_server;
+
+	Event m_queue_event;
+	Mutex m_queue_mutex;
+	std::queue<BulkEdit *> m_edit_queue;
+
+	BulkEdit *popEdit();
+};
+
 ////
 //// EmergeManager
 ////
@@ -129,6 +151,7 @@ EmergeManager::EmergeManager(Server *server)
 
 	for (s16 i = 0; i < nthreads; i++)
 		m_threads.push_back(new EmergeThread(server, i));
+	m_bulkedit_thread = new BulkEditThread(server);
 
 	infostream << "EmergeManager: using " << nthreads << " threads" << std::endl;
 }
@@ -152,6 +175,15 @@ EmergeManager::~EmergeManager()
 			delete m_mapgens[i];
 	}
 
+	if (m_threads_active) {
+		m_bulkedit_thread->stop();
+		m_bulkedit_thread->signal();
+		m_bulkedit_thread->wait();
+	}
+	// Edits queued after the thread stopped would leak their callbacks
+	m_bulkedit_thread->cancelPendingEdits();
+	delete m_bulkedit_thread;
+
 	delete biomemgr;
 	delete oremgr;
 	delete decomgr;
@@ -196,6 +228,7 @@ void EmergeManager::startThreads()
 
 	for (u32 i = 0; i != m_threads.size(); i++)
 		m_threads[i]->start();
+	m_bulkedit_thread->start();
 
 	m_threads_active = true;
 }
@@ -211,10 +244,13 @@ void EmergeManager::stopThreads()
 		m_threads[i]->stop();
 		m_threads[i]->signal();
 	}
+	m_bulkedit_thread->stop();
+	m_bulkedit_thread->signal();
 
 	// Then do the waiting for each
 	for (u32 i = 0; i != m_threads.size(); i++)
 		m_threads[i]->wait();
+	m_bulkedit_thread->wait();
 
 	m_threads_active = false;
 }
@@ -272,6 +308,19 @@ bool EmergeManager::enqueueBlockEmergeEx(
 }
 
 
+void EmergeManager::enqueueBulkEdit(BulkEdit *edit)
+{
+	m_bulkedit_thread->pushEdit(edit);
+	m_bulkedit_thread->signal();
+}
+
+
+void EmergeManager::cancelBulkEdits()
+{
+	m_bulkedit_thread->cancelPendingEdits();
+}
+
+
 //
 // Mapgen-related helper functions
 //
@@ -367,6 +416,7 @@ bool EmergeManager::pushBlockEmergeData(
 	} else {
 		bedata.flags = flags;
 		bedata.peer_requested = peer_requested;
+		bedata.queued_us = porting::getTimeUs();
 
 		count_peer++;
 	}
@@ -539,6 +589,7 @@ MapBlock *EmergeThread::finishGen(v3s16 pos, BlockMakeData *bmdata,
 	MutexAutoLock envlock(m_server->m_env_mutex);
 	ScopeProfiler sp(g_profiler,
 		"EmergeThread: after Mapgen::makeChunk", SPT_AVG);
+	TraceScope trace("EmergeThread: finish generation");
 
 	/*
 		Perform post-processing on blocks (invalidate lighting, queue liquid
@@ -579,6 +630,15 @@ MapBlock *EmergeThread::finishGen(v3s16 pos, BlockMakeData *bmdata,
 	Mapgen *mg = m_emerge->getCurrentMapgen();
 	mg->gennotify.clearEvents();
 
+	/*
+		Keep the generated blocks compact if they are mostly uniform
+	*/
+	for (std::map<v3s16, MapBlock *>::iterator it = modified_blocks->begin();
+			it != modified_blocks->end(); ++it) {
+		if (it->second)
+			it->second->compact();
+	}
+
 	EMERGE_DBG_OUT("ended up with: " << analyze_block(block));
 
 	/*
@@ -618,6 +678,8 @@ void *EmergeThread::run()
 		if (blockpos_over_max_limit(pos))
 			continue;
 
+		TraceScope trace("EmergeThread: emerge block");
+
 		bool allow_gen = bedata.flags & BLOCK_EMERGE_ALLOW_GEN;
 		EMERGE_DBG_OUT("pos=" PP(pos) " allow_gen=" << allow_gen);
 
@@ -626,6 +688,7 @@ void *EmergeThread::run()
 			{
 				ScopeProfiler sp(g_profiler,
 					"EmergeThread: Mapgen::makeChunk", SPT_AVG);
+				TraceScope trace("EmergeThread: Mapgen::makeChunk");
 				TimeTaker t("mapgen::make_block()");
 
 				m_mapgen->makeChunk(&bmdata);
@@ -639,6 +702,10 @@ void *EmergeThread::run()
 
 		runCompletionCallbacks(pos, action, bedata.callbacks);
 
+		if (g_tracer->isEnabled() && action != EMERGE_CANCELLED)
+			g_tracer->record("EmergeThread: request latency",
+				bedata.queued_us, porting::getTimeUs());
+
 		if (block)
 			modified_blocks[pos] = block;
 
@@ -668,3 +735,175 @@ void *EmergeThread::run()
 	END_DEBUG_EXCEPTION_HANDLER
 	return NULL;
 }
+
+
+////
+//// BulkEditor
+////
+
+void BulkEditor::rememberBlocks(v3s16 blockpos_min, v3s16 blockpos_max)
+{
+	m_read_blocks.clear();
+	for (s16 z = blockpos_min.Z; z <= blockpos_max.Z; z++)
+	for (s16 y = blockpos_min.Y; y <= blockpos_max.Y; y++)
+	for (s16 x = blockpos_min.X; x <= blockpos_max.X; x++) {
+		ReadBlock b;
+		b.pos = v3s16(x, y, z);
+		b.block = m_map->getBlockNoCreateNoEx(b.pos);
+		b.node_change_count = b.block ? b.block->getNodeChangeCount() : 0;
+		m_read_blocks.push_back(b);
+	}
+}
+
+
+bool BulkEditor::blocksChanged()
+{
+	for (size_t i = 0; i < m_read_blocks.size(); i++) {
+		const ReadBlock &b = m_read_blocks[i];
+		// Unloaded or reloaded blocks count as changed, too
+		MapBlock *block = m_map->getBlockNoCreateNoEx(b.pos);
+		if (block != b.block || (block &&
+				block->getNodeChangeCount() != b.node_change_count))
+			return true;
+	}
+	return false;
+}
+
+
+void BulkEditor::dispatchModifiedBlocks(
+	const std::map<v3s16, MapBlock *> &modified_blocks)
+{
+	MapEditEvent event;
+	event.type = MEET_OTHER;
+	for (std::map<v3s16, MapBlock *>::const_iterator
+			it = modified_blocks.begin();
+			it != modified_blocks.end(); ++it)
+		event.modified_blocks.insert(it->first);
+	m_map->dispatchEvent(&event);
+}
+
+
+bool BulkEditor::tryEdit(BulkEdit *edit)
+{
+	INodeDefManager *ndef = m_map->getNodeDefManager();
+	std::map<v3s16, MapBlock *> modified_blocks;
+	std::vector<bool> sunlight;
+	MMVManip vm(m_map);
+
+	{
+		MutexAutoLock envlock(*m_env_mutex);
+		vm.initialEmerge(edit->blockpos_min, edit->blockpos_max);
+		voxalgo::get_vmanip_sunlight(m_map, &vm, &sunlight);
+		// The blocks above provide the sunlight
+		rememberBlocks(edit->blockpos_min,
+			edit->blockpos_max + v3s16(0, 1, 0));
+	}
+
+	{
+		TraceScope trace("BulkEditThread: apply edit");
+		edit->apply(&vm);
+		voxalgo::compute_vmanip_light(&vm, ndef, &sunlight);
+	}
+
+	MutexAutoLock envlock(*m_env_mutex);
+	if (blocksChanged())
+		return false;
+
+	TraceScope trace("BulkEditThread: write back");
+	voxalgo::blit_back_with_computed_light(m_map, &vm, sunlight,
+		&modified_blocks);
+	dispatchModifiedBlocks(modified_blocks);
+	return true;
+}
+
+
+void BulkEditor::run(BulkEdit *edit)
+{
+	for (u32 i = 0; i < BULKEDIT_MAX_ATTEMPTS; i++) {
+		if (tryEdit(edit))
+			return;
+	}
+
+	// The area keeps changing, so do not let go of it this time
+	MutexAutoLock envlock(*m_env_mutex);
+	std::map<v3s16, MapBlock *> modified_blocks;
+	MMVManip vm(m_map);
+	vm.initialEmerge(edit->blockpos_min, edit->blockpos_max);
+	edit->apply(&vm);
+	voxalgo::blit_back_with_light(m_map, &vm, &modified_blocks);
+	dispatchModifiedBlocks(modified_blocks);
+}
+
+
+////
+//// BulkEditThread
+////
+
+BulkEditThread::BulkEditThread(Server *server) :
+	Thread("BulkEdit"),
+	m_server(server)
+{
+}
+
+
+void BulkEditThread::signal()
+{
+	m_queue_event.signal();
+}
+
+
+void BulkEditThread::pushEdit(BulkEdit *edit)
+{
+	MutexAutoLock queuelock(m_queue_mutex);
+	m_edit_queue.push(edit);
+}
+
+
+BulkEdit *BulkEditThread::popEdit()
+{
+	MutexAutoLock queuelock(m_queue_mutex);
+	if (m_edit_queue.empty())
+		return NULL;
+
+	BulkEdit *edit = m_edit_queue.front();
+	m_edit_queue.pop();
+	return edit;
+}
+
+
+void BulkEditThread::cancelPendingEdits()
+{
+	while (BulkEdit *edit = popEdit()) {
+		if (edit->callback)
+			edit->callback(BULKEDIT_CANCELLED, edit->callback_param);
+		delete edit;
+	}
+}
+
+
+void *BulkEditThread::run()
+{
+	DSTACK(FUNCTION_NAME);
+	BEGIN_DEBUG_EXCEPTION_HANDLER
+
+	BulkEditor editor(&m_server->getEnv().getServerMap(),
+		&m_server->m_env_mutex);
+
+	while (!stopRequested()) {
+		BulkEdit *edit = popEdit();
+		if (!edit) {
+			m_queue_event.wait();
+			continue;
+		}
+
+		editor.run(edit);
+		if (edit->callback)
+			edit->callback(BULKEDIT_DONE, edit->callback_param);
+		delete edit;
+	}
+
+	cancelPendingEdits();
+
+	END_DEBUG_EXCEPTION_HANDLER
+	return NULL;
+}
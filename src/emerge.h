@@ -25,16 +25,21 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/container.h"
 #include "mapgen.h" // for MapgenParams
 #include "map.h"
+#include "threading/mutex.h"
 
 #define BLOCK_EMERGE_ALLOW_GEN   (1 << 0)
 #define BLOCK_EMERGE_FORCE_QUEUE (1 << 1)
 
+// Tries of a bulk edit before it keeps the environment locked
+#define BULKEDIT_MAX_ATTEMPTS 3
+
 #define EMERGE_DBG_OUT(x) do {                         \
 	if (enable_mapgen_debug_info)                      \
 		infostream << "EmergeThread: " x << std::endl; \
 } while (0)
 
 class EmergeThread;
+class BulkEditThread;
 class INodeDefManager;
 class Settings;
 
@@ -87,6 +92,77 @@ struct BlockEmergeData {
 	u16 peer_requested;
 	u16 flags;
 	EmergeCallbackList callbacks;
+	// Time the block was first queued, for latency tracing
+	u64 queued_us;
+};
+
+// Result from processing a bulk edit
+enum BulkEditResult {
+	BULKEDIT_CANCELLED,
+	BULKEDIT_DONE,
+};
+
+typedef void (*BulkEditCallback)(BulkEditResult result, void *param);
+
+/*
+	A modification of the loaded map in blockpos_min..blockpos_max, done on
+	a VoxelManip by the bulk edit thread. The environment lock is only held
+	while the area is read and while the result is written back.
+*/
+class BulkEdit {
+public:
+	BulkEdit(v3s16 a_blockpos_min, v3s16 a_blockpos_max,
+		BulkEditCallback a_callback, void *a_callback_param):
+		blockpos_min(a_blockpos_min),
+		blockpos_max(a_blockpos_max),
+		callback(a_callback),
+		callback_param(a_callback_param)
+	{}
+	virtual ~BulkEdit() {}
+
+	// Modifies the nodes of the VoxelManip, called without any lock held
+	virtual void apply(MMVManip *vm) = 0;
+
+	v3s16 blockpos_min;
+	v3s16 blockpos_max;
+	BulkEditCallback callback;
+	void *callback_param;
+};
+
+/*
+	Does bulk edits on the map for the bulk edit thread. An edit that finds
+	the nodes of its area (or of the blocks above, which give the sunlight)
+	changed when it is written back is tried again. This also catches
+	changes that send no map event, like liquid flow.
+*/
+class BulkEditor {
+public:
+	BulkEditor(Map *map, Mutex *env_mutex):
+		m_map(map),
+		m_env_mutex(env_mutex)
+	{}
+
+	// Locks the environment as needed, doesn't call the edit's callback
+	void run(BulkEdit *edit);
+
+private:
+	struct ReadBlock {
+		v3s16 pos;
+		MapBlock *block;
+		u32 node_change_count;
+	};
+
+	Map *m_map;
+	Mutex *m_env_mutex;
+	// Blocks that the edit in progress depends on
+	std::vector<ReadBlock> m_read_blocks;
+
+	bool tryEdit(BulkEdit *edit);
+	// Both require the environment lock
+	void rememberBlocks(v3s16 blockpos_min, v3s16 blockpos_max);
+	bool blocksChanged();
+	void dispatchModifiedBlocks(
+		const std::map<v3s16, MapBlock *> &modified_blocks);
 };
 
 class EmergeManager {
@@ -138,6 +214,12 @@ class EmergeManager {
 		EmergeCompletionCallback callback,
 		void *callback_param);
 
+	// Takes ownership of the edit
+	void enqueueBulkEdit(BulkEdit *edit);
+	// Cancels the queued bulk edits and calls their callbacks.
+	// Only to be called while the threads are stopped.
+	void cancelBulkEdits();
+
 	v3s16 getContainingChunk(v3s16 blockpos);
 
 	Mapgen *getCurrentMapgen();
@@ -153,6 +235,7 @@ class EmergeManager {
 private:
 	std::vector<Mapgen *> m_mapgens;
 	std::vector<EmergeThread *> m_threads;
+	BulkEditThread *m_bulkedit_thread;
 	bool m_threads_active;
 
 	Mutex m_queue_mutex;
@@ -486,6 +486,61 @@ void InventoryList::deSerialize(std::istream &is)
 	}
 }
 
+void InventoryList::serializeDelta(std::ostream &os, const InventoryList &old) const
+{
+	for (u32 i = 0; i < m_items.size(); i++) {
+		const ItemStack &item = m_items[i];
+		if (item == old.m_items[i])
+			continue;
+		os << "Slot " << i << " ";
+		if (item.empty()) {
+			os << "Empty";
+		} else {
+			os << "Item ";
+			item.serialize(os);
+		}
+		os << "\n";
+	}
+
+	os << "EndInventoryList\n";
+}
+
+void InventoryList::deSerializeDelta(std::istream &is)
+{
+	for (;;) {
+		std::string line;
+		if (!std::getline(is, line, '\n'))
+			throw SerializationError("unexpected end of inventory list");
+
+		std::istringstream iss(line);
+
+		std::string name;
+		std::getline(iss, name, ' ');
+
+		if (name == "EndInventoryList")
+			break;
+		if (name != "Slot")
+			throw SerializationError("invalid inventory list specifier: " + name);
+
+		u32 i;
+		iss >> i >> std::ws;
+		if (iss.fail() || i >= getSize())
+			throw SerializationError("invalid inventory slot");
+
+		std::string type;
+		std::getline(iss, type, ' ');
+		if (type == "Item") {
+			ItemStack item;
+			item.deSerialize(iss, m_itemdef);
+			m_items[i] = item;
+		} else if (type == "Empty") {
+			m_items[i].clear();
+		} else {
+			throw SerializationError("invalid inventory slot content: " + type);
+		}
+	}
+}
+
 InventoryList::InventoryList(const InventoryList &other)
 {
 	*this = other;
@@ -513,10 +568,7 @@ bool InventoryList::operator == (const InventoryList &other) const
 		return false;
 	for(u32 i=0; i<m_items.size(); i++)
 	{
-		ItemStack s1 = m_items[i];
-		ItemStack s2 = other.m_items[i];
-		if(s1.name != s2.name || s1.wear!= s2.wear || s1.count != s2.count ||
-				s1.metadata != s2.metadata)
+		if (m_items[i] != other.m_items[i])
 			return false;
 	}
 
@@ -878,6 +930,58 @@ void Inventory::serialize(std::ostream &os) const
 	os<<"EndInventory\n";
 }
 
+bool Inventory::serializeDelta(std::ostream &os, const Inventory &old) const
+{
+	// Only slots are updated, the lists must stay the same
+	if (m_lists.size() != old.m_lists.size())
+		return false;
+	for (u32 i = 0; i < m_lists.size(); i++) {
+		const InventoryList *list = m_lists[i];
+		const InventoryList *old_list = old.m_lists[i];
+		if (list->getName() != old_list->getName() ||
+				list->getSize() != old_list->getSize() ||
+				list->getWidth() != old_list->getWidth())
+			return false;
+	}
+
+	for (u32 i = 0; i < m_lists.size(); i++) {
+		const InventoryList *list = m_lists[i];
+		if (*list == *old.m_lists[i])
+			continue;
+		os << "List " << list->getName() << "\n";
+		list->serializeDelta(os, *old.m_lists[i]);
+	}
+
+	os << "EndInventory\n";
+	return true;
+}
+
+void Inventory::deSerializeDelta(std::istream &is)
+{
+	for (;;) {
+		std::string line;
+		if (!std::getline(is, line, '\n'))
+			throw SerializationError("unexpected end of inventory");
+
+		std::istringstream iss(line);
+
+		std::string name;
+		std::getline(iss, name, ' ');
+
+		if (name == "EndInventory")
+			break;
+		if (name != "List")
+			throw SerializationError("invalid inventory specifier: " + name);
+
+		std::string listname;
+		std::getline(iss, listname, ' ');
+		InventoryList *list = getList(listname);
+		if (list == NULL)
+			throw SerializationError("unknown inventory list: " + listname);
+		list->deSerializeDelta(is);
+	}
+}
+
 void Inventory::deSerialize(std::istream &is)
 {
 	clear();
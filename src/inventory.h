@@ -48,6 +48,16 @@ struct ItemStack
 	// Returns the string used for inventory
 	std::string getItemString() const;
 
+	bool operator == (const ItemStack &other) const
+	{
+		return name == other.name && count == other.count &&
+			wear == other.wear && metadata == other.metadata;
+	}
+	bool operator != (const ItemStack &other) const
+	{
+		return !(*this == other);
+	}
+
 	/*
 		Quantity methods
 	*/
@@ -181,6 +191,9 @@ class InventoryList
 	void setName(const std::string &name);
 	void serialize(std::ostream &os) const;
 	void deSerialize(std::istream &is);
+	// Writes the slots that differ from 'old', a list of the same size
+	void serializeDelta(std::ostream &os, const InventoryList &old) const;
+	void deSerializeDelta(std::istream &is);
 
 	InventoryList(const InventoryList &other);
 	InventoryList & operator = (const InventoryList &other);
@@ -276,6 +289,10 @@ class Inventory
 
 	void serialize(std::ostream &os) const;
 	void deSerialize(std::istream &is);
+	// Writes the slots that differ from 'old'. Returns false, writing
+	// nothing, if the lists themselves differ.
+	bool serializeDelta(std::ostream &os, const Inventory &old) const;
+	void deSerializeDelta(std::istream &is);
 
 	InventoryList * addList(const std::string &name, u32 size);
 	InventoryList * getList(const std::string &name);
@@ -40,8 +40,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "fontengine.h"
 #include "gameparams.h"
 #include "database.h"
+#include "emerge.h"
+#include "threading/mutex_auto_lock.h"
+#include "threading/semaphore.h"
+#include "util/numeric.h"
 #include "config.h"
 #include "porting.h"
+#include "benchmark/benchmark.h"
 #if USE_CURSES
 	#include "terminal_chat_console.h"
 #endif
@@ -63,6 +68,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #define DEBUGFILE "debug.txt"
 #define DEFAULT_SERVER_PORT 30000
+// Mapchunks generated between two saves by --pregenerate
+#define PREGENERATE_BATCH_SIZE 64
 
 typedef std::map<std::string, ValueSpec> OptionList;
 
@@ -104,6 +111,7 @@ static bool determine_subgame(GameParams *game_params);
 
 static bool run_dedicated_server(const GameParams &game_params, const Settings &cmd_args);
 static bool migrate_map_database(const GameParams &game_params, const Settings &cmd_args);
+static bool pregenerate_map(const GameParams &game_params, const Settings &cmd_args);
 
 /**********************************************************************/
 
@@ -194,6 +202,22 @@ int main(int argc, char *argv[])
 	}
 #endif
 
+#if !defined(__ANDROID__) && !defined(__IOS__)
+	// Run the server benchmark
+	if (cmd_args.getFlag("run-benchmark")) {
+		porting::attachOrCreateConsole();
+		return run_benchmark(cmd_args) ? 0 : 1;
+	}
+	if (cmd_args.getFlag("run-serialize-benchmark")) {
+		porting::attachOrCreateConsole();
+		return run_serialize_benchmark(cmd_args) ? 0 : 1;
+	}
+	if (cmd_args.getFlag("run-pathfinder-benchmark")) {
+		porting::attachOrCreateConsole();
+		return run_pathfinder_benchmark(cmd_args) ? 0 : 1;
+	}
+#endif
+
 	GameParams game_params;
 #ifdef SERVER
 	porting::attachOrCreateConsole();
@@ -286,8 +310,28 @@ static void set_allowed_options(OptionList *allowed_options)
 			_("Migrate from current map backend to another (Only works when using minetestserver or with --server)"))));
 	allowed_options->insert(std::make_pair("migrate-players", ValueSpec(VALUETYPE_STRING,
 		_("Migrate from current players backend to another (Only works when using minetestserver or with --server)"))));
+	allowed_options->insert(std::make_pair("pregenerate", ValueSpec(VALUETYPE_STRING,
+			_("Generate and save the map within a radius around the spawn point, then exit (Only works when using minetestserver or with --server)"))));
+	allowed_options->insert(std::make_pair("pregenerate-min", ValueSpec(VALUETYPE_STRING,
+			_("Generate and save the map from this position \"(x,y,z)\" to --pregenerate-max, then exit"))));
+	allowed_options->insert(std::make_pair("pregenerate-max", ValueSpec(VALUETYPE_STRING,
+			_("Other corner of the area generated by --pregenerate-min"))));
 	allowed_options->insert(std::make_pair("terminal", ValueSpec(VALUETYPE_FLAG,
 			_("Feature an interactive terminal (Only works when using minetestserver or with --server)"))));
+#if !defined(__ANDROID__) && !defined(__IOS__)
+	allowed_options->insert(std::make_pair("run-benchmark", ValueSpec(VALUETYPE_FLAG,
+			_("Run the server benchmark with bot clients in a new world and exit"))));
+	allowed_options->insert(std::make_pair("benchmark-clients", ValueSpec(VALUETYPE_STRING,
+			_("Number of bot clients for --run-benchmark (default 10)"))));
+	allowed_options->insert(std::make_pair("benchmark-duration", ValueSpec(VALUETYPE_STRING,
+			_("Measured time of --run-benchmark in seconds (default 60)"))));
+	allowed_options->insert(std::make_pair("benchmark-seed", ValueSpec(VALUETYPE_STRING,
+			_("Map seed used by --run-benchmark"))));
+	allowed_options->insert(std::make_pair("run-serialize-benchmark", ValueSpec(VALUETYPE_FLAG,
+			_("Measure MapBlock serialization speed and exit"))));
+	allowed_options->insert(std::make_pair("run-pathfinder-benchmark", ValueSpec(VALUETYPE_FLAG,
+			_("Measure pathfinder speed on generated terrains and exit"))));
+#endif
 #ifndef SERVER
 	allowed_options->insert(std::make_pair("videomodes", ValueSpec(VALUETYPE_FLAG,
 			_("Show available video modes"))));
@@ -817,6 +861,11 @@ static bool run_dedicated_server(const GameParams &game_params, const Settings &
 	else if (cmd_args.exists("migrate-players"))
 		return ServerEnvironment::migratePlayersDatabase(game_params, cmd_args);
 
+	// Map pre-generation
+	if (cmd_args.exists("pregenerate") || cmd_args.exists("pregenerate-min") ||
+			cmd_args.exists("pregenerate-max"))
+		return pregenerate_map(game_params, cmd_args);
+
 	if (cmd_args.exists("terminal")) {
 #if USE_CURSES
 		bool name_ok = true;
@@ -966,3 +1015,148 @@ static bool migrate_map_database(const GameParams &game_params, const Settings &
 
 	return true;
 }
+
+struct PregenerateProgress {
+	Mutex mutex;
+	u32 generated;
+	u32 failed;
+	// Posted once for each finished mapchunk
+	Semaphore finished;
+
+	PregenerateProgress():
+		generated(0),
+		failed(0)
+	{}
+};
+
+static void pregenerate_callback(v3s16 blockpos, EmergeAction action, void *param)
+{
+	PregenerateProgress *progress = (PregenerateProgress *)param;
+	{
+		MutexAutoLock lock(progress->mutex);
+		if (action == EMERGE_GENERATED)
+			progress->generated++;
+		else if (action == EMERGE_CANCELLED || action == EMERGE_ERRORED)
+			progress->failed++;
+	}
+	progress->finished.post();
+}
+
+static bool pregenerate_map(const GameParams &game_params, const Settings &cmd_args)
+{
+	v3f minp, maxp;
+	if (cmd_args.exists("pregenerate")) {
+		float radius = cmd_args.getFloat("pregenerate");
+		v3f center;
+		g_settings->getV3FNoEx("static_spawnpoint", center);
+		minp = center - v3f(radius, radius, radius);
+		maxp = center + v3f(radius, radius, radius);
+	} else if (!cmd_args.getV3FNoEx("pregenerate-min", minp) ||
+			!cmd_args.getV3FNoEx("pregenerate-max", maxp)) {
+		errorstream << "Both --pregenerate-min and --pregenerate-max "
+			"must be given" << std::endl;
+		return false;
+	}
+
+	const s16 max_limit_bp = MAX_MAP_GENERATION_LIMIT / MAP_BLOCKSIZE;
+	v3s16 blockpos_min = getNodeBlockPos(floatToInt(minp, 1.0f));
+	v3s16 blockpos_max = getNodeBlockPos(floatToInt(maxp, 1.0f));
+	sortBoxVerticies(blockpos_min, blockpos_max);
+	blockpos_min.X = rangelim(blockpos_min.X, -max_limit_bp, max_limit_bp);
+	blockpos_min.Y = rangelim(blockpos_min.Y, -max_limit_bp, max_limit_bp);
+	blockpos_min.Z = rangelim(blockpos_min.Z, -max_limit_bp, max_limit_bp);
+	blockpos_max.X = rangelim(blockpos_max.X, -max_limit_bp, max_limit_bp);
+	blockpos_max.Y = rangelim(blockpos_max.Y, -max_limit_bp, max_limit_bp);
+	blockpos_max.Z = rangelim(blockpos_max.Z, -max_limit_bp, max_limit_bp);
+
+	// Nothing but the emerge threads runs, let them use every core.
+	// Settings are not written back when running a dedicated server.
+	g_settings->setS16("num_emerge_threads", Thread::getNumberOfProcessors());
+
+	bool &kill = *porting::signal_handler_killstatus();
+	try {
+		// The server is not started, no client is served
+		Server server(game_params.world_path, game_params.game_spec,
+			false, false, true);
+		EmergeManager *emerge = server.getEmergeManager();
+		const s16 csize = emerge->mgparams->chunksize;
+
+		// One block of every mapchunk, inside the requested area
+		std::vector<v3s16> chunks;
+		v3s16 chunk_min = emerge->getContainingChunk(blockpos_min);
+		for (s16 z = chunk_min.Z; z <= blockpos_max.Z; z += csize)
+		for (s16 y = chunk_min.Y; y <= blockpos_max.Y; y += csize)
+		for (s16 x = chunk_min.X; x <= blockpos_max.X; x += csize) {
+			chunks.push_back(v3s16(MYMAX(x, blockpos_min.X),
+				MYMAX(y, blockpos_min.Y), MYMAX(z, blockpos_min.Z)));
+		}
+
+		actionstream << "Pre-generating " << chunks.size() << " mapchunks from "
+			<< PP(blockpos_min * MAP_BLOCKSIZE) << " to "
+			<< PP((blockpos_max + 1) * MAP_BLOCKSIZE - 1) << std::endl;
+
+		PregenerateProgress progress;
+		emerge->startThreads();
+		u64 start_time = porting::getTimeMs();
+		u64 last_update_time = start_time;
+		size_t queued = 0, finished = 0;
+		while (finished < chunks.size()) {
+			size_t batch_end = MYMIN(queued + PREGENERATE_BATCH_SIZE,
+				chunks.size());
+			for (; queued < batch_end; queued++) {
+				emerge->enqueueBlockEmergeEx(chunks[queued], PEER_ID_INEXISTENT,
+					BLOCK_EMERGE_ALLOW_GEN | BLOCK_EMERGE_FORCE_QUEUE,
+					pregenerate_callback, &progress);
+			}
+
+			while (finished < queued) {
+				if (kill)
+					return false;
+				if (progress.finished.wait(1000))
+					finished++;
+				// Throws if an emerge thread failed
+				server.step(0);
+
+				u64 time = porting::getTimeMs();
+				if (time - last_update_time < 1000)
+					continue;
+				u32 generated;
+				{
+					MutexAutoLock lock(progress.mutex);
+					generated = progress.generated;
+				}
+				std::cerr << " Generated " << finished << " of " << chunks.size()
+					<< " mapchunks, "
+					<< (u64)generated * csize * csize * csize * 1000 /
+						(time - start_time) << " blocks/s, "
+					<< (100.0 * finished / chunks.size()) << "% completed.\r";
+				last_update_time = time;
+			}
+
+			// Save the batch in one transaction and free the memory,
+			// the emerge threads are idle now
+			MutexAutoLock envlock(server.m_env_mutex);
+			server.getMap().unloadUnreferencedBlocks();
+		}
+		std::cerr << std::endl;
+
+		float seconds = MYMAX(porting::getTimeMs() - start_time, 1) / 1000.0f;
+		u32 blocks = progress.generated * csize * csize * csize;
+		actionstream << "Generated " << progress.generated << " mapchunks ("
+			<< blocks << " blocks) in " << seconds << " s, "
+			<< blocks / seconds << " blocks/s" << std::endl;
+		if (progress.failed > 0) {
+			errorstream << progress.failed << " mapchunks could not be "
+				"generated" << std::endl;
+			return false;
+		}
+	} catch (const ModError &e) {
+		errorstream << "ModError: " << e.what() << std::endl;
+		return false;
+	} catch (const ServerError &e) {
+		errorstream << "ServerError: " << e.what() << std::endl;
+		return false;
+	}
+
+	return true;
+}
@@ -153,6 +153,15 @@ MapBlock * Map::getBlockNoCreateNoEx(v3s16 p3d)
 	return block;
 }
 
+MapBlock * Map::getBlockNoCreateNoExUnbuffered(v3s16 p3d) const
+{
+	std::map<v2s16, MapSector*>::const_iterator n =
+		m_sectors.find(v2s16(p3d.X, p3d.Z));
+	if (n == m_sectors.end())
+		return NULL;
+	return n->second->getBlockNoCreateNoExUnbuffered(p3d.Y);
+}
+
 MapBlock * Map::getBlockNoCreate(v3s16 p3d)
 {
 	MapBlock *block = getBlockNoCreateNoEx(p3d);
@@ -242,8 +251,10 @@ void Map::addNodeAndUpdate(v3s16 p, MapNode n,
 		std::map<v3s16, MapBlock*> &modified_blocks,
 		bool remove_metadata)
 {
-	// Collect old node for rollback
-	RollbackNode rollback_oldnode(this, p, m_gamedef);
+	// Collect old node for rollback, only when it is recorded
+	RollbackNode rollback_oldnode;
+	if (m_gamedef->rollback())
+		rollback_oldnode = RollbackNode(this, p, m_gamedef);
 
 	// This is needed for updating the lighting
 	MapNode oldnode = getNodeNoEx(p);
@@ -1243,7 +1254,8 @@ ServerMap::ServerMap(const std::string &savedir, IGameDef *gamedef,
 	Map(dout_server, gamedef),
 	settings_mgr(g_settings, savedir + DIR_DELIM + "map_meta.txt"),
 	m_emerge(emerge),
-	m_map_metadata_changed(true)
+	m_map_metadata_changed(true),
+	m_block_buffers(new BlockSerializeBuffers)
 {
 	verbosestream<<FUNCTION_NAME<<std::endl;
 
@@ -1350,6 +1362,8 @@ ServerMap::~ServerMap()
 	*/
 	delete dbase;
 
+	delete m_block_buffers;
+
 #if 0
 	/*
 		Free all MapChunks
@@ -2327,10 +2341,11 @@ void ServerMap::endSave()
 
 bool ServerMap::saveBlock(MapBlock *block)
 {
-	return saveBlock(block, dbase);
+	return saveBlock(block, dbase, m_block_buffers);
 }
 
-bool ServerMap::saveBlock(MapBlock *block, MapDatabase *db)
+bool ServerMap::saveBlock(MapBlock *block, MapDatabase *db,
+		BlockSerializeBuffers *buffers)
 {
 	v3s16 p3d = block->getPos();
 
@@ -2341,6 +2356,11 @@ bool ServerMap::saveBlock(MapBlock *block, MapDatabase *db)
 		return true;
 	}
 
+	if (!buffers) {
+		BlockSerializeBuffers tmp_buffers;
+		return saveBlock(block, db, &tmp_buffers);
+	}
+
 	// Format used for writing
 	u8 version = SER_FMT_VER_HIGHEST_WRITE;
 
@@ -2348,11 +2368,11 @@ bool ServerMap::saveBlock(MapBlock *block, MapDatabase *db)
 		[0] u8 serialization version
 		[1] data
 	*/
-	std::ostringstream o(std::ios_base::binary);
-	o.write((char*) &version, 1);
-	block->serialize(o, version, true);
+	std::string &data = buffers->output;
+	data.clear();
+	data.push_back((char)version);
+	block->serialize(data, version, true, *buffers);
 
-	std::string data = o.str();
 	bool ret = db->saveBlock(p3d, data);
 	if (ret) {
 		// We just wrote it to the disk so clear modified flag
@@ -2445,14 +2465,10 @@ void ServerMap::loadBlock(std::string *blob, v3s16 p3d, MapSector *sector, bool
 	DSTACK(FUNCTION_NAME);
 
 	try {
-		std::istringstream is(*blob, std::ios_base::binary);
-
-		u8 version = SER_FMT_VER_INVALID;
-		is.read((char*)&version, 1);
-
-		if(is.fail())
+		if (blob->empty())
 			throw SerializationError("ServerMap::loadBlock(): Failed"
 					" to read MapBlock version");
+		u8 version = (*blob)[0];
 
 		MapBlock *block = NULL;
 		bool created_new = false;
@@ -2464,7 +2480,8 @@ void ServerMap::loadBlock(std::string *blob, v3s16 p3d, MapSector *sector, bool
 		}
 
 		// Read basic data
-		block->deSerialize(is, version, true);
+		block->deSerialize((const u8 *)blob->c_str() + 1, blob->size() - 1,
+				version, true, *m_block_buffers);
 
 		// If it's a new block, insert it to the map
 		if (created_new) {
@@ -2743,4 +2760,15 @@ void MMVManip::blitBackAll(std::map<v3s16, MapBlock*> *modified_blocks,
 	}
 }
 
+bool MMVManip::hasUnloadedBlocks()
+{
+	for (std::map<v3s16, u8>::iterator i = m_loaded_blocks.begin();
+			i != m_loaded_blocks.end(); ++i) {
+		if (!(i->second & VMANIP_BLOCK_DATA_INEXIST) &&
+				!m_map->getBlockNoCreateNoEx(i->first))
+			return true;
+	}
+	return false;
+}
+
 //END
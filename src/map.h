@@ -42,6 +42,7 @@ class ClientMap;
 class MapSector;
 class ServerMapSector;
 class MapBlock;
+struct BlockSerializeBuffers;
 class NodeMetadata;
 class IGameDef;
 class IRollbackManager;
@@ -133,6 +134,8 @@ struct MapEditEvent
 class MapEventReceiver
 {
 public:
+	virtual ~MapEventReceiver() {}
+
 	// event shall be deleted by caller after the call.
 	virtual void onMapEditEvent(MapEditEvent *event) = 0;
 };
@@ -188,6 +191,10 @@ class Map /*: public NodeContainer*/
 	MapBlock * getBlockNoCreate(v3s16 p);
 	// Returns NULL if not found
 	MapBlock * getBlockNoCreateNoEx(v3s16 p);
+	// Same as the above, but doesn't use or update the lookup caches.
+	// Can be called from several threads at once while nobody modifies
+	// the map.
+	MapBlock * getBlockNoCreateNoExUnbuffered(v3s16 p) const;
 
 	/* Server overrides */
 	virtual MapBlock * emergeBlock(v3s16 p, bool create_blank=true)
@@ -455,7 +462,8 @@ class ServerMap : public Map
 	bool loadSectorMeta(v2s16 p2d);
 
 	bool saveBlock(MapBlock *block);
-	static bool saveBlock(MapBlock *block, MapDatabase *db);
+	static bool saveBlock(MapBlock *block, MapDatabase *db,
+		BlockSerializeBuffers *buffers = NULL);
 	// This will generate a sector with getSector if not found.
 	void loadBlock(const std::string &sectordir, const std::string &blockfile,
 			MapSector *sector, bool save_after_load=false);
@@ -508,6 +516,9 @@ class ServerMap : public Map
 	*/
 	bool m_map_metadata_changed;
 	MapDatabase *dbase;
+
+	// Reused for loading and saving blocks, behind the environment lock
+	BlockSerializeBuffers *m_block_buffers;
 };
 
 
@@ -536,6 +547,9 @@ class MMVManip : public VoxelManipulator
 	void blitBackAll(std::map<v3s16, MapBlock*> * modified_blocks,
 		bool overwrite_generated = true);
 
+	// Whether a block that was emerged has been unloaded from the map since
+	bool hasUnloadedBlocks();
+
 	bool m_is_dirty;
 
 protected:
@@ -19,6 +19,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "mapblock.h"
 
+#include <algorithm>
+#include <iterator>
 #include <sstream>
 #include "map.h"
 #include "light.h"
@@ -65,13 +67,18 @@ static const char *modified_reason_strings[] = {
 	MapBlock
 */
 
+u8 MapBlock::s_uniform_indices[MapBlock::nodecount];
+
 MapBlock::MapBlock(Map *parent, v3s16 pos, IGameDef *gamedef, bool dummy):
 		m_parent(parent),
 		m_pos(pos),
 		m_pos_relative(pos * MAP_BLOCKSIZE),
 		m_gamedef(gamedef),
+		m_palette_indices(NULL),
+		m_palette_size(0),
 		m_modified(MOD_STATE_WRITE_NEEDED),
 		m_modified_reason(MOD_REASON_INITIAL),
+		m_node_change_count(0),
 		is_underground(false),
 		m_lighting_complete(0xFFFF),
 		m_day_night_differs(false),
@@ -105,6 +112,7 @@ MapBlock::~MapBlock()
 	}
 #endif
 
+	freePaletteIndices();
 	if(data)
 		delete[] data;
 }
@@ -132,7 +140,100 @@ MapNode MapBlock::getNodeParent(v3s16 p, bool *is_valid_position)
 	}
 	if (is_valid_position)
 		*is_valid_position = true;
-	return data[p.Z * zstride + p.Y * ystride + p.X];
+	return data[dataIndex(p.Z * zstride + p.Y * ystride + p.X)];
+}
+
+void MapBlock::copyData(MapNode *dst)
+{
+	if (!m_palette_indices) {
+		memcpy(dst, data, nodecount * sizeof(MapNode));
+		return;
+	}
+	for (u32 i = 0; i < nodecount; i++)
+		dst[i] = data[m_palette_indices[i]];
+}
+
+void MapBlock::getContents(std::vector<content_t> &contents)
+{
+	contents.clear();
+	if (data == NULL) {
+		contents.push_back(CONTENT_IGNORE);
+		return;
+	}
+
+	u32 count = m_palette_indices ? m_palette_size : nodecount;
+	// Uncompacted blocks mostly consist of long runs of the same content
+	content_t previous_c = CONTENT_IGNORE;
+	for (u32 i = 0; i < count; i++) {
+		content_t c = data[i].getContent();
+		if (i > 0 && c == previous_c)
+			continue;
+		previous_c = c;
+		if (std::find(contents.begin(), contents.end(), c) == contents.end())
+			contents.push_back(c);
+	}
+}
+
+void MapBlock::compact()
+{
+	if (data == NULL || m_palette_indices)
+		return;
+
+	/*
+		Collect the different nodes in an open addressing hash table.
+		Consecutive nodes are usually equal, so the last one is checked first.
+	*/
+	MapNode palette[256];
+	u16 table[512]; // palette index + 1, 0 if free
+	u8 indices[nodecount];
+	memset(table, 0, sizeof(table));
+	u32 count = 0;
+	u8 last = 0;
+	for (u32 i = 0; i < nodecount; i++) {
+		const MapNode &n = data[i];
+		if (count == 0 || !(palette[last] == n)) {
+			u32 key = (u32)n.param0 << 16 | (u32)n.param1 << 8 | n.param2;
+			u32 h = (key * 2654435761U) >> 23;
+			for (;;) {
+				if (table[h] == 0) {
+					// Too many different nodes to be worth it
+					if (count == 256)
+						return;
+					palette[count] = n;
+					table[h] = ++count;
+					last = count - 1;
+					break;
+				}
+				if (palette[table[h] - 1] == n) {
+					last = table[h] - 1;
+					break;
+				}
+				h = (h + 1) & 511;
+			}
+		}
+		indices[i] = last;
+	}
+
+	delete[] data;
+	data = new MapNode[count];
+	memcpy(data, palette, count * sizeof(MapNode));
+	m_palette_size = count;
+	if (count == 1) {
+		m_palette_indices = s_uniform_indices;
+	} else {
+		m_palette_indices = new u8[nodecount];
+		memcpy(m_palette_indices, indices, nodecount);
+	}
+}
+
+void MapBlock::expand()
+{
+	MapNode *nodes = new MapNode[nodecount];
+	copyData(nodes);
+	freePaletteIndices();
+	delete[] data;
+	data = nodes;
+	m_palette_size = 0;
 }
 
 std::string MapBlock::getModifiedReasonString()
@@ -266,7 +367,8 @@ bool MapBlock::propagateSunlight(std::set<v3s16> & light_sources,
 			for(; y >= 0; y--)
 			{
 				v3s16 pos(x, y, z);
-				MapNode &n = getNodeRef(pos);
+				// Compact blocks are only expanded if the light changes
+				MapNode n = getNodeUnsafe(pos);
 
 				if(current_light == 0)
 				{
@@ -295,6 +397,7 @@ bool MapBlock::propagateSunlight(std::set<v3s16> & light_sources,
 				if(current_light > old_light || remove_light)
 				{
 					n.setLight(LIGHTBANK_DAY, current_light, nodemgr);
+					setNodeData(z * zstride + y * ystride + x, n);
 				}
 
 				if(diminish_light(current_light) != 0)
@@ -357,7 +460,15 @@ void MapBlock::copyTo(VoxelManipulator &dst)
 	VoxelArea data_area(v3s16(0,0,0), data_size - v3s16(1,1,1));
 
 	// Copy from data to VoxelManipulator
-	dst.copyFrom(data, data_area, v3s16(0,0,0),
+	if (!m_palette_indices) {
+		dst.copyFrom(data, data_area, v3s16(0,0,0),
+				getPosRelative(), data_size);
+		return;
+	}
+
+	MapNode nodes[nodecount];
+	copyData(nodes);
+	dst.copyFrom(nodes, data_area, v3s16(0,0,0),
 			getPosRelative(), data_size);
 }
 
@@ -366,9 +477,13 @@ void MapBlock::copyFrom(VoxelManipulator &dst)
 	v3s16 data_size(MAP_BLOCKSIZE, MAP_BLOCKSIZE, MAP_BLOCKSIZE);
 	VoxelArea data_area(v3s16(0,0,0), data_size - v3s16(1,1,1));
 
+	if (m_palette_indices)
+		expand();
+
 	// Copy from VoxelManipulator to data
 	dst.copyTo(data, data_area, v3s16(0,0,0),
 			getPosRelative(), data_size);
+	m_node_change_count++;
 }
 
 void MapBlock::actuallyUpdateDayNightDiff()
@@ -385,10 +500,13 @@ void MapBlock::actuallyUpdateDayNightDiff()
 
 	bool differs;
 
+	// A compact block contains exactly the nodes of its palette
+	u32 count = m_palette_indices ? m_palette_size : nodecount;
+
 	/*
 		Check if any lighting value differs
 	*/
-	for (u32 i = 0; i < nodecount; i++) {
+	for (u32 i = 0; i < count; i++) {
 		MapNode &n = data[i];
 
 		differs = !n.isLightDayNightEq(nodemgr);
@@ -402,7 +520,7 @@ void MapBlock::actuallyUpdateDayNightDiff()
 	*/
 	if (differs) {
 		bool only_air = true;
-		for (u32 i = 0; i < nodecount; i++) {
+		for (u32 i = 0; i < count; i++) {
 			MapNode &n = data[i];
 			if (n.getContent() != CONTENT_AIR) {
 				only_air = false;
@@ -439,7 +557,7 @@ s16 MapBlock::getGroundLevel(v2s16 p2d)
 		s16 y = MAP_BLOCKSIZE-1;
 		for(; y>=0; y--)
 		{
-			MapNode n = getNodeRef(p2d.X, y, p2d.Y);
+			MapNode n = getNodeNoEx(v3s16(p2d.X, y, p2d.Y));
 			if(m_gamedef->ndef()->get(n).walkable)
 			{
 				if(y == MAP_BLOCKSIZE-1)
@@ -459,52 +577,104 @@ s16 MapBlock::getGroundLevel(v2s16 p2d)
 /*
 	Serialization
 */
-// List relevant id-name pairs for ids in the block using nodedef
-// Renumbers the content IDs (starting at 0 and incrementing
-// use static memory requires about 65535 * sizeof(int) ram in order to be
-// sure we can handle all content ids. But it's absolutely worth it as it's
-// a speedup of 4 for one of the major time consuming functions on storing
-// mapblocks.
-static content_t getBlockNodeIdMapping_mapping[USHRT_MAX + 1];
-static void getBlockNodeIdMapping(NameIdMapping *nimap, MapNode *nodes,
-		INodeDefManager *nodedef)
+
+const content_t BlockSerializeBuffers::UNMAPPED;
+
+static inline void appendU8(std::string &dst, u8 i)
 {
-	memset(getBlockNodeIdMapping_mapping, 0xFF, (USHRT_MAX + 1) * sizeof(content_t));
+	dst.push_back((char)i);
+}
 
-	std::set<content_t> unknown_contents;
-	content_t id_counter = 0;
-	for (u32 i = 0; i < MapBlock::nodecount; i++) {
-		content_t global_id = nodes[i].getContent();
-		content_t id = CONTENT_IGNORE;
+static inline void appendU16(std::string &dst, u16 i)
+{
+	u8 buf[2];
+	writeU16(buf, i);
+	dst.append((const char *)buf, 2);
+}
 
-		// Try to find an existing mapping
-		if (getBlockNodeIdMapping_mapping[global_id] != 0xFFFF) {
-			id = getBlockNodeIdMapping_mapping[global_id];
-		}
-		else
-		{
-			// We have to assign a new mapping
-			id = id_counter++;
-			getBlockNodeIdMapping_mapping[global_id] = id;
-
-			const ContentFeatures &f = nodedef->get(global_id);
-			const std::string &name = f.name;
-			if(name == "")
-				unknown_contents.insert(global_id);
-			else
-				nimap->set(id, name);
+static inline void appendU32(std::string &dst, u32 i)
+{
+	u8 buf[4];
+	writeU32(buf, i);
+	dst.append((const char *)buf, 4);
+}
+
+// Number of bytes read from a stream over size bytes of memory
+static size_t getReadCount(std::istream &is, size_t size)
+{
+	if (is.eof())
+		return size;
+	std::streampos pos = is.tellg();
+	return pos < 0 ? size : (size_t)pos;
+}
+
+/*
+	Node timers and static objects are empty for most blocks; only
+	non-empty lists go through their stream based (de)serializers.
+*/
+
+static void appendNodeTimers(std::string &dst, const NodeTimerList &timers,
+		u8 version)
+{
+	if (timers.empty()) {
+		if (version == 24) {
+			appendU8(dst, 0); // version
+		} else {
+			appendU8(dst, 2 + 4 + 4); // length of the data for a single timer
+			appendU16(dst, 0); // count
 		}
+		return;
+	}
+	std::ostringstream os(std::ios_base::binary);
+	timers.serialize(os, version);
+	dst.append(os.str());
+}
 
-		// Update the MapNode
-		nodes[i].setContent(id);
+static void readNodeTimers(BufReader &br, NodeTimerList &timers, u8 version)
+{
+	const u8 *p = br.data + br.pos;
+	if (version == 24 && br.remaining() >= 1 && p[0] == 0) {
+		timers.clear();
+		br.pos += 1;
+		return;
 	}
-	for(std::set<content_t>::const_iterator
-			i = unknown_contents.begin();
-			i != unknown_contents.end(); ++i){
-		errorstream<<"getBlockNodeIdMapping(): IGNORING ERROR: "
-				<<"Name for node id "<<(*i)<<" not known"<<std::endl;
+	if (version >= 25 && br.remaining() >= 3 && p[0] == 2 + 4 + 4 &&
+			readU16(p + 1) == 0) {
+		timers.clear();
+		br.pos += 3;
+		return;
+	}
+	std::istringstream is(std::string((const char *)p, br.remaining()),
+		std::ios_base::binary);
+	timers.deSerialize(is, version);
+	br.pos += getReadCount(is, br.remaining());
+}
+
+static void appendStaticObjects(std::string &dst, StaticObjectList &objects)
+{
+	if (objects.m_stored.empty() && objects.m_active.empty()) {
+		appendU8(dst, 0); // version
+		appendU16(dst, 0); // count
+		return;
+	}
+	std::ostringstream os(std::ios_base::binary);
+	objects.serialize(os);
+	dst.append(os.str());
+}
+
+static void readStaticObjects(BufReader &br, StaticObjectList &objects)
+{
+	const u8 *p = br.data + br.pos;
+	if (br.remaining() >= 3 && readU16(p + 1) == 0) {
+		br.pos += 3;
+		return;
 	}
+	std::istringstream is(std::string((const char *)p, br.remaining()),
+		std::ios_base::binary);
+	objects.deSerialize(is);
+	br.pos += getReadCount(is, br.remaining());
 }
+
 // Correct ids in the block to match nodedef based on names.
 // Unknown ones are added to nodedef.
 // Will not update itself to match id-name pairs in nodedef.
@@ -554,6 +724,15 @@ static void correctBlockNodeIds(const NameIdMapping *nimap, MapNode *nodes,
 }
 
 void MapBlock::serialize(std::ostream &os, u8 version, bool disk)
+{
+	BlockSerializeBuffers buffers;
+	std::string dst;
+	serialize(dst, version, disk, buffers);
+	os.write(dst.c_str(), dst.size());
+}
+
+void MapBlock::serialize(std::string &dst, u8 version, bool disk,
+		BlockSerializeBuffers &buffers)
 {
 	if(!ser_ver_supported(version))
 		throw VersionMismatchException("ERROR: MapBlock format not supported");
@@ -573,46 +752,57 @@ void MapBlock::serialize(std::ostream &os, u8 version, bool disk)
 		flags |= 0x02;
 	if(m_generated == false)
 		flags |= 0x08;
-	writeU8(os, flags);
+	appendU8(dst, flags);
 	if (version >= 27) {
-		writeU16(os, m_lighting_complete);
+		appendU16(dst, m_lighting_complete);
 	}
 
 	/*
 		Bulk node data
+		On disk, content ids are numbered in order of appearance and
+		mapped to names below.
 	*/
-	NameIdMapping nimap;
-	if(disk)
-	{
-		MapNode *tmp_nodes = new MapNode[nodecount];
-		for(u32 i=0; i<nodecount; i++)
-			tmp_nodes[i] = data[i];
-		getBlockNodeIdMapping(&nimap, tmp_nodes, m_gamedef->ndef());
-
-		u8 content_width = 2;
-		u8 params_width = 2;
-		writeU8(os, content_width);
-		writeU8(os, params_width);
-		MapNode::serializeBulk(os, version, tmp_nodes, nodecount,
-				content_width, params_width, true);
-		delete[] tmp_nodes;
-	}
-	else
-	{
-		u8 content_width = 2;
-		u8 params_width = 2;
-		writeU8(os, content_width);
-		writeU8(os, params_width);
-		MapNode::serializeBulk(os, version, data, nodecount,
-				content_width, params_width, true);
+	const u8 content_width = 2;
+	const u8 params_width = 2;
+	appendU8(dst, content_width);
+	appendU8(dst, params_width);
+
+	std::string &databuf = buffers.scratch;
+	databuf.resize(nodecount * (content_width + params_width));
+	u8 *content = (u8 *)&databuf[0];
+	u8 *param1 = content + content_width * nodecount;
+	u8 *param2 = param1 + nodecount;
+	if (disk)
+		buffers.clearIdMap();
+	for (u32 i = 0; i < nodecount; i++) {
+		const MapNode &n = data[dataIndex(i)];
+		content_t id = n.getContent();
+		if (disk) {
+			content_t &local_id = buffers.id_map[id];
+			if (local_id == BlockSerializeBuffers::UNMAPPED) {
+				local_id = buffers.mapped_ids.size();
+				buffers.mapped_ids.push_back(id);
+			}
+			id = local_id;
+		}
+		writeU16(&content[i * 2], id);
+		param1[i] = n.param1;
+		param2[i] = n.param2;
 	}
+	buffers.compressor.compress(content, databuf.size(), dst);
 
 	/*
 		Node metadata
 	*/
-	std::ostringstream oss(std::ios_base::binary);
-	m_node_metadata.serialize(oss, version, disk);
-	compressZlib(oss.str(), os);
+	if (m_node_metadata.empty()) {
+		const u8 no_metadata = 0; // version 0
+		buffers.compressor.compress(&no_metadata, 1, dst);
+	} else {
+		std::ostringstream oss(std::ios_base::binary);
+		m_node_metadata.serialize(oss, version, disk);
+		std::string s = oss.str();
+		buffers.compressor.compress((const u8 *)s.c_str(), s.size(), dst);
+	}
 
 	/*
 		Data that goes to disk, but not the network
@@ -621,37 +811,79 @@ void MapBlock::serialize(std::ostream &os, u8 version, bool disk)
 	{
 		if(version <= 24){
 			// Node timers
-			m_node_timers.serialize(os, version);
+			appendNodeTimers(dst, m_node_timers, version);
 		}
 
 		// Static objects
-		m_static_objects.serialize(os);
+		appendStaticObjects(dst, m_static_objects);
 
 		// Timestamp
-		writeU32(os, getTimestamp());
-
-		// Write block-specific node definition id mapping
-		nimap.serialize(os);
+		appendU32(dst, getTimestamp());
+
+		// Write block-specific node definition id mapping,
+		// in the format of NameIdMapping
+		INodeDefManager *nodedef = m_gamedef->ndef();
+		size_t count_pos = dst.size() + 1;
+		appendU8(dst, 0); // version
+		appendU16(dst, 0); // count, written below
+		u16 count = 0;
+		for (size_t i = 0; i < buffers.mapped_ids.size(); i++) {
+			content_t id = buffers.mapped_ids[i];
+			const std::string &name = nodedef->get(id).name;
+			if (name.empty()) {
+				errorstream << "MapBlock::serialize(): IGNORING ERROR: "
+						<< "Name for node id " << id << " not known"
+						<< std::endl;
+				continue;
+			}
+			appendU16(dst, i);
+			appendU16(dst, name.size());
+			dst.append(name);
+			count++;
+		}
+		writeU16((u8 *)&dst[count_pos], count);
 
 		if(version >= 25){
 			// Node timers
-			m_node_timers.serialize(os, version);
+			appendNodeTimers(dst, m_node_timers, version);
 		}
 	}
 }
 
 void MapBlock::serializeNetworkSpecific(std::ostream &os)
+{
+	std::string dst;
+	serializeNetworkSpecific(dst);
+	os.write(dst.c_str(), dst.size());
+}
+
+void MapBlock::serializeNetworkSpecific(std::string &dst)
 {
 	if (!data) {
 		throw SerializationError("ERROR: Not writing dummy block.");
 	}
 
-	writeU8(os, 1); // version
-	writeF1000(os, 0); // deprecated heat
-	writeF1000(os, 0); // deprecated humidity
+	appendU8(dst, 1); // version
+	appendU32(dst, 0); // deprecated heat
+	appendU32(dst, 0); // deprecated humidity
 }
 
 void MapBlock::deSerialize(std::istream &is, u8 version, bool disk)
+{
+	// Read the rest of the stream and give back what the block didn't use
+	std::streampos start = is.tellg();
+	std::string buf((std::istreambuf_iterator<char>(is)),
+		std::istreambuf_iterator<char>());
+
+	BlockSerializeBuffers buffers;
+	size_t used = deSerialize((const u8 *)buf.c_str(), buf.size(),
+		version, disk, buffers);
+	is.clear();
+	is.seekg(start + (std::streamoff)used);
+}
+
+size_t MapBlock::deSerialize(const u8 *buf, size_t size, u8 version,
+		bool disk, BlockSerializeBuffers &buffers)
 {
 	if(!ser_ver_supported(version))
 		throw VersionMismatchException("ERROR: MapBlock format not supported");
@@ -660,19 +892,26 @@ void MapBlock::deSerialize(std::istream &is, u8 version, bool disk)
 
 	m_day_night_differs_expired = false;
 
+	// All nodes are overwritten, a compact block doesn't need expanding
+	if (m_palette_indices)
+		reallocate();
+
 	if(version <= 21)
 	{
+		std::istringstream is(std::string((const char *)buf, size),
+			std::ios_base::binary);
 		deSerialize_pre22(is, version, disk);
-		return;
+		return getReadCount(is, size);
 	}
 
-	u8 flags = readU8(is);
+	BufReader br(buf, size);
+	u8 flags = br.getU8();
 	is_underground = (flags & 0x01) ? true : false;
 	m_day_night_differs = (flags & 0x02) ? true : false;
 	if (version < 27)
 		m_lighting_complete = 0xFFFF;
 	else
-		m_lighting_complete = readU16(is);
+		m_lighting_complete = br.getU16();
 	m_generated = (flags & 0x08) ? false : true;
 
 	/*
@@ -680,14 +919,20 @@ void MapBlock::deSerialize(std::istream &is, u8 version, bool disk)
 	*/
 	TRACESTREAM(<<"MapBlock::deSerialize "<<PP(getPos())
 			<<": Bulk node data"<<std::endl);
-	u8 content_width = readU8(is);
-	u8 params_width = readU8(is);
+	u8 content_width = br.getU8();
+	u8 params_width = br.getU8();
 	if(content_width != 1 && content_width != 2)
 		throw SerializationError("MapBlock::deSerialize(): invalid content_width");
 	if(params_width != 2)
 		throw SerializationError("MapBlock::deSerialize(): invalid params_width");
-	MapNode::deSerializeBulk(is, version, data, nodecount,
-			content_width, params_width, true);
+	std::string &databuf = buffers.scratch;
+	br.pos += buffers.decompressor.decompress(br.data + br.pos,
+		br.remaining(), databuf);
+	if (databuf.size() != nodecount * (content_width + params_width))
+		throw SerializationError("MapBlock::deSerialize(): "
+				"decompress resulted in invalid size");
+	MapNode::deSerializeBulk((const u8 *)databuf.c_str(), version, data,
+			nodecount, content_width, params_width);
 
 	/*
 		NodeMetadata
@@ -696,15 +941,20 @@ void MapBlock::deSerialize(std::istream &is, u8 version, bool disk)
 			<<": Node metadata"<<std::endl);
 	// Ignore errors
 	try {
-		std::ostringstream oss(std::ios_base::binary);
-		decompressZlib(is, oss);
-		std::istringstream iss(oss.str(), std::ios_base::binary);
-		if (version >= 23)
-			m_node_metadata.deSerialize(iss, m_gamedef->idef());
-		else
-			content_nodemeta_deserialize_legacy(iss,
-				&m_node_metadata, &m_node_timers,
-				m_gamedef->idef());
+		br.pos += buffers.decompressor.decompress(br.data + br.pos,
+			br.remaining(), databuf);
+		if (databuf.size() == 1 && databuf[0] == 0) {
+			// Version 0 means no metadata
+			m_node_metadata.clear();
+		} else {
+			std::istringstream iss(databuf, std::ios_base::binary);
+			if (version >= 23)
+				m_node_metadata.deSerialize(iss, m_gamedef->idef());
+			else
+				content_nodemeta_deserialize_legacy(iss,
+					&m_node_metadata, &m_node_timers,
+					m_gamedef->idef());
+		}
 	} catch(SerializationError &e) {
 		warningstream<<"MapBlock::deSerialize(): Ignoring an error"
 				<<" while deserializing node metadata at ("
@@ -719,41 +969,90 @@ void MapBlock::deSerialize(std::istream &is, u8 version, bool disk)
 		// Node timers
 		if(version == 23){
 			// Read unused zero
-			readU8(is);
+			br.getU8();
 		}
 		if(version == 24){
 			TRACESTREAM(<<"MapBlock::deSerialize "<<PP(getPos())
 					<<": Node timers (ver==24)"<<std::endl);
-			m_node_timers.deSerialize(is, version);
+			readNodeTimers(br, m_node_timers, version);
 		}
 
 		// Static objects
 		TRACESTREAM(<<"MapBlock::deSerialize "<<PP(getPos())
 				<<": Static objects"<<std::endl);
-		m_static_objects.deSerialize(is);
+		readStaticObjects(br, m_static_objects);
 
 		// Timestamp
 		TRACESTREAM(<<"MapBlock::deSerialize "<<PP(getPos())
 				<<": Timestamp"<<std::endl);
-		setTimestamp(readU32(is));
+		setTimestamp(br.getU32());
 		m_disk_timestamp = m_timestamp;
 
 		// Dynamically re-set ids based on node names
 		TRACESTREAM(<<"MapBlock::deSerialize "<<PP(getPos())
 				<<": NameIdMapping"<<std::endl);
-		NameIdMapping nimap;
-		nimap.deSerialize(is);
-		correctBlockNodeIds(&nimap, data, m_gamedef);
+		correctNodeIds(br, buffers);
 
 		if(version >= 25){
 			TRACESTREAM(<<"MapBlock::deSerialize "<<PP(getPos())
 					<<": Node timers (ver>=25)"<<std::endl);
-			m_node_timers.deSerialize(is, version);
+			readNodeTimers(br, m_node_timers, version);
 		}
 	}
 
+	compact();
+
 	TRACESTREAM(<<"MapBlock::deSerialize "<<PP(getPos())
 			<<": Done."<<std::endl);
+	return br.pos;
+}
+
+// Reads a NameIdMapping and converts the block-specific content ids to the
+// global ones, like correctBlockNodeIds() but without a lookup per node.
+// Unknown names are added to the node definitions.
+void MapBlock::correctNodeIds(BufReader &br, BlockSerializeBuffers &buffers)
+{
+	INodeDefManager *nodedef = m_gamedef->ndef();
+	std::vector<content_t> &id_map = buffers.id_map;
+	buffers.clearIdMap();
+
+	if (br.getU8() != 0)
+		throw SerializationError("unsupported NameIdMapping version");
+	u16 count = br.getU16();
+	for (u16 i = 0; i < count; i++) {
+		content_t local_id = br.getU16();
+		if (!br.getStringNoEx(&buffers.name))
+			throw SerializationError("MapBlock::deSerialize(): "
+					"invalid NameIdMapping");
+
+		content_t global_id;
+		if (!nodedef->getId(buffers.name, global_id)) {
+			global_id = m_gamedef->allocateUnknownNodeId(buffers.name);
+			if (global_id == CONTENT_IGNORE) {
+				errorstream << "correctBlockNodeIds(): IGNORING ERROR: "
+						<< "Could not allocate global id for node name \""
+						<< buffers.name << "\"" << std::endl;
+				// Keep the id, like nodes without a name
+				global_id = local_id;
+			}
+		}
+		if (id_map[local_id] == BlockSerializeBuffers::UNMAPPED)
+			buffers.mapped_ids.push_back(local_id);
+		id_map[local_id] = global_id;
+	}
+
+	for (u32 i = 0; i < nodecount; i++) {
+		content_t local_id = data[i].getContent();
+		content_t global_id = id_map[local_id];
+		if (global_id == BlockSerializeBuffers::UNMAPPED) {
+			errorstream << "correctBlockNodeIds(): IGNORING ERROR: "
+					<< "Block contains id " << local_id
+					<< " with no name mapping" << std::endl;
+			global_id = id_map[local_id] = local_id;
+			buffers.mapped_ids.push_back(local_id);
+		}
+		data[i].setContent(global_id);
+	}
 }
 
 void MapBlock::deSerializeNetworkSpecific(std::istream &is)
@@ -30,6 +30,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "nodemetadata.h"
 #include "nodetimer.h"
 #include "modifiedstate.h"
+#include "serialization.h"
 #include "util/numeric.h" // getContainerPos
 #include "settings.h"
 #include "mapgen.h"
@@ -39,6 +40,7 @@ class NodeMetadataList;
 class IGameDef;
 class MapBlockMesh;
 class VoxelManipulator;
+class BufReader;
 
 #define BLOCK_TIMESTAMP_UNDEFINED 0xffffffff
 
@@ -125,6 +127,41 @@ class NodeContainer
 #define MOD_REASON_VMANIP                    (1 << 19)
 #define MOD_REASON_UNKNOWN                   (1 << 20)
 
+////
+//// Buffers for serializing MapBlocks
+////
+
+/*
+	Buffers and zlib streams that are reused when (de)serializing many
+	blocks. An instance must only be used by one thread at a time.
+*/
+struct BlockSerializeBuffers
+{
+	static const content_t UNMAPPED = 0xFFFF;
+
+	ZlibCompressor compressor;
+	ZlibDecompressor decompressor;
+	// Uncompressed node data and node metadata
+	std::string scratch;
+	// Maps content ids between blocks and the node definitions.
+	// Entries not listed in mapped_ids are UNMAPPED.
+	std::vector<content_t> id_map;
+	std::vector<content_t> mapped_ids;
+	std::string name;
+	// Free for the caller, e.g. to hold the whole serialized block
+	std::string output;
+
+	// Resets the entries of id_map used by the previous block
+	void clearIdMap()
+	{
+		if (id_map.empty())
+			id_map.resize(U16_MAX + 1, UNMAPPED);
+		for (size_t i = 0; i < mapped_ids.size(); i++)
+			id_map[mapped_ids[i]] = UNMAPPED;
+		mapped_ids.clear();
+	}
+};
+
 ////
 //// MapBlock itself
 ////
@@ -147,19 +184,36 @@ class MapBlock /*: public NodeContainer*/
 
 	void reallocate()
 	{
+		freePaletteIndices();
 		delete[] data;
 		data = new MapNode[nodecount];
 		for (u32 i = 0; i < nodecount; i++)
 			data[i] = MapNode(CONTENT_IGNORE);
+		m_node_change_count++;
 
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_REALLOCATE);
 	}
 
-	MapNode* getData()
+	// Copies all nodes to dst, which must hold nodecount nodes
+	void copyData(MapNode *dst);
+
+	////
+	//// Compact storage
+	////
+
+	// Stores the nodes as indices into a palette if there are at most
+	// 256 different ones. The block is expanded again on the first write.
+	void compact();
+
+	inline bool isCompact()
 	{
-		return data;
+		return m_palette_indices != NULL;
 	}
 
+	// Collects the different contents of the block. Compact blocks only
+	// look at their palette.
+	void getContents(std::vector<content_t> &contents);
+
 	////
 	//// Modification tracking methods
 	////
@@ -193,6 +247,13 @@ class MapBlock /*: public NodeContainer*/
 		m_modified_reason = 0;
 	}
 
+	// Increased whenever nodes are written, so that code working on a copy
+	// of the nodes can tell if the copy is outdated
+	inline u32 getNodeChangeCount()
+	{
+		return m_node_change_count;
+	}
+
 	////
 	//// Flags
 	////
@@ -317,7 +378,7 @@ class MapBlock /*: public NodeContainer*/
 		if (!*valid_position)
 			return MapNode(CONTENT_IGNORE);
 
-		return data[z * zstride + y * ystride + x];
+		return data[dataIndex(z * zstride + y * ystride + x)];
 	}
 
 	inline MapNode getNode(v3s16 p, bool *valid_position)
@@ -336,7 +397,7 @@ class MapBlock /*: public NodeContainer*/
 		if (!isValidPosition(x, y, z))
 			throw InvalidPositionException();
 
-		data[z * zstride + y * ystride + x] = n;
+		setNodeData(z * zstride + y * ystride + x, n);
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_NODE);
 	}
 
@@ -355,7 +416,7 @@ class MapBlock /*: public NodeContainer*/
 		if (!valid_position)
 			return MapNode(CONTENT_IGNORE);
 
-		return data[z * zstride + y * ystride + x];
+		return data[dataIndex(z * zstride + y * ystride + x)];
 	}
 
 	inline MapNode getNodeNoCheck(v3s16 p, bool *valid_position)
@@ -371,7 +432,7 @@ class MapBlock /*: public NodeContainer*/
 
 	inline const MapNode &getNodeUnsafe(s16 x, s16 y, s16 z)
 	{
-		return data[z * zstride + y * ystride + x];
+		return data[dataIndex(z * zstride + y * ystride + x)];
 	}
 
 	inline const MapNode &getNodeUnsafe(v3s16 &p)
@@ -384,7 +445,7 @@ class MapBlock /*: public NodeContainer*/
 		if (data == NULL)
 			throw InvalidPositionException();
 
-		data[z * zstride + y * ystride + x] = n;
+		setNodeData(z * zstride + y * ystride + x, n);
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_NODE_NO_CHECK);
 	}
 
@@ -544,11 +605,19 @@ class MapBlock /*: public NodeContainer*/
 	// Set disk to true for on-disk format, false for over-the-network format
 	// Precondition: version >= SER_FMT_VER_LOWEST_WRITE
 	void serialize(std::ostream &os, u8 version, bool disk);
+	// Appends the block to dst. Reusing dst and the buffers for many
+	// blocks avoids almost all allocations.
+	void serialize(std::string &dst, u8 version, bool disk,
+		BlockSerializeBuffers &buffers);
 	// If disk == true: In addition to doing other things, will add
 	// unknown blocks from id-name mapping to wndef
 	void deSerialize(std::istream &is, u8 version, bool disk);
+	// Returns the number of bytes read from data
+	size_t deSerialize(const u8 *data, size_t size, u8 version, bool disk,
+		BlockSerializeBuffers &buffers);
 
 	void serializeNetworkSpecific(std::ostream &os);
+	void serializeNetworkSpecific(std::string &dst);
 	void deSerializeNetworkSpecific(std::istream &is);
 private:
 	/*
@@ -556,6 +625,38 @@ class MapBlock /*: public NodeContainer*/
 	*/
 
 	void deSerialize_pre22(std::istream &is, u8 version, bool disk);
+	void correctNodeIds(BufReader &br, BlockSerializeBuffers &buffers);
+
+	/*
+		Compact storage helpers
+	*/
+
+	inline u32 dataIndex(u32 i)
+	{
+		return m_palette_indices ? m_palette_indices[i] : i;
+	}
+
+	inline void setNodeData(u32 i, MapNode &n)
+	{
+		if (m_palette_indices) {
+			// Writing the same node again keeps the block compact
+			if (data[m_palette_indices[i]] == n)
+				return;
+			expand();
+		}
+		data[i] = n;
+		m_node_change_count++;
+	}
+
+	// Converts a compact block back to a full node array
+	void expand();
+
+	inline void freePaletteIndices()
+	{
+		if (m_palette_indices != s_uniform_indices)
+			delete[] m_palette_indices;
+		m_palette_indices = NULL;
+	}
 
 	/*
 		Used only internally, because changes can't be tracked
@@ -566,6 +667,8 @@ class MapBlock /*: public NodeContainer*/
 		if (!isValidPosition(x, y, z))
 			throw InvalidPositionException();
 
+		if (m_palette_indices)
+			expand();
 		return data[z * zstride + y * ystride + x];
 	}
 
@@ -615,8 +718,15 @@ class MapBlock /*: public NodeContainer*/
 	/*
 		If NULL, block is a dummy block.
 		Dummy blocks are used for caching not-found-on-disk blocks.
+		If m_palette_indices is set, the block is compact and data only
+		holds the palette the indices refer to.
 	*/
 	MapNode *data;
+	u8 *m_palette_indices;
+	u16 m_palette_size;
+
+	// All zero, shared by the indices of uniform blocks
+	static u8 s_uniform_indices[nodecount];
 
 	/*
 		- On the server, this is used for telling whether the
@@ -625,6 +735,7 @@ class MapBlock /*: public NodeContainer*/
 	*/
 	u32 m_modified;
 	u32 m_modified_reason;
+	u32 m_node_change_count;
 
 	/*
 		When propagating sunlight and the above block doesn't exist,
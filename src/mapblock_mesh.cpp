@@ -74,7 +74,7 @@ void MeshMakeData::fill(MapBlock *block)
 {
 	fillBlockDataBegin(block->getPos());
 
-	fillBlockData(v3s16(0,0,0), block->getData());
+	block->copyTo(m_vmanip);
 
 	// Get map for reading neigbhor blocks
 	Map *map = block->getParent();
@@ -84,7 +84,7 @@ void MeshMakeData::fill(MapBlock *block)
 		v3s16 bp = m_blockpos + dir;
 		MapBlock *b = map->getBlockNoCreateNoEx(bp);
 		if(b)
-			fillBlockData(dir, b->getData());
+			b->copyTo(m_vmanip);
 	}
 }
 
@@ -1026,6 +1026,37 @@ void GenerateNotifier::clearEvents()
 }
 
 
+////
+//// ChunkBiomes
+////
+
+ChunkBiomes::ChunkBiomes(const biome_t *biomemap, v3s16 nmin, v3s16 nmax) :
+	m_has_biomemap(biomemap != NULL)
+{
+	memset(m_found, 0, sizeof(m_found));
+	if (!biomemap)
+		return;
+
+	u32 columns = (nmax.X - nmin.X + 1) * (nmax.Z - nmin.Z + 1);
+	for (u32 i = 0; i != columns; i++)
+		m_found[biomemap[i]] = true;
+}
+
+
+bool ChunkBiomes::containsAny(const UNORDERED_SET<u8> &biomes) const
+{
+	if (!m_has_biomemap || biomes.empty())
+		return true;
+
+	for (UNORDERED_SET<u8>::const_iterator it = biomes.begin();
+			it != biomes.end(); ++it) {
+		if (m_found[*it])
+			return true;
+	}
+	return false;
+}
+
+
 ////
 //// MapgenParams
 ////
@@ -27,6 +27,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "mapnode.h"
 #include "util/string.h"
 #include "util/container.h"
+#include "util/cpp11_container.h"
 
 #define MAPGEN_DEFAULT MAPGEN_V7P
 #define MAPGEN_DEFAULT_NAME "v7p"
@@ -110,6 +111,22 @@ class GenerateNotifier {
 	std::list<GenNotifyEvent> m_notify_events;
 };
 
+/*
+	The biomes found in the biome map of a chunk, so that ores and
+	decorations limited to other biomes can be skipped as a whole.
+*/
+class ChunkBiomes {
+public:
+	ChunkBiomes(const biome_t *biomemap, v3s16 nmin, v3s16 nmax);
+
+	// Also true if there is no biome map or the set is empty
+	bool containsAny(const UNORDERED_SET<u8> &biomes) const;
+
+private:
+	bool m_has_biomemap;
+	bool m_found[256];
+};
+
 enum MapgenType {
 	MAPGEN_V7P,
 	MAPGEN_FLAT,
@@ -731,6 +731,14 @@ void MapNode::deSerializeBulk(std::istream &is, int version,
 					"failed to read bulk node data");
 	}
 
+	deSerializeBulk(&databuf[0], version, nodes, nodecount,
+			content_width, params_width);
+}
+
+void MapNode::deSerializeBulk(const u8 *databuf, int version,
+		MapNode *nodes, u32 nodecount,
+		u8 content_width, u8 params_width)
+{
 	// Deserialize content
 	if(content_width == 1)
 	{
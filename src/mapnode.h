@@ -299,6 +299,10 @@ struct MapNode
 	static void deSerializeBulk(std::istream &is, int version,
 			MapNode *nodes, u32 nodecount,
 			u8 content_width, u8 params_width, bool compressed);
+	// Same for uncompressed data that is already in memory
+	static void deSerializeBulk(const u8 *databuf, int version,
+			MapNode *nodes, u32 nodecount,
+			u8 content_width, u8 params_width);
 
 private:
 	// Deprecated serialization methods
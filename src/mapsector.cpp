@@ -75,6 +75,12 @@ MapBlock * MapSector::getBlockNoCreateNoEx(s16 y)
 	return getBlockBuffered(y);
 }
 
+MapBlock * MapSector::getBlockNoCreateNoExUnbuffered(s16 y) const
+{
+	UNORDERED_MAP<s16, MapBlock*>::const_iterator n = m_blocks.find(y);
+	return (n != m_blocks.end() ? n->second : NULL);
+}
+
 MapBlock * MapSector::createBlankBlockNoInsert(s16 y)
 {
 	assert(getBlockBuffered(y) == NULL);	// Pre-condition
@@ -18,6 +18,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 
+#include <algorithm>
+#include <cfloat>
 #include "mg_biome.h"
 #include "mg_decoration.h"
 #include "emerge.h"
@@ -28,6 +30,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "porting.h"
 #include "settings.h"
 
+// Heat and humidity cells per axis of each band of a BiomeTable
+#define BIOME_TABLE_CELLS 32
+
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -36,6 +41,7 @@ BiomeManager::BiomeManager(Server *server) :
 	ObjDefManager(server, OBJDEF_BIOME)
 {
 	m_server = server;
+	m_version = 0;
 
 	// Create default biome to be used in case none exist
 	Biome *b = new Biome;
@@ -86,6 +92,181 @@ void BiomeManager::clear()
 		delete (Biome *)m_objects[i];
 
 	m_objects.resize(1);
+	m_version++;
+}
+
+
+ObjDefHandle BiomeManager::add(ObjDef *obj)
+{
+	m_version++;
+	return ObjDefManager::add(obj);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+
+BiomeTable::BiomeTable()
+{
+	m_default = NULL;
+	m_grid_heat_min      = 0.0f;
+	m_grid_humidity_min  = 0.0f;
+	m_grid_step_heat     = 1.0f;
+	m_grid_step_humidity = 1.0f;
+}
+
+
+void BiomeTable::build(const ObjDefManager *biomes)
+{
+	m_default = (Biome *)biomes->getRaw(BIOME_NONE);
+	m_bands.clear();
+
+	std::vector<Biome *> all;
+	std::vector<s32> band_starts;
+	band_starts.push_back(S16_MIN);
+	float heat_min = FLT_MAX, heat_max = -FLT_MAX;
+	float humidity_min = FLT_MAX, humidity_max = -FLT_MAX;
+	for (size_t i = 1; i < biomes->getNumObjects(); i++) {
+		Biome *b = (Biome *)biomes->getRaw(i);
+		if (!b)
+			continue;
+		all.push_back(b);
+		band_starts.push_back(b->y_min);
+		band_starts.push_back((s32)b->y_max + 1);
+		heat_min     = MYMIN(heat_min, b->heat_point);
+		heat_max     = MYMAX(heat_max, b->heat_point);
+		humidity_min = MYMIN(humidity_min, b->humidity_point);
+		humidity_max = MYMAX(humidity_max, b->humidity_point);
+	}
+	if (all.empty())
+		return;
+
+	// The grid covers the biome points and half their spread around them
+	float heat_span     = MYMAX(heat_max - heat_min, 1.0f);
+	float humidity_span = MYMAX(humidity_max - humidity_min, 1.0f);
+	m_grid_heat_min      = heat_min - heat_span / 2;
+	m_grid_humidity_min  = humidity_min - humidity_span / 2;
+	m_grid_step_heat     = heat_span * 2 / BIOME_TABLE_CELLS;
+	m_grid_step_humidity = humidity_span * 2 / BIOME_TABLE_CELLS;
+
+	// Every biome either contains a whole band or none of it
+	std::sort(band_starts.begin(), band_starts.end());
+	band_starts.erase(std::unique(band_starts.begin(), band_starts.end()),
+		band_starts.end());
+
+	for (size_t i = 0; i != band_starts.size(); i++) {
+		s32 y = band_starts[i];
+		if (y > S16_MAX)
+			break;
+
+		std::vector<Biome *> contained;
+		for (size_t j = 0; j != all.size(); j++) {
+			if (y >= all[j]->y_min && y <= all[j]->y_max)
+				contained.push_back(all[j]);
+		}
+
+		// Merge with the band below if the biomes are the same
+		if (!m_bands.empty() && m_bands.back().biomes == contained)
+			continue;
+
+		m_bands.push_back(Band());
+		Band &band = m_bands.back();
+		band.y_min  = y;
+		band.biomes = contained;
+		buildCells(&band);
+	}
+}
+
+
+void BiomeTable::buildCells(Band *band) const
+{
+	const std::vector<Biome *> &biomes = band->biomes;
+
+	// Cells are slightly enlarged to cover rounding when finding the cell
+	double margin_heat     = m_grid_step_heat * 0.001;
+	double margin_humidity = m_grid_step_humidity * 0.001;
+
+	band->cell_start.resize(BIOME_TABLE_CELLS * BIOME_TABLE_CELLS + 1);
+	band->cell_biomes.clear();
+	for (u32 cz = 0; cz != BIOME_TABLE_CELLS; cz++)
+	for (u32 cx = 0; cx != BIOME_TABLE_CELLS; cx++) {
+		double heat0 = m_grid_heat_min + cx * m_grid_step_heat - margin_heat;
+		double heat1 = heat0 + m_grid_step_heat + 2 * margin_heat;
+		double humidity0 = m_grid_humidity_min + cz * m_grid_step_humidity -
+			margin_humidity;
+		double humidity1 = humidity0 + m_grid_step_humidity + 2 * margin_humidity;
+
+		// The closest biome is at most as far as the smallest distance to
+		// the farthest corner, with some room for float rounding
+		double bound = DBL_MAX;
+		for (size_t i = 0; i != biomes.size(); i++) {
+			double dh = MYMAX(fabs(biomes[i]->heat_point - heat0),
+				fabs(biomes[i]->heat_point - heat1));
+			double du = MYMAX(fabs(biomes[i]->humidity_point - humidity0),
+				fabs(biomes[i]->humidity_point - humidity1));
+			bound = MYMIN(bound, dh * dh + du * du);
+		}
+		bound = bound * 1.0001 + 1e-6;
+
+		band->cell_start[cz * BIOME_TABLE_CELLS + cx] = band->cell_biomes.size();
+		for (size_t i = 0; i != biomes.size(); i++) {
+			double dh = MYMAX(MYMAX(heat0 - biomes[i]->heat_point,
+				biomes[i]->heat_point - heat1), 0.0);
+			double du = MYMAX(MYMAX(humidity0 - biomes[i]->humidity_point,
+				biomes[i]->humidity_point - humidity1), 0.0);
+			if (dh * dh + du * du <= bound)
+				band->cell_biomes.push_back(biomes[i]);
+		}
+	}
+	band->cell_start.back() = band->cell_biomes.size();
+}
+
+
+Biome *BiomeTable::find(float heat, float humidity, s16 y) const
+{
+	if (m_bands.empty())
+		return m_default;
+
+	// Last band starting at or below y
+	size_t lo = 0, hi = m_bands.size();
+	while (hi - lo > 1) {
+		size_t mid = (lo + hi) / 2;
+		if (m_bands[mid].y_min <= y)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	const Band &band = m_bands[lo];
+
+	Biome *const *it;
+	Biome *const *end;
+	float fx = (heat - m_grid_heat_min) / m_grid_step_heat;
+	float fz = (humidity - m_grid_humidity_min) / m_grid_step_humidity;
+	if (fx >= 0.0f && fx < BIOME_TABLE_CELLS &&
+			fz >= 0.0f && fz < BIOME_TABLE_CELLS) {
+		u32 cell = (u32)fz * BIOME_TABLE_CELLS + (u32)fx;
+		it  = band.cell_biomes.data() + band.cell_start[cell];
+		end = band.cell_biomes.data() + band.cell_start[cell + 1];
+	} else {
+		it  = band.biomes.data();
+		end = it + band.biomes.size();
+	}
+
+	// Same distance and order as comparing against every biome
+	Biome *biome_closest = NULL;
+	float dist_min = FLT_MAX;
+	for (; it != end; ++it) {
+		float d_heat     = heat     - (*it)->heat_point;
+		float d_humidity = humidity - (*it)->humidity_point;
+		float dist = (d_heat * d_heat) +
+					 (d_humidity * d_humidity);
+		if (dist < dist_min) {
+			dist_min = dist;
+			biome_closest = *it;
+		}
+	}
+
+	return biome_closest ? biome_closest : m_default;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -130,6 +311,9 @@ BiomeGenOriginal::BiomeGenOriginal(BiomeManager *biomemgr,
 	heatmap  = noise_heat->result;
 	humidmap = noise_humidity->result;
 	biomemap = new biome_t[m_csize.X * m_csize.Z];
+
+	m_table.build(m_bmgr);
+	m_table_version = m_bmgr->getVersion();
 }
 
 BiomeGenOriginal::~BiomeGenOriginal()
@@ -160,6 +344,11 @@ void BiomeGenOriginal::calcBiomeNoise(v3s16 pmin)
 {
 	m_pmin = pmin;
 
+	if (m_table_version != m_bmgr->getVersion()) {
+		m_table.build(m_bmgr);
+		m_table_version = m_bmgr->getVersion();
+	}
+
 	noise_heat->perlinMap2D(pmin.X, pmin.Z);
 	noise_humidity->perlinMap2D(pmin.X, pmin.Z);
 	noise_heat_blend->perlinMap2D(pmin.X, pmin.Z);
@@ -206,25 +395,7 @@ Biome *BiomeGenOriginal::getBiomeAtIndex(size_t index, s16 y) const
 
 Biome *BiomeGenOriginal::calcBiomeFromNoise(float heat, float humidity, s16 y) const
 {
-	Biome *b, *biome_closest = NULL;
-	float dist_min = FLT_MAX;
-
-	for (size_t i = 1; i < m_bmgr->getNumObjects(); i++) {
-		b = (Biome *)m_bmgr->getRaw(i);
-		if (!b || y > b->y_max || y < b->y_min)
-			continue;
-
-		float d_heat     = heat     - b->heat_point;
-		float d_humidity = humidity - b->humidity_point;
-		float dist = (d_heat * d_heat) +
-					 (d_humidity * d_humidity);
-		if (dist < dist_min) {
-			dist_min = dist;
-			biome_closest = b;
-		}
-	}
-
-	return biome_closest ? biome_closest : (Biome *)m_bmgr->getRaw(BIOME_NONE);
+	return m_table.find(heat, humidity, y);
 }
 
 
@@ -73,6 +73,44 @@ class Biome : public ObjDef, public NodeResolver {
 };
 
 
+////
+//// BiomeTable
+////
+
+// Finds the biome with the closest heat and humidity point among the ones
+// containing a y position, with the same result (including ties) as checking
+// every biome in order.  Biomes are grouped by y band, and each band by cells
+// of heat and humidity to the biomes that can be the closest in the cell.
+class BiomeTable {
+public:
+	BiomeTable();
+
+	// Builds the table from the biomes of the manager, the first of which is
+	// the default biome that is returned when no other biome contains y
+	void build(const ObjDefManager *biomes);
+
+	Biome *find(float heat, float humidity, s16 y) const;
+
+private:
+	struct Band {
+		s32 y_min;
+		std::vector<Biome *> biomes;
+		// Start of each cell's biomes in cell_biomes, and the end
+		std::vector<u32> cell_start;
+		std::vector<Biome *> cell_biomes;
+	};
+
+	void buildCells(Band *band) const;
+
+	Biome *m_default;
+	std::vector<Band> m_bands;
+	float m_grid_heat_min;
+	float m_grid_humidity_min;
+	float m_grid_step_heat;
+	float m_grid_step_humidity;
+};
+
+
 ////
 //// BiomeGen
 ////
@@ -179,6 +217,9 @@ class BiomeGenOriginal : public BiomeGen {
 	Noise *noise_humidity;
 	Noise *noise_heat_blend;
 	Noise *noise_humidity_blend;
+
+	BiomeTable m_table;
+	u32 m_table_version;
 };
 
 
@@ -223,10 +264,14 @@ class BiomeManager : public ObjDefManager {
 	}
 
 	virtual void clear();
+	virtual ObjDefHandle add(ObjDef *obj);
+
+	// Changes whenever biomes are added or cleared
+	u32 getVersion() const { return m_version; }
 
 private:
 	Server *m_server;
-
+	u32 m_version;
 };
 
 
@@ -51,13 +51,16 @@ size_t DecorationManager::placeAllDecos(Mapgen *mg, u32 blockseed,
 	v3s16 nmin, v3s16 nmax)
 {
 	size_t nplaced = 0;
+	SurfaceCache surfaces(mg, nmin, nmax);
+	ChunkBiomes chunk_biomes(mg->biomemap, nmin, nmax);
 
 	for (size_t i = 0; i != m_objects.size(); i++) {
 		Decoration *deco = (Decoration *)m_objects[i];
 		if (!deco)
 			continue;
 
-		nplaced += deco->placeDeco(mg, blockseed, nmin, nmax);
+		if (chunk_biomes.containsAny(deco->biomes))
+			nplaced += deco->placeDeco(mg, blockseed, nmin, nmax, &surfaces);
 		blockseed++;
 	}
 
@@ -68,6 +71,71 @@ size_t DecorationManager::placeAllDecos(Mapgen *mg, u32 blockseed,
 ///////////////////////////////////////////////////////////////////////////////
 
 
+SurfaceCache::SurfaceCache(Mapgen *mg, v3s16 nmin, v3s16 nmax) :
+	m_mg(mg),
+	m_nmin(nmin),
+	m_nmax(nmax)
+{
+	u32 columns = (nmax.X - nmin.X + 1) * (nmax.Z - nmin.Z + 1);
+	m_valid.resize(columns, false);
+	m_ground.resize(columns);
+	m_liquid.resize(columns);
+}
+
+
+s16 SurfaceCache::getGroundLevel(s16 x, s16 z)
+{
+	return m_ground[getColumn(x, z)];
+}
+
+
+s16 SurfaceCache::getLiquidSurface(s16 x, s16 z)
+{
+	return m_liquid[getColumn(x, z)];
+}
+
+
+void SurfaceCache::invalidate(v2s16 pmin, v2s16 pmax)
+{
+	s16 sizex = m_nmax.X - m_nmin.X + 1;
+	for (s16 z = MYMAX(pmin.Y, m_nmin.Z); z <= MYMIN(pmax.Y, m_nmax.Z); z++)
+	for (s16 x = MYMAX(pmin.X, m_nmin.X); x <= MYMIN(pmax.X, m_nmax.X); x++)
+		m_valid[(z - m_nmin.Z) * sizex + (x - m_nmin.X)] = false;
+}
+
+
+u32 SurfaceCache::getColumn(s16 x, s16 z)
+{
+	u32 column = (z - m_nmin.Z) * (m_nmax.X - m_nmin.X + 1) + (x - m_nmin.X);
+	if (m_valid[column])
+		return column;
+
+	// One search down to the ground finds both levels
+	MMVManip *vm = m_mg->vm;
+	INodeDefManager *ndef = m_mg->ndef;
+	v3s16 em = vm->m_area.getExtent();
+	u32 i = vm->m_area.index(x, m_nmax.Y, z);
+	s16 liquid = -MAX_MAP_GENERATION_LIMIT;
+	s16 y;
+	for (y = m_nmax.Y; y >= m_nmin.Y; y--) {
+		const ContentFeatures &f = ndef->get(vm->m_data[i]);
+		if (f.walkable)
+			break;
+		if (liquid == -MAX_MAP_GENERATION_LIMIT && f.isLiquid())
+			liquid = y;
+
+		vm->m_area.add_y(em, i, -1);
+	}
+	m_ground[column] = (y >= m_nmin.Y) ? y : -MAX_MAP_GENERATION_LIMIT;
+	m_liquid[column] = liquid;
+	m_valid[column] = true;
+	return column;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+
 Decoration::Decoration()
 {
 	mapseed    = 0;
@@ -138,7 +206,8 @@ bool Decoration::canPlaceDecoration(MMVManip *vm, v3s16 p)
 }
 
 
-size_t Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
+size_t Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax,
+	SurfaceCache *surfaces)
 {
 	PcgRandom ps(blockseed + 53);
 	int carea_size = nmax.X - nmin.X + 1;
@@ -186,13 +255,17 @@ size_t Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
 
 			int mapindex = carea_size * (z - nmin.Z) + (x - nmin.X);
 
+			if (mg->biomemap && !biomes.empty() &&
+					biomes.find(mg->biomemap[mapindex]) == biomes.end())
+				continue;
+
 			s16 y = -MAX_MAP_GENERATION_LIMIT;
 			if (flags & DECO_LIQUID_SURFACE)
-				y = mg->findLiquidSurface(v2s16(x, z), nmin.Y, nmax.Y);
+				y = surfaces->getLiquidSurface(x, z);
 			else if (mg->heightmap)
 				y = mg->heightmap[mapindex];
 			else
-				y = mg->findGroundLevel(v2s16(x, z), nmin.Y, nmax.Y);
+				y = surfaces->getGroundLevel(x, z);
 
 			if (y < nmin.Y || y > nmax.Y ||
 				y < y_min  || y > y_max)
@@ -208,19 +281,12 @@ size_t Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
 #endif
 			}
 
-			if (mg->biomemap) {
-				UNORDERED_SET<u8>::iterator iter;
-
-				if (!biomes.empty()) {
-					iter = biomes.find(mg->biomemap[mapindex]);
-					if (iter == biomes.end())
-						continue;
-				}
-			}
-
 			v3s16 pos(x, y, z);
-			if (generate(mg->vm, &ps, pos))
+			if (generate(mg->vm, &ps, pos)) {
+				int r = getRadius();
+				surfaces->invalidate(v2s16(x - r, z - r), v2s16(x + r, z + r));
 				mg->gennotify.addEvent(GENNOTIFY_DECORATION, pos, index);
+			}
 		}
 	}
 
@@ -381,6 +447,13 @@ size_t DecoSchematic::generate(MMVManip *vm, PcgRandom *pr, v3s16 p)
 }
 
 
+int DecoSchematic::getRadius()
+{
+	// Centering and rotation keep the schematic within its largest size
+	return schematic ? MYMAX(schematic->size.X, schematic->size.Z) : 0;
+}
+
+
 int DecoSchematic::getHeight()
 {
 	// Account for a schematic being sunk into the ground by flag.
@@ -47,6 +47,34 @@ enum DecorationType {
 extern FlagDesc flagdesc_deco[];
 
 
+/*
+	Ground and liquid surface levels of the columns of a chunk, searched
+	once and shared by all decorations placed in it. Columns changed by a
+	decoration are searched again on their next use.
+*/
+class SurfaceCache {
+public:
+	SurfaceCache(Mapgen *mg, v3s16 nmin, v3s16 nmax);
+
+	// Same as Mapgen::findGroundLevel() and findLiquidSurface() from
+	// nmin.Y to nmax.Y
+	s16 getGroundLevel(s16 x, s16 z);
+	s16 getLiquidSurface(s16 x, s16 z);
+
+	void invalidate(v2s16 pmin, v2s16 pmax);
+
+private:
+	u32 getColumn(s16 x, s16 z);
+
+	Mapgen *m_mg;
+	v3s16 m_nmin;
+	v3s16 m_nmax;
+	std::vector<bool> m_valid;
+	std::vector<s16> m_ground;
+	std::vector<s16> m_liquid;
+};
+
+
 #if 0
 struct CutoffData {
 	VoxelArea a;
@@ -70,11 +98,14 @@ class Decoration : public ObjDef, public NodeResolver {
 	virtual void resolveNodeNames();
 
 	bool canPlaceDecoration(MMVManip *vm, v3s16 p);
-	size_t placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax);
+	size_t placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax,
+		SurfaceCache *surfaces);
 	//size_t placeCutoffs(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax);
 
 	virtual size_t generate(MMVManip *vm, PcgRandom *pr, v3s16 p) = 0;
 	virtual int getHeight() = 0;
+	// Horizontal distance from p up to which generate() changes nodes
+	virtual int getRadius() = 0;
 
 	u32 flags;
 	int mapseed;
@@ -98,6 +129,7 @@ class DecoSimple : public Decoration {
 	virtual void resolveNodeNames();
 	virtual size_t generate(MMVManip *vm, PcgRandom *pr, v3s16 p);
 	virtual int getHeight();
+	virtual int getRadius() { return 0; }
 
 	std::vector<content_t> c_decos;
 	s16 deco_height;
@@ -111,6 +143,7 @@ class DecoSchematic : public Decoration {
 
 	virtual size_t generate(MMVManip *vm, PcgRandom *pr, v3s16 p);
 	virtual int getHeight();
+	virtual int getRadius();
 
 	Rotation rotation;
 	Schematic *schematic;
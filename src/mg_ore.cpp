@@ -46,13 +46,16 @@ OreManager::OreManager(IGameDef *gamedef) :
 size_t OreManager::placeAllOres(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
 {
 	size_t nplaced = 0;
+	ChunkBiomes chunk_biomes(mg->biomemap, nmin, nmax);
 
 	for (size_t i = 0; i != m_objects.size(); i++) {
 		Ore *ore = (Ore *)m_objects[i];
 		if (!ore)
 			continue;
 
-		nplaced += ore->placeOre(mg, blockseed, nmin, nmax);
+		// Every ore type checks the biome map before placing anything
+		if (chunk_biomes.containsAny(ore->biomes))
+			nplaced += ore->placeOre(mg, blockseed, nmin, nmax);
 		blockseed++;
 	}
 
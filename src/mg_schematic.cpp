@@ -18,6 +18,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 
+#include <algorithm>
 #include <fstream>
 #include <typeinfo>
 #include "mg_schematic.h"
@@ -31,6 +32,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/serialize.h"
 #include "serialization.h"
 #include "filesys.h"
+#include "porting.h"
+#include "exceptions.h"
+#include "threading/mutex_auto_lock.h"
 #include "voxelalgorithms.h"
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -40,6 +44,9 @@ SchematicManager::SchematicManager(Server *server) :
 	ObjDefManager(server, OBJDEF_SCHEMATIC)
 {
 	m_server = server;
+	m_load_time_us = 0;
+	m_files_loaded = 0;
+	m_files_reused = 0;
 }
 
 
@@ -60,10 +67,70 @@ void SchematicManager::clear()
 		}
 	}
 
+	m_file_schematics.clear();
 	ObjDefManager::clear();
 }
 
 
+Schematic *SchematicManager::getOrLoadFile(const std::string &filepath,
+	StringMap *replace_names)
+{
+	// The replacements are part of the key, as they change the resolved nodes
+	std::string key = filepath;
+	if (replace_names) {
+		std::map<std::string, std::string> sorted(replace_names->begin(),
+			replace_names->end());
+		for (std::map<std::string, std::string>::const_iterator
+				it = sorted.begin(); it != sorted.end(); ++it)
+			key += "\n" + it->first + "=" + it->second;
+	}
+
+	std::map<std::string, Schematic *>::const_iterator it =
+		m_file_schematics.find(key);
+	if (it != m_file_schematics.end()) {
+		m_files_reused++;
+		return it->second;
+	}
+
+	u64 t_start = porting::getTimeUs();
+	Schematic *schem = create(SCHEMATIC_NORMAL);
+	if (!schem->loadSchematicFromFile(filepath, m_ndef, replace_names)) {
+		delete schem;
+		return NULL;
+	}
+
+	// Variants with other replacements share the file name, which add()
+	// would reject
+	u32 index = addRaw(schem);
+	if (index == OBJDEF_INVALID_INDEX) {
+		delete schem;
+		return NULL;
+	}
+	schem->handle = createHandle(index, m_objtype, schem->uid);
+
+	m_file_schematics[key] = schem;
+	m_load_time_us += porting::getTimeUs() - t_start;
+	m_files_loaded++;
+	return schem;
+}
+
+
+void SchematicManager::logStatistics()
+{
+	size_t memory = 0;
+	for (size_t i = 0; i != m_objects.size(); i++) {
+		Schematic *schem = (Schematic *)m_objects[i];
+		if (schem)
+			memory += schem->getMemoryUsage();
+	}
+
+	infostream << "SchematicManager: " << m_objects.size() << " schematics ("
+		<< m_files_loaded << " loaded from files, " << m_files_reused
+		<< " reused) using " << memory / 1024 << " KiB, loading took "
+		<< m_load_time_us / 1000 << " ms" << std::endl;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 
 
@@ -73,6 +140,9 @@ Schematic::Schematic()
 	slice_probs = NULL;
 	flags       = 0;
 	size        = v3s16(0, 0, 0);
+
+	for (size_t i = 0; i != ARRLEN(m_rotated_data); i++)
+		m_rotated_data[i] = NULL;
 }
 
 
@@ -80,6 +150,7 @@ Schematic::~Schematic()
 {
 	delete []schemdata;
 	delete []slice_probs;
+	clearRotatedData();
 }
 
 
@@ -93,12 +164,18 @@ void Schematic::resolveNodeNames()
 		content_t c_new = c_nodes[c_original];
 		schemdata[i].setContent(c_new);
 	}
+
+	clearRotatedData();
 }
 
 
-void Schematic::blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_place)
+const MapNode *Schematic::getRotatedData(Rotation rot)
 {
-	sanity_check(m_ndef != NULL);
+	MutexAutoLock lock(m_rotated_mutex);
+
+	MapNode *&data = m_rotated_data[rot - ROTATE_90];
+	if (data)
+		return data;
 
 	int xstride = 1;
 	int ystride = size.X;
@@ -121,18 +198,74 @@ void Schematic::blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_pla
 			i_step_x = -xstride;
 			i_step_z = -zstride;
 			break;
-		case ROTATE_270:
+		default: // ROTATE_270
 			i_start  = zstride * (sz - 1);
 			i_step_x = -zstride;
 			i_step_z = xstride;
 			SWAP(s16, sx, sz);
-			break;
-		default:
-			i_start  = 0;
-			i_step_x = xstride;
-			i_step_z = zstride;
 	}
 
+	// Same z, y, x order as schemdata, in the rotated dimensions
+	data = new MapNode[sx * sy * sz];
+	u32 j = 0;
+	for (s16 z = 0; z != sz; z++)
+	for (s16 y = 0; y != sy; y++) {
+		u32 i = z * i_step_z + y * ystride + i_start;
+		for (s16 x = 0; x != sx; x++, i += i_step_x, j++) {
+			data[j] = schemdata[i];
+			data[j].rotateAlongYAxis(m_ndef, rot);
+		}
+	}
+
+	return data;
+}
+
+
+void Schematic::clearRotatedData()
+{
+	for (size_t i = 0; i != ARRLEN(m_rotated_data); i++) {
+		delete []m_rotated_data[i];
+		m_rotated_data[i] = NULL;
+	}
+}
+
+
+size_t Schematic::getMemoryUsage()
+{
+	size_t nodecount = size.X * size.Y * size.Z;
+	size_t memory = schemdata ? nodecount * sizeof(MapNode) : 0;
+	if (slice_probs)
+		memory += size.Y;
+	memory += c_nodes.size() * sizeof(content_t);
+
+	MutexAutoLock lock(m_rotated_mutex);
+	for (size_t i = 0; i != ARRLEN(m_rotated_data); i++) {
+		if (m_rotated_data[i])
+			memory += nodecount * sizeof(MapNode);
+	}
+	return memory;
+}
+
+
+void Schematic::blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_place)
+{
+	sanity_check(m_ndef != NULL);
+
+	s16 sx = size.X;
+	s16 sy = size.Y;
+	s16 sz = size.Z;
+
+	// Rotated placements use the node data rotated in advance
+	const MapNode *data = schemdata;
+	if (rot == ROTATE_90 || rot == ROTATE_180 || rot == ROTATE_270) {
+		data = getRotatedData(rot);
+		if (rot != ROTATE_180)
+			SWAP(s16, sx, sz);
+	}
+
+	int ystride = sx;
+	int zstride = sx * sy;
+
 	s16 y_map = p.Y;
 	for (s16 y = 0; y != sy; y++) {
 		if ((slice_probs[y] != MTSCHEM_PROB_ALWAYS) &&
@@ -140,17 +273,17 @@ void Schematic::blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_pla
 			continue;
 
 		for (s16 z = 0; z != sz; z++) {
-			u32 i = z * i_step_z + y * ystride + i_start;
-			for (s16 x = 0; x != sx; x++, i += i_step_x) {
+			u32 i = z * zstride + y * ystride;
+			for (s16 x = 0; x != sx; x++, i++) {
 				u32 vi = vm->m_area.index(p.X + x, y_map, p.Z + z);
 				if (!vm->m_area.contains(vi))
 					continue;
 
-				if (schemdata[i].getContent() == CONTENT_IGNORE)
+				if (data[i].getContent() == CONTENT_IGNORE)
 					continue;
 
-				u8 placement_prob     = schemdata[i].param1 & MTSCHEM_PROB_MASK;
-				bool force_place_node = schemdata[i].param1 & MTSCHEM_FORCE_PLACE;
+				u8 placement_prob     = data[i].param1 & MTSCHEM_PROB_MASK;
+				bool force_place_node = data[i].param1 & MTSCHEM_FORCE_PLACE;
 
 				if (placement_prob == MTSCHEM_PROB_NEVER)
 					continue;
@@ -165,11 +298,8 @@ void Schematic::blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_pla
 					(placement_prob <= myrand_range(1, MTSCHEM_PROB_ALWAYS)))
 					continue;
 
-				vm->m_data[vi] = schemdata[i];
+				vm->m_data[vi] = data[i];
 				vm->m_data[vi].param1 = 0;
-
-				if (rot)
-					vm->m_data[vi].rotateAlongYAxis(m_ndef, rot);
 			}
 		}
 		y_map++;
@@ -254,42 +384,96 @@ void Schematic::placeOnMap(ServerMap *map, v3s16 p, u32 flags,
 }
 
 
+Schematic *Schematic::clone() const
+{
+	Schematic *schem = new Schematic;
+	schem->c_nodes = c_nodes;
+	schem->flags   = flags;
+	schem->size    = size;
+
+	size_t nodecount = size.X * size.Y * size.Z;
+	schem->schemdata = new MapNode[nodecount];
+	std::copy(schemdata, schemdata + nodecount, schem->schemdata);
+	schem->slice_probs = new u8[size.Y];
+	std::copy(slice_probs, slice_probs + size.Y, schem->slice_probs);
+
+	schem->m_ndef = m_ndef;
+	schem->m_resolve_done = true;
+	return schem;
+}
+
+
+static bool mts_truncated(const char *function)
+{
+	errorstream << function << ": truncated schematic file" << std::endl;
+	return false;
+}
+
+
 bool Schematic::deserializeFromMts(std::istream *is,
 	std::vector<std::string> *names)
 {
-	std::istream &ss = *is;
+	std::string data((std::istreambuf_iterator<char>(*is)),
+		std::istreambuf_iterator<char>());
+	return deserializeFromMts(data, names);
+}
+
+
+bool Schematic::deserializeFromMts(const std::string &data,
+	std::vector<std::string> *names)
+{
+	const u8 *buf = (const u8 *)data.c_str();
+	size_t len = data.size();
 	content_t cignore = CONTENT_IGNORE;
 	bool have_cignore = false;
 
-	//// Read signature
-	u32 signature = readU32(ss);
-	if (signature != MTSCHEM_FILE_SIGNATURE) {
+	//// Read signature, version and size
+	if (len < 12 || readU32(buf) != MTSCHEM_FILE_SIGNATURE) {
 		errorstream << __FUNCTION__ << ": invalid schematic "
 			"file" << std::endl;
 		return false;
 	}
 
-	//// Read version
-	u16 version = readU16(ss);
+	u16 version = readU16(buf + 4);
 	if (version > MTSCHEM_FILE_VER_HIGHEST_READ) {
 		errorstream << __FUNCTION__ << ": unsupported schematic "
 			"file version" << std::endl;
 		return false;
 	}
 
-	//// Read size
-	size = readV3S16(ss);
+	v3s16 new_size = readV3S16(buf + 6);
+	if (new_size.X < 0 || new_size.Y < 0 || new_size.Z < 0) {
+		errorstream << __FUNCTION__ << ": invalid schematic "
+			"size" << std::endl;
+		return false;
+	}
+	size = new_size;
+	size_t pos = 12;
 
 	//// Read Y-slice probability values
+	if (version >= 3 && len - pos < (size_t)size.Y)
+		return mts_truncated(__FUNCTION__);
+
 	delete []slice_probs;
 	slice_probs = new u8[size.Y];
 	for (int y = 0; y != size.Y; y++)
-		slice_probs[y] = (version >= 3) ? readU8(ss) : MTSCHEM_PROB_ALWAYS_OLD;
+		slice_probs[y] = (version >= 3) ? buf[pos++] : MTSCHEM_PROB_ALWAYS_OLD;
 
 	//// Read node names
-	u16 nidmapcount = readU16(ss);
+	if (len - pos < 2)
+		return mts_truncated(__FUNCTION__);
+	u16 nidmapcount = readU16(buf + pos);
+	pos += 2;
+
 	for (int i = 0; i != nidmapcount; i++) {
-		std::string name = deSerializeString(ss);
+		if (len - pos < 2)
+			return mts_truncated(__FUNCTION__);
+		u16 namelen = readU16(buf + pos);
+		pos += 2;
+		if (len - pos < namelen)
+			return mts_truncated(__FUNCTION__);
+		std::string name((const char *)buf + pos, namelen);
+		pos += namelen;
 
 		// Instances of "ignore" from v1 are converted to air (and instances
 		// are fixed to have MTSCHEM_PROB_NEVER later on).
@@ -302,14 +486,25 @@ bool Schematic::deserializeFromMts(std::istream *is,
 		names->push_back(name);
 	}
 
-	//// Read node data
+	//// Read node data, inflated straight into a buffer of the final size
 	size_t nodecount = size.X * size.Y * size.Z;
 
 	delete []schemdata;
 	schemdata = new MapNode[nodecount];
 
-	MapNode::deSerializeBulk(ss, SER_FMT_VER_HIGHEST_READ, schemdata,
-		nodecount, 2, 2, true);
+	if (nodecount) {
+		// content (u16), param1 (u8) and param2 (u8) for each node
+		std::vector<u8> nodebuf(nodecount * 4);
+		try {
+			decompressZlib(buf + pos, len - pos, &nodebuf[0],
+				nodebuf.size());
+		} catch (SerializationError &e) {
+			errorstream << __FUNCTION__ << ": " << e.what() << std::endl;
+			return false;
+		}
+		MapNode::deSerializeBulk(&nodebuf[0], SER_FMT_VER_HIGHEST_READ,
+			schemdata, nodecount, 2, 2);
+	}
 
 	// Fix probability values for nodes that were ignore; removed in v2
 	if (version < 2) {
@@ -441,8 +636,19 @@ bool Schematic::loadSchematicFromFile(const std::string &filename,
 		return false;
 	}
 
+	// Read the whole file at once and parse it from memory
+	is.seekg(0, std::ios_base::end);
+	std::string data((size_t)is.tellg(), '\0');
+	is.seekg(0, std::ios_base::beg);
+	is.read(&data[0], data.size());
+	if (!is.good()) {
+		errorstream << __FUNCTION__ << ": unable to read file '"
+			<< filename << "'" << std::endl;
+		return false;
+	}
+
 	size_t origsize = m_nodenames.size();
-	if (!deserializeFromMts(&is, &m_nodenames))
+	if (!deserializeFromMts(data, &m_nodenames))
 		return false;
 
 	m_nnlistsizes.push_back(m_nodenames.size() - origsize);
@@ -581,3 +787,37 @@ void generate_nodelist_and_update_ids(MapNode *nodes, size_t nodecount,
 		nodes[i].setContent(id);
 	}
 }
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+
+SchematicBulkEdit::SchematicBulkEdit(const Schematic *schem, v3s16 p,
+	Rotation rot, bool force_place, BulkEditCallback callback,
+	void *callback_param) :
+	BulkEdit(v3s16(), v3s16(), callback, callback_param),
+	m_schem(schem->clone()),
+	m_pos(p),
+	m_rot(rot),
+	m_force_place(force_place)
+{
+	if (m_rot == ROTATE_RAND)
+		m_rot = (Rotation)myrand_range(ROTATE_0, ROTATE_270);
+
+	v3s16 s = (m_rot == ROTATE_90 || m_rot == ROTATE_270) ?
+		v3s16(schem->size.Z, schem->size.Y, schem->size.X) : schem->size;
+	blockpos_min = getNodeBlockPos(p);
+	blockpos_max = getNodeBlockPos(p + s - v3s16(1, 1, 1));
+}
+
+
+SchematicBulkEdit::~SchematicBulkEdit()
+{
+	delete m_schem;
+}
+
+
+void SchematicBulkEdit::apply(MMVManip *vm)
+{
+	m_schem->blitToVManip(vm, m_pos, m_rot, m_force_place);
+}
@@ -22,7 +22,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define MG_SCHEMATIC_HEADER
 
 #include <map>
+#include "emerge.h"
 #include "mg_decoration.h"
+#include "threading/mutex.h"
 #include "util/string.h"
 
 class Map;
@@ -104,6 +106,8 @@ class Schematic : public ObjDef, public NodeResolver {
 	bool getSchematicFromMap(Map *map, v3s16 p1, v3s16 p2);
 
 	bool deserializeFromMts(std::istream *is, std::vector<std::string> *names);
+	bool deserializeFromMts(const std::string &data,
+		std::vector<std::string> *names);
 	bool serializeToMts(std::ostream *os, const std::vector<std::string> &names);
 	bool serializeToLua(std::ostream *os, const std::vector<std::string> &names,
 		bool use_comments, u32 indent_spaces);
@@ -112,6 +116,12 @@ class Schematic : public ObjDef, public NodeResolver {
 	bool placeOnVManip(MMVManip *vm, v3s16 p, u32 flags, Rotation rot, bool force_place);
 	void placeOnMap(ServerMap *map, v3s16 p, u32 flags, Rotation rot, bool force_place);
 
+	// Copy of the resolved schematic that no manager owns
+	Schematic *clone() const;
+
+	// Bytes used by the node data, including rotated copies
+	size_t getMemoryUsage();
+
 	void applyProbabilities(v3s16 p0,
 		std::vector<std::pair<v3s16, u8> > *plist,
 		std::vector<std::pair<s16, u8> > *splist);
@@ -121,6 +131,34 @@ class Schematic : public ObjDef, public NodeResolver {
 	v3s16 size;
 	MapNode *schemdata;
 	u8 *slice_probs;
+
+private:
+	// Node data laid out and rotated for placement with the given rotation,
+	// built on first use and shared by every placement afterwards
+	const MapNode *getRotatedData(Rotation rot);
+	void clearRotatedData();
+
+	MapNode *m_rotated_data[3];
+	Mutex m_rotated_mutex;
+};
+
+/*
+	Places a copy of a schematic from the bulk edit thread,
+	see EmergeManager::enqueueBulkEdit()
+*/
+class SchematicBulkEdit : public BulkEdit {
+public:
+	SchematicBulkEdit(const Schematic *schem, v3s16 p, Rotation rot,
+		bool force_place, BulkEditCallback callback, void *callback_param);
+	~SchematicBulkEdit();
+
+	void apply(MMVManip *vm);
+
+private:
+	Schematic *m_schem;
+	v3s16 m_pos;
+	Rotation m_rot;
+	bool m_force_place;
 };
 
 class SchematicManager : public ObjDefManager {
@@ -130,6 +168,13 @@ class SchematicManager : public ObjDefManager {
 
 	virtual void clear();
 
+	// Returns the schematic loaded from the file with these replacements,
+	// loading and adding it on first use
+	Schematic *getOrLoadFile(const std::string &filepath,
+		StringMap *replace_names);
+
+	void logStatistics();
+
 	const char *getObjectTitle() const
 	{
 		return "schematic";
@@ -142,6 +187,11 @@ class SchematicManager : public ObjDefManager {
 
 private:
 	Server *m_server;
+
+	std::map<std::string, Schematic *> m_file_schematics;
+	u64 m_load_time_us;
+	u32 m_files_loaded;
+	u32 m_files_reused;
 };
 
 void generate_nodelist_and_update_ids(MapNode *nodes, size_t nodecount,
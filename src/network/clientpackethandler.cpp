@@ -288,8 +288,9 @@ void Client::handleCommand_BlockData(NetworkPacket* pkt)
 	v3s16 p;
 	*pkt >> p;
 
-	std::string datastring(pkt->getString(6), pkt->getSize() - 6);
-	std::istringstream istr(datastring, std::ios_base::binary);
+	// The network specific data after the block is unused
+	const u8 *data = (const u8 *)pkt->getString(6);
+	size_t size = pkt->getSize() - 6;
 
 	MapSector *sector;
 	MapBlock *block;
@@ -304,21 +305,21 @@ void Client::handleCommand_BlockData(NetworkPacket* pkt)
 		/*
 			Update an existing block
 		*/
-		block->deSerialize(istr, m_server_ser_ver, false);
-		block->deSerializeNetworkSpecific(istr);
+		block->deSerialize(data, size, m_server_ser_ver, false,
+			*m_block_buffers);
 	}
 	else {
 		/*
 			Create a new block
 		*/
 		block = new MapBlock(&m_env.getMap(), p, this);
-		block->deSerialize(istr, m_server_ser_ver, false);
-		block->deSerializeNetworkSpecific(istr);
+		block->deSerialize(data, size, m_server_ser_ver, false,
+			*m_block_buffers);
 		sector->insertBlock(block);
 	}
 
 	if (m_localdb) {
-		ServerMap::saveBlock(block, m_localdb);
+		ServerMap::saveBlock(block, m_localdb, m_block_buffers);
 	}
 
 	/*
@@ -347,6 +348,32 @@ void Client::handleCommand_Inventory(NetworkPacket* pkt)
 	m_inventory_from_server_age = 0.0;
 }
 
+void Client::handleCommand_InventoryDelta(NetworkPacket* pkt)
+{
+	if (pkt->getSize() < 1)
+		return;
+
+	// The changes are relative to the last inventory from the server
+	if (m_inventory_from_server == NULL) {
+		errorstream << "Client: Received inventory changes before the "
+			"inventory" << std::endl;
+		return;
+	}
+
+	std::string datastring(pkt->getString(0), pkt->getSize());
+	std::istringstream is(datastring, std::ios_base::binary);
+
+	LocalPlayer *player = m_env.getLocalPlayer();
+	assert(player != NULL);
+
+	m_inventory_from_server->deSerializeDelta(is);
+	// This also reverts local changes that the server didn't make
+	player->inventory = *m_inventory_from_server;
+
+	m_inventory_updated = true;
+	m_inventory_from_server_age = 0.0;
+}
+
 void Client::handleCommand_TimeOfDay(NetworkPacket* pkt)
 {
 	if (pkt->getSize() < 2)
@@ -632,6 +659,7 @@ void Client::handleCommand_AnnounceMedia(NetworkPacket* pkt)
 		std::string sha1_raw = base64_decode(sha1_base64);
 		m_media_downloader->addFile(name, sha1_raw);
 	}
+	m_media_set_digest = m_media_downloader->getMediaSetDigest();
 
 	try {
 		std::string str;
@@ -29,6 +29,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/string.h"
 #include "settings.h"
 #include "profiler.h"
+#include "tracer.h"
 
 namespace con
 {
@@ -1297,6 +1298,8 @@ void * ConnectionSendThread::run()
 		/* remove all triggers */
 		while(m_send_sleep_semaphore.wait(0)) {}
 
+		TraceScope trace("ConnectionSend: step");
+
 		lasttime = curtime;
 		curtime = porting::getTimeMs();
 		float dtime = CALC_DTIME(lasttime,curtime);
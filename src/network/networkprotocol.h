@@ -638,7 +638,22 @@ enum ToClientCommand
 		std::string bytes_B
 	*/
 
-	TOCLIENT_NUM_MSG_TYPES = 0x61,
+	/*
+		Commands from 0x70 on are not part of the upstream protocol. They
+		are only sent to clients that announced the matching CLIENT_FEATURE
+		flag in TOSERVER_CLIENT_READY.
+	*/
+
+	TOCLIENT_INVENTORY_DELTA = 0x70,
+	/*
+		Needs CLIENT_FEATURE_INVENTORY_DELTA.
+
+		[0] u16 command
+		[2] changed slots of the inventory, relative to the last
+		    TOCLIENT_INVENTORY or TOCLIENT_INVENTORY_DELTA
+	*/
+
+	TOCLIENT_NUM_MSG_TYPES = 0x71,
 };
 
 enum ToServerCommand
@@ -878,7 +893,7 @@ enum ToServerCommand
 		u8 major
 		u8 minor
 		u8 patch
-		u8 reserved
+		u8 reserved (CLIENT_FEATURE_* flags, 0 for upstream clients)
 		u16 len
 		u8[len] full_version_string
 	*/
@@ -928,6 +943,13 @@ enum AuthMechanism
 	AUTH_MECHANISM_FIRST_SRP = 1 << 2,
 };
 
+// Features of this fork, announced by the client in TOSERVER_CLIENT_READY
+enum ClientFeature
+{
+	// Understands TOCLIENT_INVENTORY_DELTA
+	CLIENT_FEATURE_INVENTORY_DELTA = 1 << 0,
+};
+
 enum AccessDeniedCode {
 	SERVER_ACCESSDENIED_WRONG_PASSWORD,
 	SERVER_ACCESSDENIED_UNEXPECTED_DATA,
@@ -625,10 +625,10 @@ void Server::handleCommand_Init2(NetworkPacket* pkt)
 	SendMovement(pkt->getPeerId());
 
 	// Send item definitions
-	SendItemDef(pkt->getPeerId(), m_itemdef, protocol_version);
+	SendItemDef(pkt->getPeerId(), protocol_version);
 
 	// Send node definitions
-	SendNodeDef(pkt->getPeerId(), m_nodedef, protocol_version);
+	SendNodeDef(pkt->getPeerId(), protocol_version);
 
 	m_clients.event(pkt->getPeerId(), CSE_SetDefinitionsSent);
 
@@ -708,13 +708,13 @@ void Server::handleCommand_ClientReady(NetworkPacket* pkt)
 		return;
 	}
 
-	u8 major_ver, minor_ver, patch_ver, reserved;
+	u8 major_ver, minor_ver, patch_ver, features;
 	std::string full_ver;
-	*pkt >> major_ver >> minor_ver >> patch_ver >> reserved >> full_ver;
+	*pkt >> major_ver >> minor_ver >> patch_ver >> features >> full_ver;
 
 	m_clients.setClientVersion(
 			peer_id, major_ver, minor_ver, patch_ver,
-			full_ver);
+			full_ver, features);
 
 	m_clients.event(peer_id, CSE_SetClientReady);
 	m_script->on_joinplayer(playersao);
@@ -1767,6 +1767,11 @@ void Server::handleCommand_NodeMetaFields(NetworkPacket* pkt)
 	RollbackScopeActor rollback_scope(m_rollback,
 			std::string("player:")+player->getName());
 
+	if (!rollback()) {
+		m_script->node_on_receive_fields(p, formname, fields, playersao);
+		return;
+	}
+
 	// Check the target node for rollback data; leave others unnoticed
 	RollbackNode rn_old(&m_env->getMap(), p, this);
 
@@ -1774,7 +1779,7 @@ void Server::handleCommand_NodeMetaFields(NetworkPacket* pkt)
 
 	// Report rollback data
 	RollbackNode rn_new(&m_env->getMap(), p, this);
-	if (rollback() && rn_new != rn_old) {
+	if (rn_new != rn_old) {
 		RollbackAction action;
 		action.setSetNode(p, rn_old, rn_new);
 		rollback()->reportAction(action);
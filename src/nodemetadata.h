@@ -90,6 +90,11 @@ class NodeMetadataList
 	// Deletes all
 	void clear();
 
+	bool empty() const
+	{
+		return countNonEmpty() == 0;
+	}
+
 private:
 	int countNonEmpty() const;
 
@@ -65,7 +65,7 @@ void NodeTimerList::serialize(std::ostream &os, u8 map_format_version) const
 			i != m_timers.end(); ++i) {
 		NodeTimer t = i->second;
 		NodeTimer nt = NodeTimer(t.timeout,
-			t.timeout - (f32)(i->first - m_time), t.position);
+			t.timeout - (f32)(i->first - getTime()), t.position);
 		v3s16 p = t.position;
 
 		u16 p16 = p.Z * MAP_BLOCKSIZE * MAP_BLOCKSIZE + p.Y * MAP_BLOCKSIZE + p.X;
@@ -129,16 +129,32 @@ void NodeTimerList::deSerialize(std::istream &is, u8 map_format_version)
 
 std::vector<NodeTimer> NodeTimerList::step(float dtime)
 {
-	std::vector<NodeTimer> elapsed_timers;
 	m_time += dtime;
-	if (m_next_trigger_time == -1. || m_time < m_next_trigger_time) {
+	return popElapsed();
+}
+
+std::vector<NodeTimer> NodeTimerList::stepScheduled(double scheduled_time)
+{
+	if (!m_scheduler || scheduled_time != m_scheduled_time)
+		return std::vector<NodeTimer>();
+	// The entry has been used up
+	m_scheduled_time = -1.;
+	return popElapsed();
+}
+
+std::vector<NodeTimer> NodeTimerList::popElapsed()
+{
+	std::vector<NodeTimer> elapsed_timers;
+	double time = getTime();
+	if (m_next_trigger_time == -1. || time < m_next_trigger_time) {
+		updateSchedule();
 		return elapsed_timers;
 	}
 	std::multimap<double, NodeTimer>::iterator i = m_timers.begin();
 	// Process timers
-	for (; i != m_timers.end() && i->first <= m_time; ++i) {
+	for (; i != m_timers.end() && i->first <= time; ++i) {
 		NodeTimer t = i->second;
-		t.elapsed = t.timeout + (f32)(m_time - i->first);
+		t.elapsed = t.timeout + (f32)(time - i->first);
 		elapsed_timers.push_back(t);
 		m_iterators.erase(t.position);
 	}
@@ -148,5 +164,47 @@ std::vector<NodeTimer> NodeTimerList::step(float dtime)
 		m_next_trigger_time = -1.;
 	else
 		m_next_trigger_time = m_timers.begin()->first;
+	updateSchedule();
 	return elapsed_timers;
 }
+
+void NodeTimerList::attach(NodeTimerScheduler *scheduler, v3s16 blockpos)
+{
+	detach();
+	m_scheduler = scheduler;
+	m_blockpos = blockpos;
+	m_time_offset = m_time - scheduler->getTime();
+	m_scheduled_time = -1.;
+	updateSchedule();
+}
+
+void NodeTimerList::detach()
+{
+	m_time = getTime();
+	m_scheduler = NULL;
+}
+
+void NodeTimerList::updateSchedule()
+{
+	if (!m_scheduler || m_next_trigger_time == -1.)
+		return;
+	double trigger_time = m_next_trigger_time - m_time_offset;
+	if (m_scheduled_time == -1. || trigger_time < m_scheduled_time) {
+		m_scheduler->schedule(m_blockpos, trigger_time);
+		m_scheduled_time = trigger_time;
+	}
+}
+
+/*
+	NodeTimerScheduler
+*/
+
+void NodeTimerScheduler::step(float dtime, std::vector<Entry> &due)
+{
+	m_time += dtime;
+	// Blocks scheduled while handling these are due in the next step
+	while (!m_queue.empty() && m_queue.top().first <= m_time) {
+		due.push_back(m_queue.top());
+		m_queue.pop();
+	}
+}
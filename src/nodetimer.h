@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "irr_v3d.h"
 #include <iostream>
 #include <map>
+#include <queue>
 #include <vector>
 
 /*
@@ -51,6 +52,44 @@ class NodeTimer
 	v3s16 position;
 };
 
+/*
+	Environment-wide schedule of the blocks with pending timers.
+
+	Timer lists attached to it take their time from it instead of being
+	stepped, and schedule their block whenever their next timer is due
+	earlier than before. Each list only acts on its latest entry; earlier
+	ones are outdated and ignored.
+*/
+
+class NodeTimerScheduler
+{
+public:
+	// Scheduler time and block position
+	typedef std::pair<double, v3s16> Entry;
+
+	NodeTimerScheduler(): m_time(0.) {}
+
+	double getTime() const { return m_time; }
+	size_t size() const { return m_queue.size(); }
+
+	void schedule(v3s16 blockpos, double trigger_time) {
+		m_queue.push(Entry(trigger_time, blockpos));
+	}
+
+	// Move forward in time, returns the entries that are due
+	void step(float dtime, std::vector<Entry> &due);
+
+private:
+	struct EntryLater {
+		bool operator()(const Entry &a, const Entry &b) const {
+			return a.first > b.first;
+		}
+	};
+
+	double m_time;
+	std::priority_queue<Entry, std::vector<Entry>, EntryLater> m_queue;
+};
+
 /*
 	List of timers of all the nodes of a block
 */
@@ -58,7 +97,9 @@ class NodeTimer
 class NodeTimerList
 {
 public:
-	NodeTimerList(): m_next_trigger_time(-1.), m_time(0.) {}
+	NodeTimerList():
+		m_next_trigger_time(-1.), m_time(0.),
+		m_scheduler(NULL), m_time_offset(0.), m_scheduled_time(-1.) {}
 	~NodeTimerList() {}
 	
 	void serialize(std::ostream &os, u8 map_format_version) const;
@@ -71,7 +112,7 @@ class NodeTimerList
 		if (n == m_iterators.end())
 			return NodeTimer();
 		NodeTimer t = n->second->second;
-		t.elapsed = t.timeout - (n->second->first - m_time);
+		t.elapsed = t.timeout - (n->second->first - getTime());
 		return t;
 	}
 	// Deletes timer
@@ -96,21 +137,26 @@ class NodeTimerList
 	// Undefined behaviour if there already is a timer
 	void insert(NodeTimer timer) {
 		v3s16 p = timer.position;
-		double trigger_time = m_time + (double)(timer.timeout - timer.elapsed);
+		double trigger_time = getTime() + (double)(timer.timeout - timer.elapsed);
 		std::multimap<double, NodeTimer>::iterator it =
 			m_timers.insert(std::pair<double, NodeTimer>(
 				trigger_time, timer
 			));
 		m_iterators.insert(
 			std::pair<v3s16, std::multimap<double, NodeTimer>::iterator>(p, it));
-		if (m_next_trigger_time == -1. || trigger_time < m_next_trigger_time)
+		if (m_next_trigger_time == -1. || trigger_time < m_next_trigger_time) {
 			m_next_trigger_time = trigger_time;
+			updateSchedule();
+		}
 	}
 	// Deletes old timer and sets a new one
 	inline void set(const NodeTimer &timer) {
 		remove(timer.position);
 		insert(timer);
 	}
+	inline bool empty() const {
+		return m_timers.empty();
+	}
 	// Deletes all timers
 	void clear() {
 		m_timers.clear();
@@ -122,14 +168,39 @@ class NodeTimerList
 		return m_next_trigger_time;
 	}
 
-	// Move forward in time, returns elapsed timers
+	// Move forward in time, returns elapsed timers.
+	// Only for lists that are not attached to a scheduler.
 	std::vector<NodeTimer> step(float dtime);
 
+	// Let the time pass with the scheduler, e.g. while the block is active
+	void attach(NodeTimerScheduler *scheduler, v3s16 blockpos);
+	void detach();
+	bool isAttached(const NodeTimerScheduler *scheduler) const {
+		return m_scheduler == scheduler;
+	}
+	// Returns the timers that elapsed by the scheduler's current time,
+	// given a due entry of the scheduler
+	std::vector<NodeTimer> stepScheduled(double scheduled_time);
+
 private:
+	std::vector<NodeTimer> popElapsed();
+	double getTime() const {
+		return m_scheduler ? m_scheduler->getTime() + m_time_offset : m_time;
+	}
+	void updateSchedule();
+
 	std::multimap<double, NodeTimer> m_timers;
 	std::map<v3s16, std::multimap<double, NodeTimer>::iterator> m_iterators;
 	double m_next_trigger_time;
+	// Time of the block, only used while not attached
 	double m_time;
+
+	NodeTimerScheduler *m_scheduler;
+	v3s16 m_blockpos;
+	// Time of the block minus the scheduler's time
+	double m_time_offset;
+	// Scheduler time of the earliest entry of this block, -1 if none
+	double m_scheduled_time;
 };
 
 #endif
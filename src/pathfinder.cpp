@@ -23,29 +23,18 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 /******************************************************************************/
 
 #include "pathfinder.h"
+#include <algorithm>
 #include "serverenvironment.h"
 #include "server.h"
 #include "nodedef.h"
+#include "mapblock.h"
 
 //#define PATHFINDER_DEBUG
-//#define PATHFINDER_CALC_TIME
-
-#ifdef PATHFINDER_DEBUG
-	#include <string>
-#endif
-#ifdef PATHFINDER_DEBUG
-	#include <iomanip>
-#endif
-#ifdef PATHFINDER_CALC_TIME
-	#include <sys/time.h>
-#endif
 
 /******************************************************************************/
 /* Typedefs and macros                                                        */
 /******************************************************************************/
 
-#define LVL "(" << level << ")" <<
-
 #ifdef PATHFINDER_DEBUG
 #define DEBUG_OUT(a)     std::cout << a
 #define INFO_TARGET      std::cout
@@ -55,324 +44,21 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define DEBUG_OUT(a)     while(0)
 #define INFO_TARGET      infostream << "Pathfinder: "
 #define VERBOSE_TARGET   verbosestream << "Pathfinder: "
-#define ERROR_TARGET     warningstream << "Pathfinder: "
+#define ERROR_TARGET     errorstream << "Pathfinder: "
 #endif
 
-/******************************************************************************/
-/* Class definitions                                                          */
-/******************************************************************************/
-
-
-/** representation of cost in specific direction */
-class PathCost {
-public:
-
-	/** default constructor */
-	PathCost();
-
-	/** copy constructor */
-	PathCost(const PathCost &b);
-
-	/** assignment operator */
-	PathCost &operator= (const PathCost &b);
-
-	bool valid;              /**< movement is possible         */
-	int  value;              /**< cost of movement             */
-	int  direction;          /**< y-direction of movement      */
-	bool updated;            /**< this cost has ben calculated */
-
-};
-
-
-/** representation of a mapnode to be used for pathfinding */
-class PathGridnode {
-
-public:
-	/** default constructor */
-	PathGridnode();
-
-	/** copy constructor */
-	PathGridnode(const PathGridnode &b);
-
-	/**
-	 * assignment operator
-	 * @param b node to copy
-	 */
-	PathGridnode &operator= (const PathGridnode &b);
-
-	/**
-	 * read cost in a specific direction
-	 * @param dir direction of cost to fetch
-	 */
-	PathCost getCost(v3s16 dir);
-
-	/**
-	 * set cost value for movement
-	 * @param dir direction to set cost for
-	 * @cost cost to set
-	 */
-	void      setCost(v3s16 dir, const PathCost &cost);
-
-	bool      valid;               /**< node is on surface                    */
-	bool      target;              /**< node is target position               */
-	bool      source;              /**< node is stating position              */
-	int       totalcost;           /**< cost to move here from starting point */
-	v3s16     sourcedir;           /**< origin of movement for current cost   */
-	v3s16     pos;                 /**< real position of node                 */
-	PathCost directions[4];        /**< cost in different directions          */
-
-	/* debug values */
-	bool      is_element;          /**< node is element of path detected      */
-	char      type;                /**< type of node                          */
-};
+#define PATH_NO_PARENT U32_MAX
 
-class Pathfinder;
+// The navigation cache is cleared when it holds more blocks
+#define NAVIGATION_CACHE_MAX_BLOCKS 4096
 
-/** Abstract class to manage the map data */
-class GridNodeContainer {
-public:
-	virtual PathGridnode &access(v3s16 p)=0;
-	virtual ~GridNodeContainer() {}
-protected:
-	Pathfinder *m_pathf;
+#define BLOCK_NODECOUNT (MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE)
 
-	void initNode(v3s16 ipos, PathGridnode *p_node);
-};
-
-class ArrayGridNodeContainer : public GridNodeContainer {
-public:
-	virtual ~ArrayGridNodeContainer() {}
-	ArrayGridNodeContainer(Pathfinder *pathf, v3s16 dimensions);
-	virtual PathGridnode &access(v3s16 p);
-private:
-	v3s16 m_dimensions;
-
-	int m_x_stride;
-	int m_y_stride;
-	std::vector<PathGridnode> m_nodes_array;
-};
-
-class MapGridNodeContainer : public GridNodeContainer {
-public:
-	virtual ~MapGridNodeContainer() {}
-	MapGridNodeContainer(Pathfinder *pathf);
-	virtual PathGridnode &access(v3s16 p);
-private:
-	std::map<v3s16, PathGridnode> m_nodes;
-};
-
-/** class doing pathfinding */
-class Pathfinder {
-
-public:
-	/**
-	 * default constructor
-	 */
-	Pathfinder();
-
-	~Pathfinder();
-
-	/**
-	 * path evaluation function
-	 * @param env environment to look for path
-	 * @param source origin of path
-	 * @param destination end position of path
-	 * @param searchdistance maximum number of nodes to look in each direction
-	 * @param max_jump maximum number of blocks a path may jump up
-	 * @param max_drop maximum number of blocks a path may drop
-	 * @param algo Algorithm to use for finding a path
-	 */
-	std::vector<v3s16> getPath(ServerEnvironment *env,
-			v3s16 source,
-			v3s16 destination,
-			unsigned int searchdistance,
-			unsigned int max_jump,
-			unsigned int max_drop,
-			PathAlgorithm algo);
-
-private:
-	/* helper functions */
-
-	/**
-	 * transform index pos to mappos
-	 * @param ipos a index position
-	 * @return map position
-	 */
-	v3s16          getRealPos(v3s16 ipos);
-
-	/**
-	 * transform mappos to index pos
-	 * @param pos a real pos
-	 * @return index position
-	 */
-	v3s16          getIndexPos(v3s16 pos);
-
-	/**
-	 * get gridnode at a specific index position
-	 * @param ipos index position
-	 * @return gridnode for index
-	 */
-	PathGridnode &getIndexElement(v3s16 ipos);
-
-	/**
-	 * Get gridnode at a specific index position
-	 * @return gridnode for index
-	 */
-	PathGridnode &getIdxElem(s16 x, s16 y, s16 z);
-
-	/**
-	 * invert a 3d position
-	 * @param pos 3d position
-	 * @return pos *-1
-	 */
-	v3s16          invert(v3s16 pos);
-
-	/**
-	 * check if a index is within current search area
-	 * @param index position to validate
-	 * @return true/false
-	 */
-	bool           isValidIndex(v3s16 index);
-
-	/**
-	 * translate position to float position
-	 * @param pos integer position
-	 * @return float position
-	 */
-	v3f            tov3f(v3s16 pos);
-
-
-	/* algorithm functions */
-
-	/**
-	 * calculate 2d manahttan distance to target on the xz plane
-	 * @param pos position to calc distance
-	 * @return integer distance
-	 */
-	int           getXZManhattanDist(v3s16 pos);
-
-	/**
-	 * get best direction based uppon heuristics
-	 * @param directions list of unchecked directions
-	 * @param g_pos mapnode to start from
-	 * @return direction to check
-	 */
-	v3s16         getDirHeuristic(std::vector<v3s16> &directions, PathGridnode &g_pos);
-
-	/**
-	 * build internal data representation of search area
-	 * @return true/false if costmap creation was successfull
-	 */
-	bool          buildCostmap();
-
-	/**
-	 * calculate cost of movement
-	 * @param pos real world position to start movement
-	 * @param dir direction to move to
-	 * @return cost information
-	 */
-	PathCost     calcCost(v3s16 pos, v3s16 dir);
-
-	/**
-	 * recursive update whole search areas total cost information
-	 * @param ipos position to check next
-	 * @param srcdir positionc checked last time
-	 * @param total_cost cost of moving to ipos
-	 * @param level current recursion depth
-	 * @return true/false path to destination has been found
-	 */
-	bool          updateAllCosts(v3s16 ipos, v3s16 srcdir, int total_cost, int level);
-
-	/**
-	 * recursive try to find a patrh to destionation
-	 * @param ipos position to check next
-	 * @param srcdir positionc checked last time
-	 * @param total_cost cost of moving to ipos
-	 * @param level current recursion depth
-	 * @return true/false path to destination has been found
-	 */
-	bool          updateCostHeuristic(v3s16 ipos, v3s16 srcdir, int current_cost, int level);
-
-	/**
-	 * recursive build a vector containing all nodes from source to destination
-	 * @param path vector to add nodes to
-	 * @param pos pos to check next
-	 * @param level recursion depth
-	 */
-	void          buildPath(std::vector<v3s16> &path, v3s16 pos, int level);
-
-	/* variables */
-	int m_max_index_x;            /**< max index of search area in x direction  */
-	int m_max_index_y;            /**< max index of search area in y direction  */
-	int m_max_index_z;            /**< max index of search area in z direction  */
-
-
-	int m_searchdistance;         /**< max distance to search in each direction */
-	int m_maxdrop;                /**< maximum number of blocks a path may drop */
-	int m_maxjump;                /**< maximum number of blocks a path may jump */
-	int m_min_target_distance;    /**< current smalest path to target           */
-
-	bool m_prefetch;              /**< prefetch cost data                       */
-
-	v3s16 m_start;                /**< source position                          */
-	v3s16 m_destination;          /**< destination position                     */
-
-	core::aabbox3d<s16> m_limits; /**< position limits in real map coordinates  */
-
-	/** contains all map data already collected and analyzed.
-		Access it via the getIndexElement/getIdxElem methods. */
-	friend class GridNodeContainer;
-	GridNodeContainer *m_nodes_container;
-
-	ServerEnvironment *m_env;     /**< minetest environment pointer             */
-
-#ifdef PATHFINDER_DEBUG
-
-	/**
-	 * print collected cost information
-	 */
-	void printCost();
-
-	/**
-	 * print collected cost information in a specific direction
-	 * @param dir direction to print
-	 */
-	void printCost(PathDirections dir);
-
-	/**
-	 * print type of node as evaluated
-	 */
-	void printType();
-
-	/**
-	 * print pathlenght for all nodes in search area
-	 */
-	void printPathLen();
-
-	/**
-	 * print a path
-	 * @param path path to show
-	 */
-	void printPath(std::vector<v3s16> path);
-
-	/**
-	 * print y direction for all movements
-	 */
-	void printYdir();
-
-	/**
-	 * print y direction for moving in a specific direction
-	 * @param dir direction to show data
-	 */
-	void printYdir(PathDirections dir);
-
-	/**
-	 * helper function to translate a direction to speaking text
-	 * @param dir direction to translate
-	 * @return textual name of direction
-	 */
-	std::string dirToName(PathDirections dir);
-#endif
+static const v3s16 path_directions[4] = {
+	v3s16( 1, 0,  0),
+	v3s16(-1, 0,  0),
+	v3s16( 0, 0,  1),
+	v3s16( 0, 0, -1),
 };
 
 /******************************************************************************/
@@ -387,223 +73,27 @@ std::vector<v3s16> get_path(ServerEnvironment* env,
 							unsigned int max_drop,
 							PathAlgorithm algo)
 {
-	Pathfinder searchclass;
-
-	return searchclass.getPath(env,
+	return env->getPathfinder().getPath(&env->getMap(),
+				env->getGameDef()->ndef(),
 				source, destination,
 				searchdistance, max_jump, max_drop, algo);
 }
 
 /******************************************************************************/
-PathCost::PathCost()
-:	valid(false),
-	value(0),
-	direction(0),
-	updated(false)
-{
-	//intentionaly empty
-}
-
-/******************************************************************************/
-PathCost::PathCost(const PathCost &b)
-{
-	valid     = b.valid;
-	direction = b.direction;
-	value     = b.value;
-	updated   = b.updated;
-}
-
-/******************************************************************************/
-PathCost &PathCost::operator= (const PathCost &b)
-{
-	valid     = b.valid;
-	direction = b.direction;
-	value     = b.value;
-	updated   = b.updated;
-
-	return *this;
-}
-
-/******************************************************************************/
-PathGridnode::PathGridnode()
-:	valid(false),
-	target(false),
-	source(false),
-	totalcost(-1),
-	sourcedir(v3s16(0, 0, 0)),
-	pos(v3s16(0, 0, 0)),
-	is_element(false),
-	type('u')
+Pathfinder::Pathfinder(NavigationCache *cache) :
+	m_maxdrop(0),
+	m_maxjump(0),
+	m_heuristic(true),
+	m_destination(0, 0, 0),
+	m_corridor_block(0, 0, 0),
+	m_cache(cache ? cache : &m_local_cache)
 {
 	//intentionaly empty
 }
 
 /******************************************************************************/
-PathGridnode::PathGridnode(const PathGridnode &b)
-:	valid(b.valid),
-	target(b.target),
-	source(b.source),
-	totalcost(b.totalcost),
-	sourcedir(b.sourcedir),
-	pos(b.pos),
-	is_element(b.is_element),
-	type(b.type)
-{
-
-	directions[DIR_XP] = b.directions[DIR_XP];
-	directions[DIR_XM] = b.directions[DIR_XM];
-	directions[DIR_ZP] = b.directions[DIR_ZP];
-	directions[DIR_ZM] = b.directions[DIR_ZM];
-}
-
-/******************************************************************************/
-PathGridnode &PathGridnode::operator= (const PathGridnode &b)
-{
-	valid      = b.valid;
-	target     = b.target;
-	source     = b.source;
-	is_element = b.is_element;
-	totalcost  = b.totalcost;
-	sourcedir  = b.sourcedir;
-	pos        = b.pos;
-	type       = b.type;
-
-	directions[DIR_XP] = b.directions[DIR_XP];
-	directions[DIR_XM] = b.directions[DIR_XM];
-	directions[DIR_ZP] = b.directions[DIR_ZP];
-	directions[DIR_ZM] = b.directions[DIR_ZM];
-
-	return *this;
-}
-
-/******************************************************************************/
-PathCost PathGridnode::getCost(v3s16 dir)
-{
-	if (dir.X > 0) {
-		return directions[DIR_XP];
-	}
-	if (dir.X < 0) {
-		return directions[DIR_XM];
-	}
-	if (dir.Z > 0) {
-		return directions[DIR_ZP];
-	}
-	if (dir.Z < 0) {
-		return directions[DIR_ZM];
-	}
-	PathCost retval;
-	return retval;
-}
-
-/******************************************************************************/
-void PathGridnode::setCost(v3s16 dir, const PathCost &cost)
-{
-	if (dir.X > 0) {
-		directions[DIR_XP] = cost;
-	}
-	if (dir.X < 0) {
-		directions[DIR_XM] = cost;
-	}
-	if (dir.Z > 0) {
-		directions[DIR_ZP] = cost;
-	}
-	if (dir.Z < 0) {
-		directions[DIR_ZM] = cost;
-	}
-}
-
-void GridNodeContainer::initNode(v3s16 ipos, PathGridnode *p_node)
-{
-	INodeDefManager *ndef = m_pathf->m_env->getGameDef()->ndef();
-	PathGridnode &elem = *p_node;
-
-	v3s16 realpos = m_pathf->getRealPos(ipos);
-
-	MapNode current = m_pathf->m_env->getMap().getNodeNoEx(realpos);
-	MapNode below   = m_pathf->m_env->getMap().getNodeNoEx(realpos + v3s16(0, -1, 0));
-
-
-	if ((current.param0 == CONTENT_IGNORE) ||
-			(below.param0 == CONTENT_IGNORE)) {
-		DEBUG_OUT("Pathfinder: " << PP(realpos) <<
-			" current or below is invalid element" << std::endl);
-		if (current.param0 == CONTENT_IGNORE) {
-			elem.type = 'i';
-			DEBUG_OUT(PP(ipos) << ": " << 'i' << std::endl);
-		}
-		return;
-	}
-
-	//don't add anything if it isn't an air node
-	if (ndef->get(current).walkable || !ndef->get(below).walkable) {
-			DEBUG_OUT("Pathfinder: " << PP(realpos)
-				<< " not on surface" << std::endl);
-			if (ndef->get(current).walkable) {
-				elem.type = 's';
-				DEBUG_OUT(PP(ipos) << ": " << 's' << std::endl);
-			} else {
-				elem.type = '-';
-				DEBUG_OUT(PP(ipos) << ": " << '-' << std::endl);
-			}
-			return;
-	}
-
-	elem.valid = true;
-	elem.pos   = realpos;
-	elem.type  = 'g';
-	DEBUG_OUT(PP(ipos) << ": " << 'a' << std::endl);
-
-	if (m_pathf->m_prefetch) {
-		elem.directions[DIR_XP] = m_pathf->calcCost(realpos, v3s16( 1, 0, 0));
-		elem.directions[DIR_XM] = m_pathf->calcCost(realpos, v3s16(-1, 0, 0));
-		elem.directions[DIR_ZP] = m_pathf->calcCost(realpos, v3s16( 0, 0, 1));
-		elem.directions[DIR_ZM] = m_pathf->calcCost(realpos, v3s16( 0, 0,-1));
-	}
-}
-
-ArrayGridNodeContainer::ArrayGridNodeContainer(Pathfinder *pathf, v3s16 dimensions) :
-	m_x_stride(dimensions.Y * dimensions.Z),
-	m_y_stride(dimensions.Z)
-{
-	m_pathf = pathf;
-
-	m_nodes_array.resize(dimensions.X * dimensions.Y * dimensions.Z);
-	INFO_TARGET << "Pathfinder ArrayGridNodeContainer constructor." << std::endl;
-	for (int x = 0; x < dimensions.X; x++) {
-		for (int y = 0; y < dimensions.Y; y++) {
-			for (int z= 0; z < dimensions.Z; z++) {
-				v3s16 ipos(x, y, z);
-				initNode(ipos, &access(ipos));
-			}
-		}
-	}
-}
-
-PathGridnode &ArrayGridNodeContainer::access(v3s16 p)
-{
-	return m_nodes_array[p.X * m_x_stride + p.Y * m_y_stride + p.Z];
-}
-
-MapGridNodeContainer::MapGridNodeContainer(Pathfinder *pathf)
-{
-	m_pathf = pathf;
-}
-
-PathGridnode &MapGridNodeContainer::access(v3s16 p)
-{
-	std::map<v3s16, PathGridnode>::iterator it = m_nodes.find(p);
-	if (it != m_nodes.end()) {
-		return it->second;
-	}
-	PathGridnode &n = m_nodes[p];
-	initNode(p, &n);
-	return n;
-}
-
-
-
-/******************************************************************************/
-std::vector<v3s16> Pathfinder::getPath(ServerEnvironment *env,
+std::vector<v3s16> Pathfinder::getPath(Map *map,
+							INodeDefManager *ndef,
 							v3s16 source,
 							v3s16 destination,
 							unsigned int searchdistance,
@@ -611,801 +101,724 @@ std::vector<v3s16> Pathfinder::getPath(ServerEnvironment *env,
 							unsigned int max_drop,
 							PathAlgorithm algo)
 {
-#ifdef PATHFINDER_CALC_TIME
-	timespec ts;
-	clock_gettime(CLOCK_REALTIME, &ts);
-#endif
 	std::vector<v3s16> retval;
 
-	//check parameters
-	if (env == 0) {
-		ERROR_TARGET << "missing environment pointer" << std::endl;
-		return retval;
-	}
+	// Nothing tells the local cache about changes of the map
+	if (m_cache == &m_local_cache)
+		m_local_cache.clear();
+	m_cache->begin(map, ndef);
 
-	m_searchdistance = searchdistance;
-	m_env = env;
 	m_maxjump = max_jump;
 	m_maxdrop = max_drop;
-	m_start       = source;
 	m_destination = destination;
-	m_min_target_distance = -1;
-	m_prefetch = true;
-
-	if (algo == PA_PLAIN_NP) {
-		m_prefetch = false;
-	}
-
-	int min_x = MYMIN(source.X, destination.X);
-	int max_x = MYMAX(source.X, destination.X);
-
-	int min_y = MYMIN(source.Y, destination.Y);
-	int max_y = MYMAX(source.Y, destination.Y);
-
-	int min_z = MYMIN(source.Z, destination.Z);
-	int max_z = MYMAX(source.Z, destination.Z);
-
-	m_limits.MinEdge.X = min_x - searchdistance;
-	m_limits.MinEdge.Y = min_y - searchdistance;
-	m_limits.MinEdge.Z = min_z - searchdistance;
-
-	m_limits.MaxEdge.X = max_x + searchdistance;
-	m_limits.MaxEdge.Y = max_y + searchdistance;
-	m_limits.MaxEdge.Z = max_z + searchdistance;
-
-	v3s16 diff = m_limits.MaxEdge - m_limits.MinEdge;
-
-	m_max_index_x = diff.X;
-	m_max_index_y = diff.Y;
-	m_max_index_z = diff.Z;
-
-	delete m_nodes_container;
-	if (diff.getLength() > 5) {
-		m_nodes_container = new MapGridNodeContainer(this);
-	} else {
-		m_nodes_container = new ArrayGridNodeContainer(this, diff);
-	}
-#ifdef PATHFINDER_DEBUG
-	printType();
-	printCost();
-	printYdir();
-#endif
-
-	//validate and mark start and end pos
-	v3s16 StartIndex  = getIndexPos(source);
-	v3s16 EndIndex    = getIndexPos(destination);
-
-	PathGridnode &startpos = getIndexElement(StartIndex);
-	PathGridnode &endpos   = getIndexElement(EndIndex);
-
-	if (!startpos.valid) {
-		VERBOSE_TARGET << "invalid startpos" <<
-				"Index: " << PP(StartIndex) <<
-				"Realpos: " << PP(getRealPos(StartIndex)) << std::endl;
+	m_heuristic = algo != PA_DIJKSTRA;
+
+	const int limit = MAX_MAP_GENERATION_LIMIT;
+	int distance = MYMIN(searchdistance, (unsigned int)limit);
+	m_limits.MinEdge.X = MYMAX(MYMIN(source.X, destination.X) - distance, -limit);
+	m_limits.MinEdge.Y = MYMAX(MYMIN(source.Y, destination.Y) - distance, -limit);
+	m_limits.MinEdge.Z = MYMAX(MYMIN(source.Z, destination.Z) - distance, -limit);
+	m_limits.MaxEdge.X = MYMIN(MYMAX(source.X, destination.X) + distance, limit);
+	m_limits.MaxEdge.Y = MYMIN(MYMAX(source.Y, destination.Y) + distance, limit);
+	m_limits.MaxEdge.Z = MYMIN(MYMAX(source.Z, destination.Z) + distance, limit);
+	if (algo == PA_HIERARCHICAL) {
+		// Whole blocks, like the region search
+		m_limits.MinEdge = getNodeBlockPos(m_limits.MinEdge) * MAP_BLOCKSIZE;
+		m_limits.MaxEdge = getNodeBlockPos(m_limits.MaxEdge) * MAP_BLOCKSIZE +
+				v3s16(1, 1, 1) * (MAP_BLOCKSIZE - 1);
+	}
+
+	//validate start and end pos
+	if (!m_cache->isSurface(source)) {
+		VERBOSE_TARGET << "invalid startpos " << PP(source) << std::endl;
 		return retval;
 	}
-	if (!endpos.valid) {
-		VERBOSE_TARGET << "invalid stoppos" <<
-				"Index: " << PP(EndIndex) <<
-				"Realpos: " << PP(getRealPos(EndIndex)) << std::endl;
+	if (!m_cache->isSurface(destination)) {
+		VERBOSE_TARGET << "invalid stoppos " << PP(destination) << std::endl;
 		return retval;
 	}
 
-	endpos.target      = true;
-	startpos.source    = true;
-	startpos.totalcost = 0;
-
-	bool update_cost_retval = false;
-
-	switch (algo) {
-		case PA_DIJKSTRA:
-			update_cost_retval = updateAllCosts(StartIndex, v3s16(0, 0, 0), 0, 0);
-			break;
-		case PA_PLAIN_NP:
-		case PA_PLAIN:
-			update_cost_retval = updateCostHeuristic(StartIndex, v3s16(0, 0, 0), 0, 0);
-			break;
-		default:
-			ERROR_TARGET << "missing PathAlgorithm"<< std::endl;
-			break;
+	m_corridor.clear();
+	if (algo == PA_HIERARCHICAL && !searchRegions(source)) {
+		VERBOSE_TARGET << "no path from " << PP(source) << " to "
+				<< PP(destination) << " after visiting " << m_regions.size()
+				<< " regions" << std::endl;
+		return retval;
 	}
 
-	if (update_cost_retval) {
-
-#ifdef PATHFINDER_DEBUG
-		std::cout << "Path to target found!" << std::endl;
-		printPathLen();
-#endif
+	u32 target = searchNodes(source);
+	if (target == PATH_NO_PARENT && !m_corridor.empty()) {
+		// Not expected, the regions of the corridor are connected
+		ERROR_TARGET << "no path in the corridor from " << PP(source)
+				<< " to " << PP(destination) << std::endl;
+		m_corridor.clear();
+		target = searchNodes(source);
+	}
 
-		//find path
-		std::vector<v3s16> path;
-		buildPath(path, EndIndex, 0);
+	if (target == PATH_NO_PARENT) {
+		VERBOSE_TARGET << "no path from " << PP(source) << " to "
+				<< PP(destination) << " after visiting " << m_nodes.size()
+				<< " nodes" << std::endl;
+		return retval;
+	}
 
-#ifdef PATHFINDER_DEBUG
-		std::cout << "Full index path:" << std::endl;
-		printPath(path);
-#endif
+	for (u32 i = target; i != PATH_NO_PARENT; i = m_nodes[i].parent)
+		retval.push_back(m_nodes[i].pos);
+	std::reverse(retval.begin(), retval.end());
+	return retval;
+}
 
-		//finalize path
-		std::vector<v3s16> full_path;
-		for (std::vector<v3s16>::iterator i = path.begin();
-					i != path.end(); ++i) {
-			full_path.push_back(getIndexElement(*i).pos);
+/******************************************************************************/
+u32 Pathfinder::searchNodes(v3s16 source)
+{
+	reset();
+	u32 start = getNodeIndex(source);
+	m_nodes[start].cost = 0;
+	OpenEntry entry;
+	entry.estimate = estimateCost(source);
+	entry.cost = 0;
+	entry.node = start;
+	m_open.push_back(entry);
+
+	/*
+		Take the open node with the lowest estimated total cost until
+		the destination is reached. Costs of the moves are calculated
+		when a node is taken, stale heap entries are skipped.
+	*/
+	while (!m_open.empty()) {
+		std::pop_heap(m_open.begin(), m_open.end());
+		OpenEntry current = m_open.back();
+		m_open.pop_back();
+
+		Node &node = m_nodes[current.node];
+		if (node.closed || node.cost != current.cost)
+			continue;
+		node.closed = true;
+		v3s16 pos = node.pos;
+
+		if (pos == m_destination)
+			return current.node;
+
+		for (u32 i = 0; i < 4; i++) {
+			PathCost cost = m_cache->getMove(pos, path_directions[i],
+					m_maxjump, m_maxdrop, m_limits);
+			if (!cost.valid)
+				continue;
+			assert(cost.value > 0);
+
+			v3s16 pos2 = pos + path_directions[i];
+			pos2.Y += cost.direction;
+			if (!m_corridor.empty() && !isInCorridor(pos2))
+				continue;
+			u32 index2 = getNodeIndex(pos2);
+			Node &node2 = m_nodes[index2];
+			int new_cost = current.cost + cost.value;
+			if (node2.closed ||
+					(node2.cost >= 0 && node2.cost <= new_cost))
+				continue;
+
+			DEBUG_OUT("Pathfinder: updating path at: " << PP(pos2)
+					<< " from: " << node2.cost << " to " << new_cost
+					<< std::endl);
+			node2.cost = new_cost;
+			node2.parent = current.node;
+			entry.estimate = new_cost + estimateCost(pos2);
+			entry.cost = new_cost;
+			entry.node = index2;
+			m_open.push_back(entry);
+			std::push_heap(m_open.begin(), m_open.end());
 		}
+	}
+	return PATH_NO_PARENT;
+}
 
-#ifdef PATHFINDER_DEBUG
-		std::cout << "full path:" << std::endl;
-		printPath(full_path);
-#endif
-#ifdef PATHFINDER_CALC_TIME
-		timespec ts2;
-		clock_gettime(CLOCK_REALTIME, &ts2);
+/******************************************************************************/
+u32 Pathfinder::getRegionIndex(v3s16 blockpos, u16 region)
+{
+	u64 key = ((u64)(u16)blockpos.X << 48) | ((u64)(u16)blockpos.Y << 32) |
+		((u64)(u16)blockpos.Z << 16) | region;
+	std::map<u64, u32>::iterator it = m_region_index.find(key);
+	if (it != m_region_index.end())
+		return it->second;
 
-		int ms = (ts2.tv_nsec - ts.tv_nsec)/(1000*1000);
-		int us = ((ts2.tv_nsec - ts.tv_nsec) - (ms*1000*1000))/1000;
-		int ns = ((ts2.tv_nsec - ts.tv_nsec) - ( (ms*1000*1000) + (us*1000)));
+	Region r;
+	r.blockpos = blockpos;
+	r.region = region;
+	r.cost = -1;
+	r.parent = PATH_NO_PARENT;
+	r.closed = false;
+	m_regions.push_back(r);
+	m_region_index[key] = m_regions.size() - 1;
+	return m_regions.size() - 1;
+}
+
+/******************************************************************************/
+bool Pathfinder::searchRegions(v3s16 source)
+{
+	m_regions.clear();
+	m_region_index.clear();
+	m_open.clear();
+
+	core::aabbox3d<s16> block_limits(getNodeBlockPos(m_limits.MinEdge),
+			getNodeBlockPos(m_limits.MaxEdge));
+	v3s16 source_block = getNodeBlockPos(source);
+	v3s16 dest_block = getNodeBlockPos(m_destination);
+	int dest_region = m_cache->getSummary(dest_block, m_maxjump, m_maxdrop)
+			->getRegion(m_destination);
+	int source_region = m_cache->getSummary(source_block, m_maxjump, m_maxdrop)
+			->getRegion(source);
+	assert(source_region >= 0 && dest_region >= 0);
+
+	u32 start = getRegionIndex(source_block, source_region);
+	m_regions[start].cost = 0;
+	OpenEntry entry;
+	entry.estimate = 0;
+	entry.cost = 0;
+	entry.node = start;
+	m_open.push_back(entry);
+
+	/*
+		Same as the node search, moving to another block costs 1
+	*/
+	u32 target = PATH_NO_PARENT;
+	while (!m_open.empty()) {
+		std::pop_heap(m_open.begin(), m_open.end());
+		OpenEntry current = m_open.back();
+		m_open.pop_back();
+
+		Region &r = m_regions[current.node];
+		if (r.closed || r.cost != current.cost)
+			continue;
+		r.closed = true;
+		v3s16 blockpos = r.blockpos;
+		u16 region = r.region;
+
+		if (blockpos == dest_block && region == dest_region) {
+			target = current.node;
+			break;
+		}
 
+		// Copy the targets, reading other summaries may drop this one
+		const NavigationCache::Summary *summary =
+				m_cache->getSummary(blockpos, m_maxjump, m_maxdrop);
+		m_targets.clear();
+		for (size_t i = 0; i < summary->portals.size(); i++) {
+			if (summary->portals[i].region == region)
+				m_targets.push_back(summary->portals[i].target);
+		}
 
-		std::cout << "Calculating path took: " << (ts2.tv_sec - ts.tv_sec) <<
-				"s " << ms << "ms " << us << "us " << ns << "ns " << std::endl;
-#endif
-		return full_path;
-	}
-	else {
-#ifdef PATHFINDER_DEBUG
-		printPathLen();
-#endif
-		ERROR_TARGET << "failed to update cost map"<< std::endl;
+		summary = NULL;
+		v3s16 last_blockpos;
+		for (size_t i = 0; i < m_targets.size(); i++) {
+			v3s16 blockpos2 = getNodeBlockPos(m_targets[i]);
+			if (!block_limits.isPointInside(blockpos2))
+				continue;
+			if (summary == NULL || blockpos2 != last_blockpos) {
+				summary = m_cache->getSummary(blockpos2, m_maxjump, m_maxdrop);
+				last_blockpos = blockpos2;
+			}
+			int region2 = summary->getRegion(m_targets[i]);
+			if (region2 < 0)
+				continue;
+
+			u32 index2 = getRegionIndex(blockpos2, region2);
+			Region &r2 = m_regions[index2];
+			int new_cost = current.cost + (blockpos2 != blockpos ? 1 : 0);
+			if (r2.closed || (r2.cost >= 0 && r2.cost <= new_cost))
+				continue;
+
+			r2.cost = new_cost;
+			r2.parent = current.node;
+			// Every move changes X or Z by 1 at most
+			entry.estimate = new_cost + abs(blockpos2.X - dest_block.X) +
+					abs(blockpos2.Z - dest_block.Z);
+			entry.cost = new_cost;
+			entry.node = index2;
+			m_open.push_back(entry);
+			std::push_heap(m_open.begin(), m_open.end());
+		}
 	}
 
+	if (target == PATH_NO_PARENT)
+		return false;
 
-	//return
-	return retval;
+	for (u32 i = target; i != PATH_NO_PARENT; i = m_regions[i].parent) {
+		v3s16 blockpos = m_regions[i].blockpos;
+		for (s16 z = -1; z <= 1; z++)
+		for (s16 x = -1; x <= 1; x++)
+			m_corridor.push_back(blockpos + v3s16(x, 0, z));
+	}
+	std::sort(m_corridor.begin(), m_corridor.end());
+	m_corridor.erase(std::unique(m_corridor.begin(), m_corridor.end()),
+			m_corridor.end());
+	m_corridor_block = m_corridor.front();
+	return true;
 }
 
 /******************************************************************************/
-Pathfinder::Pathfinder() :
-	m_max_index_x(0),
-	m_max_index_y(0),
-	m_max_index_z(0),
-	m_searchdistance(0),
-	m_maxdrop(0),
-	m_maxjump(0),
-	m_min_target_distance(0),
-	m_prefetch(true),
-	m_start(0, 0, 0),
-	m_destination(0, 0, 0),
-	m_nodes_container(NULL),
-	m_env(0)
+bool Pathfinder::isInCorridor(v3s16 pos)
 {
-	//intentionaly empty
+	v3s16 blockpos = getNodeBlockPos(pos);
+	if (blockpos == m_corridor_block)
+		return true;
+	if (!std::binary_search(m_corridor.begin(), m_corridor.end(), blockpos))
+		return false;
+	m_corridor_block = blockpos;
+	return true;
 }
 
-Pathfinder::~Pathfinder()
-{
-	delete m_nodes_container;
-}
 /******************************************************************************/
-v3s16 Pathfinder::getRealPos(v3s16 ipos)
+static inline u32 hash_pos(v3s16 pos)
 {
-	return m_limits.MinEdge + ipos;
+	return ((u32)(u16)pos.X * 73856093U) ^ ((u32)(u16)pos.Y * 19349663U) ^
+		((u32)(u16)pos.Z * 83492791U);
 }
 
 /******************************************************************************/
-PathCost Pathfinder::calcCost(v3s16 pos, v3s16 dir)
+u32 Pathfinder::getNodeIndex(v3s16 pos)
 {
-	INodeDefManager *ndef = m_env->getGameDef()->ndef();
-	PathCost retval;
+	// Keep the load factor at 1/2 at most
+	if (m_nodes.size() * 2 >= m_slots.size())
+		growSlots();
 
-	retval.updated = true;
-
-	v3s16 pos2 = pos + dir;
-
-	//check limits
-	if (!m_limits.isPointInside(pos2)) {
-		DEBUG_OUT("Pathfinder: " << PP(pos2) <<
-				" no cost -> out of limits" << std::endl);
-		return retval;
+	u32 mask = m_slots.size() - 1;
+	u32 slot = hash_pos(pos) & mask;
+	while (m_slots[slot] != 0) {
+		u32 index = m_slots[slot] - 1;
+		if (m_nodes[index].pos == pos)
+			return index;
+		slot = (slot + 1) & mask;
 	}
 
-	MapNode node_at_pos2 = m_env->getMap().getNodeNoEx(pos2);
+	Node node;
+	node.pos = pos;
+	node.cost = -1;
+	node.parent = PATH_NO_PARENT;
+	node.slot = slot;
+	node.closed = false;
+	m_nodes.push_back(node);
+	m_slots[slot] = m_nodes.size();
+	return m_nodes.size() - 1;
+}
 
-	//did we get information about node?
-	if (node_at_pos2.param0 == CONTENT_IGNORE ) {
-			VERBOSE_TARGET << "Pathfinder: (1) area at pos: "
-					<< PP(pos2) << " not loaded";
-			return retval;
+/******************************************************************************/
+void Pathfinder::growSlots()
+{
+	m_slots.assign(MYMAX(m_slots.size() * 2, (size_t)1024), 0);
+	u32 mask = m_slots.size() - 1;
+	for (u32 i = 0; i < m_nodes.size(); i++) {
+		u32 slot = hash_pos(m_nodes[i].pos) & mask;
+		while (m_slots[slot] != 0)
+			slot = (slot + 1) & mask;
+		m_slots[slot] = i + 1;
+		m_nodes[i].slot = slot;
 	}
+}
 
-	if (!ndef->get(node_at_pos2).walkable) {
-		MapNode node_below_pos2 =
-							m_env->getMap().getNodeNoEx(pos2 + v3s16(0, -1, 0));
-
-		//did we get information about node?
-		if (node_below_pos2.param0 == CONTENT_IGNORE ) {
-				VERBOSE_TARGET << "Pathfinder: (2) area at pos: "
-					<< PP((pos2 + v3s16(0, -1, 0))) << " not loaded";
-				return retval;
-		}
-
-		if (ndef->get(node_below_pos2).walkable) {
-			retval.valid = true;
-			retval.value = 1;
-			retval.direction = 0;
-			DEBUG_OUT("Pathfinder: "<< PP(pos)
-					<< " cost same height found" << std::endl);
-		}
-		else {
-			v3s16 testpos = pos2 - v3s16(0, -1, 0);
-			MapNode node_at_pos = m_env->getMap().getNodeNoEx(testpos);
-
-			while ((node_at_pos.param0 != CONTENT_IGNORE) &&
-					(!ndef->get(node_at_pos).walkable) &&
-					(testpos.Y > m_limits.MinEdge.Y)) {
-				testpos += v3s16(0, -1, 0);
-				node_at_pos = m_env->getMap().getNodeNoEx(testpos);
-			}
-
-			//did we find surface?
-			if ((testpos.Y >= m_limits.MinEdge.Y) &&
-					(node_at_pos.param0 != CONTENT_IGNORE) &&
-					(ndef->get(node_at_pos).walkable)) {
-				if ((pos2.Y - testpos.Y - 1) <= m_maxdrop) {
-					retval.valid = true;
-					retval.value = 2;
-					//difference of y-pos +1 (target node is ABOVE solid node)
-					retval.direction = ((testpos.Y - pos2.Y) +1);
-					DEBUG_OUT("Pathfinder cost below height found" << std::endl);
-				}
-				else {
-					INFO_TARGET << "Pathfinder:"
-							" distance to surface below to big: "
-							<< (testpos.Y - pos2.Y) << " max: " << m_maxdrop
-							<< std::endl;
-				}
-			}
-			else {
-				DEBUG_OUT("Pathfinder: no surface below found" << std::endl);
-			}
-		}
-	}
-	else {
-		v3s16 testpos = pos2;
-		MapNode node_at_pos = m_env->getMap().getNodeNoEx(testpos);
-
-		while ((node_at_pos.param0 != CONTENT_IGNORE) &&
-				(ndef->get(node_at_pos).walkable) &&
-				(testpos.Y < m_limits.MaxEdge.Y)) {
-			testpos += v3s16(0, 1, 0);
-			node_at_pos = m_env->getMap().getNodeNoEx(testpos);
-		}
+/******************************************************************************/
+void Pathfinder::reset()
+{
+	for (u32 i = 0; i < m_nodes.size(); i++)
+		m_slots[m_nodes[i].slot] = 0;
+	m_nodes.clear();
+	m_open.clear();
+}
 
-		//did we find surface?
-		if ((testpos.Y <= m_limits.MaxEdge.Y) &&
-				(!ndef->get(node_at_pos).walkable)) {
+/******************************************************************************/
+int Pathfinder::estimateCost(v3s16 pos)
+{
+	if (!m_heuristic)
+		return 0;
 
-			if (testpos.Y - pos2.Y <= m_maxjump) {
-				retval.valid = true;
-				retval.value = 2;
-				retval.direction = (testpos.Y - pos2.Y);
-				DEBUG_OUT("Pathfinder cost above found" << std::endl);
-			}
-			else {
-				DEBUG_OUT("Pathfinder: distance to surface above to big: "
-						<< (testpos.Y - pos2.Y) << " max: " << m_maxjump
-						<< std::endl);
-			}
-		}
-		else {
-			DEBUG_OUT("Pathfinder: no surface above found" << std::endl);
-		}
-	}
-	return retval;
+	// Every move costs at least 1 and changes X or Z by 1. Moves that
+	// change the height cost 1 more and climb or drop a limited amount.
+	int estimate = abs(pos.X - m_destination.X) + abs(pos.Z - m_destination.Z);
+	int dy = m_destination.Y - pos.Y;
+	if (dy > 0 && m_maxjump > 0)
+		estimate += (dy + m_maxjump - 1) / m_maxjump;
+	else if (dy < 0 && m_maxdrop > 0)
+		estimate += (-dy + m_maxdrop - 1) / m_maxdrop;
+	return estimate;
 }
 
 /******************************************************************************/
-v3s16 Pathfinder::getIndexPos(v3s16 pos)
+static inline u32 node_index(v3s16 pos, v3s16 blockpos)
 {
-	return pos - m_limits.MinEdge;
+	v3s16 rel = pos - blockpos * MAP_BLOCKSIZE;
+	return (rel.Z * MAP_BLOCKSIZE + rel.Y) * MAP_BLOCKSIZE + rel.X;
 }
 
 /******************************************************************************/
-PathGridnode &Pathfinder::getIndexElement(v3s16 ipos)
+static bool compare_surface_index(const NavigationCache::SurfaceNode &a, u16 index)
 {
-	return m_nodes_container->access(ipos);
+	return a.index < index;
 }
 
 /******************************************************************************/
-inline PathGridnode &Pathfinder::getIdxElem(s16 x, s16 y, s16 z)
+int NavigationCache::Summary::getRegion(v3s16 pos) const
 {
-	return m_nodes_container->access(v3s16(x,y,z));
+	u16 index = node_index(pos, getNodeBlockPos(pos));
+	std::vector<SurfaceNode>::const_iterator it = std::lower_bound(
+			surface.begin(), surface.end(), index, compare_surface_index);
+	if (it == surface.end() || it->index != index)
+		return -1;
+	return it->region;
 }
 
 /******************************************************************************/
-bool Pathfinder::isValidIndex(v3s16 index)
+NavigationCache::NavigationCache() :
+	m_map(NULL),
+	m_ndef(NULL),
+	m_last(NULL),
+	m_last_pos(0, 0, 0),
+	m_maxjump(0),
+	m_maxdrop(0),
+	m_search(0)
 {
-	if (	(index.X < m_max_index_x) &&
-			(index.Y < m_max_index_y) &&
-			(index.Z < m_max_index_z) &&
-			(index.X >= 0) &&
-			(index.Y >= 0) &&
-			(index.Z >= 0))
-		return true;
-
-	return false;
 }
 
 /******************************************************************************/
-v3s16 Pathfinder::invert(v3s16 pos)
+NavigationCache::~NavigationCache()
 {
-	v3s16 retval = pos;
-
-	retval.X *=-1;
-	retval.Y *=-1;
-	retval.Z *=-1;
-
-	return retval;
+	clear();
 }
 
 /******************************************************************************/
-bool Pathfinder::updateAllCosts(v3s16 ipos,
-								v3s16 srcdir,
-								int current_cost,
-								int level)
+void NavigationCache::begin(Map *map, INodeDefManager *ndef)
 {
-	PathGridnode &g_pos = getIndexElement(ipos);
-	g_pos.totalcost = current_cost;
-	g_pos.sourcedir = srcdir;
-
-	level ++;
-
-	//check if target has been found
-	if (g_pos.target) {
-		m_min_target_distance = current_cost;
-		DEBUG_OUT(LVL " Pathfinder: target found!" << std::endl);
-		return true;
-	}
-
-	bool retval = false;
-
-	std::vector<v3s16> directions;
-
-	directions.push_back(v3s16( 1,0, 0));
-	directions.push_back(v3s16(-1,0, 0));
-	directions.push_back(v3s16( 0,0, 1));
-	directions.push_back(v3s16( 0,0,-1));
-
-	for (unsigned int i=0; i < directions.size(); i++) {
-		if (directions[i] != srcdir) {
-			PathCost cost = g_pos.getCost(directions[i]);
-
-			if (cost.valid) {
-				directions[i].Y = cost.direction;
-
-				v3s16 ipos2 = ipos + directions[i];
-
-				if (!isValidIndex(ipos2)) {
-					DEBUG_OUT(LVL " Pathfinder: " << PP(ipos2) <<
-						" out of range, max=" << PP(m_limits.MaxEdge) << std::endl);
-					continue;
-				}
-
-				PathGridnode &g_pos2 = getIndexElement(ipos2);
-
-				if (!g_pos2.valid) {
-					VERBOSE_TARGET << LVL "Pathfinder: no data for new position: "
-												<< PP(ipos2) << std::endl;
-					continue;
-				}
-
-				assert(cost.value > 0);
-
-				int new_cost = current_cost + cost.value;
-
-				// check if there already is a smaller path
-				if ((m_min_target_distance > 0) &&
-						(m_min_target_distance < new_cost)) {
-					return false;
-				}
-
-				if ((g_pos2.totalcost < 0) ||
-						(g_pos2.totalcost > new_cost)) {
-					DEBUG_OUT(LVL "Pathfinder: updating path at: "<<
-							PP(ipos2) << " from: " << g_pos2.totalcost << " to "<<
-							new_cost << std::endl);
-					if (updateAllCosts(ipos2, invert(directions[i]),
-											new_cost, level)) {
-						retval = true;
-						}
-					}
-				else {
-					DEBUG_OUT(LVL "Pathfinder:"
-							" already found shorter path to: "
-							<< PP(ipos2) << std::endl);
-				}
-			}
-			else {
-				DEBUG_OUT(LVL "Pathfinder:"
-						" not moving to invalid direction: "
-						<< PP(directions[i]) << std::endl);
-			}
-		}
-	}
-	return retval;
+	if (map != m_map || ndef != m_ndef ||
+			m_blocks.size() > NAVIGATION_CACHE_MAX_BLOCKS)
+		clear();
+	m_map = map;
+	m_ndef = ndef;
+	m_last = NULL;
+	m_search++;
 }
 
 /******************************************************************************/
-int Pathfinder::getXZManhattanDist(v3s16 pos)
+void NavigationCache::clear()
 {
-	int min_x = MYMIN(pos.X, m_destination.X);
-	int max_x = MYMAX(pos.X, m_destination.X);
-	int min_z = MYMIN(pos.Z, m_destination.Z);
-	int max_z = MYMAX(pos.Z, m_destination.Z);
-
-	return (max_x - min_x) + (max_z - min_z);
+	for (std::map<v3s16, Block *>::iterator it = m_blocks.begin();
+			it != m_blocks.end(); ++it)
+		delete it->second;
+	m_blocks.clear();
+	m_last = NULL;
+	m_maxjump = 0;
+	m_maxdrop = 0;
 }
 
 /******************************************************************************/
-v3s16 Pathfinder::getDirHeuristic(std::vector<v3s16> &directions, PathGridnode &g_pos)
+void NavigationCache::onMapEditEvent(MapEditEvent *event)
 {
-	int   minscore = -1;
-	v3s16 retdir   = v3s16(0, 0, 0);
-	v3s16 srcpos = g_pos.pos;
-	DEBUG_OUT("Pathfinder: remaining dirs at beginning:"
-				<< directions.size() << std::endl);
-
-	for (std::vector<v3s16>::iterator iter = directions.begin();
-			iter != directions.end();
-			++iter) {
-
-		v3s16 pos1 = v3s16(srcpos.X + iter->X, 0, srcpos.Z+iter->Z);
-
-		int cur_manhattan = getXZManhattanDist(pos1);
-		PathCost cost    = g_pos.getCost(*iter);
-
-		if (!cost.updated) {
-			cost = calcCost(g_pos.pos, *iter);
-			g_pos.setCost(*iter, cost);
-		}
-
-		if (cost.valid) {
-			int score = cost.value + cur_manhattan;
-
-			if ((minscore < 0)|| (score < minscore)) {
-				minscore = score;
-				retdir = *iter;
-			}
-		}
+	switch (event->type) {
+	case MEET_ADDNODE:
+	case MEET_REMOVENODE:
+	case MEET_SWAPNODE: {
+		v3s16 blockpos = getNodeBlockPos(event->p);
+		std::map<v3s16, Block *>::iterator it = m_blocks.find(blockpos);
+		if (it == m_blocks.end())
+			return;
+		Block *b = it->second;
+		if (b->block == NULL)
+			return;
+		u32 i = node_index(event->p, blockpos);
+		b->ignore[i] = event->n.getContent() == CONTENT_IGNORE;
+		b->walkable[i] = m_ndef->get(event->n).walkable;
+		invalidateSummaries(event->p, event->p);
+		break;
 	}
-
-	if (retdir != v3s16(0, 0, 0)) {
-		for (std::vector<v3s16>::iterator iter = directions.begin();
-					iter != directions.end();
-					++iter) {
-			if(*iter == retdir) {
-				DEBUG_OUT("Pathfinder: removing return direction" << std::endl);
-				directions.erase(iter);
-				break;
-			}
+	case MEET_OTHER:
+		for (std::set<v3s16>::iterator it = event->modified_blocks.begin();
+				it != event->modified_blocks.end(); ++it) {
+			// Read again when needed
+			std::map<v3s16, Block *>::iterator b = m_blocks.find(*it);
+			if (b == m_blocks.end())
+				continue;
+			delete b->second;
+			m_blocks.erase(b);
+			m_last = NULL;
+			v3s16 p0 = *it * MAP_BLOCKSIZE;
+			invalidateSummaries(p0, p0 + v3s16(1, 1, 1) * (MAP_BLOCKSIZE - 1));
 		}
+		break;
+	default:
+		break;
 	}
-	else {
-		DEBUG_OUT("Pathfinder: didn't find any valid direction clearing"
-					<< std::endl);
-		directions.clear();
-	}
-	DEBUG_OUT("Pathfinder: remaining dirs at end:" << directions.size()
-				<< std::endl);
-	return retdir;
 }
 
 /******************************************************************************/
-bool Pathfinder::updateCostHeuristic(	v3s16 ipos,
-										v3s16 srcdir,
-										int current_cost,
-										int level)
+void NavigationCache::invalidateSummaries(v3s16 minp, v3s16 maxp)
 {
-
-	PathGridnode &g_pos = getIndexElement(ipos);
-	g_pos.totalcost = current_cost;
-	g_pos.sourcedir = srcdir;
-
-	level ++;
-
-	//check if target has been found
-	if (g_pos.target) {
-		m_min_target_distance = current_cost;
-		DEBUG_OUT(LVL " Pathfinder: target found!" << std::endl);
-		return true;
+	// A summary reads the nodes next to its block, up to maxjump nodes
+	// above and maxdrop + 1 nodes below
+	v3s16 bmin = getNodeBlockPos(minp - v3s16(1, m_maxjump, 1));
+	v3s16 bmax = getNodeBlockPos(maxp + v3s16(1, m_maxdrop + 1, 1));
+	for (s16 z = bmin.Z; z <= bmax.Z; z++)
+	for (s16 y = bmin.Y; y <= bmax.Y; y++)
+	for (s16 x = bmin.X; x <= bmax.X; x++) {
+		std::map<v3s16, Block *>::iterator it = m_blocks.find(v3s16(x, y, z));
+		if (it != m_blocks.end())
+			it->second->summaries.clear();
 	}
+}
 
-	bool retval = false;
-
-	std::vector<v3s16> directions;
-
-	directions.push_back(v3s16( 1, 0,  0));
-	directions.push_back(v3s16(-1, 0,  0));
-	directions.push_back(v3s16( 0, 0,  1));
-	directions.push_back(v3s16( 0, 0, -1));
-
-	v3s16 direction = getDirHeuristic(directions, g_pos);
-
-	while (direction != v3s16(0, 0, 0) && (!retval)) {
-
-		if (direction != srcdir) {
-			PathCost cost = g_pos.getCost(direction);
-
-			if (cost.valid) {
-				direction.Y = cost.direction;
-
-				v3s16 ipos2 = ipos + direction;
-
-				if (!isValidIndex(ipos2)) {
-					DEBUG_OUT(LVL " Pathfinder: " << PP(ipos2) <<
-						" out of range, max=" << PP(m_limits.MaxEdge) << std::endl);
-					direction = getDirHeuristic(directions, g_pos);
-					continue;
-				}
-
-				PathGridnode &g_pos2 = getIndexElement(ipos2);
-
-				if (!g_pos2.valid) {
-					VERBOSE_TARGET << LVL "Pathfinder: no data for new position: "
-												<< PP(ipos2) << std::endl;
-					direction = getDirHeuristic(directions, g_pos);
-					continue;
-				}
-
-				assert(cost.value > 0);
-
-				int new_cost = current_cost + cost.value;
-
-				// check if there already is a smaller path
-				if ((m_min_target_distance > 0) &&
-						(m_min_target_distance < new_cost)) {
-					DEBUG_OUT(LVL "Pathfinder:"
-							" already longer than best already found path "
-							<< PP(ipos2) << std::endl);
-					return false;
-				}
-
-				if ((g_pos2.totalcost < 0) ||
-						(g_pos2.totalcost > new_cost)) {
-					DEBUG_OUT(LVL "Pathfinder: updating path at: "<<
-							PP(ipos2) << " from: " << g_pos2.totalcost << " to "<<
-							new_cost << " srcdir=" <<
-							PP(invert(direction))<< std::endl);
-					if (updateCostHeuristic(ipos2, invert(direction),
-											new_cost, level)) {
-						retval = true;
-						}
-					}
-				else {
-					DEBUG_OUT(LVL "Pathfinder:"
-							" already found shorter path to: "
-							<< PP(ipos2) << std::endl);
-				}
-			}
-			else {
-				DEBUG_OUT(LVL "Pathfinder:"
-						" not moving to invalid direction: "
-						<< PP(direction) << std::endl);
-			}
-		}
-		else {
-			DEBUG_OUT(LVL "Pathfinder:"
-							" skipping srcdir: "
-							<< PP(direction) << std::endl);
+/******************************************************************************/
+NavigationCache::Block *NavigationCache::getBlock(v3s16 blockpos)
+{
+	if (m_last != NULL && blockpos == m_last_pos)
+		return m_last;
+
+	MapBlock *block = m_map->getBlockNoCreateNoEx(blockpos);
+	Block *b;
+	std::map<v3s16, Block *>::iterator it = m_blocks.find(blockpos);
+	if (it == m_blocks.end()) {
+		b = new Block();
+		b->checked = 0;
+		readBlock(b, block);
+		m_blocks[blockpos] = b;
+	} else {
+		b = it->second;
+		if (b->block != block ||
+				(block != NULL && b->generated != block->isGenerated())) {
+			// Loaded, unloaded or generated since it was read
+			readBlock(b, block);
+			v3s16 p0 = blockpos * MAP_BLOCKSIZE;
+			invalidateSummaries(p0, p0 + v3s16(1, 1, 1) * (MAP_BLOCKSIZE - 1));
 		}
-		direction = getDirHeuristic(directions, g_pos);
 	}
-	return retval;
+	m_last = b;
+	m_last_pos = blockpos;
+	return b;
 }
 
 /******************************************************************************/
-void Pathfinder::buildPath(std::vector<v3s16> &path, v3s16 pos, int level)
+void NavigationCache::readBlock(Block *b, MapBlock *block)
 {
-	level ++;
-	if (level > 700) {
-		ERROR_TARGET
-			<< LVL "Pathfinder: path is too long aborting" << std::endl;
-		return;
-	}
-
-	PathGridnode &g_pos = getIndexElement(pos);
-	if (!g_pos.valid) {
-		ERROR_TARGET
-			<< LVL "Pathfinder: invalid next pos detected aborting" << std::endl;
+	b->block = block;
+	b->walkable.reset();
+	if (block == NULL || block->isDummy()) {
+		b->generated = false;
+		b->ignore.set();
 		return;
 	}
+	b->generated = block->isGenerated();
+	b->ignore.reset();
 
-	g_pos.is_element = true;
-
-	//check if source reached
-	if (g_pos.source) {
-		path.push_back(pos);
-		return;
+	u32 i = 0;
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+	for (s16 y = 0; y < MAP_BLOCKSIZE; y++)
+	for (s16 x = 0; x < MAP_BLOCKSIZE; x++, i++) {
+		const MapNode &n = block->getNodeUnsafe(x, y, z);
+		if (n.getContent() == CONTENT_IGNORE)
+			b->ignore.set(i);
+		else if (m_ndef->get(n).walkable)
+			b->walkable.set(i);
 	}
-
-	buildPath(path, pos + g_pos.sourcedir, level);
-	path.push_back(pos);
 }
 
 /******************************************************************************/
-v3f Pathfinder::tov3f(v3s16 pos)
+NavNodeType NavigationCache::getNode(v3s16 pos)
 {
-	return v3f(BS * pos.X, BS * pos.Y, BS * pos.Z);
+	v3s16 blockpos = getNodeBlockPos(pos);
+	Block *b = getBlock(blockpos);
+	u32 i = node_index(pos, blockpos);
+	if (b->ignore[i])
+		return NAV_IGNORE;
+	return b->walkable[i] ? NAV_WALKABLE : NAV_OPEN;
 }
 
-#ifdef PATHFINDER_DEBUG
-
 /******************************************************************************/
-void Pathfinder::printCost()
+bool NavigationCache::isSurface(v3s16 pos)
 {
-	printCost(DIR_XP);
-	printCost(DIR_XM);
-	printCost(DIR_ZP);
-	printCost(DIR_ZM);
+	return getNode(pos) == NAV_OPEN &&
+		getNode(pos + v3s16(0, -1, 0)) == NAV_WALKABLE;
 }
 
 /******************************************************************************/
-void Pathfinder::printYdir()
+PathCost NavigationCache::getMove(v3s16 pos, v3s16 dir, int maxjump,
+		int maxdrop, const core::aabbox3d<s16> &limits)
 {
-	printYdir(DIR_XP);
-	printYdir(DIR_XM);
-	printYdir(DIR_ZP);
-	printYdir(DIR_ZM);
-}
+	PathCost retval;
+	v3s16 pos2 = pos + dir;
 
-/******************************************************************************/
-void Pathfinder::printCost(PathDirections dir)
-{
-	std::cout << "Cost in direction: " << dirToName(dir) << std::endl;
-	std::cout << std::setfill('-') << std::setw(80) << "-" << std::endl;
-	std::cout << std::setfill(' ');
-	for (int y = 0; y < m_max_index_y; y++) {
+	//check limits
+	if (!limits.isPointInside(pos2))
+		return retval;
 
-		std::cout << "Level: " << y << std::endl;
+	NavNodeType type = getNode(pos2);
+	if (type == NAV_IGNORE)
+		return retval;
 
-		std::cout << std::setw(4) << " " << "  ";
-		for (int x = 0; x < m_max_index_x; x++) {
-			std::cout << std::setw(4) << x;
-		}
-		std::cout << std::endl;
-
-		for (int z = 0; z < m_max_index_z; z++) {
-			std::cout << std::setw(4) << z <<": ";
-			for (int x = 0; x < m_max_index_x; x++) {
-				if (getIdxElem(x, y, z).directions[dir].valid)
-					std::cout << std::setw(4)
-						<< getIdxElem(x, y, z).directions[dir].value;
-				else
-					std::cout << std::setw(4) << "-";
-				}
-			std::cout << std::endl;
+	if (type == NAV_OPEN) {
+		// Drop down to the first walkable node, up to maxdrop nodes
+		v3s16 testpos = pos2 + v3s16(0, -1, 0);
+		type = getNode(testpos);
+		while (type == NAV_OPEN && testpos.Y > limits.MinEdge.Y &&
+				pos2.Y - testpos.Y <= maxdrop) {
+			testpos.Y--;
+			type = getNode(testpos);
 		}
-		std::cout << std::endl;
+		if (type != NAV_WALKABLE)
+			return retval;
+
+		int drop = pos2.Y - testpos.Y - 1;
+		retval.valid = true;
+		retval.value = drop == 0 ? 1 : 2;
+		retval.direction = -drop;
+		return retval;
 	}
+
+	// Climb up to the first open node, up to maxjump nodes
+	v3s16 testpos = pos2;
+	while (type == NAV_WALKABLE && testpos.Y < limits.MaxEdge.Y &&
+			testpos.Y - pos2.Y < maxjump) {
+		testpos.Y++;
+		type = getNode(testpos);
+	}
+	if (type != NAV_OPEN)
+		return retval;
+
+	retval.valid = true;
+	retval.value = 2;
+	retval.direction = testpos.Y - pos2.Y;
+	return retval;
 }
 
 /******************************************************************************/
-void Pathfinder::printYdir(PathDirections dir)
+const NavigationCache::Summary *NavigationCache::getSummary(v3s16 blockpos,
+		int maxjump, int maxdrop)
 {
-	std::cout << "Height difference in direction: " << dirToName(dir) << std::endl;
-	std::cout << std::setfill('-') << std::setw(80) << "-" << std::endl;
-	std::cout << std::setfill(' ');
-	for (int y = 0; y < m_max_index_y; y++) {
+	m_maxjump = MYMAX(m_maxjump, maxjump);
+	m_maxdrop = MYMAX(m_maxdrop, maxdrop);
 
-		std::cout << "Level: " << y << std::endl;
+	// Read the blocks the summary depends on once per search, a change
+	// of them drops the summary
+	Block *b = getBlock(blockpos);
+	if (b->checked != m_search) {
+		v3s16 p0 = blockpos * MAP_BLOCKSIZE;
+		v3s16 bmin = getNodeBlockPos(p0 - v3s16(1, maxdrop + 1, 1));
+		v3s16 bmax = getNodeBlockPos(p0 + v3s16(MAP_BLOCKSIZE,
+				MAP_BLOCKSIZE - 1 + maxjump, MAP_BLOCKSIZE));
+		for (s16 z = bmin.Z; z <= bmax.Z; z++)
+		for (s16 y = bmin.Y; y <= bmax.Y; y++)
+		for (s16 x = bmin.X; x <= bmax.X; x++)
+			getBlock(v3s16(x, y, z));
+		b->checked = m_search;
+	}
 
-		std::cout << std::setw(4) << " " << "  ";
-		for (int x = 0; x < m_max_index_x; x++) {
-			std::cout << std::setw(4) << x;
-		}
-		std::cout << std::endl;
-
-		for (int z = 0; z < m_max_index_z; z++) {
-			std::cout << std::setw(4) << z <<": ";
-			for (int x = 0; x < m_max_index_x; x++) {
-				if (getIdxElem(x, y, z).directions[dir].valid)
-					std::cout << std::setw(4)
-						<< getIdxElem(x, y, z).directions[dir].direction;
-				else
-					std::cout << std::setw(4) << "-";
-				}
-			std::cout << std::endl;
-		}
-		std::cout << std::endl;
+	for (size_t i = 0; i < b->summaries.size(); i++) {
+		Summary &summary = b->summaries[i];
+		if (summary.maxjump == maxjump && summary.maxdrop == maxdrop)
+			return &summary;
 	}
+
+	b->summaries.push_back(Summary());
+	Summary &summary = b->summaries.back();
+	summary.maxjump = maxjump;
+	summary.maxdrop = maxdrop;
+	makeSummary(blockpos, summary);
+	return &summary;
 }
 
 /******************************************************************************/
-void Pathfinder::printType()
+u16 NavigationCache::findRoot(u16 i)
 {
-	std::cout << "Type of node:" << std::endl;
-	std::cout << std::setfill('-') << std::setw(80) << "-" << std::endl;
-	std::cout << std::setfill(' ');
-	for (int y = 0; y < m_max_index_y; y++) {
-
-		std::cout << "Level: " << y << std::endl;
-
-		std::cout << std::setw(3) << " " << "  ";
-		for (int x = 0; x < m_max_index_x; x++) {
-			std::cout << std::setw(3) << x;
-		}
-		std::cout << std::endl;
-
-		for (int z = 0; z < m_max_index_z; z++) {
-			std::cout << std::setw(3) << z <<": ";
-			for (int x = 0; x < m_max_index_x; x++) {
-				char toshow = getIdxElem(x, y, z).type;
-				std::cout << std::setw(3) << toshow;
-			}
-			std::cout << std::endl;
-		}
-		std::cout << std::endl;
+	while (m_parents[i] != i) {
+		m_parents[i] = m_parents[m_parents[i]];
+		i = m_parents[i];
 	}
-	std::cout << std::endl;
+	return i;
 }
 
 /******************************************************************************/
-void Pathfinder::printPathLen()
+void NavigationCache::makeSummary(v3s16 blockpos, Summary &summary)
 {
-	std::cout << "Pathlen:" << std::endl;
-		std::cout << std::setfill('-') << std::setw(80) << "-" << std::endl;
-		std::cout << std::setfill(' ');
-		for (int y = 0; y < m_max_index_y; y++) {
+	const s16 limit = MAX_MAP_GENERATION_LIMIT + MAP_BLOCKSIZE;
+	const core::aabbox3d<s16> limits(-limit, -limit, -limit,
+			limit, limit, limit);
+	v3s16 p0 = blockpos * MAP_BLOCKSIZE;
 
-			std::cout << "Level: " << y << std::endl;
+	/*
+		Find the moves of the surface nodes. Moves inside the block that
+		can be made in both directions join regions, the others are portals.
+	*/
+	m_targets.assign(BLOCK_NODECOUNT * 4, -1);
+	m_parents.resize(BLOCK_NODECOUNT);
+	m_surface.clear();
+	u32 i = 0;
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+	for (s16 y = 0; y < MAP_BLOCKSIZE; y++)
+	for (s16 x = 0; x < MAP_BLOCKSIZE; x++, i++) {
+		v3s16 pos = p0 + v3s16(x, y, z);
+		if (!isSurface(pos))
+			continue;
+		m_parents[i] = i;
+		m_surface.push_back(i);
 
-			std::cout << std::setw(3) << " " << "  ";
-			for (int x = 0; x < m_max_index_x; x++) {
-				std::cout << std::setw(3) << x;
+		for (u32 d = 0; d < 4; d++) {
+			PathCost cost = getMove(pos, path_directions[d],
+					summary.maxjump, summary.maxdrop, limits);
+			if (!cost.valid)
+				continue;
+			v3s16 target = pos + path_directions[d];
+			target.Y += cost.direction;
+			if (getNodeBlockPos(target) == blockpos) {
+				m_targets[i * 4 + d] = node_index(target, blockpos);
+			} else {
+				Portal portal;
+				portal.region = i;
+				portal.target = target;
+				summary.portals.push_back(portal);
 			}
-			std::cout << std::endl;
-
-			for (int z = 0; z < m_max_index_z; z++) {
-				std::cout << std::setw(3) << z <<": ";
-				for (int x = 0; x < m_max_index_x; x++) {
-					std::cout << std::setw(3) << getIdxElem(x, y, z).totalcost;
-				}
-				std::cout << std::endl;
+		}
+	}
+
+	// Opposite directions differ in the lowest bit
+	for (size_t k = 0; k < m_surface.size(); k++) {
+		u16 a = m_surface[k];
+		for (u32 d = 0; d < 4; d++) {
+			s32 b = m_targets[a * 4 + d];
+			if (b < 0)
+				continue;
+			if (m_targets[b * 4 + (d ^ 1)] == a) {
+				m_parents[findRoot(a)] = findRoot(b);
+				continue;
 			}
-			std::cout << std::endl;
+			Portal portal;
+			portal.region = a;
+			portal.target = p0 + v3s16(b % MAP_BLOCKSIZE,
+					b / MAP_BLOCKSIZE % MAP_BLOCKSIZE,
+					b / (MAP_BLOCKSIZE * MAP_BLOCKSIZE));
+			summary.portals.push_back(portal);
 		}
-		std::cout << std::endl;
-}
+	}
 
-/******************************************************************************/
-std::string Pathfinder::dirToName(PathDirections dir)
-{
-	switch (dir) {
-	case DIR_XP:
-		return "XP";
-		break;
-	case DIR_XM:
-		return "XM";
-		break;
-	case DIR_ZP:
-		return "ZP";
-		break;
-	case DIR_ZM:
-		return "ZM";
-		break;
-	default:
-		return "UKN";
+	// Number the regions, the targets are not needed anymore
+	u16 regions = 0;
+	for (size_t k = 0; k < m_surface.size(); k++) {
+		u16 a = m_surface[k];
+		if (findRoot(a) == a)
+			m_targets[a * 4] = regions++;
+	}
+	summary.surface.resize(m_surface.size());
+	for (size_t k = 0; k < m_surface.size(); k++) {
+		u16 a = m_surface[k];
+		summary.surface[k].index = a;
+		summary.surface[k].region = m_targets[findRoot(a) * 4];
 	}
-}
 
-/******************************************************************************/
-void Pathfinder::printPath(std::vector<v3s16> path)
-{
-	unsigned int current = 0;
-	for (std::vector<v3s16>::iterator i = path.begin();
-			i != path.end(); ++i) {
-		std::cout << std::setw(3) << current << ":" << PP((*i)) << std::endl;
-		current++;
+	std::vector<Portal> &portals = summary.portals;
+	size_t count = 0;
+	for (size_t k = 0; k < portals.size(); k++) {
+		Portal &portal = portals[k];
+		portal.region = m_targets[findRoot(portal.region) * 4];
+		// One way moves may end in the same region
+		if (getNodeBlockPos(portal.target) == blockpos &&
+				summary.getRegion(portal.target) == portal.region)
+			continue;
+		portals[count++] = portal;
 	}
+	portals.resize(count);
+	std::sort(portals.begin(), portals.end());
+	portals.erase(std::unique(portals.begin(), portals.end()), portals.end());
 }
-
-#endif
@@ -23,33 +23,311 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 /******************************************************************************/
 /* Includes                                                                   */
 /******************************************************************************/
+#include <bitset>
+#include <map>
 #include <vector>
 #include "irr_v3d.h"
+#include "irr_aabb3d.h"
+#include "map.h"
 
 /******************************************************************************/
 /* Forward declarations                                                       */
 /******************************************************************************/
 
 class ServerEnvironment;
+class MapBlock;
+class INodeDefManager;
 
 /******************************************************************************/
 /* Typedefs and macros                                                        */
 /******************************************************************************/
 
-typedef enum {
-	DIR_XP,
-	DIR_XM,
-	DIR_ZP,
-	DIR_ZM
-} PathDirections;
-
 /** List of supported algorithms */
 typedef enum {
 	PA_DIJKSTRA,           /**< Dijkstra shortest path algorithm             */
 	PA_PLAIN,            /**< A* algorithm using heuristics to find a path */
-	PA_PLAIN_NP          /**< A* algorithm without prefetching of map data */
+	PA_PLAIN_NP,         /**< Same as PA_PLAIN, costs are evaluated lazily
+	                          by both                                      */
+	PA_HIERARCHICAL      /**< A* on the regions of the MapBlocks first, then
+	                          A* on the nodes of the blocks it passes      */
 } PathAlgorithm;
 
+/** what a mob finds at a position */
+typedef enum {
+	NAV_IGNORE,          /**< not loaded                                   */
+	NAV_OPEN,            /**< a mob can move through it                    */
+	NAV_WALKABLE         /**< a mob can stand on it                        */
+} NavNodeType;
+
+/******************************************************************************/
+/* Class definitions                                                          */
+/******************************************************************************/
+
+/** cost of moving in a specific direction */
+struct PathCost {
+	PathCost() : valid(false), value(0), direction(0) {}
+
+	bool valid;              /**< movement is possible         */
+	int  value;              /**< cost of movement             */
+	int  direction;          /**< y-direction of movement      */
+};
+
+/**
+ * Walkability of the nodes of MapBlocks and a summary of the surface of each
+ * block: which surface positions reach each other inside the block, and the
+ * moves leaving their region. Map edit events update the cache, blocks that
+ * are loaded, unloaded or generated are read again.
+ */
+class NavigationCache : public MapEventReceiver {
+public:
+	/** surface position of a block */
+	struct SurfaceNode {
+		u16 index;               /**< index of the node in the block        */
+		u16 region;              /**< positions of a region reach each other */
+	};
+
+	/** a move from a region to a position in another region */
+	struct Portal {
+		u16 region;              /**< region the move starts in             */
+		v3s16 target;            /**< real position the move ends at        */
+
+		bool operator<(const Portal &b) const
+		{
+			return region < b.region || (region == b.region && target < b.target);
+		}
+		bool operator==(const Portal &b) const
+		{
+			return region == b.region && target == b.target;
+		}
+	};
+
+	/** surface of a block for one pair of jump and drop heights */
+	struct Summary {
+		int maxjump;
+		int maxdrop;
+		std::vector<SurfaceNode> surface;  /**< sorted by index             */
+		std::vector<Portal> portals;       /**< sorted by region            */
+
+		/**
+		 * @param pos real position inside the block
+		 * @return region of the position, -1 if it isn't on the surface
+		 */
+		int getRegion(v3s16 pos) const;
+	};
+
+	NavigationCache();
+	~NavigationCache();
+
+	/**
+	 * prepare for a search, the map must not change until it is done
+	 * @param map map to look for path
+	 * @param ndef node definitions of the map
+	 */
+	void begin(Map *map, INodeDefManager *ndef);
+
+	/** @param pos real position */
+	NavNodeType getNode(v3s16 pos);
+
+	/**
+	 * check if a mob can stand at a position
+	 * @param pos real position
+	 */
+	bool isSurface(v3s16 pos);
+
+	/**
+	 * calculate cost of movement
+	 * @param pos real world position to start movement
+	 * @param dir direction to move to
+	 * @param limits positions the movement may end at
+	 * @return cost information
+	 */
+	PathCost getMove(v3s16 pos, v3s16 dir, int maxjump, int maxdrop,
+			const core::aabbox3d<s16> &limits);
+
+	/**
+	 * @param blockpos position of the block
+	 * @return summary, valid until the next call
+	 */
+	const Summary *getSummary(v3s16 blockpos, int maxjump, int maxdrop);
+
+	/** forget all blocks */
+	void clear();
+
+	void onMapEditEvent(MapEditEvent *event);
+
+private:
+	/** cached state of a block */
+	struct Block {
+		MapBlock *block;                      /**< block that was read       */
+		bool generated;
+		u32 checked;                          /**< search that last read the
+		                                           blocks of the summaries   */
+		std::bitset<MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE> walkable;
+		std::bitset<MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE> ignore;
+		std::vector<Summary> summaries;
+	};
+
+	/** find the block, reading it if it changed */
+	Block *getBlock(v3s16 blockpos);
+
+	/** read the nodes of a block */
+	void readBlock(Block *b, MapBlock *block);
+
+	/**
+	 * drop the summaries reading nodes of an area
+	 * @param minp, maxp real positions
+	 */
+	void invalidateSummaries(v3s16 minp, v3s16 maxp);
+
+	/** build the summary of a block */
+	void makeSummary(v3s16 blockpos, Summary &summary);
+
+	/** @return root of the union-find tree of a node index */
+	u16 findRoot(u16 i);
+
+	std::map<v3s16, Block *> m_blocks;
+	Map *m_map;
+	INodeDefManager *m_ndef;
+	Block *m_last;                /**< last block found by getBlock          */
+	v3s16 m_last_pos;
+	int m_maxjump;                /**< highest maxjump of the summaries      */
+	int m_maxdrop;                /**< highest maxdrop of the summaries      */
+	u32 m_search;                 /**< number of the current search          */
+
+	/* buffers of makeSummary */
+	std::vector<s32> m_targets;   /**< node index reached by each move       */
+	std::vector<u16> m_parents;   /**< union-find trees of the node indices  */
+	std::vector<u16> m_surface;   /**< surface node indices                  */
+};
+
+/**
+ * A* search on the surface nodes of the map. Nodes and the open set are
+ * kept in pools that are reused by the following searches.
+ */
+class Pathfinder {
+public:
+	/**
+	 * @param cache walkability of the map, the pathfinder reads the map
+	 * again for every search if it is NULL
+	 */
+	Pathfinder(NavigationCache *cache = NULL);
+
+	/**
+	 * path evaluation function
+	 * @param map map to look for path
+	 * @param ndef node definitions of the map
+	 * @param source origin of path
+	 * @param destination end position of path
+	 * @param searchdistance maximum number of nodes to look in each direction
+	 * @param max_jump maximum number of blocks a path may jump up
+	 * @param max_drop maximum number of blocks a path may drop
+	 * @param algo Algorithm to use for finding a path
+	 * @return positions from source to destination, empty if there is none
+	 */
+	std::vector<v3s16> getPath(Map *map,
+			INodeDefManager *ndef,
+			v3s16 source,
+			v3s16 destination,
+			unsigned int searchdistance,
+			unsigned int max_jump,
+			unsigned int max_drop,
+			PathAlgorithm algo);
+
+private:
+	/** a surface position reached by the search */
+	struct Node {
+		v3s16 pos;               /**< real position of node                 */
+		int   cost;              /**< cost to move here from starting point */
+		u32   parent;            /**< index of the previous node on the path */
+		u32   slot;              /**< index in m_slots                      */
+		bool  closed;            /**< cost can't get lower anymore          */
+	};
+
+	/** entry of the open set, a binary heap */
+	struct OpenEntry {
+		int estimate;            /**< cost plus estimated remaining cost    */
+		int cost;                /**< cost when the entry was added         */
+		u32 node;                /**< index in m_nodes                      */
+
+		// Lowest estimate on top, ties go to the node closest to the target
+		bool operator<(const OpenEntry &b) const
+		{
+			return estimate > b.estimate ||
+				(estimate == b.estimate && cost < b.cost);
+		}
+	};
+
+	/** a region of a block reached by the search */
+	struct Region {
+		v3s16 blockpos;          /**< position of the block                 */
+		u16   region;            /**< region in the block summary           */
+		int   cost;              /**< number of blocks from the start       */
+		u32   parent;            /**< index of the previous region          */
+		bool  closed;            /**< cost can't get lower anymore          */
+	};
+
+	/**
+	 * A* search on the nodes
+	 * @return index of the destination in m_nodes, PATH_NO_PARENT if it
+	 * wasn't reached
+	 */
+	u32 searchNodes(v3s16 source);
+
+	/**
+	 * A* search on the regions of the blocks, sets m_corridor to the
+	 * blocks of the path and the ones next to them
+	 * @return false if there is no path
+	 */
+	bool searchRegions(v3s16 source);
+
+	/** @return index in m_regions */
+	u32 getRegionIndex(v3s16 blockpos, u16 region);
+
+	/** check if a node search may enter a position */
+	bool isInCorridor(v3s16 pos);
+
+	/**
+	 * find or add the node at a position
+	 * @return index in m_nodes
+	 */
+	u32 getNodeIndex(v3s16 pos);
+
+	/** clear the pools, keeping their memory */
+	void reset();
+
+	/** double the size of the node hash table */
+	void growSlots();
+
+	/**
+	 * estimate the remaining cost to the destination
+	 * @param pos position to calc distance
+	 */
+	int estimateCost(v3s16 pos);
+
+	/* variables */
+	int m_maxdrop;                /**< maximum number of blocks a path may drop */
+	int m_maxjump;                /**< maximum number of blocks a path may jump */
+	bool m_heuristic;             /**< A* instead of Dijkstra                   */
+
+	v3s16 m_destination;          /**< destination position                     */
+
+	core::aabbox3d<s16> m_limits; /**< position limits in real map coordinates  */
+
+	std::vector<Node> m_nodes;        /**< nodes reached by the search      */
+	std::vector<u32> m_slots;         /**< hash table, node index + 1       */
+	std::vector<OpenEntry> m_open;    /**< open set                         */
+
+	std::vector<Region> m_regions;    /**< regions reached by the search    */
+	std::map<u64, u32> m_region_index; /**< index in m_regions by position  */
+	std::vector<v3s16> m_targets;     /**< portal targets of a region       */
+	std::vector<v3s16> m_corridor;    /**< sorted blocks a node search may
+	                                       enter, empty if not limited       */
+	v3s16 m_corridor_block;           /**< last block found in m_corridor   */
+
+	NavigationCache *m_cache;
+	NavigationCache m_local_cache;    /**< used if no cache is passed       */
+};
+
 /******************************************************************************/
 /* declarations                                                               */
 /******************************************************************************/
@@ -28,6 +28,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "porting.h"
 #include "util/string.h"
 #include "server.h"
+#include "profiler.h"
 #ifndef SERVER
 #include "client.h"
 #endif
@@ -272,6 +273,12 @@ void ScriptApiBase::setOriginFromTableRaw(int index, const char *fxn)
 #endif
 }
 
+void ScriptApiBase::reportCallbackCosts(Profiler *profiler)
+{
+	RecursiveMutexAutoLock lock(m_luastackmutex);
+	m_callback_costs.report(profiler);
+}
+
 void ScriptApiBase::addObjectReference(ServerActiveObject *cobj)
 {
 	SCRIPTAPI_PRECHECKHEADER
@@ -342,3 +349,108 @@ Client* ScriptApiBase::getClient()
 	return dynamic_cast<Client *>(m_gamedef);
 }
 #endif
+
+/*
+	ScriptCallbackCosts
+*/
+
+Atomic<u32> ScriptCallbackSite::s_next_index(0);
+
+u32 ScriptCallbackCosts::getSlot(const std::string &mod, const char *callback)
+{
+	std::map<std::string, ModCosts>::iterator mod_it = m_mods.find(mod);
+	if (mod_it == m_mods.end()) {
+		mod_it = m_mods.insert(std::make_pair(mod, ModCosts())).first;
+		mod_it->second.profiler_name = "Lua: " + mod + " avg ms";
+		mod_it->second.unreported_us = 0;
+	}
+
+	ModCosts &costs = mod_it->second;
+	std::map<const char *, u32, CStringLess>::const_iterator it =
+		costs.slots.find(callback);
+	if (it != costs.slots.end())
+		return it->second;
+
+	Entry entry;
+	entry.mod = mod;
+	entry.callback = callback;
+	entry.calls = 0;
+	entry.total_us = 0;
+	entry.max_us = 0;
+	m_entries.push_back(entry);
+	m_entry_mods.push_back(&costs);
+
+	u32 slot = m_entries.size() - 1;
+	costs.slots[m_entries.back().callback.c_str()] = slot;
+	return slot;
+}
+
+u32 ScriptCallbackCosts::getSlot(const ScriptCallbackSite &site,
+	const std::string &mod)
+{
+	if (site.index >= m_site_slots.size())
+		m_site_slots.resize(site.index + 1);
+
+	std::vector<std::pair<std::string, u32> > &slots =
+		m_site_slots[site.index];
+	for (size_t i = 0; i < slots.size(); i++) {
+		if (slots[i].first == mod)
+			return slots[i].second;
+	}
+
+	u32 slot = getSlot(mod, site.callback);
+	slots.push_back(std::make_pair(mod, slot));
+	return slot;
+}
+
+void ScriptCallbackCosts::add(u32 slot, u64 start_us, u64 end_us,
+	u64 accounted_us)
+{
+	if (slot >= m_entries.size())
+		return;
+
+	// Everything accounted since the start ran nested in this callback
+	u64 nested_us = m_accounted_us - accounted_us;
+	u64 duration_us = end_us > start_us ? end_us - start_us : 0;
+	duration_us = duration_us > nested_us ? duration_us - nested_us : 0;
+	m_accounted_us += duration_us;
+
+	Entry &entry = m_entries[slot];
+	entry.calls++;
+	entry.total_us += duration_us;
+	entry.max_us = MYMAX(entry.max_us, MYMIN(duration_us, (u64)U32_MAX));
+	m_entry_mods[slot]->unreported_us += duration_us;
+}
+
+void ScriptCallbackCosts::report(Profiler *profiler)
+{
+	for (std::map<std::string, ModCosts>::iterator it = m_mods.begin();
+			it != m_mods.end(); ++it) {
+		profiler->avg(it->second.profiler_name,
+			it->second.unreported_us / 1000.0f);
+		it->second.unreported_us = 0;
+	}
+}
+
+void ScriptCallbackCosts::clear()
+{
+	// Slots stay valid, Lua keeps them around
+	for (size_t i = 0; i < m_entries.size(); i++) {
+		m_entries[i].calls = 0;
+		m_entries[i].total_us = 0;
+		m_entries[i].max_us = 0;
+	}
+}
+
+ScriptCallbackScope::ScriptCallbackScope(ScriptCallbackCosts *costs, u32 slot) :
+	m_costs(costs),
+	m_slot(slot),
+	m_start(porting::getTimeUs()),
+	m_accounted(costs->getAccountedTime())
+{
+}
+
+ScriptCallbackScope::~ScriptCallbackScope()
+{
+	m_costs->add(m_slot, m_start, porting::getTimeUs(), m_accounted);
+}
@@ -22,6 +22,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <iostream>
 #include <string>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <vector>
 
 extern "C" {
 #include <lua.h>
@@ -31,6 +35,7 @@ extern "C" {
 #include "threads.h"
 #include "threading/mutex.h"
 #include "threading/mutex_auto_lock.h"
+#include "threading/atomic.h"
 #include "common/c_types.h"
 #include "common/c_internal.h"
 
@@ -62,6 +67,105 @@ class IGameDef;
 class Environment;
 class GUIEngine;
 class ServerActiveObject;
+class Profiler;
+
+// A place in the engine that calls a Lua callback, see SCRIPT_CALLBACK_COST
+class ScriptCallbackSite
+{
+public:
+	ScriptCallbackSite(const char *a_callback) :
+		callback(a_callback),
+		index(s_next_index++)
+	{}
+
+	const char *const callback;
+	const u32 index;
+
+private:
+	static Atomic<u32> s_next_index;
+};
+
+/*
+	Wall time and call counts of Lua callbacks, attributed to the mod that
+	registered them. Only used with the script lock held.
+
+	Times are exclusive: a callback that runs while another one is measured
+	(e.g. register_on_dignode callbacks during on_dig) is only counted for
+	itself.
+*/
+class ScriptCallbackCosts
+{
+public:
+	ScriptCallbackCosts() : m_accounted_us(0) {}
+
+	struct Entry
+	{
+		std::string mod;
+		std::string callback;
+		u32 calls;
+		u64 total_us;
+		u32 max_us;
+	};
+
+	u32 getSlot(const std::string &mod, const char *callback);
+	// Same as getSlot(), but remembers the slots of each site
+	u32 getSlot(const ScriptCallbackSite &site, const std::string &mod);
+
+	// Time accounted to all callbacks so far. Read when a callback starts
+	// and passed to add() to leave out the callbacks nested in it.
+	u64 getAccountedTime() const { return m_accounted_us; }
+	void add(u32 slot, u64 start_us, u64 end_us, u64 accounted_us);
+	// Adds the time spent per mod since the last report to the profiler
+	void report(Profiler *profiler);
+	void clear();
+
+	const std::deque<Entry> &getEntries() const { return m_entries; }
+
+private:
+	struct CStringLess
+	{
+		bool operator()(const char *a, const char *b) const
+		{
+			return strcmp(a, b) < 0;
+		}
+	};
+
+	struct ModCosts
+	{
+		std::string profiler_name;
+		u64 unreported_us;
+		// Keys point to the callback names in m_entries
+		std::map<const char *, u32, CStringLess> slots;
+	};
+
+	// A deque keeps the keys of ModCosts::slots valid when growing
+	std::deque<Entry> m_entries;
+	std::vector<ModCosts *> m_entry_mods;
+	std::map<std::string, ModCosts> m_mods;
+	// Slots per mod of each site, by ScriptCallbackSite::index. Sites
+	// only see a few mods, so these are searched linearly.
+	std::vector<std::vector<std::pair<std::string, u32> > > m_site_slots;
+	u64 m_accounted_us;
+};
+
+class ScriptCallbackScope
+{
+public:
+	ScriptCallbackScope(ScriptCallbackCosts *costs, u32 slot);
+	~ScriptCallbackScope();
+
+private:
+	ScriptCallbackCosts *m_costs;
+	u32 m_slot;
+	u64 m_start;
+	u64 m_accounted;
+};
+
+// Accounts the rest of the scope to the current origin mod
+#define SCRIPT_CALLBACK_COST(callback) \
+	static const ScriptCallbackSite callback_site_(callback); \
+	ScriptCallbackScope callback_cost_(&m_callback_costs, \
+		m_callback_costs.getSlot(callback_site_, m_last_run_mod))
 
 class ScriptApiBase {
 public:
@@ -89,6 +193,9 @@ class ScriptApiBase {
 	void setOriginDirect(const char *origin);
 	void setOriginFromTableRaw(int index, const char *fxn);
 
+	ScriptCallbackCosts &getCallbackCosts() { return m_callback_costs; }
+	void reportCallbackCosts(Profiler *profiler);
+
 protected:
 	friend class LuaABM;
 	friend class LuaLBM;
@@ -119,6 +226,7 @@ class ScriptApiBase {
 	RecursiveMutex  m_luastackmutex;
 	std::string     m_last_run_mod;
 	bool            m_secure;
+	ScriptCallbackCosts m_callback_costs;
 #ifdef SCRIPTAPI_LOCK_DEBUG
 	int             m_lock_recursion_count;
 	threadid_t      m_owning_thread;
@@ -24,6 +24,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "common/c_converter.h"
 #include "common/c_content.h"
 #include "server.h"
+#include "tracer.h"
 
 bool ScriptApiEntity::luaentity_Add(u16 id, const char *name)
 {
@@ -96,6 +97,7 @@ void ScriptApiEntity::luaentity_Activate(u16 id,
 		lua_pushinteger(L, dtime_s);
 
 		setOriginFromTable(object);
+		SCRIPT_CALLBACK_COST("entity on_activate");
 		PCALL_RES(lua_pcall(L, 3, 0, error_handler));
 	} else {
 		lua_pop(L, 1);
@@ -145,6 +147,7 @@ std::string ScriptApiEntity::luaentity_GetStaticdata(u16 id)
 	lua_pushvalue(L, object); // self
 
 	setOriginFromTable(object);
+	SCRIPT_CALLBACK_COST("entity get_staticdata");
 	PCALL_RES(lua_pcall(L, 1, 1, error_handler));
 
 	lua_remove(L, object);
@@ -199,6 +202,7 @@ void ScriptApiEntity::luaentity_GetProperties(u16 id,
 void ScriptApiEntity::luaentity_Step(u16 id, float dtime)
 {
 	SCRIPTAPI_PRECHECKHEADER
+	TraceScope trace("Lua: entity on_step");
 
 	//infostream<<"scriptapi_luaentity_step: id="<<id<<std::endl;
 
@@ -219,6 +223,7 @@ void ScriptApiEntity::luaentity_Step(u16 id, float dtime)
 	lua_pushnumber(L, dtime); // dtime
 
 	setOriginFromTable(object);
+	SCRIPT_CALLBACK_COST("entity on_step");
 	PCALL_RES(lua_pcall(L, 2, 0, error_handler));
 
 	lua_pop(L, 2); // Pop object and error handler
@@ -255,6 +260,7 @@ bool ScriptApiEntity::luaentity_Punch(u16 id,
 	lua_pushnumber(L, damage);
 
 	setOriginFromTable(object);
+	SCRIPT_CALLBACK_COST("entity on_punch");
 	PCALL_RES(lua_pcall(L, 6, 1, error_handler));
 
 	bool retval = lua_toboolean(L, -1);
@@ -287,6 +293,7 @@ void ScriptApiEntity::luaentity_Rightclick(u16 id,
 	objectrefGetOrCreate(L, clicker); // Clicker reference
 
 	setOriginFromTable(object);
+	SCRIPT_CALLBACK_COST("entity on_rightclick");
 	PCALL_RES(lua_pcall(L, 2, 0, error_handler));
 
 	lua_pop(L, 2); // Pop object and error handler
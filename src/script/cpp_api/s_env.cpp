@@ -25,6 +25,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "mapgen.h"
 #include "lua_api/l_env.h"
 #include "server.h"
+#include "tracer.h"
 
 void ScriptApiEnv::environment_OnGenerated(v3s16 minp, v3s16 maxp,
 	u32 blockseed)
@@ -45,6 +46,7 @@ void ScriptApiEnv::environment_Step(float dtime)
 {
 	SCRIPTAPI_PRECHECKHEADER
 	//infostream << "scriptapi_environment_step" << std::endl;
+	TraceScope trace("Lua: globalsteps");
 
 	// Get core.registered_globalsteps
 	lua_getglobal(L, "core");
@@ -151,8 +153,13 @@ void ScriptApiEnv::initializeEnvironment(ServerEnvironment *env)
 		bool simple_catch_up = true;
 		getboolfield(L, current_abm, "catch_up", simple_catch_up);
 
+		std::string label = getstringfield_default(L, current_abm,
+			"label", "action");
+		u32 cost_slot = m_callback_costs.getSlot(getstringfield_default(L,
+			current_abm, "mod_origin", "??"), ("ABM " + label).c_str());
+
 		LuaABM *abm = new LuaABM(L, id, trigger_contents, required_neighbors,
-			trigger_interval, trigger_chance, simple_catch_up);
+			trigger_interval, trigger_chance, simple_catch_up, cost_slot);
 
 		env->addActiveBlockModifier(abm);
 
@@ -200,8 +207,11 @@ void ScriptApiEnv::initializeEnvironment(ServerEnvironment *env)
 		bool run_at_every_load = getboolfield_default(L, current_lbm,
 			"run_at_every_load", false);
 
+		u32 cost_slot = m_callback_costs.getSlot(getstringfield_default(L,
+			current_lbm, "mod_origin", "??"), ("LBM " + name).c_str());
+
 		LuaLBM *lbm = new LuaLBM(L, id, trigger_contents, name,
-			run_at_every_load);
+			run_at_every_load, cost_slot);
 
 		env->addLoadingBlockModifierDef(lbm);
 
@@ -253,3 +263,35 @@ void ScriptApiEnv::on_emerge_area_completion(
 		luaL_unref(L, LUA_REGISTRYINDEX, state->args_ref);
 	}
 }
+
+void ScriptApiEnv::on_place_schematic_completion(
+	bool placed, ScriptCallbackState *state)
+{
+	Server *server = getServer();
+
+	// Like on_emerge_area_completion, envlock must be held by the caller
+	SCRIPTAPI_PRECHECKHEADER
+
+	int error_handler = PUSH_ERROR_HANDLER(L);
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, state->callback_ref);
+	luaL_checktype(L, -1, LUA_TFUNCTION);
+
+	lua_pushboolean(L, placed);
+	lua_rawgeti(L, LUA_REGISTRYINDEX, state->args_ref);
+
+	setOriginDirect(state->origin.c_str());
+
+	try {
+		PCALL_RES(lua_pcall(L, 2, 0, error_handler));
+	} catch (LuaError &e) {
+		server->setAsyncFatalError(
+				std::string("on_place_schematic_completion: ") + e.what() + "\n"
+				+ script_get_backtrace(L));
+	}
+
+	lua_pop(L, 1); // Pop error handler
+
+	luaL_unref(L, LUA_REGISTRYINDEX, state->callback_ref);
+	luaL_unref(L, LUA_REGISTRYINDEX, state->args_ref);
+}
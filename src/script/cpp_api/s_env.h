@@ -42,6 +42,10 @@ class ScriptApiEnv : virtual public ScriptApiBase
 	void on_emerge_area_completion(v3s16 blockpos, int action,
 		ScriptCallbackState *state);
 
+	// Called after a schematic from core.place_schematic_async() is placed
+	void on_place_schematic_completion(bool placed,
+		ScriptCallbackState *state);
+
 	void initializeEnvironment(ServerEnvironment *env);
 };
 
@@ -39,6 +39,7 @@ bool ScriptApiItem::item_OnDrop(ItemStack &item,
 	// Push callback function on stack
 	if (!getItemCallback(item.name.c_str(), "on_drop"))
 		return false;
+	SCRIPT_CALLBACK_COST("item on_drop");
 
 	// Call function
 	LuaItemStack::create(L, item);
@@ -66,6 +67,7 @@ bool ScriptApiItem::item_OnPlace(ItemStack &item,
 	// Push callback function on stack
 	if (!getItemCallback(item.name.c_str(), "on_place"))
 		return false;
+	SCRIPT_CALLBACK_COST("item on_place");
 
 	// Call function
 	LuaItemStack::create(L, item);
@@ -101,6 +103,7 @@ bool ScriptApiItem::item_OnUse(ItemStack &item,
 	// Push callback function on stack
 	if (!getItemCallback(item.name.c_str(), "on_use"))
 		return false;
+	SCRIPT_CALLBACK_COST("item on_use");
 
 	// Call function
 	LuaItemStack::create(L, item);
@@ -126,6 +129,7 @@ bool ScriptApiItem::item_OnSecondaryUse(ItemStack &item, ServerActiveObject *use
 	
 	if (!getItemCallback(item.name.c_str(), "on_secondary_use"))
 		return false;
+	SCRIPT_CALLBACK_COST("item on_secondary_use");
 	
 	LuaItemStack::create(L, item);
 	objectrefGetOrCreate(L, user);
@@ -24,6 +24,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "nodedef.h"
 #include "server.h"
 #include "environment.h"
+#include "tracer.h"
 #include "util/pointedthing.h"
 
 
@@ -110,6 +111,7 @@ bool ScriptApiNode::node_on_punch(v3s16 p, MapNode node,
 	// Push callback function on stack
 	if (!getItemCallback(ndef->get(node).name.c_str(), "on_punch", &p))
 		return false;
+	SCRIPT_CALLBACK_COST("node on_punch");
 
 	// Call function
 	push_v3s16(L, p);
@@ -133,6 +135,7 @@ bool ScriptApiNode::node_on_dig(v3s16 p, MapNode node,
 	// Push callback function on stack
 	if (!getItemCallback(ndef->get(node).name.c_str(), "on_dig", &p))
 		return false;
+	SCRIPT_CALLBACK_COST("node on_dig");
 
 	// Call function
 	push_v3s16(L, p);
@@ -154,6 +157,7 @@ void ScriptApiNode::node_on_construct(v3s16 p, MapNode node)
 	// Push callback function on stack
 	if (!getItemCallback(ndef->get(node).name.c_str(), "on_construct", &p))
 		return;
+	SCRIPT_CALLBACK_COST("node on_construct");
 
 	// Call function
 	push_v3s16(L, p);
@@ -172,6 +176,7 @@ void ScriptApiNode::node_on_destruct(v3s16 p, MapNode node)
 	// Push callback function on stack
 	if (!getItemCallback(ndef->get(node).name.c_str(), "on_destruct", &p))
 		return;
+	SCRIPT_CALLBACK_COST("node on_destruct");
 
 	// Call function
 	push_v3s16(L, p);
@@ -190,6 +195,7 @@ bool ScriptApiNode::node_on_flood(v3s16 p, MapNode node, MapNode newnode)
 	// Push callback function on stack
 	if (!getItemCallback(ndef->get(node).name.c_str(), "on_flood", &p))
 		return false;
+	SCRIPT_CALLBACK_COST("node on_flood");
 
 	// Call function
 	push_v3s16(L, p);
@@ -211,6 +217,7 @@ void ScriptApiNode::node_after_destruct(v3s16 p, MapNode node)
 	// Push callback function on stack
 	if (!getItemCallback(ndef->get(node).name.c_str(), "after_destruct", &p))
 		return;
+	SCRIPT_CALLBACK_COST("node after_destruct");
 
 	// Call function
 	push_v3s16(L, p);
@@ -222,6 +229,7 @@ void ScriptApiNode::node_after_destruct(v3s16 p, MapNode node)
 bool ScriptApiNode::node_on_timer(v3s16 p, MapNode node, f32 dtime)
 {
 	SCRIPTAPI_PRECHECKHEADER
+	TraceScope trace("Lua: node on_timer");
 
 	int error_handler = PUSH_ERROR_HANDLER(L);
 
@@ -230,6 +238,7 @@ bool ScriptApiNode::node_on_timer(v3s16 p, MapNode node, f32 dtime)
 	// Push callback function on stack
 	if (!getItemCallback(ndef->get(node).name.c_str(), "on_timer", &p))
 		return false;
+	SCRIPT_CALLBACK_COST("node on_timer");
 
 	// Call function
 	push_v3s16(L, p);
@@ -258,6 +267,7 @@ void ScriptApiNode::node_on_receive_fields(v3s16 p,
 	// Push callback function on stack
 	if (!getItemCallback(ndef->get(node).name.c_str(), "on_receive_fields", &p))
 		return;
+	SCRIPT_CALLBACK_COST("node on_receive_fields");
 
 	// Call function
 	push_v3s16(L, p);                    // pos
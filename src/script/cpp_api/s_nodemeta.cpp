@@ -47,6 +47,7 @@ int ScriptApiNodemeta::nodemeta_inventory_AllowMove(v3s16 p,
 	std::string nodename = ndef->get(node).name;
 	if (!getItemCallback(nodename.c_str(), "allow_metadata_inventory_move", &p))
 		return count;
+	SCRIPT_CALLBACK_COST("node allow_metadata_inventory_move");
 
 	// function(pos, from_list, from_index, to_list, to_index, count, player)
 	push_v3s16(L, p);                     // pos
@@ -85,6 +86,7 @@ int ScriptApiNodemeta::nodemeta_inventory_AllowPut(v3s16 p,
 	std::string nodename = ndef->get(node).name;
 	if (!getItemCallback(nodename.c_str(), "allow_metadata_inventory_put", &p))
 		return stack.count;
+	SCRIPT_CALLBACK_COST("node allow_metadata_inventory_put");
 
 	// Call function(pos, listname, index, stack, player)
 	push_v3s16(L, p);                    // pos
@@ -121,6 +123,7 @@ int ScriptApiNodemeta::nodemeta_inventory_AllowTake(v3s16 p,
 	std::string nodename = ndef->get(node).name;
 	if (!getItemCallback(nodename.c_str(), "allow_metadata_inventory_take", &p))
 		return stack.count;
+	SCRIPT_CALLBACK_COST("node allow_metadata_inventory_take");
 
 	// Call function(pos, listname, index, count, player)
 	push_v3s16(L, p);                    // pos
@@ -158,6 +161,7 @@ void ScriptApiNodemeta::nodemeta_inventory_OnMove(v3s16 p,
 	std::string nodename = ndef->get(node).name;
 	if (!getItemCallback(nodename.c_str(), "on_metadata_inventory_move", &p))
 		return;
+	SCRIPT_CALLBACK_COST("node on_metadata_inventory_move");
 
 	// function(pos, from_list, from_index, to_list, to_index, count, player)
 	push_v3s16(L, p);                     // pos
@@ -191,6 +195,7 @@ void ScriptApiNodemeta::nodemeta_inventory_OnPut(v3s16 p,
 	std::string nodename = ndef->get(node).name;
 	if (!getItemCallback(nodename.c_str(), "on_metadata_inventory_put", &p))
 		return;
+	SCRIPT_CALLBACK_COST("node on_metadata_inventory_put");
 
 	// Call function(pos, listname, index, stack, player)
 	push_v3s16(L, p);                    // pos
@@ -222,6 +227,7 @@ void ScriptApiNodemeta::nodemeta_inventory_OnTake(v3s16 p,
 	std::string nodename = ndef->get(node).name;
 	if (!getItemCallback(nodename.c_str(), "on_metadata_inventory_take", &p))
 		return;
+	SCRIPT_CALLBACK_COST("node on_metadata_inventory_take");
 
 	// Call function(pos, listname, index, stack, player)
 	push_v3s16(L, p);                    // pos
@@ -312,7 +312,9 @@ LuaAreaStore::LuaAreaStore(const std::string &type)
 		this->as = new SpatialAreaStore();
 	} else
 #endif
-	{
+	if (type == "RTree") {
+		this->as = new RTreeAreaStore();
+	} else {
 		this->as = new VectorAreaStore();
 	}
 }
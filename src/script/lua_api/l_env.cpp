@@ -36,6 +36,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "emerge.h"
 #include "pathfinder.h"
 #include "face_position_cache.h"
+#include "tracer.h"
 
 struct EnumString ModApiEnvMod::es_ClearObjectsMode[] =
 {
@@ -50,6 +51,7 @@ struct EnumString ModApiEnvMod::es_ClearObjectsMode[] =
 void LuaABM::trigger(ServerEnvironment *env, v3s16 p, MapNode n,
 		u32 active_object_count, u32 active_object_count_wider)
 {
+	TraceScope trace("Lua: ABM action");
 	ServerScripting *scriptIface = env->getScriptIface();
 	scriptIface->realityCheck();
 
@@ -84,6 +86,7 @@ void LuaABM::trigger(ServerEnvironment *env, v3s16 p, MapNode n,
 	lua_pushnumber(L, active_object_count);
 	lua_pushnumber(L, active_object_count_wider);
 
+	ScriptCallbackScope cost(&scriptIface->m_callback_costs, m_cost_slot);
 	int result = lua_pcall(L, 4, 0, error_handler);
 	if (result)
 		scriptIface->scriptError(result, "LuaABM::trigger");
@@ -91,8 +94,10 @@ void LuaABM::trigger(ServerEnvironment *env, v3s16 p, MapNode n,
 	lua_pop(L, 1); // Pop error handler
 }
 
-void LuaLBM::trigger(ServerEnvironment *env, v3s16 p, MapNode n)
+void LuaLBM::triggerBlock(ServerEnvironment *env, MapBlock *block,
+	const std::vector<v3s16> &positions, const std::vector<MapNode> &nodes)
 {
+	TraceScope trace("Lua: LBM action");
 	ServerScripting *scriptIface = env->getScriptIface();
 	scriptIface->realityCheck();
 
@@ -121,14 +126,26 @@ void LuaLBM::trigger(ServerEnvironment *env, v3s16 p, MapNode n)
 	lua_getfield(L, -1, "action");
 	luaL_checktype(L, -1, LUA_TFUNCTION);
 	lua_remove(L, -2); // Remove registered_lbms[m_id]
-	push_v3s16(L, p);
-	pushnode(L, n, env->getGameDef()->ndef());
+	int action = lua_gettop(L);
 
-	int result = lua_pcall(L, 2, 0, error_handler);
-	if (result)
-		scriptIface->scriptError(result, "LuaLBM::trigger");
+	// The action is looked up once and called for every node of the block
+	INodeDefManager *ndef = env->getGameDef()->ndef();
+	for (size_t i = 0; i < positions.size(); i++) {
+		MapNode n = nodes[i];
+		if (!refreshNode(block, positions[i], n))
+			continue;
 
-	lua_pop(L, 1); // Pop error handler
+		lua_pushvalue(L, action);
+		push_v3s16(L, positions[i]);
+		pushnode(L, n, ndef);
+
+		ScriptCallbackScope cost(&scriptIface->m_callback_costs, m_cost_slot);
+		int result = lua_pcall(L, 2, 0, error_handler);
+		if (result)
+			scriptIface->scriptError(result, "LuaLBM::trigger");
+	}
+
+	lua_pop(L, 2); // Pop action and error handler
 }
 
 void LuaEmergeAreaCallback(v3s16 blockpos, EmergeAction action, void *param)
@@ -995,6 +1012,9 @@ int ModApiEnvMod::l_find_path(lua_State *L)
 
 		if (algorithm == "Dijkstra")
 			algo = PA_DIJKSTRA;
+
+		if (algorithm == "hierarchical")
+			algo = PA_HIERARCHICAL;
 	}
 
 	std::vector<v3s16> path = get_path(env, pos1, pos2,
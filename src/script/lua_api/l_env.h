@@ -190,17 +190,20 @@ class LuaABM : public ActiveBlockModifier {
 	float m_trigger_interval;
 	u32 m_trigger_chance;
 	bool m_simple_catch_up;
+	u32 m_cost_slot;
 public:
 	LuaABM(lua_State *L, int id,
 			const std::set<std::string> &trigger_contents,
 			const std::set<std::string> &required_neighbors,
-			float trigger_interval, u32 trigger_chance, bool simple_catch_up):
+			float trigger_interval, u32 trigger_chance, bool simple_catch_up,
+			u32 cost_slot):
 		m_id(id),
 		m_trigger_contents(trigger_contents),
 		m_required_neighbors(required_neighbors),
 		m_trigger_interval(trigger_interval),
 		m_trigger_chance(trigger_chance),
-		m_simple_catch_up(simple_catch_up)
+		m_simple_catch_up(simple_catch_up),
+		m_cost_slot(cost_slot)
 	{
 	}
 	virtual const std::set<std::string> &getTriggerContents() const
@@ -231,18 +234,21 @@ class LuaLBM : public LoadingBlockModifierDef
 {
 private:
 	int m_id;
+	u32 m_cost_slot;
 public:
 	LuaLBM(lua_State *L, int id,
 			const std::set<std::string> &trigger_contents,
 			const std::string &name,
-			bool run_at_every_load):
-		m_id(id)
+			bool run_at_every_load, u32 cost_slot):
+		m_id(id),
+		m_cost_slot(cost_slot)
 	{
 		this->run_at_every_load = run_at_every_load;
 		this->trigger_contents = trigger_contents;
 		this->name = name;
 	}
-	virtual void trigger(ServerEnvironment *env, v3s16 p, MapNode n);
+	virtual void triggerBlock(ServerEnvironment *env, MapBlock *block,
+		const std::vector<v3s16> &positions, const std::vector<MapNode> &nodes);
 };
 
 struct ScriptCallbackState {
@@ -19,12 +19,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "lua_api/l_mapgen.h"
 #include "lua_api/l_internal.h"
+#include "lua_api/l_env.h"
 #include "lua_api/l_vmanip.h"
 #include "common/c_converter.h"
 #include "common/c_content.h"
 #include "cpp_api/s_security.h"
 #include "util/serialize.h"
 #include "server.h"
+#include "scripting_server.h"
 #include "environment.h"
 #include "emerge.h"
 #include "mg_biome.h"
@@ -104,6 +106,7 @@ size_t get_biome_list(lua_State *L, int index,
 
 Schematic *get_or_load_schematic(lua_State *L, int index,
 	SchematicManager *schemmgr, StringMap *replace_names);
+std::string get_schematic_filepath(lua_State *L, int index);
 Schematic *load_schematic(lua_State *L, int index, INodeDefManager *ndef,
 	StringMap *replace_names);
 Schematic *load_schematic_from_def(lua_State *L, int index,
@@ -141,6 +144,11 @@ Schematic *get_or_load_schematic(lua_State *L, int index,
 	if (index < 0)
 		index = lua_gettop(L) + 1 + index;
 
+	// Files are loaded once for each set of replacements
+	if (lua_isstring(L, index) && !lua_isnumber(L, index))
+		return schemmgr->getOrLoadFile(get_schematic_filepath(L, index),
+			replace_names);
+
 	Schematic *schem = (Schematic *)get_objdef(L, index, schemmgr);
 	if (schem)
 		return schem;
@@ -159,6 +167,15 @@ Schematic *get_or_load_schematic(lua_State *L, int index,
 }
 
 
+std::string get_schematic_filepath(lua_State *L, int index)
+{
+	std::string filepath = lua_tostring(L, index);
+	if (!fs::IsPathAbsolute(filepath))
+		filepath = ModApiBase::getCurrentModPath(L) + DIR_DELIM + filepath;
+	return filepath;
+}
+
+
 Schematic *load_schematic(lua_State *L, int index, INodeDefManager *ndef,
 	StringMap *replace_names)
 {
@@ -179,10 +196,7 @@ Schematic *load_schematic(lua_State *L, int index, INodeDefManager *ndef,
 	} else if (lua_isstring(L, index)) {
 		schem = SchematicManager::create(SCHEMATIC_NORMAL);
 
-		std::string filepath = lua_tostring(L, index);
-		if (!fs::IsPathAbsolute(filepath))
-			filepath = ModApiBase::getCurrentModPath(L) + DIR_DELIM + filepath;
-
+		std::string filepath = get_schematic_filepath(L, index);
 		if (!schem->loadSchematicFromFile(filepath, ndef,
 				replace_names)) {
 			delete schem;
@@ -1184,6 +1198,16 @@ int ModApiMapgen::l_register_schematic(lua_State *L)
 	if (lua_istable(L, 2))
 		read_schematic_replacements(L, 2, &replace_names);
 
+	if (lua_isstring(L, 1) && !lua_isnumber(L, 1)) {
+		Schematic *schem = schemmgr->getOrLoadFile(
+			get_schematic_filepath(L, 1), &replace_names);
+		if (!schem)
+			return 0;
+
+		lua_pushinteger(L, schem->handle);
+		return 1;
+	}
+
 	Schematic *schem = load_schematic(L, 1, schemmgr->getNodeDef(),
 		&replace_names);
 	if (!schem)
@@ -1403,6 +1427,85 @@ int ModApiMapgen::l_place_schematic(lua_State *L)
 	return 1;
 }
 
+static void LuaPlaceSchematicCallback(BulkEditResult result, void *param)
+{
+	ScriptCallbackState *state = (ScriptCallbackState *)param;
+	assert(state != NULL);
+	assert(state->script != NULL);
+
+	// state must be protected by envlock
+	Server *server = state->script->getServer();
+	MutexAutoLock envlock(server->m_env_mutex);
+
+	state->script->on_place_schematic_completion(
+		result == BULKEDIT_DONE, state);
+
+	delete state;
+}
+
+// place_schematic_async(p, schematic, rotation, replacements, force_placement,
+//	[callback, param])
+int ModApiMapgen::l_place_schematic_async(lua_State *L)
+{
+	GET_ENV_PTR;
+
+	EmergeManager *emerge = getServer(L)->getEmergeManager();
+
+	//// Read position
+	v3s16 p = check_v3s16(L, 1);
+
+	//// Read rotation
+	int rot = ROTATE_0;
+	const char *enumstr = lua_tostring(L, 3);
+	if (enumstr)
+		string_to_enum(es_Rotation, rot, std::string(enumstr));
+
+	//// Read force placement
+	bool force_placement = true;
+	if (lua_isboolean(L, 5))
+		force_placement = lua_toboolean(L, 5);
+
+	//// Read node replacements
+	StringMap replace_names;
+	if (lua_istable(L, 4))
+		read_schematic_replacements(L, 4, &replace_names);
+
+	//// Read schematic
+	Schematic *schem = get_or_load_schematic(L, 2, emerge->schemmgr,
+		&replace_names);
+	if (!schem) {
+		errorstream << "place_schematic_async: failed to get schematic"
+			<< std::endl;
+		return 0;
+	}
+
+	//// Read callback
+	BulkEditCallback callback = NULL;
+	ScriptCallbackState *state = NULL;
+	if (lua_isfunction(L, 6)) {
+		callback = LuaPlaceSchematicCallback;
+
+		lua_pushvalue(L, 6);
+		int callback_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+		lua_pushvalue(L, 7);
+		int args_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+		state = new ScriptCallbackState;
+		state->script       = getServer(L)->getScriptIface();
+		state->callback_ref = callback_ref;
+		state->args_ref     = args_ref;
+		state->refcount     = 1;
+		state->origin       = getScriptApiBase(L)->getOrigin();
+	}
+
+	emerge->enqueueBulkEdit(new SchematicBulkEdit(schem, p, (Rotation)rot,
+		force_placement, callback, state));
+
+	lua_pushboolean(L, true);
+	return 1;
+}
+
 int ModApiMapgen::l_place_schematic_on_vmanip(lua_State *L)
 {
 	NO_MAP_LOCK_REQUIRED;
@@ -1527,6 +1630,7 @@ void ModApiMapgen::Initialize(lua_State *L, int top)
 	API_FCT(generate_decorations);
 	API_FCT(create_schematic);
 	API_FCT(place_schematic);
+	API_FCT(place_schematic_async);
 	API_FCT(place_schematic_on_vmanip);
 	API_FCT(serialize_schematic);
 }
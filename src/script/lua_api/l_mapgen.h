@@ -101,6 +101,10 @@ class ModApiMapgen : public ModApiBase
 	// place_schematic(p, schematic, rotation, replacements, force_placement)
 	static int l_place_schematic(lua_State *L);
 
+	// place_schematic_async(p, schematic, rotation, replacements,
+	//	force_placement, callback, param)
+	static int l_place_schematic_async(lua_State *L);
+
 	// place_schematic_on_vmanip(vm, p, schematic,
 	//     rotation, replacements, force_placement)
 	static int l_place_schematic_on_vmanip(lua_State *L);
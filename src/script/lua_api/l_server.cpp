@@ -26,7 +26,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "environment.h"
 #include "player.h"
 #include "log.h"
+#include "tracer.h"
+#include "filesys.h"
 #include <algorithm>
+#include <ctime>
 
 // request_shutdown()
 int ModApiServer::l_request_shutdown(lua_State *L)
@@ -507,6 +510,138 @@ int ModApiServer::l_set_last_run_mod(lua_State *L)
 	return 0;
 }
 
+// get_trace_stats([seconds])
+int ModApiServer::l_get_trace_stats(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	u64 since_us = 0;
+	if (lua_isnumber(L, 1)) {
+		u64 now = porting::getTimeUs();
+		u64 span = MYMAX(lua_tonumber(L, 1), 0) * 1000000;
+		since_us = now > span ? now - span : 0;
+	}
+
+	std::vector<TracePhaseStats> stats;
+	g_tracer->getPhaseStats(stats, since_us);
+
+	lua_createtable(L, stats.size(), 0);
+	for (size_t i = 0; i < stats.size(); i++) {
+		const TracePhaseStats &s = stats[i];
+		lua_createtable(L, 0, 6);
+		lua_pushstring(L, s.name.c_str());
+		lua_setfield(L, -2, "name");
+		lua_pushinteger(L, s.count);
+		lua_setfield(L, -2, "count");
+		lua_pushnumber(L, s.total_us);
+		lua_setfield(L, -2, "total");
+		lua_pushinteger(L, s.p50_us);
+		lua_setfield(L, -2, "p50");
+		lua_pushinteger(L, s.p99_us);
+		lua_setfield(L, -2, "p99");
+		lua_pushinteger(L, s.max_us);
+		lua_setfield(L, -2, "max");
+		lua_rawseti(L, -2, i + 1);
+	}
+	return 1;
+}
+
+// write_trace()
+int ModApiServer::l_write_trace(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	std::ostringstream os;
+	os << getServer(L)->getWorldPath() << DIR_DELIM << "trace-"
+		<< time(NULL) << ".json";
+	std::string path = os.str();
+
+	std::ostringstream trace(std::ios_base::binary);
+	g_tracer->writeChromeTrace(trace);
+	if (!fs::safeWriteToFile(path, trace.str())) {
+		lua_pushnil(L);
+		return 1;
+	}
+	lua_pushstring(L, path.c_str());
+	return 1;
+}
+
+// clear_trace()
+int ModApiServer::l_clear_trace(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	g_tracer->clear();
+	return 0;
+}
+
+// get_callback_cost_slot(mod, callback)
+int ModApiServer::l_get_callback_cost_slot(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	std::string mod = luaL_checkstring(L, 1);
+	const char *callback = luaL_checkstring(L, 2);
+	lua_pushinteger(L,
+		getScriptApiBase(L)->getCallbackCosts().getSlot(mod, callback));
+	return 1;
+}
+
+// get_callback_cost_start()
+int ModApiServer::l_get_callback_cost_start(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	lua_pushnumber(L, porting::getTimeUs());
+	lua_pushnumber(L,
+		getScriptApiBase(L)->getCallbackCosts().getAccountedTime());
+	return 2;
+}
+
+// add_callback_cost(slot, start_us, accounted_us)
+int ModApiServer::l_add_callback_cost(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	u32 slot = luaL_checkinteger(L, 1);
+	u64 start_us = luaL_checknumber(L, 2);
+	u64 accounted_us = luaL_checknumber(L, 3);
+	getScriptApiBase(L)->getCallbackCosts().add(slot, start_us,
+		porting::getTimeUs(), accounted_us);
+	return 0;
+}
+
+// get_callback_costs()
+int ModApiServer::l_get_callback_costs(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	const std::deque<ScriptCallbackCosts::Entry> &entries =
+		getScriptApiBase(L)->getCallbackCosts().getEntries();
+
+	lua_newtable(L);
+	int i = 1;
+	for (size_t j = 0; j < entries.size(); j++) {
+		const ScriptCallbackCosts::Entry &entry = entries[j];
+		if (entry.calls == 0)
+			continue;
+		lua_createtable(L, 0, 5);
+		lua_pushstring(L, entry.mod.c_str());
+		lua_setfield(L, -2, "mod");
+		lua_pushstring(L, entry.callback.c_str());
+		lua_setfield(L, -2, "callback");
+		lua_pushinteger(L, entry.calls);
+		lua_setfield(L, -2, "calls");
+		lua_pushnumber(L, entry.total_us);
+		lua_setfield(L, -2, "total");
+		lua_pushinteger(L, entry.max_us);
+		lua_setfield(L, -2, "max");
+		lua_rawseti(L, -2, i++);
+	}
+	return 1;
+}
+
+// clear_callback_costs()
+int ModApiServer::l_clear_callback_costs(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	getScriptApiBase(L)->getCallbackCosts().clear();
+	return 0;
+}
+
 void ModApiServer::Initialize(lua_State *L, int top)
 {
 	API_FCT(request_shutdown);
@@ -541,4 +676,14 @@ void ModApiServer::Initialize(lua_State *L, int top)
 
 	API_FCT(get_last_run_mod);
 	API_FCT(set_last_run_mod);
+
+	API_FCT(get_trace_stats);
+	API_FCT(write_trace);
+	API_FCT(clear_trace);
+
+	API_FCT(get_callback_cost_slot);
+	API_FCT(get_callback_cost_start);
+	API_FCT(add_callback_cost);
+	API_FCT(get_callback_costs);
+	API_FCT(clear_callback_costs);
 }
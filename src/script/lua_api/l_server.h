@@ -107,6 +107,30 @@ class ModApiServer : public ModApiBase
 	// set_last_run_mod(modname)
 	static int l_set_last_run_mod(lua_State *L);
 
+	// get_trace_stats([seconds])
+	static int l_get_trace_stats(lua_State *L);
+
+	// write_trace()
+	static int l_write_trace(lua_State *L);
+
+	// clear_trace()
+	static int l_clear_trace(lua_State *L);
+
+	// get_callback_cost_slot(mod, callback)
+	static int l_get_callback_cost_slot(lua_State *L);
+
+	// get_callback_cost_start()
+	static int l_get_callback_cost_start(lua_State *L);
+
+	// add_callback_cost(slot, start_us, accounted_us)
+	static int l_add_callback_cost(lua_State *L);
+
+	// get_callback_costs()
+	static int l_get_callback_costs(lua_State *L);
+
+	// clear_callback_costs()
+	static int l_clear_callback_costs(lua_State *L);
+
 public:
 	static void Initialize(lua_State *L, int top);
 };
@@ -186,6 +186,34 @@ void decompressZlib(std::istream &is, std::ostream &os)
 	inflateEnd(&z);
 }
 
+void decompressZlib(const u8 *data, u32 size, u8 *out, u32 outsize)
+{
+	z_stream z;
+	z.zalloc = Z_NULL;
+	z.zfree = Z_NULL;
+	z.opaque = Z_NULL;
+
+	if (inflateInit(&z) != Z_OK)
+		throw SerializationError("decompressZlib: inflateInit failed");
+
+	z.next_in = (Bytef *)data;
+	z.avail_in = size;
+	z.next_out = (Bytef *)out;
+	z.avail_out = outsize;
+
+	// Trailing data after the end of the stream is ignored
+	int status = inflate(&z, Z_FINISH);
+	bool filled = (status == Z_STREAM_END && z.avail_out == 0);
+	inflateEnd(&z);
+
+	if (!filled) {
+		if (status != Z_STREAM_END && status != Z_BUF_ERROR)
+			zerr(status);
+		throw SerializationError("decompressZlib: decompress resulted "
+			"in invalid size");
+	}
+}
+
 void compress(SharedBuffer<u8> data, std::ostream &os, u8 version)
 {
 	if(version >= 11)
@@ -268,3 +296,101 @@ void decompress(std::istream &is, std::ostream &os, u8 version)
 }
 
 
+
+/*
+	ZlibCompressor
+*/
+
+ZlibCompressor::ZlibCompressor(int level)
+{
+	m_zstream = new z_stream;
+	m_zstream->zalloc = Z_NULL;
+	m_zstream->zfree = Z_NULL;
+	m_zstream->opaque = Z_NULL;
+	if (deflateInit(m_zstream, level) != Z_OK) {
+		delete m_zstream;
+		throw SerializationError("ZlibCompressor: deflateInit failed");
+	}
+}
+
+ZlibCompressor::~ZlibCompressor()
+{
+	deflateEnd(m_zstream);
+	delete m_zstream;
+}
+
+void ZlibCompressor::compress(const u8 *data, size_t size, std::string &dst)
+{
+	deflateReset(m_zstream);
+
+	// Make room for the worst case, so everything is done in one call
+	size_t start = dst.size();
+	dst.resize(start + deflateBound(m_zstream, size));
+
+	m_zstream->next_in = (Bytef *)data;
+	m_zstream->avail_in = size;
+	m_zstream->next_out = (Bytef *)&dst[start];
+	m_zstream->avail_out = dst.size() - start;
+
+	int status = deflate(m_zstream, Z_FINISH);
+	if (status != Z_STREAM_END) {
+		zerr(status);
+		throw SerializationError("ZlibCompressor: deflate failed");
+	}
+	dst.resize(dst.size() - m_zstream->avail_out);
+}
+
+/*
+	ZlibDecompressor
+*/
+
+ZlibDecompressor::ZlibDecompressor()
+{
+	m_zstream = new z_stream;
+	m_zstream->zalloc = Z_NULL;
+	m_zstream->zfree = Z_NULL;
+	m_zstream->opaque = Z_NULL;
+	m_zstream->next_in = Z_NULL;
+	m_zstream->avail_in = 0;
+	if (inflateInit(m_zstream) != Z_OK) {
+		delete m_zstream;
+		throw SerializationError("ZlibDecompressor: inflateInit failed");
+	}
+}
+
+ZlibDecompressor::~ZlibDecompressor()
+{
+	inflateEnd(m_zstream);
+	delete m_zstream;
+}
+
+size_t ZlibDecompressor::decompress(const u8 *data, size_t size,
+		std::string &dst)
+{
+	inflateReset(m_zstream);
+
+	// Use all capacity of the buffer before growing it
+	dst.resize(MYMAX(dst.capacity(), (size_t)16384));
+
+	m_zstream->next_in = (Bytef *)data;
+	m_zstream->avail_in = size;
+	size_t out = 0;
+	for (;;) {
+		m_zstream->next_out = (Bytef *)&dst[out];
+		m_zstream->avail_out = dst.size() - out;
+
+		int status = inflate(m_zstream, Z_NO_FLUSH);
+		out = dst.size() - m_zstream->avail_out;
+		if (status == Z_STREAM_END)
+			break;
+		if (status != Z_OK && status != Z_BUF_ERROR) {
+			zerr(status);
+			throw SerializationError("ZlibDecompressor: inflate failed");
+		}
+		if (m_zstream->avail_out != 0)
+			throw SerializationError("ZlibDecompressor: data ended halfway");
+		dst.resize(dst.size() * 2);
+	}
+	dst.resize(out);
+	return size - m_zstream->avail_in;
+}
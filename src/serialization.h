@@ -24,6 +24,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "exceptions.h"
 #include <iostream>
 #include "util/pointer.h"
+#include "util/basic_macros.h"
+#include <string>
 
 /*
 	Map format serialization version
@@ -89,11 +91,51 @@ inline bool ser_ver_supported(s32 v) {
 void compressZlib(SharedBuffer<u8> data, std::ostream &os, int level = -1);
 void compressZlib(const std::string &data, std::ostream &os, int level = -1);
 void decompressZlib(std::istream &is, std::ostream &os);
+// Decompresses into a buffer that must be filled exactly
+void decompressZlib(const u8 *data, u32 size, u8 *out, u32 outsize);
 
 // These choose between zlib and a self-made one according to version
 void compress(SharedBuffer<u8> data, std::ostream &os, u8 version);
 //void compress(const std::string &data, std::ostream &os, u8 version);
 void decompress(std::istream &is, std::ostream &os, u8 version);
 
+/*
+	zlib streams that are reset instead of set up again for every buffer.
+	An instance must only be used by one thread at a time.
+*/
+
+struct z_stream_s;
+
+class ZlibCompressor
+{
+public:
+	ZlibCompressor(int level = -1);
+	~ZlibCompressor();
+
+	// Appends the compressed data to dst
+	void compress(const u8 *data, size_t size, std::string &dst);
+
+private:
+	DISABLE_CLASS_COPY(ZlibCompressor);
+
+	z_stream_s *m_zstream;
+};
+
+class ZlibDecompressor
+{
+public:
+	ZlibDecompressor();
+	~ZlibDecompressor();
+
+	// Replaces dst by the contents of the zlib stream at the start of data.
+	// Returns the number of bytes read from data.
+	size_t decompress(const u8 *data, size_t size, std::string &dst);
+
+private:
+	DISABLE_CLASS_COPY(ZlibDecompressor);
+
+	z_stream_s *m_zstream;
+};
+
 #endif
 
@@ -37,6 +37,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "genericobject.h"
 #include "settings.h"
 #include "profiler.h"
+#include "tracer.h"
 #include "log.h"
 #include "scripting_server.h"
 #include "nodedef.h"
@@ -45,6 +46,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "emerge.h"
 #include "mapgen.h"
 #include "mg_biome.h"
+#include "mg_schematic.h"
 #include "content_mapnode.h"
 #include "content_nodemeta.h"
 #include "content_abm.h"
@@ -186,6 +188,7 @@ Server::Server(
 	m_admin_chat(iface),
 	m_ignore_map_edit_events(false),
 	m_ignore_map_edit_events_peer_id(0),
+	m_block_buffers(new BlockSerializeBuffers),
 	m_next_sound_id(0),
 	m_mod_storage_save_timer(10.0f)
 {
@@ -284,6 +287,7 @@ Server::Server(
 
 	// Perform pending node name resolutions
 	m_nodedef->runNodeResolveCallbacks();
+	m_emerge->schemmgr->logStatistics();
 
 	// unmap node names for connected nodeboxes
 	m_nodedef->mapNodeboxConnections();
@@ -291,6 +295,10 @@ Server::Server(
 	// init the recipe hashes to speed up crafting
 	m_craftdef->initHashes(this);
 
+	// The item definitions are final now, prepare them for joining clients.
+	// Node definitions still get dummies for unknown nodes of loaded blocks.
+	getDefinitionsPacket(TOCLIENT_ITEMDEF, LATEST_PROTOCOL_VERSION);
+
 	// Initialize Environment
 	m_env = new ServerEnvironment(servermap, m_script, this, m_path_world);
 
@@ -326,6 +334,8 @@ Server::Server(
 
 	m_liquid_transform_every = g_settings->getFloat("liquid_update");
 	m_max_chatmessage_length = g_settings->getU16("chat_message_max_size");
+
+	g_tracer->setEnabled(g_settings->getBool("profiler.trace"));
 }
 
 Server::~Server()
@@ -372,6 +382,9 @@ Server::~Server()
 		m_env->saveMeta();
 	}
 
+	// Edits queued by the shutdown hooks are not done anymore
+	m_emerge->cancelBulkEdits();
+
 	// Stop threads
 	stop();
 	delete m_thread;
@@ -385,6 +398,7 @@ Server::~Server()
 	delete m_itemdef;
 	delete m_nodedef;
 	delete m_craftdef;
+	delete m_block_buffers;
 
 	// Deinitialize scripting
 	infostream << "Server: Deinitializing scripting" << std::endl;
@@ -465,6 +479,7 @@ void Server::AsyncRunStep(bool initial_step)
 	DSTACK(FUNCTION_NAME);
 
 	g_profiler->add("Server::AsyncRunStep (num)", 1);
+	TraceScope trace("Server::AsyncRunStep");
 
 	float dtime;
 	{
@@ -530,16 +545,20 @@ void Server::AsyncRunStep(bool initial_step)
 		m_env->reportMaxLagEstimate(max_lag);
 		// Step environment
 		ScopeProfiler sp(g_profiler, "SEnv step");
+		TraceScope trace("Server: environment step");
 		ScopeProfiler sp2(g_profiler, "SEnv step avg", SPT_AVG);
 		m_env->step(dtime);
 	}
 
+	m_script->reportCallbackCosts(g_profiler);
+
 	static const float map_timer_and_unload_dtime = 2.92;
 	if(m_map_timer_and_unload_interval.step(dtime, map_timer_and_unload_dtime))
 	{
 		MutexAutoLock lock(m_env_mutex);
 		// Run Map's timers and unload unused data
 		ScopeProfiler sp(g_profiler, "Server: map timer and unload");
+		TraceScope trace("Server: map timer and unload");
 		m_env->getMap().timerUpdate(map_timer_and_unload_dtime,
 			g_settings->getFloat("server_unload_unused_data_timeout"),
 			U32_MAX);
@@ -574,6 +593,7 @@ void Server::AsyncRunStep(bool initial_step)
 		MutexAutoLock lock(m_env_mutex);
 
 		ScopeProfiler sp(g_profiler, "Server: liquid transform");
+		TraceScope trace("Server: liquid transform");
 
 		std::map<v3s16, MapBlock*> modified_blocks;
 		m_env->getMap().transformLiquids(modified_blocks, m_env);
@@ -638,6 +658,7 @@ void Server::AsyncRunStep(bool initial_step)
 		m_clients.lock();
 		UNORDERED_MAP<u16, RemoteClient*> clients = m_clients.getClientList();
 		ScopeProfiler sp(g_profiler, "Server: checking added and deleted objs");
+		TraceScope trace("Server: checking added and deleted objs");
 
 		// Radius inside which objects are active
 		static const s16 radius =
@@ -778,6 +799,7 @@ void Server::AsyncRunStep(bool initial_step)
 	{
 		MutexAutoLock envlock(m_env_mutex);
 		ScopeProfiler sp(g_profiler, "Server: sending object messages");
+		TraceScope trace("Server: sending object messages");
 
 		// Key = object id
 		// Value = data sent by object
@@ -991,6 +1013,7 @@ void Server::AsyncRunStep(bool initial_step)
 			MutexAutoLock lock(m_env_mutex);
 
 			ScopeProfiler sp(g_profiler, "Server: saving stuff");
+			TraceScope trace("Server: saving stuff");
 
 			// Save ban file
 			if (m_banmanager->isModified()) {
@@ -1169,6 +1192,7 @@ void Server::ProcessData(NetworkPacket *pkt)
 	MutexAutoLock envlock(m_env_mutex);
 
 	ScopeProfiler sp(g_profiler, "Server::ProcessData");
+	TraceScope trace("Server::ProcessData");
 	u32 peer_id = pkt->getPeerId();
 
 	try {
@@ -1470,7 +1494,12 @@ void Server::printToConsoleOnly(const std::string &text)
 
 void Server::Send(NetworkPacket* pkt)
 {
-	m_clients.send(pkt->getPeerId(),
+	Send(pkt->getPeerId(), pkt);
+}
+
+void Server::Send(u16 peer_id, NetworkPacket *pkt)
+{
+	m_clients.send(peer_id,
 		clientCommandFactoryTable[pkt->getCommand()].channel,
 		pkt,
 		clientCommandFactoryTable[pkt->getCommand()].reliable);
@@ -1565,55 +1594,57 @@ void Server::SendDeathscreen(u16 peer_id,bool set_camera_point_target,
 	Send(&pkt);
 }
 
-void Server::SendItemDef(u16 peer_id,
-		IItemDefManager *itemdef, u16 protocol_version)
+void Server::SendItemDef(u16 peer_id, u16 protocol_version)
 {
 	DSTACK(FUNCTION_NAME);
 
-	NetworkPacket pkt(TOCLIENT_ITEMDEF, 0, peer_id);
-
-	/*
-		u16 command
-		u32 length of the next item
-		zlib-compressed serialized ItemDefManager
-	*/
-	std::ostringstream tmp_os(std::ios::binary);
-	itemdef->serialize(tmp_os, protocol_version);
-	std::ostringstream tmp_os2(std::ios::binary);
-	compressZlib(tmp_os.str(), tmp_os2);
-	pkt.putLongString(tmp_os2.str());
+	NetworkPacket *pkt = getDefinitionsPacket(TOCLIENT_ITEMDEF, protocol_version);
 
-	// Make data buffer
 	verbosestream << "Server: Sending item definitions to id(" << peer_id
-			<< "): size=" << pkt.getSize() << std::endl;
+			<< "): size=" << pkt->getSize() << std::endl;
 
-	Send(&pkt);
+	Send(peer_id, pkt);
 }
 
-void Server::SendNodeDef(u16 peer_id,
-		INodeDefManager *nodedef, u16 protocol_version)
+void Server::SendNodeDef(u16 peer_id, u16 protocol_version)
 {
 	DSTACK(FUNCTION_NAME);
 
-	NetworkPacket pkt(TOCLIENT_NODEDEF, 0, peer_id);
+	NetworkPacket *pkt = getDefinitionsPacket(TOCLIENT_NODEDEF, protocol_version);
+
+	verbosestream << "Server: Sending node definitions to id(" << peer_id
+			<< "): size=" << pkt->getSize() << std::endl;
+
+	Send(peer_id, pkt);
+}
+
+NetworkPacket *Server::getDefinitionsPacket(u16 command, u16 protocol_version)
+{
+	std::map<u16, NetworkPacket> &packets = command == TOCLIENT_ITEMDEF ?
+		m_itemdef_packets : m_nodedef_packets;
+	std::map<u16, NetworkPacket>::iterator it = packets.find(protocol_version);
+	if (it != packets.end())
+		return &it->second;
+
+	ScopeProfiler sp(g_profiler, "Server: serialize definitions", SPT_AVG);
 
 	/*
 		u16 command
 		u32 length of the next item
-		zlib-compressed serialized NodeDefManager
+		zlib-compressed serialized ItemDefManager or NodeDefManager
 	*/
 	std::ostringstream tmp_os(std::ios::binary);
-	nodedef->serialize(tmp_os, protocol_version);
+	if (command == TOCLIENT_ITEMDEF)
+		m_itemdef->serialize(tmp_os, protocol_version);
+	else
+		m_nodedef->serialize(tmp_os, protocol_version);
 	std::ostringstream tmp_os2(std::ios::binary);
 	compressZlib(tmp_os.str(), tmp_os2);
 
+	NetworkPacket &pkt = packets[protocol_version];
+	pkt = NetworkPacket(command, 0);
 	pkt.putLongString(tmp_os2.str());
-
-	// Make data buffer
-	verbosestream << "Server: Sending node definitions to id(" << peer_id
-			<< "): size=" << pkt.getSize() << std::endl;
-
-	Send(&pkt);
+	return &pkt;
 }
 
 /*
@@ -1624,16 +1655,26 @@ void Server::SendInventory(PlayerSAO* playerSAO)
 {
 	DSTACK(FUNCTION_NAME);
 
+	Inventory *inventory = playerSAO->getInventory();
+	const Inventory *sent = playerSAO->getSentInventory();
+
 	UpdateCrafting(playerSAO->getPlayer());
 
 	/*
-		Serialize it
+		Serialize it, only the changed slots if the client supports it
 	*/
 
-	NetworkPacket pkt(TOCLIENT_INVENTORY, 0, playerSAO->getPeerID());
-
+	u16 command = TOCLIENT_INVENTORY;
 	std::ostringstream os;
-	playerSAO->getInventory()->serialize(os);
+	if (sent && (m_clients.getClientFeatures(playerSAO->getPeerID()) &
+				CLIENT_FEATURE_INVENTORY_DELTA) &&
+			inventory->serializeDelta(os, *sent))
+		command = TOCLIENT_INVENTORY_DELTA;
+	else
+		inventory->serialize(os);
+	playerSAO->setSentInventory(*inventory);
+
+	NetworkPacket pkt(command, 0, playerSAO->getPeerID());
 
 	std::string s = os.str();
 
@@ -2275,10 +2316,10 @@ void Server::SendBlockNoLock(u16 peer_id, MapBlock *block, u8 ver, u16 net_proto
 		Create a packet with the block in the right format
 	*/
 
-	std::ostringstream os(std::ios_base::binary);
-	block->serialize(os, ver, false);
-	block->serializeNetworkSpecific(os);
-	std::string s = os.str();
+	std::string &s = m_block_buffers->output;
+	s.clear();
+	block->serialize(s, ver, false, *m_block_buffers);
+	block->serializeNetworkSpecific(s);
 
 	NetworkPacket pkt(TOCLIENT_BLOCKDATA, 2 + 2 + 2 + 2 + s.size(), peer_id);
 
@@ -2295,6 +2336,7 @@ void Server::SendBlocks(float dtime)
 	//TODO check if one big lock could be faster then multiple small ones
 
 	ScopeProfiler sp(g_profiler, "Server: sel and send blocks to clients");
+	TraceScope trace("Server: sel and send blocks to clients");
 
 	std::vector<PrioritySortedBlockTransfer> queue;
 
@@ -2302,6 +2344,7 @@ void Server::SendBlocks(float dtime)
 
 	{
 		ScopeProfiler sp(g_profiler, "Server: selecting blocks for sending");
+		TraceScope trace("Server: selecting blocks for sending");
 
 		std::vector<u16> clients = m_clients.getClientIDs();
 
@@ -2363,6 +2406,9 @@ void Server::fillMediaCache()
 
 	infostream<<"Server: Calculating media file checksums"<<std::endl;
 
+	u64 cache_limit = g_settings->getU64("media_cache_size") * 1024 * 1024;
+	u64 cache_size = 0;
+
 	// Collect all media file paths
 	std::vector<std::string> paths;
 	for(std::vector<ModSpec>::iterator i = m_mods.begin();
@@ -2449,8 +2495,26 @@ void Server::fillMediaCache()
 			m_media[filename] = MediaInfo(filepath, sha1_base64);
 			verbosestream << "Server: " << sha1_hex << " is " << filename
 					<< std::endl;
+
+			// Keep the data for sending, identical files are stored once
+			if (m_media_data.find(sha1_base64) == m_media_data.end() &&
+					cache_size + tmp_os.str().size() <= cache_limit) {
+				m_media_data[sha1_base64] = tmp_os.str();
+				cache_size += tmp_os.str().size();
+			}
 		}
 	}
+	infostream << "Server: Keeping " << m_media_data.size() << " media files ("
+		<< cache_size / 1024 << " KiB) in memory" << std::endl;
+
+	// The announcement is the same for every client
+	m_media_announcement = NetworkPacket(TOCLIENT_ANNOUNCE_MEDIA, 0);
+	m_media_announcement << (u16) m_media.size();
+	for (UNORDERED_MAP<std::string, MediaInfo>::iterator i = m_media.begin();
+			i != m_media.end(); ++i) {
+		m_media_announcement << i->first << i->second.sha1_digest;
+	}
+	m_media_announcement << g_settings->get("remote_media");
 }
 
 void Server::sendMediaAnnouncement(u16 peer_id)
@@ -2460,19 +2524,7 @@ void Server::sendMediaAnnouncement(u16 peer_id)
 	verbosestream << "Server: Announcing files to id(" << peer_id << ")"
 		<< std::endl;
 
-	// Make packet
-	std::ostringstream os(std::ios_base::binary);
-
-	NetworkPacket pkt(TOCLIENT_ANNOUNCE_MEDIA, 0, peer_id);
-	pkt << (u16) m_media.size();
-
-	for (UNORDERED_MAP<std::string, MediaInfo>::iterator i = m_media.begin();
-			i != m_media.end(); ++i) {
-		pkt << i->first << i->second.sha1_digest;
-	}
-
-	pkt << g_settings->get("remote_media");
-	Send(&pkt);
+	Send(peer_id, &m_media_announcement);
 }
 
 struct SendableMedia
@@ -2480,13 +2532,21 @@ struct SendableMedia
 	std::string name;
 	std::string path;
 	std::string data;
+	// Data of the media cache, used instead of data if set
+	const std::string *cached_data;
 
 	SendableMedia(const std::string &name_="", const std::string &path_="",
-	              const std::string &data_=""):
+	              const std::string &data_="", const std::string *cached_data_=NULL):
 		name(name_),
 		path(path_),
-		data(data_)
+		data(data_),
+		cached_data(cached_data_)
 	{}
+
+	const std::string &getData() const
+	{
+		return cached_data ? *cached_data : data;
+	}
 };
 
 void Server::sendRequestedMedia(u16 peer_id,
@@ -2519,39 +2579,46 @@ void Server::sendRequestedMedia(u16 peer_id,
 
 		//TODO get path + name
 		std::string tpath = m_media[name].path;
+		SendableMedia media(name, tpath);
 
-		// Read data
-		std::ifstream fis(tpath.c_str(), std::ios_base::binary);
-		if(fis.good() == false){
-			errorstream<<"Server::sendRequestedMedia(): Could not open \""
-					<<tpath<<"\" for reading"<<std::endl;
-			continue;
-		}
-		std::ostringstream tmp_os(std::ios_base::binary);
-		bool bad = false;
-		for(;;) {
-			char buf[1024];
-			fis.read(buf, 1024);
-			std::streamsize len = fis.gcount();
-			tmp_os.write(buf, len);
-			file_size_bunch_total += len;
-			if(fis.eof())
-				break;
-			if(!fis.good()) {
-				bad = true;
-				break;
+		UNORDERED_MAP<std::string, std::string>::const_iterator cached =
+			m_media_data.find(m_media[name].sha1_digest);
+		if (cached != m_media_data.end()) {
+			media.cached_data = &cached->second;
+		} else {
+			// Read data
+			std::ifstream fis(tpath.c_str(), std::ios_base::binary);
+			if(fis.good() == false){
+				errorstream<<"Server::sendRequestedMedia(): Could not open \""
+						<<tpath<<"\" for reading"<<std::endl;
+				continue;
 			}
+			std::ostringstream tmp_os(std::ios_base::binary);
+			bool bad = false;
+			for(;;) {
+				char buf[1024];
+				fis.read(buf, 1024);
+				std::streamsize len = fis.gcount();
+				tmp_os.write(buf, len);
+				if(fis.eof())
+					break;
+				if(!fis.good()) {
+					bad = true;
+					break;
+				}
+			}
+			if(bad) {
+				errorstream<<"Server::sendRequestedMedia(): Failed to read \""
+						<<name<<"\""<<std::endl;
+				continue;
+			}
+			/*infostream<<"Server::sendRequestedMedia(): Loaded \""
+					<<tname<<"\""<<std::endl;*/
+			media.data = tmp_os.str();
 		}
-		if(bad) {
-			errorstream<<"Server::sendRequestedMedia(): Failed to read \""
-					<<name<<"\""<<std::endl;
-			continue;
-		}
-		/*infostream<<"Server::sendRequestedMedia(): Loaded \""
-				<<tname<<"\""<<std::endl;*/
 		// Put in list
-		file_bunches[file_bunches.size()-1].push_back(
-				SendableMedia(name, tpath, tmp_os.str()));
+		file_bunches[file_bunches.size()-1].push_back(media);
+		file_size_bunch_total += media.getData().size();
 
 		// Start next bunch if got enough data
 		if(file_size_bunch_total >= bytes_per_bunch) {
@@ -2585,7 +2652,7 @@ void Server::sendRequestedMedia(u16 peer_id,
 				j = file_bunches[i].begin();
 				j != file_bunches[i].end(); ++j) {
 			pkt << j->name;
-			pkt.putLongString(j->data);
+			pkt.putLongString(j->getData());
 		}
 
 		verbosestream << "Server::sendRequestedMedia(): bunch "
@@ -3461,6 +3528,8 @@ ICraftDefManager *Server::getCraftDefManager()
 
 u16 Server::allocateUnknownNodeId(const std::string &name)
 {
+	// Joining clients need the new node, serialize again on demand
+	m_nodedef_packets.clear();
 	return m_nodedef->allocateDummy(name);
 }
 
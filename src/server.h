@@ -57,6 +57,7 @@ class ServerScripting;
 class ServerEnvironment;
 struct SimpleSoundSpec;
 class ServerThread;
+struct BlockSerializeBuffers;
 
 enum ClientDeletionReason {
 	CDR_LEAVE,
@@ -198,6 +199,8 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	void ProcessData(NetworkPacket *pkt);
 
 	void Send(NetworkPacket* pkt);
+	// Sends a packet that isn't addressed to the peer, e.g. a shared one
+	void Send(u16 peer_id, NetworkPacket *pkt);
 
 	// Helper for handleCommand_PlayerPos and handleCommand_Interact
 	void process_PlayerPos(RemotePlayer *player, PlayerSAO *playersao,
@@ -389,8 +392,9 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 		const std::string &custom_reason, bool reconnect = false);
 	void SendAccessDenied_Legacy(u16 peer_id, const std::wstring &reason);
 	void SendDeathscreen(u16 peer_id,bool set_camera_point_target, v3f camera_point_target);
-	void SendItemDef(u16 peer_id,IItemDefManager *itemdef, u16 protocol_version);
-	void SendNodeDef(u16 peer_id,INodeDefManager *nodedef, u16 protocol_version);
+	void SendItemDef(u16 peer_id, u16 protocol_version);
+	void SendNodeDef(u16 peer_id, u16 protocol_version);
+	NetworkPacket *getDefinitionsPacket(u16 command, u16 protocol_version);
 
 	/* mark blocks not sent for all clients */
 	void SetBlocksNotSent(std::map<v3s16, MapBlock *>& block);
@@ -655,6 +659,20 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 
 	// media files known to server
 	UNORDERED_MAP<std::string, MediaInfo> m_media;
+	// Contents of the media files by SHA1 digest, up to media_cache_size
+	UNORDERED_MAP<std::string, std::string> m_media_data;
+	NetworkPacket m_media_announcement;
+
+	/*
+		Compressed definitions by protocol version, shared by all joining
+		clients. Behind m_env_mutex once the environment exists, the node
+		definitions are dropped when a dummy node is allocated.
+	*/
+	std::map<u16, NetworkPacket> m_itemdef_packets;
+	std::map<u16, NetworkPacket> m_nodedef_packets;
+
+	// Reused for serializing the blocks that are sent, behind m_env_mutex
+	BlockSerializeBuffers *m_block_buffers;
 
 	/*
 		Sounds
@@ -18,6 +18,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include "serverenvironment.h"
+#include <algorithm>
 #include "content_sao.h"
 #include "settings.h"
 #include "log.h"
@@ -26,6 +27,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "gamedef.h"
 #include "map.h"
 #include "profiler.h"
+#include "tracer.h"
+#include "pathfinder.h"
 #include "raycast.h"
 #include "remoteplayer.h"
 #include "scripting_server.h"
@@ -35,6 +38,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/basic_macros.h"
 #include "util/pointedthing.h"
 #include "threading/mutex_auto_lock.h"
+#include "threading/semaphore.h"
+#include "threading/atomic.h"
+#include "threading/thread.h"
 #include "filesys.h"
 #include "gameparams.h"
 #include "database-dummy.h"
@@ -51,6 +57,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 // A number that is much smaller than the timeout for particle spawners should/could ever be
 #define PARTICLE_SPAWNER_NO_EXPIRY -1024.f
 
+// Below this many active objects, waking up the physics threads costs
+// more than it saves
+#define OBJECT_PHYSICS_MIN_BATCH 32
+
 /*
 	ABMWithState
 */
@@ -71,6 +81,26 @@ ABMWithState::ABMWithState(ActiveBlockModifier *abm_):
 	LBMManager
 */
 
+void LoadingBlockModifierDef::triggerBlock(ServerEnvironment *env,
+	MapBlock *block, const std::vector<v3s16> &positions,
+	const std::vector<MapNode> &nodes)
+{
+	for (size_t i = 0; i < positions.size(); i++) {
+		MapNode n = nodes[i];
+		if (refreshNode(block, positions[i], n))
+			trigger(env, positions[i], n);
+	}
+}
+
+bool LoadingBlockModifierDef::refreshNode(MapBlock *block, v3s16 p, MapNode &n)
+{
+	MapNode current = block->getNodeNoEx(p - block->getPosRelative());
+	if (current.getContent() != n.getContent())
+		return false;
+	n = current;
+	return true;
+}
+
 void LBMContentMapping::deleteContents()
 {
 	for (std::vector<LoadingBlockModifierDef *>::iterator it = lbm_list.begin();
@@ -228,6 +258,17 @@ void LBMManager::loadIntroductionTimes(const std::string &times,
 	// Clear the list, so that we don't delete remaining elements
 	// twice in the destructor
 	m_lbm_defs.clear();
+
+	for (lbm_lookup_map::const_iterator it = m_lbm_lookup.begin();
+		it != m_lbm_lookup.end(); ++it) {
+		const LBMContentMapping::container_map &map = it->second.map;
+		for (LBMContentMapping::container_map::const_iterator iit = map.begin();
+			iit != map.end(); ++iit) {
+			if (iit->first >= m_trigger_contents.size())
+				m_trigger_contents.resize(iit->first + 1, false);
+			m_trigger_contents[iit->first] = true;
+		}
+	}
 }
 
 std::string LBMManager::createIntroductionTimesString()
@@ -254,32 +295,67 @@ std::string LBMManager::createIntroductionTimesString()
 	return oss.str();
 }
 
+void LBMManager::getTriggerContents(MapBlock *block,
+	std::vector<content_t> &contents)
+{
+	block->getContents(contents);
+	size_t count = 0;
+	for (size_t i = 0; i < contents.size(); i++) {
+		content_t c = contents[i];
+		if (c < m_trigger_contents.size() && m_trigger_contents[c])
+			contents[count++] = c;
+	}
+	contents.resize(count);
+}
+
+struct LBMBlockTargets
+{
+	LoadingBlockModifierDef *lbm;
+	std::vector<v3s16> positions;
+	std::vector<MapNode> nodes;
+};
+
 void LBMManager::applyLBMs(ServerEnvironment *env, MapBlock *block, u32 stamp)
 {
 	// Precondition, we need m_lbm_lookup to be initialized
 	FATAL_ERROR_IF(m_query_mode == false,
 		"attempted to query on non fully set up LBMManager");
+	lbm_lookup_map::const_iterator it = getLBMsIntroducedAfter(stamp);
+	if (it == m_lbm_lookup.end())
+		return;
+
+	// Summarize the block first, so blocks without any content an LBM
+	// triggers on are done after a single pass without any lookups
+	std::vector<content_t> contents;
+	getTriggerContents(block, contents);
+	if (contents.empty())
+		return;
+
 	v3s16 pos_of_block = block->getPosRelative();
 	v3s16 pos;
 	MapNode n;
 	content_t c;
-	lbm_lookup_map::const_iterator it = getLBMsIntroducedAfter(stamp);
+	std::vector<LBMBlockTargets> targets;
 	for (; it != m_lbm_lookup.end(); ++it) {
-		// Cache previous version to speedup lookup which has a very high performance
-		// penalty on each call
-		content_t previous_c = CONTENT_IGNORE;
-		std::vector<LoadingBlockModifierDef *> *lbm_list = NULL;
+		bool matches = false;
+		for (size_t i = 0; i < contents.size() && !matches; i++)
+			matches = it->second.lookup(contents[i]) != NULL;
+		if (!matches)
+			continue;
 
+		// Collect the matching nodes of every LBM, so each one is
+		// triggered only once for the whole block
+		targets.clear();
+		content_t previous_c = CONTENT_IGNORE;
+		const std::vector<LoadingBlockModifierDef *> *lbm_list = NULL;
 		for (pos.X = 0; pos.X < MAP_BLOCKSIZE; pos.X++)
 			for (pos.Y = 0; pos.Y < MAP_BLOCKSIZE; pos.Y++)
 				for (pos.Z = 0; pos.Z < MAP_BLOCKSIZE; pos.Z++) {
 					n = block->getNodeNoEx(pos);
 					c = n.getContent();
 
-					// If content_t are not matching perform an LBM lookup
 					if (previous_c != c) {
-						lbm_list = (std::vector<LoadingBlockModifierDef *> *)
-							it->second.lookup(c);
+						lbm_list = it->second.lookup(c);
 						previous_c = c;
 					}
 
@@ -287,9 +363,28 @@ void LBMManager::applyLBMs(ServerEnvironment *env, MapBlock *block, u32 stamp)
 						continue;
 					for (std::vector<LoadingBlockModifierDef *>::const_iterator iit =
 						lbm_list->begin(); iit != lbm_list->end(); ++iit) {
-						(*iit)->trigger(env, pos + pos_of_block, n);
+						size_t i = 0;
+						while (i < targets.size() && targets[i].lbm != *iit)
+							i++;
+						if (i == targets.size()) {
+							targets.push_back(LBMBlockTargets());
+							targets[i].lbm = *iit;
+						}
+						targets[i].positions.push_back(pos + pos_of_block);
+						targets[i].nodes.push_back(n);
 					}
 				}
+
+		for (size_t i = 0; i < targets.size(); i++)
+			targets[i].lbm->triggerBlock(env, block, targets[i].positions,
+				targets[i].nodes);
+
+		// The LBMs may have changed the block
+		if (!targets.empty()) {
+			getTriggerContents(block, contents);
+			if (contents.empty())
+				return;
+		}
 	}
 }
 
@@ -297,74 +392,336 @@ void LBMManager::applyLBMs(ServerEnvironment *env, MapBlock *block, u32 stamp)
 	ActiveBlockList
 */
 
-void fillRadiusBlock(v3s16 p0, s16 r, std::set<v3s16> &list)
+static inline u64 spread_bits(u16 v)
+{
+	u64 x = v;
+	x = (x | x << 32) & 0x1f00000000ffffULL;
+	x = (x | x << 16) & 0x1f0000ff0000ffULL;
+	x = (x | x << 8) & 0x100f00f00f00f00fULL;
+	x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+	x = (x | x << 2) & 0x1249249249249249ULL;
+	return x;
+}
+
+// Z-order curve, nearby blocks end up close to each other
+static inline u64 block_locality_key(v3s16 p)
+{
+	return spread_bits((u16)p.X ^ 0x8000) << 2 |
+		spread_bits((u16)p.Y ^ 0x8000) << 1 |
+		spread_bits((u16)p.Z ^ 0x8000);
+}
+
+struct BlockLocalityOrder
+{
+	bool operator()(v3s16 a, v3s16 b) const
+	{
+		return block_locality_key(a) < block_locality_key(b);
+	}
+
+	template <typename T>
+	bool operator()(const std::pair<v3s16, T> &a,
+			const std::pair<v3s16, T> &b) const
+	{
+		return (*this)(a.first, b.first);
+	}
+};
+
+// Integer distances are rounded down, like v3s16::getDistanceFrom
+static inline s32 sphere_radius_sq(s16 radius)
+{
+	return ((s32)radius + 1) * (radius + 1) - 1;
+}
+
+static inline bool in_sphere(v3s16 center, s32 radius_sq, v3s16 p)
+{
+	v3s32 d(p.X - center.X, p.Y - center.Y, p.Z - center.Z);
+	return d.X * d.X + d.Y * d.Y + d.Z * d.Z <= radius_sq;
+}
+
+void ActiveBlockList::addSphere(v3s16 center, s16 radius, s16 change,
+		std::vector<RefChange> &changes)
 {
+	s32 radius_sq = sphere_radius_sq(radius);
 	v3s16 p;
-	for(p.X=p0.X-r; p.X<=p0.X+r; p.X++)
-		for(p.Y=p0.Y-r; p.Y<=p0.Y+r; p.Y++)
-			for(p.Z=p0.Z-r; p.Z<=p0.Z+r; p.Z++)
-			{
-				// limit to a sphere
-				if (p.getDistanceFrom(p0) <= r) {
-					// Set in list
-					list.insert(p);
-				}
-			}
+	for (p.X = center.X - radius; p.X <= center.X + radius; p.X++)
+	for (p.Y = center.Y - radius; p.Y <= center.Y + radius; p.Y++)
+	for (p.Z = center.Z - radius; p.Z <= center.Z + radius; p.Z++) {
+		if (in_sphere(center, radius_sq, p))
+			changes.push_back(RefChange(p, change));
+	}
+}
+
+void ActiveBlockList::moveSphere(v3s16 from, v3s16 to, s16 radius,
+		std::vector<RefChange> &changes)
+{
+	// Only the blocks that are in one of the spheres change
+	s32 radius_sq = sphere_radius_sq(radius);
+	v3s16 minp(MYMIN(from.X, to.X) - radius, MYMIN(from.Y, to.Y) - radius,
+		MYMIN(from.Z, to.Z) - radius);
+	v3s16 maxp(MYMAX(from.X, to.X) + radius, MYMAX(from.Y, to.Y) + radius,
+		MYMAX(from.Z, to.Z) + radius);
+	v3s16 p;
+	for (p.X = minp.X; p.X <= maxp.X; p.X++)
+	for (p.Y = minp.Y; p.Y <= maxp.Y; p.Y++)
+	for (p.Z = minp.Z; p.Z <= maxp.Z; p.Z++) {
+		bool was_in = in_sphere(from, radius_sq, p);
+		bool is_in = in_sphere(to, radius_sq, p);
+		if (was_in != is_in)
+			changes.push_back(RefChange(p, is_in ? 1 : -1));
+	}
 }
 
 void ActiveBlockList::update(std::vector<v3s16> &active_positions,
 	s16 radius,
-	std::set<v3s16> &blocks_removed,
-	std::set<v3s16> &blocks_added)
+	std::vector<v3s16> &blocks_removed,
+	std::vector<v3s16> &blocks_added)
 {
+	BlockLocalityOrder order;
+	std::vector<RefChange> changes;
+
 	/*
-		Create the new list
+		Players that did not move keep their spheres
 	*/
-	std::set<v3s16> newlist = m_forceloaded_list;
-	for(std::vector<v3s16>::iterator i = active_positions.begin();
-		i != active_positions.end(); ++i)
-	{
-		fillRadiusBlock(*i, radius, newlist);
+	std::vector<v3s16> centers(active_positions);
+	std::sort(centers.begin(), centers.end(), order);
+	std::vector<v3s16> gone;
+	std::vector<v3s16> came;
+	if (radius == m_radius) {
+		std::set_difference(m_centers.begin(), m_centers.end(),
+			centers.begin(), centers.end(), std::back_inserter(gone), order);
+		std::set_difference(centers.begin(), centers.end(),
+			m_centers.begin(), m_centers.end(), std::back_inserter(came), order);
+	} else {
+		gone = m_centers;
+		came = centers;
 	}
 
 	/*
-		Find out which blocks on the old list are not on the new list
+		Spheres that overlap their old position are moved, the others
+		are removed and added
 	*/
-	// Go through old list
-	for(std::set<v3s16>::iterator i = m_list.begin();
-		i != m_list.end(); ++i)
-	{
-		v3s16 p = *i;
-		// If not on new list, it's been removed
-		if(newlist.find(p) == newlist.end())
-			blocks_removed.insert(p);
+	for (size_t i = 0; i < came.size(); i++) {
+		size_t nearest = gone.size();
+		s32 d_min = S32_MAX;
+		for (size_t j = 0; j < gone.size() && radius == m_radius; j++) {
+			s32 d = MYMAX(MYMAX(abs(came[i].X - gone[j].X),
+				abs(came[i].Y - gone[j].Y)), abs(came[i].Z - gone[j].Z));
+			if (d < d_min) {
+				d_min = d;
+				nearest = j;
+			}
+		}
+		if (nearest < gone.size() && d_min <= 2 * radius) {
+			moveSphere(gone[nearest], came[i], radius, changes);
+			gone[nearest] = gone.back();
+			gone.pop_back();
+		} else {
+			addSphere(came[i], radius, 1, changes);
+		}
 	}
+	for (size_t j = 0; j < gone.size(); j++)
+		addSphere(gone[j], m_radius, -1, changes);
+	m_centers.swap(centers);
+	m_radius = radius;
 
 	/*
-		Find out which blocks on the new list are not on the old list
+		Forceloaded blocks count like a sphere of radius 0
 	*/
-	// Go through new list
-	for(std::set<v3s16>::iterator i = newlist.begin();
-		i != newlist.end(); ++i)
-	{
-		v3s16 p = *i;
-		// If not on old list, it's been added
-		if(m_list.find(p) == m_list.end())
-			blocks_added.insert(p);
+	std::vector<v3s16> forceloaded(m_forceloaded_list.begin(),
+		m_forceloaded_list.end());
+	std::sort(forceloaded.begin(), forceloaded.end(), order);
+	gone.clear();
+	came.clear();
+	std::set_difference(m_forceloaded.begin(), m_forceloaded.end(),
+		forceloaded.begin(), forceloaded.end(), std::back_inserter(gone), order);
+	std::set_difference(forceloaded.begin(), forceloaded.end(),
+		m_forceloaded.begin(), m_forceloaded.end(), std::back_inserter(came), order);
+	for (size_t i = 0; i < gone.size(); i++)
+		changes.push_back(RefChange(gone[i], -1));
+	for (size_t i = 0; i < came.size(); i++)
+		changes.push_back(RefChange(came[i], 1));
+	m_forceloaded.swap(forceloaded);
+
+	/*
+		Apply the changes to the reference counts, collecting the blocks
+		that came into and went out of range
+	*/
+	std::vector<v3s16> wanted;
+	std::vector<v3s16> unwanted;
+	if (!changes.empty()) {
+		std::sort(changes.begin(), changes.end(), order);
+		std::vector<std::pair<v3s16, u16> > refs;
+		refs.reserve(m_refs.size() + changes.size());
+		size_t i = 0, j = 0;
+		while (i < m_refs.size() || j < changes.size()) {
+			bool old_ref = i < m_refs.size() && (j == changes.size() ||
+				!order(changes[j].first, m_refs[i].first));
+			v3s16 p = old_ref ? m_refs[i].first : changes[j].first;
+			s32 before = old_ref ? m_refs[i++].second : 0;
+			s32 after = before;
+			while (j < changes.size() && changes[j].first == p)
+				after += changes[j++].second;
+
+			if (after > 0)
+				refs.push_back(std::make_pair(p, (u16)after));
+			if (before == 0 && after > 0)
+				wanted.push_back(p);
+			else if (before > 0 && after <= 0)
+				unwanted.push_back(p);
+		}
+		m_refs.swap(refs);
+	}
+
+	/*
+		Find the added and removed blocks
+	*/
+	for (size_t i = 0; i < unwanted.size(); i++) {
+		if (contains(unwanted[i]))
+			blocks_removed.push_back(unwanted[i]);
+	}
+	blocks_added.insert(blocks_added.end(), wanted.begin(), wanted.end());
+	for (size_t i = 0; i < m_retry.size(); i++) {
+		if (std::binary_search(m_refs.begin(), m_refs.end(),
+				std::make_pair(m_retry[i], (u16)0), order))
+			blocks_added.push_back(m_retry[i]);
 	}
+	if (!m_retry.empty())
+		std::sort(blocks_added.begin(), blocks_added.end(), order);
+	m_retry.clear();
 
 	/*
 		Update m_list
 	*/
+	if (blocks_removed.empty() && blocks_added.empty())
+		return;
+	std::vector<v3s16> kept;
+	kept.reserve(m_list.size());
+	std::set_difference(m_list.begin(), m_list.end(),
+		blocks_removed.begin(), blocks_removed.end(),
+		std::back_inserter(kept), order);
 	m_list.clear();
-	for(std::set<v3s16>::iterator i = newlist.begin();
-		i != newlist.end(); ++i)
-	{
-		v3s16 p = *i;
-		m_list.insert(p);
+	std::merge(kept.begin(), kept.end(),
+		blocks_added.begin(), blocks_added.end(),
+		std::back_inserter(m_list), order);
+}
+
+bool ActiveBlockList::contains(v3s16 p) const
+{
+	return std::binary_search(m_list.begin(), m_list.end(), p,
+		BlockLocalityOrder());
+}
+
+void ActiveBlockList::remove(std::vector<v3s16> &blocks)
+{
+	if (blocks.empty())
+		return;
+	BlockLocalityOrder order;
+	std::sort(blocks.begin(), blocks.end(), order);
+	std::vector<v3s16> kept;
+	kept.reserve(m_list.size());
+	std::set_difference(m_list.begin(), m_list.end(),
+		blocks.begin(), blocks.end(), std::back_inserter(kept), order);
+	m_list.swap(kept);
+	m_retry.insert(m_retry.end(), blocks.begin(), blocks.end());
+}
+
+void ActiveBlockList::clear()
+{
+	m_list.clear();
+	m_refs.clear();
+	m_centers.clear();
+	m_forceloaded.clear();
+	m_retry.clear();
+}
+
+/*
+	ObjectPhysicsStepper
+*/
+
+class ObjectPhysicsThread : public Thread
+{
+public:
+	ObjectPhysicsThread(ObjectPhysicsStepper *stepper, int id):
+		Thread("ObjectPhysics" + itos(id)),
+		m_stepper(stepper)
+	{}
+
+	Semaphore m_wake;
+
+protected:
+	void *run();
+
+private:
+	ObjectPhysicsStepper *m_stepper;
+};
+
+ObjectPhysicsStepper::ObjectPhysicsStepper(u16 nthreads):
+	m_objects(NULL),
+	m_dtime(0),
+	m_next(0)
+{
+	for (u16 i = 0; i < nthreads; i++) {
+		ObjectPhysicsThread *thread = new ObjectPhysicsThread(this, i);
+		m_threads.push_back(thread);
+		thread->start();
+	}
+}
+
+ObjectPhysicsStepper::~ObjectPhysicsStepper()
+{
+	for (size_t i = 0; i < m_threads.size(); i++) {
+		ObjectPhysicsThread *thread = m_threads[i];
+		thread->stop();
+		thread->m_wake.post();
+		thread->wait();
+		delete thread;
 	}
 }
 
+void ObjectPhysicsStepper::run(const std::vector<ServerActiveObject *> &objects,
+	float dtime)
+{
+	m_objects = &objects;
+	m_dtime = dtime;
+	m_next = 0;
+
+	for (size_t i = 0; i < m_threads.size(); i++)
+		m_threads[i]->m_wake.post();
+
+	work();
+
+	for (size_t i = 0; i < m_threads.size(); i++)
+		m_done.wait();
+
+	m_objects = NULL;
+}
+
+void ObjectPhysicsStepper::work()
+{
+	const u32 count = m_objects->size();
+	u32 i;
+	while ((i = m_next++) < count)
+		(*m_objects)[i]->stepPhysics(m_dtime);
+}
+
+void *ObjectPhysicsThread::run()
+{
+	DSTACK(FUNCTION_NAME);
+	BEGIN_DEBUG_EXCEPTION_HANDLER
+
+	for (;;) {
+		m_wake.wait();
+		if (stopRequested())
+			break;
+
+		m_stepper->work();
+		m_stepper->m_done.post();
+	}
+
+	END_DEBUG_EXCEPTION_HANDLER
+	return NULL;
+}
+
 /*
 	ServerEnvironment
 */
@@ -378,13 +735,19 @@ ServerEnvironment::ServerEnvironment(ServerMap *map,
 	m_server(server),
 	m_path_world(path_world),
 	m_send_recommended_timer(0),
-	m_active_block_interval_overload_skip(0),
+	m_abm_handler(NULL),
+	m_abm_queue_next(0),
+	m_abm_pass_time(0),
+	m_abm_time_budget(g_settings->getFloat("abm_time_budget")),
 	m_game_time(0),
 	m_game_time_fraction_counter(0),
 	m_last_clear_objects_time(0),
 	m_recommended_send_interval(0.1),
 	m_max_lag_estimate(0.1),
-	m_player_database(NULL)
+	m_player_database(NULL),
+	m_physics_stepper(NULL),
+	m_pathfinder(NULL),
+	m_navigation_cache(NULL)
 {
 	// Determine which database backend to use
 	std::string conf_path = path_world + DIR_DELIM + "world.mt";
@@ -407,21 +770,42 @@ ServerEnvironment::ServerEnvironment(ServerMap *map,
 	std::string name = "";
 	conf.getNoEx("player_backend", name);
 	m_player_database = openPlayerDatabase(name, path_world, conf);
+
+	// If unspecified, leave a proc for the main thread (which takes part
+	// in the work) and one for the emerge thread
+	s16 nthreads = 0;
+	if (!g_settings->getS16NoEx("num_object_physics_threads", nthreads))
+		nthreads = Thread::getNumberOfProcessors() - 2;
+	if (nthreads > 0) {
+		m_physics_stepper = new ObjectPhysicsStepper(nthreads);
+		infostream << "ServerEnvironment: using " << nthreads
+			<< " object physics threads" << std::endl;
+	}
 }
 
 ServerEnvironment::~ServerEnvironment()
 {
 	// Clear active block list.
 	// This makes the next one delete all active objects.
+	for (std::vector<v3s16>::iterator i = m_active_blocks.m_list.begin();
+			i != m_active_blocks.m_list.end(); ++i) {
+		MapBlock *block = m_map->getBlockNoCreateNoEx(*i);
+		if (block)
+			block->m_node_timers.detach();
+	}
 	m_active_blocks.clear();
 
 	// Convert all objects to static and delete the active objects
 	deactivateFarObjects(true);
 
+	if (m_navigation_cache)
+		m_map->removeEventReceiver(m_navigation_cache);
+
 	// Drop/delete map
 	m_map->drop();
 
 	// Delete ActiveBlockModifiers
+	clearABMPass();
 	for (std::vector<ABMWithState>::iterator
 		i = m_abms.begin(); i != m_abms.end(); ++i){
 		delete i->abm;
@@ -434,6 +818,10 @@ ServerEnvironment::~ServerEnvironment()
 	}
 
 	delete m_player_database;
+
+	delete m_physics_stepper;
+	delete m_pathfinder;
+	delete m_navigation_cache;
 }
 
 Map & ServerEnvironment::getMap()
@@ -446,6 +834,22 @@ ServerMap & ServerEnvironment::getServerMap()
 	return *m_map;
 }
 
+Pathfinder &ServerEnvironment::getPathfinder()
+{
+	if (m_pathfinder == NULL)
+		m_pathfinder = new Pathfinder(&getNavigationCache());
+	return *m_pathfinder;
+}
+
+NavigationCache &ServerEnvironment::getNavigationCache()
+{
+	if (m_navigation_cache == NULL) {
+		m_navigation_cache = new NavigationCache();
+		m_map->addEventReceiver(m_navigation_cache);
+	}
+	return *m_navigation_cache;
+}
+
 RemotePlayer *ServerEnvironment::getPlayer(const u16 peer_id)
 {
 	for (std::vector<RemotePlayer *>::iterator i = m_players.begin();
@@ -723,6 +1127,10 @@ class ABMHandler
 					continue;
 				i->timer -= trigger_interval;
 				actual_interval = trigger_interval;
+				// A pass longer than the interval must not build up a
+				// backlog that would make the ABM fire on every later pass
+				if (i->timer > trigger_interval)
+					i->timer = trigger_interval;
 			}
 			float chance = abm->getTriggerChance();
 			if(chance == 0)
@@ -876,6 +1284,109 @@ class ABMHandler
 	}
 };
 
+void ServerEnvironment::getPlayerBlockPositions(std::vector<v3s16> &positions)
+{
+	for (std::vector<RemotePlayer *>::iterator i = m_players.begin();
+		i != m_players.end(); ++i) {
+		RemotePlayer *player = dynamic_cast<RemotePlayer *>(*i);
+		assert(player);
+
+		// Ignore disconnected players
+		if (player->peer_id == 0)
+			continue;
+
+		PlayerSAO *playersao = player->getPlayerSAO();
+		assert(playersao);
+
+		positions.push_back(getNodeBlockPos(
+			floatToInt(playersao->getBasePosition(), BS)));
+	}
+}
+
+void ServerEnvironment::clearABMPass()
+{
+	delete m_abm_handler;
+	m_abm_handler = NULL;
+	m_abm_queue.clear();
+	m_abm_queue_next = 0;
+}
+
+void ServerEnvironment::stepABMs(float dtime)
+{
+	m_abm_pass_time += dtime;
+
+	/*
+		Start a new pass once the previous one is done and the interval
+		has passed. Each ABM fires at most once per pass.
+	*/
+	if (!m_abm_handler && m_abm_pass_time >= m_cache_abm_interval) {
+		ScopeProfiler sp(g_profiler, "SEnv: start ABM pass avg", SPT_AVG);
+		m_abm_handler = new ABMHandler(m_abms, m_abm_pass_time, this, true);
+		m_abm_pass_time = 0;
+
+		// Order the blocks by distance to the nearest player
+		std::vector<v3s16> players_blockpos;
+		getPlayerBlockPositions(players_blockpos);
+		std::vector<std::pair<s32, v3s16> > sorted;
+		sorted.reserve(m_active_blocks.m_list.size());
+		for (std::vector<v3s16>::const_iterator i = m_active_blocks.m_list.begin();
+				i != m_active_blocks.m_list.end(); ++i) {
+			s32 d_min = S32_MAX;
+			for (size_t j = 0; j < players_blockpos.size(); j++) {
+				v3s32 d(i->X - players_blockpos[j].X,
+					i->Y - players_blockpos[j].Y,
+					i->Z - players_blockpos[j].Z);
+				d_min = MYMIN(d_min, d.X * d.X + d.Y * d.Y + d.Z * d.Z);
+			}
+			sorted.push_back(std::make_pair(d_min, *i));
+		}
+		std::sort(sorted.begin(), sorted.end());
+		for (size_t i = 0; i < sorted.size(); i++)
+			m_abm_queue.push_back(sorted[i].second);
+	}
+
+	if (!m_abm_handler)
+		return;
+
+	ScopeProfiler sp(g_profiler, "SEnv: modify in blocks avg per step", SPT_AVG);
+	TraceScope trace("SEnv: ABMs");
+
+	// At least one block is handled per step, so every pass ends.
+	// Without a budget the whole pass runs in the step that started it.
+	bool limited = m_abm_time_budget > 0;
+	u64 end_us = porting::getTimeUs() + dtime * m_abm_time_budget * 1000000;
+	u32 handled = 0;
+	while (m_abm_queue_next < m_abm_queue.size()) {
+		if (limited && handled > 0 && porting::getTimeUs() >= end_us)
+			break;
+		v3s16 p = m_abm_queue[m_abm_queue_next++];
+
+		// Blocks may have become inactive since the pass started
+		if (!m_active_blocks.contains(p))
+			continue;
+		MapBlock *block = m_map->getBlockNoCreateNoEx(p);
+		if (block == NULL)
+			continue;
+
+		// Set current time as timestamp
+		block->setTimestampNoChangedFlag(m_game_time);
+
+		/* Handle ActiveBlockModifiers */
+		m_abm_handler->apply(block);
+		handled++;
+	}
+	g_profiler->avg("SEnv: ABM blocks per step", handled);
+
+	if (m_abm_queue_next < m_abm_queue.size())
+		return;
+
+	// Share of the configured ABM rate that was achieved
+	float pass_time = MYMAX(m_abm_pass_time, m_cache_abm_interval);
+	g_profiler->avg("SEnv: ABM coverage %",
+		100.0f * m_cache_abm_interval / pass_time);
+	clearABMPass();
+}
+
 void ServerEnvironment::activateBlock(MapBlock *block, u32 additional_dtime)
 {
 	// Reset usage timer immediately, otherwise a block that becomes active
@@ -1161,6 +1672,7 @@ void ServerEnvironment::step(float dtime)
 	DSTACK(FUNCTION_NAME);
 
 	//TimeTaker timer("ServerEnv step");
+	TraceScope trace("ServerEnvironment::step");
 
 	/* Step time of day */
 	stepTimeOfDay(dtime);
@@ -1186,6 +1698,7 @@ void ServerEnvironment::step(float dtime)
 	*/
 	{
 		ScopeProfiler sp(g_profiler, "SEnv: handle players avg", SPT_AVG);
+		TraceScope trace("SEnv: handle players");
 		for (std::vector<RemotePlayer *>::iterator i = m_players.begin();
 			i != m_players.end(); ++i) {
 			RemotePlayer *player = dynamic_cast<RemotePlayer *>(*i);
@@ -1205,33 +1718,19 @@ void ServerEnvironment::step(float dtime)
 	*/
 	if (m_active_blocks_management_interval.step(dtime, m_cache_active_block_mgmt_interval)) {
 		ScopeProfiler sp(g_profiler, "SEnv: manage act. block list avg per interval", SPT_AVG);
+		TraceScope trace("SEnv: manage active blocks");
 		/*
 			Get player block positions
 		*/
 		std::vector<v3s16> players_blockpos;
-		for (std::vector<RemotePlayer *>::iterator i = m_players.begin();
-			i != m_players.end(); ++i) {
-			RemotePlayer *player = dynamic_cast<RemotePlayer *>(*i);
-			assert(player);
-
-			// Ignore disconnected players
-			if (player->peer_id == 0)
-				continue;
-
-			PlayerSAO *playersao = player->getPlayerSAO();
-			assert(playersao);
-
-			v3s16 blockpos = getNodeBlockPos(
-				floatToInt(playersao->getBasePosition(), BS));
-			players_blockpos.push_back(blockpos);
-		}
+		getPlayerBlockPositions(players_blockpos);
 
 		/*
 			Update list of active blocks, collecting changes
 		*/
 		static const s16 active_block_range = g_settings->getS16("active_block_range");
-		std::set<v3s16> blocks_removed;
-		std::set<v3s16> blocks_added;
+		std::vector<v3s16> blocks_removed;
+		std::vector<v3s16> blocks_added;
 		m_active_blocks.update(players_blockpos, active_block_range,
 			blocks_removed, blocks_added);
 
@@ -1242,7 +1741,7 @@ void ServerEnvironment::step(float dtime)
 		// Convert active objects that are no more in active blocks to static
 		deactivateFarObjects(false);
 
-		for(std::set<v3s16>::iterator
+		for(std::vector<v3s16>::iterator
 			i = blocks_removed.begin();
 			i != blocks_removed.end(); ++i) {
 			v3s16 p = *i;
@@ -1256,13 +1755,20 @@ void ServerEnvironment::step(float dtime)
 
 			// Set current time as timestamp (and let it set ChangedFlag)
 			block->setTimestamp(m_game_time);
+
+			// Stop the node timers
+			block->m_node_timers.detach();
+
+			// Nodes of inactive blocks are rarely written
+			block->compact();
 		}
 
 		/*
 			Handle added blocks
 		*/
 
-		for(std::set<v3s16>::iterator
+		std::vector<v3s16> blocks_failed;
+		for(std::vector<v3s16>::iterator
 			i = blocks_added.begin();
 			i != blocks_added.end(); ++i)
 		{
@@ -1270,7 +1776,7 @@ void ServerEnvironment::step(float dtime)
 
 			MapBlock *block = m_map->getBlockOrEmerge(p);
 			if(block==NULL){
-				m_active_blocks.m_list.erase(p);
+				blocks_failed.push_back(p);
 				continue;
 			}
 
@@ -1278,6 +1784,19 @@ void ServerEnvironment::step(float dtime)
 			/* infostream<<"Server: Block " << PP(p)
 				<< " became active"<<std::endl; */
 		}
+		m_active_blocks.remove(blocks_failed);
+
+		/*
+			Let the node timers of active blocks run, this includes blocks
+			that were reloaded while active
+		*/
+		for (std::vector<v3s16>::iterator i = m_active_blocks.m_list.begin();
+				i != m_active_blocks.m_list.end(); ++i) {
+			MapBlock *block = m_map->getBlockNoCreateNoEx(*i);
+			if (block != NULL &&
+					!block->m_node_timers.isAttached(&m_node_timer_scheduler))
+				block->m_node_timers.attach(&m_node_timer_scheduler, *i);
+		}
 	}
 
 	/*
@@ -1285,20 +1804,12 @@ void ServerEnvironment::step(float dtime)
 	*/
 	if (m_active_blocks_nodemetadata_interval.step(dtime, m_cache_nodetimer_interval)) {
 		ScopeProfiler sp(g_profiler, "SEnv: mess in act. blocks avg per interval", SPT_AVG);
+		TraceScope trace("SEnv: node timers");
 
-		float dtime = m_cache_nodetimer_interval;
-
-		for(std::set<v3s16>::iterator
-			i = m_active_blocks.m_list.begin();
-			i != m_active_blocks.m_list.end(); ++i)
-		{
-			v3s16 p = *i;
-
-			/*infostream<<"Server: Block ("<<p.X<<","<<p.Y<<","<<p.Z
-					<<") being handled"<<std::endl;*/
-
-			MapBlock *block = m_map->getBlockNoCreateNoEx(p);
-			if(block==NULL)
+		for (std::vector<v3s16>::iterator i = m_active_blocks.m_list.begin();
+				i != m_active_blocks.m_list.end(); ++i) {
+			MapBlock *block = m_map->getBlockNoCreateNoEx(*i);
+			if (block == NULL)
 				continue;
 
 			// Reset block usage timer
@@ -1311,67 +1822,37 @@ void ServerEnvironment::step(float dtime)
 			if(block->getTimestamp() > block->getDiskTimestamp() + 60)
 				block->raiseModified(MOD_STATE_WRITE_AT_UNLOAD,
 					MOD_REASON_BLOCK_EXPIRED);
+		}
+
+		// Only blocks with due timers are visited
+		std::vector<NodeTimerScheduler::Entry> due;
+		m_node_timer_scheduler.step(m_cache_nodetimer_interval, due);
+		g_profiler->avg("SEnv: blocks with due node timers", due.size());
+		g_profiler->avg("SEnv: scheduled node timer blocks",
+			m_node_timer_scheduler.size());
+
+		for (size_t i = 0; i < due.size(); i++) {
+			MapBlock *block = m_map->getBlockNoCreateNoEx(due[i].second);
+			if (block == NULL ||
+					!block->m_node_timers.isAttached(&m_node_timer_scheduler))
+				continue;
 
-			// Run node timers
 			std::vector<NodeTimer> elapsed_timers =
-				block->m_node_timers.step((float)dtime);
-			if (!elapsed_timers.empty()) {
-				MapNode n;
-				for (std::vector<NodeTimer>::iterator i = elapsed_timers.begin();
-					i != elapsed_timers.end(); ++i) {
-					n = block->getNodeNoEx(i->position);
-					p = i->position + block->getPosRelative();
-					if (m_script->node_on_timer(p, n, i->elapsed)) {
-						block->setNodeTimer(NodeTimer(
-							i->timeout, 0, i->position));
-					}
+				block->m_node_timers.stepScheduled(due[i].first);
+			MapNode n;
+			for (std::vector<NodeTimer>::iterator t = elapsed_timers.begin();
+				t != elapsed_timers.end(); ++t) {
+				n = block->getNodeNoEx(t->position);
+				v3s16 p = t->position + block->getPosRelative();
+				if (m_script->node_on_timer(p, n, t->elapsed)) {
+					block->setNodeTimer(NodeTimer(
+						t->timeout, 0, t->position));
 				}
 			}
 		}
 	}
 
-	if (m_active_block_modifier_interval.step(dtime, m_cache_abm_interval))
-		do{ // breakable
-			if(m_active_block_interval_overload_skip > 0){
-				ScopeProfiler sp(g_profiler, "SEnv: ABM overload skips");
-				m_active_block_interval_overload_skip--;
-				break;
-			}
-			ScopeProfiler sp(g_profiler, "SEnv: modify in blocks avg per interval", SPT_AVG);
-			TimeTaker timer("modify in active blocks per interval");
-
-			// Initialize handling of ActiveBlockModifiers
-			ABMHandler abmhandler(m_abms, m_cache_abm_interval, this, true);
-
-			for(std::set<v3s16>::iterator
-				i = m_active_blocks.m_list.begin();
-				i != m_active_blocks.m_list.end(); ++i)
-			{
-				v3s16 p = *i;
-
-				/*infostream<<"Server: Block ("<<p.X<<","<<p.Y<<","<<p.Z
-						<<") being handled"<<std::endl;*/
-
-				MapBlock *block = m_map->getBlockNoCreateNoEx(p);
-				if(block == NULL)
-					continue;
-
-				// Set current time as timestamp
-				block->setTimestampNoChangedFlag(m_game_time);
-
-				/* Handle ActiveBlockModifiers */
-				abmhandler.apply(block);
-			}
-
-			u32 time_ms = timer.stop(true);
-			u32 max_time_ms = 200;
-			if(time_ms > max_time_ms){
-				warningstream<<"active block modifiers took "
-					<<time_ms<<"ms (longer than "
-					<<max_time_ms<<"ms)"<<std::endl;
-				m_active_block_interval_overload_skip = (time_ms / max_time_ms) + 1;
-			}
-		}while(0);
+	stepABMs(dtime);
 
 	/*
 		Step script environment (run global on_step())
@@ -1383,6 +1864,7 @@ void ServerEnvironment::step(float dtime)
 	*/
 	{
 		ScopeProfiler sp(g_profiler, "SEnv: step act. objs avg", SPT_AVG);
+		TraceScope trace("SEnv: step objects");
 		//TimeTaker timer("Step active objects");
 
 		g_profiler->avg("SEnv: num of objects", m_active_objects.size());
@@ -1396,13 +1878,17 @@ void ServerEnvironment::step(float dtime)
 			send_recommended = true;
 		}
 
+		// Movement first, in parallel where possible
+		stepObjectPhysics(dtime);
+
 		for(ActiveObjectMap::iterator i = m_active_objects.begin();
 			i != m_active_objects.end(); ++i) {
 			ServerActiveObject* obj = i->second;
 			if (obj->isGone())
 				continue;
 
-			// Step object
+			// Step object (Lua callbacks, messages and any movement
+			// that wasn't done by stepObjectPhysics())
 			obj->step(dtime, send_recommended);
 			// Read messages from object
 			while (!obj->m_messages_out.empty()) {
@@ -1418,6 +1904,7 @@ void ServerEnvironment::step(float dtime)
 	if(m_object_management_interval.step(dtime, 0.5))
 	{
 		ScopeProfiler sp(g_profiler, "SEnv: remove removed objs avg /.5s", SPT_AVG);
+		TraceScope trace("SEnv: remove objects");
 		removeRemovedObjects();
 	}
 
@@ -1442,6 +1929,36 @@ void ServerEnvironment::step(float dtime)
 	}
 }
 
+void ServerEnvironment::stepObjectPhysics(float dtime)
+{
+	if (m_physics_stepper == NULL ||
+			m_active_objects.size() < OBJECT_PHYSICS_MIN_BATCH)
+		return;
+
+	ScopeProfiler sp(g_profiler, "SEnv: step obj. physics avg", SPT_AVG);
+	TraceScope trace("SEnv: object physics");
+
+	std::vector<ServerActiveObject *> objects;
+	objects.reserve(m_active_objects.size());
+	for (ActiveObjectMap::iterator i = m_active_objects.begin();
+			i != m_active_objects.end(); ++i) {
+		ServerActiveObject *obj = i->second;
+		if (!obj->isGone())
+			objects.push_back(obj);
+	}
+
+	/*
+		Nothing else touches the map or the objects meanwhile: the caller
+		holds the environment lock, and the worker threads only read
+		shared state until finishPhysics() is called below.
+	*/
+	m_physics_stepper->run(objects, dtime);
+
+	for (std::vector<ServerActiveObject *>::iterator i = objects.begin();
+			i != objects.end(); ++i)
+		(*i)->finishPhysics();
+}
+
 u32 ServerEnvironment::addParticleSpawner(float exptime)
 {
 	// Timers with lifetime 0 do not expire
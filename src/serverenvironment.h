@@ -23,6 +23,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "environment.h"
 #include "mapnode.h"
 #include "mapblock.h"
+#include "threading/atomic.h"
+#include "threading/semaphore.h"
 #include <set>
 
 class IGameDef;
@@ -37,6 +39,10 @@ struct StaticObject;
 class ServerActiveObject;
 class Server;
 class ServerScripting;
+class ObjectPhysicsThread;
+class ABMHandler;
+class Pathfinder;
+class NavigationCache;
 
 /*
 	{Active, Loading} block modifier interface.
@@ -85,6 +91,16 @@ struct LoadingBlockModifierDef
 
 	virtual ~LoadingBlockModifierDef() {}
 	virtual void trigger(ServerEnvironment *env, v3s16 p, MapNode n){};
+	// Called once per block with all matching nodes, in block order.
+	// By default trigger() is called for each of them that is still
+	// there, see refreshNode().
+	virtual void triggerBlock(ServerEnvironment *env, MapBlock *block,
+		const std::vector<v3s16> &positions, const std::vector<MapNode> &nodes);
+
+	// Reads the node at p from the block again, as earlier actions may
+	// have changed it. Returns false if its content is not the one of n
+	// anymore.
+	static bool refreshNode(MapBlock *block, v3s16 p, MapNode &n);
 };
 
 struct LBMContentMapping
@@ -139,6 +155,11 @@ class LBMManager
 	// For m_query_mode == true:
 	// The key of the map is the LBM def's first introduction time.
 	lbm_lookup_map m_lbm_lookup;
+	// Indexed by content_t, true if any LBM triggers on the content
+	std::vector<bool> m_trigger_contents;
+
+	// Collects the distinct contents of the block that any LBM triggers on
+	void getTriggerContents(MapBlock *block, std::vector<content_t> &contents);
 
 	// Returns an iterator to the LBMs that were introduced
 	// after the given time. This is guaranteed to return
@@ -151,26 +172,77 @@ class LBMManager
 	List of active blocks, used by ServerEnvironment
 */
 
+/*
+	The blocks around players and the forceloaded blocks.
+
+	Every block counts the player spheres and forceloads that cover it.
+	Updates only walk the spheres of players that moved, and only the
+	blocks whose count changed are compared against the active list.
+*/
 class ActiveBlockList
 {
 public:
+	ActiveBlockList(): m_radius(-1) {}
+
+	// The added and removed blocks are returned in locality order
 	void update(std::vector<v3s16> &active_positions,
 		s16 radius,
-		std::set<v3s16> &blocks_removed,
-		std::set<v3s16> &blocks_added);
+		std::vector<v3s16> &blocks_removed,
+		std::vector<v3s16> &blocks_added);
+
+	bool contains(v3s16 p) const;
 
-	bool contains(v3s16 p){
-		return (m_list.find(p) != m_list.end());
-	}
+	// Deactivates blocks that could not be loaded. They are added again on
+	// the next update as long as they are in range.
+	void remove(std::vector<v3s16> &blocks);
 
-	void clear(){
-		m_list.clear();
-	}
+	void clear();
 
-	std::set<v3s16> m_list;
+	// Active blocks in locality order
+	std::vector<v3s16> m_list;
 	std::set<v3s16> m_forceloaded_list;
 
 private:
+	typedef std::pair<v3s16, s16> RefChange;
+
+	void addSphere(v3s16 center, s16 radius, s16 change,
+		std::vector<RefChange> &changes);
+	void moveSphere(v3s16 from, v3s16 to, s16 radius,
+		std::vector<RefChange> &changes);
+
+	// Sorted in locality order, blocks without references are left out
+	std::vector<std::pair<v3s16, u16> > m_refs;
+	// Player positions and forceloaded blocks of the last update
+	std::vector<v3s16> m_centers;
+	std::vector<v3s16> m_forceloaded;
+	s16 m_radius;
+	// Blocks that were removed while still in range
+	std::vector<v3s16> m_retry;
+};
+
+/*
+	Runs ServerActiveObject::stepPhysics() for a batch of objects on a
+	number of worker threads. The calling thread works on the batch too,
+	and run() only returns once all of it is done.
+*/
+class ObjectPhysicsStepper
+{
+public:
+	ObjectPhysicsStepper(u16 nthreads);
+	~ObjectPhysicsStepper();
+
+	void run(const std::vector<ServerActiveObject *> &objects, float dtime);
+
+	// Steps objects from the current batch until none are left
+	void work();
+
+	Semaphore m_done;
+
+private:
+	std::vector<ObjectPhysicsThread *> m_threads;
+	const std::vector<ServerActiveObject *> *m_objects;
+	float m_dtime;
+	Atomic<u32> m_next;
 };
 
 /*
@@ -204,6 +276,12 @@ class ServerEnvironment : public Environment
 
 	ServerMap & getServerMap();
 
+	// Keeps its buffers between searches
+	Pathfinder &getPathfinder();
+
+	// Walkability of the map, updated by the map edit events
+	NavigationCache &getNavigationCache();
+
 	//TODO find way to remove this fct!
 	ServerScripting* getScriptIface()
 	{ return m_script; }
@@ -362,6 +440,23 @@ class ServerEnvironment : public Environment
 	*/
 	u16 addActiveObjectRaw(ServerActiveObject *object, bool set_changed, u32 dtime_s);
 
+	/*
+		Run the movement of all objects that support it
+		(ServerActiveObject::stepPhysics) on the physics worker threads
+	*/
+	void stepObjectPhysics(float dtime);
+
+	/*
+		Run ActiveBlockModifiers. Each pass goes through the active blocks
+		nearest to the players first and is spread over as many steps as
+		the time budget requires.
+	*/
+	void stepABMs(float dtime);
+	void clearABMPass();
+
+	// Block positions of all connected players
+	void getPlayerBlockPositions(std::vector<v3s16> &positions);
+
 	/*
 		Remove all objects that satisfy (isGone() && m_known_by_count==0)
 	*/
@@ -413,9 +508,17 @@ class ServerEnvironment : public Environment
 	// List of active blocks
 	ActiveBlockList m_active_blocks;
 	IntervalLimiter m_active_blocks_management_interval;
-	IntervalLimiter m_active_block_modifier_interval;
 	IntervalLimiter m_active_blocks_nodemetadata_interval;
-	int m_active_block_interval_overload_skip;
+	// Due times of the node timers of active blocks
+	NodeTimerScheduler m_node_timer_scheduler;
+	// ABM pass in progress, NULL if none
+	ABMHandler *m_abm_handler;
+	std::vector<v3s16> m_abm_queue;
+	size_t m_abm_queue_next;
+	// Time since the current or last ABM pass started
+	float m_abm_pass_time;
+	// Fraction of each step ABMs may take
+	float m_abm_time_budget;
 	// Time from the beginning of the game in seconds.
 	// Incremented in step().
 	u32 m_game_time;
@@ -438,6 +541,13 @@ class ServerEnvironment : public Environment
 
 	PlayerDatabase *m_player_database;
 
+	// Worker threads for stepObjectPhysics(), NULL if disabled
+	ObjectPhysicsStepper *m_physics_stepper;
+
+	// Created on first use
+	Pathfinder *m_pathfinder;
+	NavigationCache *m_navigation_cache;
+
 	// Particles
 	IntervalLimiter m_particle_management_interval;
 	UNORDERED_MAP<u32, float> m_particle_spawners;
@@ -108,6 +108,22 @@ class ServerActiveObject : public ActiveObject
 	*/
 	virtual void step(float dtime, bool send_recommended){}
 
+	/*
+		Optional movement phase that runs before step().
+
+		ServerEnvironment calls stepPhysics() for many objects at once
+		from its physics worker threads. It must not call into Lua and
+		must only read shared state (the map, other objects); changes
+		visible to other objects, like the new position, are kept aside
+		until finishPhysics() is called serially afterwards.
+
+		Return false if the object does all its movement in step().
+	*/
+	virtual bool stepPhysics(float dtime)
+	{ return false; }
+	virtual void finishPhysics()
+	{}
+
 	/*
 		The return value of this is passed to the client-side object
 		when it is created
@@ -0,0 +1,188 @@
+/*
+MultiCraft
+Copyright (C) 2026 MultiCraft Development Team
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "tracer.h"
+#include <algorithm>
+#include <map>
+#include "threading/mutex_auto_lock.h"
+#include "util/basic_macros.h"
+#include "util/serialize.h"
+#include "debug.h"
+#include "log.h"
+
+static Tracer main_tracer;
+Tracer *g_tracer = &main_tracer;
+
+Tracer::Tracer() :
+	m_enabled(false)
+{
+#ifdef _WIN32
+	m_buffer_key = TlsAlloc();
+	FATAL_ERROR_IF(m_buffer_key == TLS_OUT_OF_INDEXES,
+		"Tracer: TlsAlloc() failed");
+#else
+	FATAL_ERROR_IF(pthread_key_create(&m_buffer_key, NULL) != 0,
+		"Tracer: pthread_key_create() failed");
+#endif
+}
+
+Tracer::~Tracer()
+{
+#ifdef _WIN32
+	TlsFree(m_buffer_key);
+#else
+	pthread_key_delete(m_buffer_key);
+#endif
+	for (size_t i = 0; i < m_buffers.size(); i++)
+		delete m_buffers[i];
+}
+
+Tracer::ThreadBuffer *Tracer::getThreadBuffer()
+{
+#ifdef _WIN32
+	ThreadBuffer *buffer = (ThreadBuffer *)TlsGetValue(m_buffer_key);
+#else
+	ThreadBuffer *buffer = (ThreadBuffer *)pthread_getspecific(m_buffer_key);
+#endif
+	if (buffer)
+		return buffer;
+	return addThreadBuffer();
+}
+
+Tracer::ThreadBuffer *Tracer::addThreadBuffer()
+{
+	ThreadBuffer *buffer = new ThreadBuffer;
+	buffer->thread_name = g_logger.getThreadName();
+	buffer->next = 0;
+	{
+		MutexAutoLock lock(m_buffers_mutex);
+		buffer->tid = m_buffers.size() + 1;
+		m_buffers.push_back(buffer);
+	}
+#ifdef _WIN32
+	TlsSetValue(m_buffer_key, buffer);
+#else
+	pthread_setspecific(m_buffer_key, buffer);
+#endif
+	return buffer;
+}
+
+void Tracer::record(const char *name, u64 start_us, u64 end_us)
+{
+	ThreadBuffer *buffer = getThreadBuffer();
+	TraceEvent event;
+	event.name = name;
+	event.start_us = start_us;
+	event.duration_us = end_us > start_us ?
+		MYMIN(end_us - start_us, (u64)U32_MAX) : 0;
+
+	MutexAutoLock lock(buffer->mutex);
+	if (buffer->events.size() < TRACER_BUFFER_SIZE) {
+		buffer->events.push_back(event);
+		return;
+	}
+	buffer->events[buffer->next] = event;
+	buffer->next = (buffer->next + 1) % TRACER_BUFFER_SIZE;
+}
+
+static bool cmp_phase_total(const TracePhaseStats &a, const TracePhaseStats &b)
+{
+	return a.total_us > b.total_us;
+}
+
+void Tracer::getPhaseStats(std::vector<TracePhaseStats> &stats, u64 since_us)
+{
+	std::map<std::string, std::vector<u32> > durations;
+	{
+		MutexAutoLock lock(m_buffers_mutex);
+		for (size_t i = 0; i < m_buffers.size(); i++) {
+			ThreadBuffer *buffer = m_buffers[i];
+			MutexAutoLock buffer_lock(buffer->mutex);
+			for (size_t j = 0; j < buffer->events.size(); j++) {
+				const TraceEvent &event = buffer->events[j];
+				if (event.start_us >= since_us)
+					durations[event.name].push_back(event.duration_us);
+			}
+		}
+	}
+
+	stats.clear();
+	for (std::map<std::string, std::vector<u32> >::iterator it =
+			durations.begin(); it != durations.end(); ++it) {
+		std::vector<u32> &d = it->second;
+		std::sort(d.begin(), d.end());
+
+		TracePhaseStats s;
+		s.name = it->first;
+		s.count = d.size();
+		s.total_us = 0;
+		for (size_t i = 0; i < d.size(); i++)
+			s.total_us += d[i];
+		// Nearest-rank percentiles
+		s.p50_us = d[(d.size() - 1) * 50 / 100];
+		s.p99_us = d[(d.size() - 1) * 99 / 100];
+		s.max_us = d.back();
+		stats.push_back(s);
+	}
+	std::sort(stats.begin(), stats.end(), cmp_phase_total);
+}
+
+void Tracer::writeChromeTrace(std::ostream &os)
+{
+	MutexAutoLock lock(m_buffers_mutex);
+	bool first = true;
+	os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	for (size_t i = 0; i < m_buffers.size(); i++) {
+		ThreadBuffer *buffer = m_buffers[i];
+		MutexAutoLock buffer_lock(buffer->mutex);
+		if (buffer->events.empty())
+			continue;
+
+		if (!first)
+			os << ",";
+		first = false;
+		os << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+			<< buffer->tid << ",\"args\":{\"name\":"
+			<< serializeJsonString(buffer->thread_name) << "}}";
+
+		// Oldest event first
+		size_t count = buffer->events.size();
+		for (size_t j = 0; j < count; j++) {
+			const TraceEvent &event =
+				buffer->events[(buffer->next + j) % count];
+			os << ",\n{\"name\":" << serializeJsonString(event.name)
+				<< ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+				<< ",\"ts\":" << event.start_us
+				<< ",\"dur\":" << event.duration_us << "}";
+		}
+	}
+	os << "\n]}\n";
+}
+
+void Tracer::clear()
+{
+	MutexAutoLock lock(m_buffers_mutex);
+	for (size_t i = 0; i < m_buffers.size(); i++) {
+		ThreadBuffer *buffer = m_buffers[i];
+		MutexAutoLock buffer_lock(buffer->mutex);
+		// Also frees the memory of threads that are gone
+		std::vector<TraceEvent>().swap(buffer->events);
+		buffer->next = 0;
+	}
+}
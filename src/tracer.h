@@ -0,0 +1,134 @@
+/*
+MultiCraft
+Copyright (C) 2026 MultiCraft Development Team
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef TRACER_HEADER
+#define TRACER_HEADER
+
+#include "irrlichttypes.h"
+#include <string>
+#include <vector>
+#include <ostream>
+#ifndef _WIN32
+	#include <pthread.h>
+#endif
+
+#include "threading/mutex.h"
+#include "threading/atomic.h"
+#include "porting.h"
+#include "threads.h"
+
+// Number of events kept per thread before the oldest ones are overwritten
+#define TRACER_BUFFER_SIZE 32768
+
+class Tracer;
+extern Tracer *g_tracer;
+
+struct TraceEvent
+{
+	// Must have static storage duration (i.e. be a string literal)
+	const char *name;
+	u64 start_us;
+	u32 duration_us;
+};
+
+struct TracePhaseStats
+{
+	std::string name;
+	u32 count;
+	u64 total_us;
+	u32 p50_us;
+	u32 p99_us;
+	u32 max_us;
+};
+
+/*
+	Timeline profiler
+
+	Scope events are recorded into a ring buffer per thread. The buffered
+	history can be
+	summarized into per-phase percentiles or exported in the Chrome trace
+	event format (chrome://tracing, https://ui.perfetto.dev).
+*/
+
+class Tracer
+{
+public:
+	Tracer();
+	~Tracer();
+
+	void setEnabled(bool enabled) { m_enabled = enabled; }
+	bool isEnabled() { return m_enabled; }
+
+	void record(const char *name, u64 start_us, u64 end_us);
+
+	// Statistics over the buffered events that started at or after since_us,
+	// sorted by total time spent
+	void getPhaseStats(std::vector<TracePhaseStats> &stats, u64 since_us = 0);
+	void writeChromeTrace(std::ostream &os);
+	void clear();
+
+private:
+	struct ThreadBuffer
+	{
+		std::string thread_name;
+		u32 tid;
+		Mutex mutex;
+		std::vector<TraceEvent> events;
+		// Index of the slot written next once the buffer is full
+		u32 next;
+	};
+
+	ThreadBuffer *getThreadBuffer();
+	ThreadBuffer *addThreadBuffer();
+
+	Atomic<bool> m_enabled;
+	Mutex m_buffers_mutex;
+	// In order of creation. Buffers of threads that are gone only keep
+	// their name once cleared.
+	std::vector<ThreadBuffer *> m_buffers;
+	// Thread local buffer of the calling thread, so that recording doesn't
+	// need m_buffers_mutex. New threads start without one even if the
+	// system reuses a thread id.
+#ifdef _WIN32
+	DWORD m_buffer_key;
+#else
+	pthread_key_t m_buffer_key;
+#endif
+};
+
+class TraceScope
+{
+public:
+	TraceScope(const char *name) :
+		m_name(name),
+		m_start(g_tracer->isEnabled() ? porting::getTimeUs() : 0)
+	{}
+
+	~TraceScope()
+	{
+		if (m_start)
+			g_tracer->record(m_name, m_start, porting::getTimeUs());
+	}
+
+private:
+	const char *m_name;
+	u64 m_start;
+};
+
+#endif
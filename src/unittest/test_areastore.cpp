@@ -19,6 +19,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "test.h"
 
+#include <algorithm>
+#include <iomanip>
+#include "noise.h"
+#include "porting.h"
 #include "util/areastore.h"
 
 class TestAreaStore : public TestBase {
@@ -31,7 +35,10 @@ class TestAreaStore : public TestBase {
 	void genericStoreTest(AreaStore *store);
 	void testVectorStore();
 	void testSpatialStore();
+	void testRTreeStore();
+	void testRTreeRandom();
 	void testSerialization();
+	void benchmarkStores();
 };
 
 static TestAreaStore g_test_instance;
@@ -42,7 +49,10 @@ void TestAreaStore::runTests(IGameDef *gamedef)
 #if USE_SPATIAL
 	TEST(testSpatialStore);
 #endif
+	TEST(testRTreeStore);
+	TEST(testRTreeRandom);
 	TEST(testSerialization);
+	TEST(benchmarkStores);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -61,6 +71,95 @@ void TestAreaStore::testSpatialStore()
 #endif
 }
 
+void TestAreaStore::testRTreeStore()
+{
+	RTreeAreaStore store;
+	genericStoreTest(&store);
+}
+
+static Area random_area(PcgRandom &pr, s16 range, s16 max_size)
+{
+	v3s16 p(pr.range(-range, range), pr.range(-range / 8, range / 8),
+		pr.range(-range, range));
+	v3s16 size(pr.range(0, max_size), pr.range(0, max_size),
+		pr.range(0, max_size));
+	return Area(p, p + size);
+}
+
+static std::vector<u32> sorted_ids(const std::vector<Area *> &areas)
+{
+	std::vector<u32> ids;
+	for (size_t i = 0; i < areas.size(); i++)
+		ids.push_back(areas[i]->id);
+	std::sort(ids.begin(), ids.end());
+	return ids;
+}
+
+static void compare_stores(AreaStore *store, AreaStore *reference,
+		PcgRandom &pr)
+{
+	std::vector<Area *> res, ref_res;
+	for (u32 i = 0; i < 200; i++) {
+		v3s16 pos = random_area(pr, 1000, 0).minedge;
+		store->getAreasForPos(&res, pos);
+		reference->getAreasForPos(&ref_res, pos);
+		UASSERT(sorted_ids(res) == sorted_ids(ref_res));
+		res.clear();
+		ref_res.clear();
+
+		Area box = random_area(pr, 1000, 200);
+		bool overlap = i % 2;
+		store->getAreasInArea(&res, box.minedge, box.maxedge, overlap);
+		reference->getAreasInArea(&ref_res, box.minedge, box.maxedge, overlap);
+		UASSERT(sorted_ids(res) == sorted_ids(ref_res));
+		res.clear();
+		ref_res.clear();
+	}
+}
+
+void TestAreaStore::testRTreeRandom()
+{
+	PcgRandom pr(13107);
+	RTreeAreaStore store;
+	VectorAreaStore reference;
+	store.setCacheParams(false, 16, 20);
+	reference.setCacheParams(false, 16, 20);
+
+	// Inserting one by one, with splits
+	for (u32 i = 0; i < 2000; i++) {
+		Area a = random_area(pr, 1000, 50);
+		store.insertArea(&a);
+		reference.insertArea(&a);
+	}
+	compare_stores(&store, &reference, pr);
+
+	// Removing, with nodes being dissolved
+	for (u32 id = 0; id < 2000; id += 3) {
+		UASSERT(store.removeArea(id));
+		reference.removeArea(id);
+	}
+	UASSERT(!store.removeArea(0));
+	UASSERTEQ(size_t, store.size(), reference.size());
+	compare_stores(&store, &reference, pr);
+
+	// Building from the bottom up
+	std::ostringstream os;
+	reference.serialize(os);
+	RTreeAreaStore loaded;
+	loaded.setCacheParams(false, 16, 20);
+	VectorAreaStore loaded_reference;
+	std::istringstream is(os.str());
+	loaded.deserialize(is);
+	std::istringstream is2(os.str());
+	loaded_reference.deserialize(is2);
+	UASSERTEQ(size_t, loaded.size(), reference.size());
+	compare_stores(&loaded, &loaded_reference, pr);
+
+	for (u32 id = 0; id < loaded.size(); id += 2)
+		loaded.removeArea(id), loaded_reference.removeArea(id);
+	compare_stores(&loaded, &loaded_reference, pr);
+}
+
 void TestAreaStore::genericStoreTest(AreaStore *store)
 {
 	Area a(v3s16(-10, -3, 5), v3s16(0, 29, 7));
@@ -160,3 +259,74 @@ void TestAreaStore::testSerialization()
 	UASSERTEQ(size_t, store.size(), 4);  // deserialize() doesn't clear the store
 }
 
+
+/*
+	Areas of protection mods: mostly small, some of them nested. Prints the
+	time per operation of each backend, with the result cache disabled.
+*/
+#define BENCHMARK_AREAS 20000
+#define BENCHMARK_QUERIES 2000
+
+// Loads the areas left in store into the empty store loaded
+static void benchmark_store(const char *name, AreaStore *store,
+		AreaStore *loaded, const std::vector<Area> &areas)
+{
+	PcgRandom pr(4242);
+	store->setCacheParams(false, 16, 20);
+	std::vector<Area *> res;
+
+	u64 t0 = porting::getTimeUs();
+	for (size_t i = 0; i < areas.size(); i++) {
+		Area a = areas[i];
+		store->insertArea(&a);
+	}
+	u64 t1 = porting::getTimeUs();
+	for (u32 i = 0; i < BENCHMARK_QUERIES; i++) {
+		store->getAreasForPos(&res, random_area(pr, 2000, 0).minedge);
+		res.clear();
+	}
+	u64 t2 = porting::getTimeUs();
+	for (u32 i = 0; i < BENCHMARK_QUERIES; i++) {
+		Area box = random_area(pr, 2000, 64);
+		store->getAreasInArea(&res, box.minedge, box.maxedge, true);
+		res.clear();
+	}
+	u64 t3 = porting::getTimeUs();
+	for (u32 id = 0; id < BENCHMARK_QUERIES; id++)
+		store->removeArea(id * (areas.size() / BENCHMARK_QUERIES));
+	u64 t4 = porting::getTimeUs();
+
+	std::ostringstream os;
+	store->serialize(os);
+	std::istringstream is(os.str());
+	u64 t5 = porting::getTimeUs();
+	loaded->deserialize(is);
+	u64 t6 = porting::getTimeUs();
+
+	rawstream << std::fixed << std::setprecision(2) << "    "
+		<< std::left << std::setw(8) << name << std::right
+		<< std::setw(9) << (t1 - t0) / (float)areas.size() << " us/insert"
+		<< std::setw(9) << (t2 - t1) / (float)BENCHMARK_QUERIES << " us/pos"
+		<< std::setw(9) << (t3 - t2) / (float)BENCHMARK_QUERIES << " us/area"
+		<< std::setw(9) << (t4 - t3) / (float)BENCHMARK_QUERIES << " us/remove"
+		<< std::setw(9) << (t6 - t5) / 1000.0f << " ms/load" << std::endl;
+}
+
+void TestAreaStore::benchmarkStores()
+{
+	PcgRandom pr(13107);
+	std::vector<Area> areas;
+	for (u32 i = 0; i < BENCHMARK_AREAS; i++)
+		areas.push_back(random_area(pr, 2000, i % 10 == 0 ? 64 : 16));
+
+	rawstream << "    AreaStore benchmark (" << areas.size() << " areas)"
+		<< std::endl;
+	VectorAreaStore vector_store, vector_loaded;
+	benchmark_store("Vector", &vector_store, &vector_loaded, areas);
+#if USE_SPATIAL
+	SpatialAreaStore spatial_store, spatial_loaded;
+	benchmark_store("Spatial", &spatial_store, &spatial_loaded, areas);
+#endif
+	RTreeAreaStore rtree_store, rtree_loaded;
+	benchmark_store("RTree", &rtree_store, &rtree_loaded, areas);
+}
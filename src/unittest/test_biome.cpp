@@ -0,0 +1,134 @@
+/*
+MultiCraft
+Copyright (C) 2026 MultiCraft Development Team
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include <cfloat>
+
+#include "mg_biome.h"
+#include "noise.h"
+
+class TestBiome : public TestBase {
+public:
+	TestBiome() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestBiome"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testTableMatchesScan();
+	void testTableDefault();
+};
+
+static TestBiome g_test_instance;
+
+void TestBiome::runTests(IGameDef *gamedef)
+{
+	TEST(testTableMatchesScan);
+	TEST(testTableDefault);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static Biome *add_biome(ObjDefManager &biomes, s16 y_min, s16 y_max,
+	float heat_point, float humidity_point)
+{
+	Biome *b = new Biome;
+	b->y_min = y_min;
+	b->y_max = y_max;
+	b->heat_point = heat_point;
+	b->humidity_point = humidity_point;
+	biomes.add(b);
+	return b;
+}
+
+// The closest biome as found by checking every biome
+static Biome *scan_biomes(const ObjDefManager &biomes,
+	float heat, float humidity, s16 y)
+{
+	Biome *biome_closest = NULL;
+	float dist_min = FLT_MAX;
+	for (size_t i = 1; i < biomes.getNumObjects(); i++) {
+		Biome *b = (Biome *)biomes.getRaw(i);
+		if (y > b->y_max || y < b->y_min)
+			continue;
+
+		float d_heat     = heat     - b->heat_point;
+		float d_humidity = humidity - b->humidity_point;
+		float dist = (d_heat * d_heat) +
+					 (d_humidity * d_humidity);
+		if (dist < dist_min) {
+			dist_min = dist;
+			biome_closest = b;
+		}
+	}
+	return biome_closest ? biome_closest : (Biome *)biomes.getRaw(0);
+}
+
+void TestBiome::testTableMatchesScan()
+{
+	static const s16 y_limits[] = { -31000, -112, -64, 1, 4, 50, 31000 };
+
+	ObjDefManager biomes(NULL, OBJDEF_BIOME);
+	add_biome(biomes, -31000, 31000, 0, 0);
+
+	// Points on a coarse grid give biomes at equal distances
+	PcgRandom pr(1234);
+	for (int i = 0; i != 60; i++) {
+		s16 y_min = y_limits[pr.range(0, ARRLEN(y_limits) - 2)];
+		s16 y_max = y_limits[pr.range(0, ARRLEN(y_limits) - 1)];
+		add_biome(biomes, y_min, y_max,
+			pr.range(0, 10) * 10, pr.range(0, 10) * 10);
+	}
+
+	BiomeTable table;
+	table.build(&biomes);
+
+	for (int i = 0; i != 100000; i++) {
+		// Also outside of the biome points
+		float heat     = pr.range(-8000, 18000) / 100.0f;
+		float humidity = pr.range(-8000, 18000) / 100.0f;
+		if (i % 4 == 0) {
+			heat     = pr.range(0, 10) * 10 + pr.range(-1, 1) * 5;
+			humidity = pr.range(0, 10) * 10;
+		}
+		s16 y = pr.range(-200, 200);
+		if (i % 100 == 0)
+			y = pr.range(-32768, 32767);
+
+		UASSERT(table.find(heat, humidity, y) ==
+			scan_biomes(biomes, heat, humidity, y));
+	}
+}
+
+void TestBiome::testTableDefault()
+{
+	ObjDefManager biomes(NULL, OBJDEF_BIOME);
+	Biome *b_default = add_biome(biomes, -31000, 31000, 0, 0);
+
+	BiomeTable table;
+	table.build(&biomes);
+	UASSERT(table.find(50, 50, 0) == b_default);
+
+	Biome *b = add_biome(biomes, 0, 100, 50, 50);
+	table.build(&biomes);
+	UASSERT(table.find(0, 0, 0) == b);
+	UASSERT(table.find(0, 0, 100) == b);
+	UASSERT(table.find(0, 0, 101) == b_default);
+	UASSERT(table.find(0, 0, -1) == b_default);
+}
@@ -0,0 +1,129 @@
+/*
+MultiCraft
+Copyright (C) 2026 MultiCraft Development Team
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include "gamedef.h"
+#include "map.h"
+#include "mapgen.h"
+#include "mg_decoration.h"
+#include "nodedef.h"
+
+class TestDecoration : public TestBase {
+public:
+	TestDecoration() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestDecoration"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testSurfaceCache(IWritableNodeDefManager *ndef);
+	void testChunkBiomes();
+};
+
+static TestDecoration g_test_instance;
+
+void TestDecoration::runTests(IGameDef *gamedef)
+{
+	IWritableNodeDefManager *ndef =
+		(IWritableNodeDefManager *)gamedef->getNodeDefManager();
+
+	TEST(testSurfaceCache, ndef);
+	TEST(testChunkBiomes);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void check_surfaces(Mapgen &mg, SurfaceCache &surfaces,
+	v3s16 nmin, v3s16 nmax)
+{
+	for (s16 z = nmin.Z; z <= nmax.Z; z++)
+	for (s16 x = nmin.X; x <= nmax.X; x++) {
+		UASSERTEQ(s16, surfaces.getGroundLevel(x, z),
+			mg.findGroundLevel(v2s16(x, z), nmin.Y, nmax.Y));
+		UASSERTEQ(s16, surfaces.getLiquidSurface(x, z),
+			mg.findLiquidSurface(v2s16(x, z), nmin.Y, nmax.Y));
+	}
+}
+
+void TestDecoration::testSurfaceCache(IWritableNodeDefManager *ndef)
+{
+	// The test water is walkable
+	ContentFeatures f;
+	f.name = "test:decoration_water";
+	f.liquid_type = LIQUID_SOURCE;
+	f.walkable = false;
+	content_t c_water = ndef->set(f.name, f);
+
+	MMVManip vm(NULL);
+	v3s16 nmin(0, 0, 0), nmax(15, 15, 15);
+	// Stone up to y = 3, water above it for x >= 8 and a column of
+	// stone floating in the water
+	for (s16 z = nmin.Z; z <= nmax.Z; z++)
+	for (s16 y = nmin.Y; y <= nmax.Y; y++)
+	for (s16 x = nmin.X; x <= nmax.X; x++) {
+		content_t c = CONTENT_AIR;
+		if (y <= 3 || (x == 12 && z == 12 && y == 8))
+			c = t_CONTENT_STONE;
+		else if (x >= 8 && y <= 8)
+			c = c_water;
+		vm.setNodeNoRef(v3s16(x, y, z), MapNode(c));
+	}
+
+	Mapgen mg;
+	mg.vm = &vm;
+	mg.ndef = ndef;
+	SurfaceCache surfaces(&mg, nmin, nmax);
+	check_surfaces(mg, surfaces, nmin, nmax);
+	UASSERTEQ(s16, surfaces.getGroundLevel(2, 2), 3);
+	UASSERTEQ(s16, surfaces.getLiquidSurface(10, 2), 8);
+	UASSERTEQ(s16, surfaces.getLiquidSurface(12, 12),
+		-MAX_MAP_GENERATION_LIMIT);
+
+	// Changed columns are searched again once invalidated
+	for (s16 y = 4; y <= 6; y++) {
+		vm.setNodeNoRef(v3s16(2, y, 2), MapNode(t_CONTENT_STONE));
+		vm.setNodeNoRef(v3s16(10, y + 5, 3), MapNode(c_water));
+	}
+	UASSERTEQ(s16, surfaces.getGroundLevel(2, 2), 3);
+	surfaces.invalidate(v2s16(2, 2), v2s16(2, 2));
+	surfaces.invalidate(v2s16(9, 2), v2s16(20, 4));
+	check_surfaces(mg, surfaces, nmin, nmax);
+	UASSERTEQ(s16, surfaces.getGroundLevel(2, 2), 6);
+	UASSERTEQ(s16, surfaces.getLiquidSurface(10, 3), 11);
+}
+
+void TestDecoration::testChunkBiomes()
+{
+	v3s16 nmin(0, 0, 0), nmax(3, 3, 3);
+	biome_t biomemap[4 * 4];
+	for (u32 i = 0; i != ARRLEN(biomemap); i++)
+		biomemap[i] = (i < 10) ? 1 : 2;
+	ChunkBiomes chunk_biomes(biomemap, nmin, nmax);
+
+	UNORDERED_SET<u8> biomes;
+	UASSERT(chunk_biomes.containsAny(biomes));
+	biomes.insert(3);
+	UASSERT(!chunk_biomes.containsAny(biomes));
+	biomes.insert(2);
+	UASSERT(chunk_biomes.containsAny(biomes));
+
+	// Without a biome map nothing can be skipped
+	biomes.erase(2);
+	UASSERT(ChunkBiomes(NULL, nmin, nmax).containsAny(biomes));
+}
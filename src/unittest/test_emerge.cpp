@@ -0,0 +1,183 @@
+/*
+MultiCraft
+Copyright (C) 2026 MultiCraft Development Team
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include "test.h"
+
+#include "emerge.h"
+#include "gamedef.h"
+#include "log.h"
+#include "map.h"
+#include "mapblock.h"
+#include "mapsector.h"
+
+class TestEmerge : public TestBase {
+public:
+	TestEmerge() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestEmerge"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testBulkEdit(IGameDef *gamedef);
+	void testBulkEditRetry(IGameDef *gamedef);
+	void testBulkEditFallback(IGameDef *gamedef);
+};
+
+static TestEmerge g_test_instance;
+
+void TestEmerge::runTests(IGameDef *gamedef)
+{
+	TEST(testBulkEdit, gamedef);
+	TEST(testBulkEditRetry, gamedef);
+	TEST(testBulkEditFallback, gamedef);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// 3x3x3 blocks of air around the origin
+static void make_map(Map &map, IGameDef *gamedef)
+{
+	for (s16 bz = -1; bz <= 1; bz++)
+	for (s16 bx = -1; bx <= 1; bx++) {
+		v2s16 p2d(bx, bz);
+		MapSector *sector = new ServerMapSector(&map, p2d, gamedef);
+		(*map.getSectorsPtr())[p2d] = sector;
+		for (s16 by = -1; by <= 1; by++) {
+			MapBlock *block = sector->createBlankBlock(by);
+			MapNode air(CONTENT_AIR);
+			for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+			for (s16 y = 0; y < MAP_BLOCKSIZE; y++)
+			for (s16 x = 0; x < MAP_BLOCKSIZE; x++)
+				block->setNodeNoCheck(x, y, z, air);
+		}
+	}
+}
+
+static bool is_filled(Map &map, v3s16 blockpos, content_t c)
+{
+	MapBlock *block = map.getBlockNoCreateNoEx(blockpos);
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+	for (s16 y = 0; y < MAP_BLOCKSIZE; y++)
+	for (s16 x = 0; x < MAP_BLOCKSIZE; x++) {
+		if (block->getNodeNoEx(v3s16(x, y, z)).getContent() != c)
+			return false;
+	}
+	return true;
+}
+
+/*
+	Fills the block at the origin with stone. The first applications also
+	change a block of the map, like the server thread could while the edit
+	runs. This writes the nodes directly, without a map event, like liquid
+	flow does.
+*/
+class TestBulkEdit : public BulkEdit {
+public:
+	TestBulkEdit(Map *map, v3s16 changed_blockpos, u32 changes):
+		BulkEdit(v3s16(0, 0, 0), v3s16(0, 0, 0), NULL, NULL),
+		applied(0),
+		m_map(map),
+		m_changed_blockpos(changed_blockpos),
+		m_changes(changes)
+	{}
+
+	void apply(MMVManip *vm)
+	{
+		applied++;
+		MapNode stone(t_CONTENT_STONE);
+		for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+		for (s16 y = 0; y < MAP_BLOCKSIZE; y++)
+		for (s16 x = 0; x < MAP_BLOCKSIZE; x++)
+			vm->setNodeNoEmerge(v3s16(x, y, z), stone);
+
+		if (applied <= m_changes) {
+			MapNode water(t_CONTENT_WATER);
+			m_map->getBlockNoCreateNoEx(m_changed_blockpos)->setNodeNoCheck(
+				v3s16(3, 0, 3), water);
+		}
+	}
+
+	u32 applied;
+
+private:
+	Map *m_map;
+	v3s16 m_changed_blockpos;
+	u32 m_changes;
+};
+
+class TestEventCounter : public MapEventReceiver {
+public:
+	TestEventCounter(): events(0) {}
+	void onMapEditEvent(MapEditEvent *event) { events++; }
+	u32 events;
+};
+
+void TestEmerge::testBulkEdit(IGameDef *gamedef)
+{
+	Map map(dout_server, gamedef);
+	make_map(map, gamedef);
+	TestEventCounter counter;
+	map.addEventReceiver(&counter);
+	Mutex env_mutex;
+	BulkEditor editor(&map, &env_mutex);
+
+	// Changes beside the area don't matter
+	TestBulkEdit edit(&map, v3s16(1, 0, 0), 1);
+	editor.run(&edit);
+	UASSERTEQ(u32, edit.applied, 1);
+	UASSERT(is_filled(map, v3s16(0, 0, 0), t_CONTENT_STONE));
+	UASSERTEQ(u32, counter.events, 1);
+
+	map.removeEventReceiver(&counter);
+}
+
+void TestEmerge::testBulkEditRetry(IGameDef *gamedef)
+{
+	Map map(dout_server, gamedef);
+	make_map(map, gamedef);
+	Mutex env_mutex;
+	BulkEditor editor(&map, &env_mutex);
+
+	// A change inside the area is overwritten by the next try
+	TestBulkEdit edit(&map, v3s16(0, 0, 0), 1);
+	editor.run(&edit);
+	UASSERTEQ(u32, edit.applied, 2);
+	UASSERT(is_filled(map, v3s16(0, 0, 0), t_CONTENT_STONE));
+
+	// The block above provides the sunlight
+	TestBulkEdit edit2(&map, v3s16(0, 1, 0), 2);
+	editor.run(&edit2);
+	UASSERTEQ(u32, edit2.applied, 3);
+	UASSERT(map.getNodeNoEx(v3s16(3, MAP_BLOCKSIZE, 3)).getContent() ==
+		t_CONTENT_WATER);
+}
+
+void TestEmerge::testBulkEditFallback(IGameDef *gamedef)
+{
+	Map map(dout_server, gamedef);
+	make_map(map, gamedef);
+	Mutex env_mutex;
+	BulkEditor editor(&map, &env_mutex);
+
+	// After the last try the edit is done with the map locked
+	TestBulkEdit edit(&map, v3s16(0, 0, 0), BULKEDIT_MAX_ATTEMPTS);
+	editor.run(&edit);
+	UASSERTEQ(u32, edit.applied, BULKEDIT_MAX_ATTEMPTS + 1);
+	UASSERT(is_filled(map, v3s16(0, 0, 0), t_CONTENT_STONE));
+}
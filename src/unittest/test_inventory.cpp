@@ -32,6 +32,7 @@ class TestInventory : public TestBase {
 	void runTests(IGameDef *gamedef);
 
 	void testSerializeDeserialize(IItemDefManager *idef);
+	void testSerializeDelta(IItemDefManager *idef);
 
 	static const char *serialized_inventory;
 	static const char *serialized_inventory_2;
@@ -42,6 +43,7 @@ static TestInventory g_test_instance;
 void TestInventory::runTests(IGameDef *gamedef)
 {
 	TEST(testSerializeDeserialize, gamedef->getItemDefManager());
+	TEST(testSerializeDelta, gamedef->getItemDefManager());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -66,6 +68,42 @@ void TestInventory::testSerializeDeserialize(IItemDefManager *idef)
 	UASSERTEQ(std::string, inv_os.str(), serialized_inventory_2);
 }
 
+void TestInventory::testSerializeDelta(IItemDefManager *idef)
+{
+	Inventory old_inv(idef);
+	std::istringstream is(serialized_inventory, std::ios::binary);
+	old_inv.deSerialize(is);
+	old_inv.addList("craft", 9);
+
+	Inventory inv(old_inv);
+	std::ostringstream empty_os(std::ios::binary);
+	UASSERT(inv.serializeDelta(empty_os, old_inv));
+	UASSERTEQ(std::string, empty_os.str(), "EndInventory\n");
+
+	InventoryList *list = inv.getList("0");
+	list->changeItem(0, ItemStack("default:stone", 5, 0, idef));
+	list->deleteItem(16);
+	std::ostringstream delta_os(std::ios::binary);
+	UASSERT(inv.serializeDelta(delta_os, old_inv));
+	UASSERTEQ(std::string, delta_os.str(),
+		"List 0\n"
+		"Slot 0 Item default:stone 5\n"
+		"Slot 16 Empty\n"
+		"EndInventoryList\n"
+		"EndInventory\n");
+
+	// Applying the changes to the old inventory results in the new one
+	std::istringstream delta_is(delta_os.str(), std::ios::binary);
+	old_inv.deSerializeDelta(delta_is);
+	UASSERT(old_inv == inv);
+
+	// Changed lists need a full update
+	inv.addList("extra", 1);
+	std::ostringstream full_os(std::ios::binary);
+	UASSERT(!inv.serializeDelta(full_os, old_inv));
+	UASSERT(full_os.str().empty());
+}
+
 const char *TestInventory::serialized_inventory =
 	"List 0 32\n"
 	"Width 3\n"
@@ -0,0 +1,208 @@
+/*
+MultiCraft
+Copyright (C) 2026 MultiCraft Development Team
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include <sstream>
+
+#include "gamedef.h"
+#include "log.h"
+#include "map.h"
+#include "mapblock.h"
+#include "serialization.h"
+
+class TestMapBlock : public TestBase {
+public:
+	TestMapBlock() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestMapBlock"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testCompactUniform(IGameDef *gamedef);
+	void testCompactPalette(IGameDef *gamedef);
+	void testCompactTooManyNodes(IGameDef *gamedef);
+	void testSerializeBuffers(IGameDef *gamedef);
+	void testPropagateSunlightCompact(IGameDef *gamedef);
+};
+
+static TestMapBlock g_test_instance;
+
+void TestMapBlock::runTests(IGameDef *gamedef)
+{
+	TEST(testCompactUniform, gamedef);
+	TEST(testCompactPalette, gamedef);
+	TEST(testCompactTooManyNodes, gamedef);
+	TEST(testSerializeBuffers, gamedef);
+	TEST(testPropagateSunlightCompact, gamedef);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TestMapBlock::testCompactUniform(IGameDef *gamedef)
+{
+	MapBlock block(NULL, v3s16(0, 0, 0), gamedef);
+	UASSERT(!block.isCompact());
+
+	block.compact();
+	UASSERT(block.isCompact());
+	UASSERT(block.getNodeNoEx(v3s16(3, 4, 5)).getContent() == CONTENT_IGNORE);
+	UASSERT(block.getNodeUnsafe(15, 15, 15).getContent() == CONTENT_IGNORE);
+
+	// Writing the same node keeps the block compact
+	MapNode ignore(CONTENT_IGNORE);
+	block.setNode(v3s16(1, 2, 3), ignore);
+	UASSERT(block.isCompact());
+
+	// Any other node expands it
+	MapNode stone(t_CONTENT_STONE);
+	block.setNode(v3s16(1, 2, 3), stone);
+	UASSERT(!block.isCompact());
+	UASSERT(block.getNodeNoEx(v3s16(1, 2, 3)).getContent() == t_CONTENT_STONE);
+	UASSERT(block.getNodeNoEx(v3s16(3, 2, 1)).getContent() == CONTENT_IGNORE);
+}
+
+void TestMapBlock::testCompactPalette(IGameDef *gamedef)
+{
+	MapBlock block(NULL, v3s16(0, 0, 0), gamedef);
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+	for (s16 y = 0; y < MAP_BLOCKSIZE; y++)
+	for (s16 x = 0; x < MAP_BLOCKSIZE; x++) {
+		MapNode n(y < 8 ? t_CONTENT_STONE : CONTENT_AIR, x % 4, z % 4);
+		block.setNode(x, y, z, n);
+	}
+
+	MapNode expected[MapBlock::nodecount];
+	block.copyData(expected);
+
+	block.compact();
+	UASSERT(block.isCompact());
+
+	MapNode nodes[MapBlock::nodecount];
+	block.copyData(nodes);
+	for (u32 i = 0; i < MapBlock::nodecount; i++)
+		UASSERT(nodes[i] == expected[i]);
+
+	MapNode n = block.getNodeNoEx(v3s16(7, 3, 9));
+	UASSERT(n.getContent() == t_CONTENT_STONE);
+	UASSERT(n.getParam1() == 3 && n.getParam2() == 1);
+	UASSERT(block.getNodeUnsafe(2, 12, 4).getContent() == CONTENT_AIR);
+
+	// Compact blocks serialize like full ones
+	std::ostringstream os(std::ios_base::binary);
+	block.serialize(os, SER_FMT_VER_HIGHEST_WRITE, false);
+
+	MapBlock block2(NULL, v3s16(0, 0, 0), gamedef);
+	std::istringstream is(os.str(), std::ios_base::binary);
+	block2.deSerialize(is, SER_FMT_VER_HIGHEST_WRITE, false);
+	UASSERT(block2.isCompact());
+	block2.copyData(nodes);
+	for (u32 i = 0; i < MapBlock::nodecount; i++)
+		UASSERT(nodes[i] == expected[i]);
+}
+
+void TestMapBlock::testCompactTooManyNodes(IGameDef *gamedef)
+{
+	MapBlock block(NULL, v3s16(0, 0, 0), gamedef);
+	for (u32 i = 0; i < 257; i++) {
+		MapNode n(t_CONTENT_STONE, i & 0xFF, i >> 8);
+		block.setNode(i % MAP_BLOCKSIZE, i / MAP_BLOCKSIZE % MAP_BLOCKSIZE,
+			i / MAP_BLOCKSIZE / MAP_BLOCKSIZE, n);
+	}
+
+	block.compact();
+	UASSERT(!block.isCompact());
+	UASSERT(block.getNodeNoEx(v3s16(0, 0, 1)).getParam2() == 1);
+}
+
+void TestMapBlock::testSerializeBuffers(IGameDef *gamedef)
+{
+	MapBlock block(NULL, v3s16(0, 0, 0), gamedef);
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+	for (s16 y = 0; y < MAP_BLOCKSIZE; y++)
+	for (s16 x = 0; x < MAP_BLOCKSIZE; x++) {
+		content_t c = y < 4 ? t_CONTENT_STONE : y < 6 ? t_CONTENT_GRASS :
+			y < 8 ? t_CONTENT_WATER : CONTENT_AIR;
+		MapNode n(c, x, z);
+		block.setNode(x, y, z, n);
+	}
+
+	MapNode expected[MapBlock::nodecount];
+	block.copyData(expected);
+
+	// The buffer serializer writes the same data as the stream one
+	BlockSerializeBuffers buffers;
+	std::string data;
+	block.serialize(data, SER_FMT_VER_HIGHEST_WRITE, true, buffers);
+	std::ostringstream os(std::ios_base::binary);
+	block.serialize(os, SER_FMT_VER_HIGHEST_WRITE, true);
+	UASSERT(data == os.str());
+
+	// Trailing data is not consumed
+	data += "trailing";
+	MapBlock block2(NULL, v3s16(0, 0, 0), gamedef);
+	UASSERTEQ(size_t, block2.deSerialize((const u8 *)data.c_str(),
+		data.size(), SER_FMT_VER_HIGHEST_WRITE, true, buffers),
+		os.str().size());
+
+	MapNode nodes[MapBlock::nodecount];
+	block2.copyData(nodes);
+	for (u32 i = 0; i < MapBlock::nodecount; i++)
+		UASSERT(nodes[i] == expected[i]);
+
+	// Truncated data is rejected
+	bool thrown = false;
+	try {
+		block2.deSerialize((const u8 *)data.c_str(), data.size() / 2,
+			SER_FMT_VER_HIGHEST_WRITE, true, buffers);
+	} catch (SerializationError &e) {
+		thrown = true;
+	}
+	UASSERT(thrown);
+}
+
+void TestMapBlock::testPropagateSunlightCompact(IGameDef *gamedef)
+{
+	INodeDefManager *ndef = gamedef->ndef();
+	// No block above, so the block gets sunlight
+	Map map(dout_server, gamedef);
+	MapBlock block(&map, v3s16(0, 0, 0), gamedef);
+	MapNode air(CONTENT_AIR);
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+	for (s16 y = 0; y < MAP_BLOCKSIZE; y++)
+	for (s16 x = 0; x < MAP_BLOCKSIZE; x++)
+		block.setNode(x, y, z, air);
+	block.compact();
+
+	// Adding the missing sunlight expands the block
+	std::set<v3s16> light_sources;
+	UASSERT(block.propagateSunlight(light_sources));
+	UASSERT(!block.isCompact());
+	UASSERT(block.getNodeNoEx(v3s16(4, 0, 9)).getLight(LIGHTBANK_DAY, ndef)
+		== LIGHT_SUN);
+	UASSERTEQ(size_t, light_sources.size(), MapBlock::nodecount);
+
+	// Lighting it again changes nothing and keeps the block compact
+	block.compact();
+	UASSERT(block.isCompact());
+	light_sources.clear();
+	UASSERT(block.propagateSunlight(light_sources));
+	UASSERT(block.isCompact());
+	UASSERT(block.getNodeNoEx(v3s16(4, 0, 9)).getLight(LIGHTBANK_DAY, ndef)
+		== LIGHT_SUN);
+}
@@ -0,0 +1,144 @@
+/*
+MultiCraft
+Copyright (C) 2026 MultiCraft Development Team
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include "nodetimer.h"
+
+class TestNodeTimer : public TestBase
+{
+public:
+	TestNodeTimer() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestNodeTimer"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testScheduledTimers();
+	void testReschedule();
+	void testDetach();
+};
+
+static TestNodeTimer g_test_instance;
+
+void TestNodeTimer::runTests(IGameDef *gamedef)
+{
+	TEST(testScheduledTimers);
+	TEST(testReschedule);
+	TEST(testDetach);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Steps the scheduler and returns the timers that elapsed in the given list
+static std::vector<NodeTimer> step_scheduler(NodeTimerScheduler &scheduler,
+	NodeTimerList &list, float dtime, u32 *due_count = NULL)
+{
+	std::vector<NodeTimerScheduler::Entry> due;
+	scheduler.step(dtime, due);
+	if (due_count)
+		*due_count = due.size();
+
+	std::vector<NodeTimer> elapsed;
+	for (size_t i = 0; i < due.size(); i++) {
+		std::vector<NodeTimer> e = list.stepScheduled(due[i].first);
+		elapsed.insert(elapsed.end(), e.begin(), e.end());
+	}
+	return elapsed;
+}
+
+void TestNodeTimer::testScheduledTimers()
+{
+	NodeTimerScheduler scheduler;
+	NodeTimerList idle, list;
+	idle.attach(&scheduler, v3s16(1, 0, 0));
+	list.attach(&scheduler, v3s16(0, 0, 0));
+	list.set(NodeTimer(2.0f, 0.0f, v3s16(1, 2, 3)));
+
+	// Blocks without timers aren't scheduled at all
+	UASSERTEQ(size_t, scheduler.size(), 1);
+
+	u32 due_count;
+	std::vector<NodeTimer> elapsed =
+		step_scheduler(scheduler, list, 1.0f, &due_count);
+	UASSERTEQ(u32, due_count, 0);
+	UASSERT(elapsed.empty());
+	UASSERT(list.get(v3s16(1, 2, 3)).elapsed == 1.0f);
+
+	elapsed = step_scheduler(scheduler, list, 1.5f, &due_count);
+	UASSERTEQ(u32, due_count, 1);
+	UASSERTEQ(size_t, elapsed.size(), 1);
+	UASSERT(elapsed[0].position == v3s16(1, 2, 3));
+	UASSERT(elapsed[0].elapsed == 2.5f);
+	UASSERTEQ(size_t, scheduler.size(), 0);
+}
+
+void TestNodeTimer::testReschedule()
+{
+	NodeTimerScheduler scheduler;
+	NodeTimerList list;
+	list.attach(&scheduler, v3s16(0, 0, 0));
+	list.set(NodeTimer(10.0f, 0.0f, v3s16(0, 0, 0)));
+	list.set(NodeTimer(5.0f, 0.0f, v3s16(1, 0, 0)));
+	UASSERTEQ(size_t, scheduler.size(), 2);
+
+	std::vector<NodeTimer> elapsed = step_scheduler(scheduler, list, 5.0f);
+	UASSERTEQ(size_t, elapsed.size(), 1);
+	UASSERT(elapsed[0].position == v3s16(1, 0, 0));
+
+	// The block is due twice at 10: once for its outdated entry
+	u32 due_count;
+	elapsed = step_scheduler(scheduler, list, 5.0f, &due_count);
+	UASSERTEQ(u32, due_count, 2);
+	UASSERTEQ(size_t, elapsed.size(), 1);
+	UASSERT(elapsed[0].position == v3s16(0, 0, 0));
+
+	// Moving a timer to a later time makes the entry fire early, harmlessly
+	list.set(NodeTimer(1.0f, 0.0f, v3s16(2, 0, 0)));
+	list.set(NodeTimer(3.0f, 0.0f, v3s16(2, 0, 0)));
+	elapsed = step_scheduler(scheduler, list, 1.0f);
+	UASSERT(elapsed.empty());
+	elapsed = step_scheduler(scheduler, list, 2.0f);
+	UASSERTEQ(size_t, elapsed.size(), 1);
+}
+
+void TestNodeTimer::testDetach()
+{
+	NodeTimerScheduler scheduler;
+	NodeTimerList list;
+	list.attach(&scheduler, v3s16(0, 0, 0));
+	list.set(NodeTimer(2.0f, 0.0f, v3s16(0, 0, 0)));
+	step_scheduler(scheduler, list, 1.0f);
+
+	// Time of a detached list stands still
+	list.detach();
+	UASSERT(step_scheduler(scheduler, list, 5.0f).empty());
+	UASSERT(list.get(v3s16(0, 0, 0)).elapsed == 1.0f);
+
+	// Reattached, it continues where it stopped
+	list.attach(&scheduler, v3s16(0, 0, 0));
+	UASSERT(step_scheduler(scheduler, list, 0.5f).empty());
+	std::vector<NodeTimer> elapsed = step_scheduler(scheduler, list, 0.5f);
+	UASSERTEQ(size_t, elapsed.size(), 1);
+	UASSERT(elapsed[0].elapsed == 2.0f);
+
+	// Detached lists are still stepped on their own
+	list.detach();
+	list.set(NodeTimer(1.0f, 0.0f, v3s16(0, 0, 0)));
+	UASSERTEQ(size_t, list.step(1.0f).size(), 1);
+}
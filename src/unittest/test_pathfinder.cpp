@@ -0,0 +1,251 @@
+/*
+MultiCraft
+Copyright (C) 2026 MultiCraft Development Team
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include <algorithm>
+
+#include "gamedef.h"
+#include "log.h"
+#include "map.h"
+#include "mapblock.h"
+#include "mapsector.h"
+#include "pathfinder.h"
+
+class TestPathfinder : public TestBase {
+public:
+	TestPathfinder() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestPathfinder"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testDetour(IGameDef *gamedef);
+	void testUnreachable(IGameDef *gamedef);
+	void testJump(IGameDef *gamedef);
+	void testHierarchical(IGameDef *gamedef);
+	void testCacheUpdate(IGameDef *gamedef);
+};
+
+static TestPathfinder g_test_instance;
+
+void TestPathfinder::runTests(IGameDef *gamedef)
+{
+	TEST(testDetour, gamedef);
+	TEST(testUnreachable, gamedef);
+	TEST(testJump, gamedef);
+	TEST(testHierarchical, gamedef);
+	TEST(testCacheUpdate, gamedef);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// A block with a stone floor at y = 0, the rest is not loaded
+static MapBlock *create_block(Map &map, IGameDef *gamedef,
+		v3s16 blockpos = v3s16(0, 0, 0))
+{
+	v2s16 p2d(blockpos.X, blockpos.Z);
+	MapSector *sector = map.getSectorNoGenerateNoEx(p2d);
+	if (!sector) {
+		sector = new ServerMapSector(&map, p2d, gamedef);
+		(*map.getSectorsPtr())[p2d] = sector;
+	}
+	MapBlock *block = sector->createBlankBlock(blockpos.Y);
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+	for (s16 y = 0; y < MAP_BLOCKSIZE; y++)
+	for (s16 x = 0; x < MAP_BLOCKSIZE; x++) {
+		MapNode n(y == 0 ? t_CONTENT_STONE : CONTENT_AIR);
+		block->setNodeNoCheck(x, y, z, n);
+	}
+	return block;
+}
+
+static void set_wall(MapBlock *block, s16 x, s16 z, s16 height)
+{
+	for (s16 y = 1; y <= height; y++) {
+		MapNode n(t_CONTENT_STONE);
+		block->setNodeNoCheck(x, y, z, n);
+	}
+}
+
+static void set_map_wall(Map &map, s16 x, s16 z, s16 height)
+{
+	for (s16 y = 1; y <= height; y++) {
+		MapNode n(t_CONTENT_STONE);
+		map.setNode(v3s16(x, y, z), n);
+	}
+}
+
+static bool is_connected(const std::vector<v3s16> &path)
+{
+	for (size_t i = 1; i < path.size(); i++) {
+		v3s16 d = path[i] - path[i - 1];
+		if (abs(d.X) + abs(d.Z) != 1)
+			return false;
+	}
+	return true;
+}
+
+void TestPathfinder::testDetour(IGameDef *gamedef)
+{
+	Map map(dout_server, gamedef);
+	MapBlock *block = create_block(map, gamedef);
+	// A wall with a gap at z = 12
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++) {
+		if (z != 12)
+			set_wall(block, 8, z, 3);
+	}
+
+	Pathfinder pathfinder;
+	v3s16 source(2, 1, 2), destination(13, 1, 2);
+	PathAlgorithm algos[] = { PA_PLAIN, PA_PLAIN_NP, PA_DIJKSTRA };
+	for (size_t i = 0; i < ARRLEN(algos); i++) {
+		std::vector<v3s16> path = pathfinder.getPath(&map, gamedef->ndef(),
+			source, destination, 16, 1, 1, algos[i]);
+		// The shortest path through the gap
+		UASSERTEQ(size_t, path.size(), 32);
+		UASSERT(path.front() == source);
+		UASSERT(path.back() == destination);
+		UASSERT(is_connected(path));
+		UASSERT(std::find(path.begin(), path.end(), v3s16(8, 1, 12)) !=
+			path.end());
+	}
+}
+
+void TestPathfinder::testUnreachable(IGameDef *gamedef)
+{
+	Map map(dout_server, gamedef);
+	MapBlock *block = create_block(map, gamedef);
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+		set_wall(block, 8, z, 3);
+
+	Pathfinder pathfinder;
+	UASSERT(pathfinder.getPath(&map, gamedef->ndef(), v3s16(2, 1, 2),
+		v3s16(13, 1, 2), 16, 1, 1, PA_PLAIN).empty());
+
+	// Positions that are not on the surface
+	UASSERT(pathfinder.getPath(&map, gamedef->ndef(), v3s16(2, 2, 2),
+		v3s16(4, 1, 2), 16, 1, 1, PA_PLAIN).empty());
+	UASSERT(pathfinder.getPath(&map, gamedef->ndef(), v3s16(2, 1, 2),
+		v3s16(8, 1, 2), 16, 1, 1, PA_PLAIN).empty());
+}
+
+void TestPathfinder::testJump(IGameDef *gamedef)
+{
+	Map map(dout_server, gamedef);
+	MapBlock *block = create_block(map, gamedef);
+	// A step of one node at x = 8 and beyond
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+	for (s16 x = 8; x < MAP_BLOCKSIZE; x++)
+		set_wall(block, x, z, 1);
+
+	Pathfinder pathfinder;
+	v3s16 source(2, 1, 2), destination(13, 2, 2);
+	UASSERT(pathfinder.getPath(&map, gamedef->ndef(), source, destination,
+		16, 0, 1, PA_PLAIN).empty());
+
+	std::vector<v3s16> path = pathfinder.getPath(&map, gamedef->ndef(),
+		source, destination, 16, 1, 1, PA_PLAIN);
+	UASSERTEQ(size_t, path.size(), 12);
+	UASSERT(is_connected(path));
+	UASSERT(path[6] == v3s16(8, 2, 2));
+
+	// Dropping down the step again
+	path = pathfinder.getPath(&map, gamedef->ndef(), destination, source,
+		16, 0, 1, PA_PLAIN);
+	UASSERTEQ(size_t, path.size(), 12);
+	UASSERT(path[6] == v3s16(7, 1, 2));
+}
+
+void TestPathfinder::testHierarchical(IGameDef *gamedef)
+{
+	Map map(dout_server, gamedef);
+	for (s16 z = 0; z < 3; z++)
+	for (s16 x = 0; x < 3; x++)
+		create_block(map, gamedef, v3s16(x, 0, z));
+	// A wall across the blocks with a gap at z = 44
+	for (s16 z = 0; z < 3 * MAP_BLOCKSIZE; z++) {
+		if (z != 44)
+			set_map_wall(map, 24, z, 3);
+	}
+
+	Pathfinder pathfinder;
+	v3s16 source(2, 1, 2), destination(45, 1, 2);
+	std::vector<v3s16> plain = pathfinder.getPath(&map, gamedef->ndef(),
+		source, destination, 48, 1, 1, PA_PLAIN);
+	UASSERTEQ(size_t, plain.size(), 128);
+
+	std::vector<v3s16> path = pathfinder.getPath(&map, gamedef->ndef(),
+		source, destination, 48, 1, 1, PA_HIERARCHICAL);
+	UASSERTEQ(size_t, path.size(), plain.size());
+	UASSERT(path.front() == source);
+	UASSERT(path.back() == destination);
+	UASSERT(is_connected(path));
+
+	// Closing the gap
+	set_map_wall(map, 24, 44, 3);
+	UASSERT(pathfinder.getPath(&map, gamedef->ndef(), source, destination,
+		48, 1, 1, PA_HIERARCHICAL).empty());
+}
+
+void TestPathfinder::testCacheUpdate(IGameDef *gamedef)
+{
+	Map map(dout_server, gamedef);
+	MapBlock *block = create_block(map, gamedef);
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++) {
+		if (z != 12)
+			set_wall(block, 8, z, 3);
+	}
+
+	NavigationCache cache;
+	map.addEventReceiver(&cache);
+	Pathfinder pathfinder(&cache);
+	v3s16 source(2, 1, 2), destination(13, 1, 2);
+	PathAlgorithm algos[] = { PA_PLAIN, PA_HIERARCHICAL };
+	for (size_t i = 0; i < ARRLEN(algos); i++) {
+		UASSERTEQ(size_t, pathfinder.getPath(&map, gamedef->ndef(),
+			source, destination, 16, 1, 1, algos[i]).size(), 32);
+	}
+
+	// Node events close and open the gap
+	for (s16 y = 1; y <= 3; y++)
+		map.addNodeWithEvent(v3s16(8, y, 12), MapNode(t_CONTENT_STONE));
+	for (size_t i = 0; i < ARRLEN(algos); i++) {
+		UASSERT(pathfinder.getPath(&map, gamedef->ndef(),
+			source, destination, 16, 1, 1, algos[i]).empty());
+	}
+	for (s16 y = 1; y <= 3; y++)
+		map.removeNodeWithEvent(v3s16(8, y, 12));
+	for (size_t i = 0; i < ARRLEN(algos); i++) {
+		UASSERTEQ(size_t, pathfinder.getPath(&map, gamedef->ndef(),
+			source, destination, 16, 1, 1, algos[i]).size(), 32);
+	}
+
+	// Other changes are announced by block
+	set_wall(block, 8, 12, 3);
+	MapEditEvent event;
+	event.type = MEET_OTHER;
+	event.modified_blocks.insert(v3s16(0, 0, 0));
+	map.dispatchEvent(&event);
+	for (size_t i = 0; i < ARRLEN(algos); i++) {
+		UASSERT(pathfinder.getPath(&map, gamedef->ndef(),
+			source, destination, 16, 1, 1, algos[i]).empty());
+	}
+
+	map.removeEventReceiver(&cache);
+}
@@ -19,7 +19,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "test.h"
 
+#include <sstream>
 #include "profiler.h"
+#include "tracer.h"
+#include "threading/thread.h"
+#include "script/cpp_api/s_base.h"
 
 class TestProfiler : public TestBase
 {
@@ -30,6 +34,10 @@ class TestProfiler : public TestBase
 	void runTests(IGameDef *gamedef);
 
 	void testProfilerAverage();
+	void testTracerStats();
+	void testTracerRingBuffer();
+	void testTracerThreads();
+	void testCallbackCosts();
 };
 
 static TestProfiler g_test_instance;
@@ -37,6 +45,10 @@ static TestProfiler g_test_instance;
 void TestProfiler::runTests(IGameDef *gamedef)
 {
 	TEST(testProfilerAverage);
+	TEST(testTracerStats);
+	TEST(testTracerRingBuffer);
+	TEST(testTracerThreads);
+	TEST(testCallbackCosts);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -71,3 +83,184 @@ void TestProfiler::testProfilerAverage()
 
 	UASSERT(p.getValue("Test2") == 123.57f);
 }
+
+void TestProfiler::testTracerStats()
+{
+	Tracer t;
+
+	for (u32 i = 1; i <= 100; i++)
+		t.record("Phase1", 1000 + i, 1000 + i + i);
+	t.record("Phase2", 5000, 15000);
+
+	std::vector<TracePhaseStats> stats;
+	t.getPhaseStats(stats);
+	UASSERTEQ(size_t, stats.size(), 2);
+
+	UASSERT(stats[0].name == "Phase2");
+	UASSERTEQ(u32, stats[0].count, 1);
+	UASSERTEQ(u32, stats[0].p50_us, 10000);
+	UASSERTEQ(u32, stats[0].max_us, 10000);
+
+	UASSERT(stats[1].name == "Phase1");
+	UASSERTEQ(u32, stats[1].count, 100);
+	UASSERTEQ(u64, stats[1].total_us, 5050);
+	UASSERTEQ(u32, stats[1].p50_us, 50);
+	UASSERTEQ(u32, stats[1].p99_us, 99);
+	UASSERTEQ(u32, stats[1].max_us, 100);
+
+	t.getPhaseStats(stats, 5000);
+	UASSERTEQ(size_t, stats.size(), 1);
+	UASSERT(stats[0].name == "Phase2");
+
+	std::ostringstream os;
+	t.writeChromeTrace(os);
+	UASSERT(os.str().find("{\"name\":\"Phase2\",\"ph\":\"X\",\"pid\":1,"
+		"\"tid\":1,\"ts\":5000,\"dur\":10000}") != std::string::npos);
+
+	t.clear();
+	t.getPhaseStats(stats);
+	UASSERTEQ(size_t, stats.size(), 0);
+}
+
+void TestProfiler::testTracerRingBuffer()
+{
+	Tracer t;
+
+	for (u32 i = 0; i < TRACER_BUFFER_SIZE; i++)
+		t.record("Old", i, i + 1);
+	for (u32 i = 0; i < 10; i++)
+		t.record("New", TRACER_BUFFER_SIZE + i, TRACER_BUFFER_SIZE + i + 2);
+
+	std::vector<TracePhaseStats> stats;
+	t.getPhaseStats(stats);
+	UASSERTEQ(size_t, stats.size(), 2);
+	UASSERT(stats[0].name == "Old");
+	UASSERTEQ(u32, stats[0].count, TRACER_BUFFER_SIZE - 10);
+	UASSERT(stats[1].name == "New");
+	UASSERTEQ(u32, stats[1].count, 10);
+
+	// The oldest remaining event must be exported first
+	std::ostringstream os;
+	t.writeChromeTrace(os);
+	size_t first_event = os.str().find("\"ph\":\"X\"");
+	UASSERT(first_event != std::string::npos);
+	UASSERT(os.str().find("\"ts\":10,", first_event) < os.str().find("\"ts\":11,"));
+}
+
+class TracerTestThread : public Thread
+{
+public:
+	TracerTestThread(Tracer *tracer) :
+		Thread("TracerTest"),
+		m_tracer(tracer)
+	{}
+
+private:
+	void *run()
+	{
+		for (u32 i = 0; i < 100; i++)
+			m_tracer->record("Work", i * 10, i * 10 + 5);
+		// start() doesn't return before the thread ran
+		while (!stopRequested())
+			sleep_ms(1);
+		return NULL;
+	}
+
+	Tracer *m_tracer;
+};
+
+void TestProfiler::testTracerThreads()
+{
+	Tracer t;
+	UASSERT(!t.isEnabled());
+
+	// Threads with the same name still get their own buffer
+	TracerTestThread thread1(&t), thread2(&t);
+	thread1.start();
+	thread2.start();
+	thread1.stop();
+	thread2.stop();
+	thread1.wait();
+	thread2.wait();
+
+	std::vector<TracePhaseStats> stats;
+	t.getPhaseStats(stats);
+	UASSERTEQ(size_t, stats.size(), 1);
+	UASSERTEQ(u32, stats[0].count, 200);
+
+	std::ostringstream os;
+	t.writeChromeTrace(os);
+	UASSERT(os.str().find("\"tid\":1,\"ts\":990,") != std::string::npos);
+	UASSERT(os.str().find("\"tid\":2,\"ts\":990,") != std::string::npos);
+
+	// Buffers of finished threads are emptied, but kept
+	t.clear();
+	t.record("Main", 10, 20);
+	os.str("");
+	t.writeChromeTrace(os);
+	UASSERT(os.str().find("\"tid\":3,\"ts\":10,") != std::string::npos);
+	UASSERT(os.str().find("\"tid\":1,") == std::string::npos);
+
+	// A new thread doesn't inherit a buffer, even if it reuses a thread id
+	t.clear();
+	TracerTestThread thread3(&t);
+	thread3.start();
+	thread3.stop();
+	thread3.wait();
+	os.str("");
+	t.writeChromeTrace(os);
+	UASSERT(os.str().find("\"tid\":4,\"ts\":990,") != std::string::npos);
+	UASSERT(os.str().find("\"tid\":1,") == std::string::npos);
+}
+
+void TestProfiler::testCallbackCosts()
+{
+	ScriptCallbackCosts costs;
+	u32 dig = costs.getSlot("mod_a", "node on_dig");
+	u32 dignode = costs.getSlot("mod_b", "register_on_dignode");
+	UASSERT(dig != dignode);
+	UASSERTEQ(u32, costs.getSlot("mod_a", "node on_dig"), dig);
+
+	// on_dig runs from 0 to 100 us, two callbacks of 20 and 30 us in it
+	u64 dig_accounted = costs.getAccountedTime();
+	costs.add(dignode, 10, 30, costs.getAccountedTime());
+	costs.add(dignode, 40, 70, costs.getAccountedTime());
+	costs.add(dig, 0, 100, dig_accounted);
+
+	const std::deque<ScriptCallbackCosts::Entry> &entries = costs.getEntries();
+	UASSERTEQ(u32, entries[dig].calls, 1);
+	UASSERTEQ(u64, entries[dig].total_us, 50);
+	UASSERTEQ(u32, entries[dig].max_us, 50);
+	UASSERTEQ(u32, entries[dignode].calls, 2);
+	UASSERTEQ(u64, entries[dignode].total_us, 50);
+	UASSERTEQ(u32, entries[dignode].max_us, 30);
+
+	// Deeper nesting, each level only counts itself
+	u64 outer = costs.getAccountedTime();
+	u64 middle = costs.getAccountedTime();
+	costs.add(dignode, 120, 130, costs.getAccountedTime());
+	costs.add(dignode, 110, 160, middle);
+	costs.add(dig, 100, 200, outer);
+	UASSERTEQ(u64, entries[dig].total_us, 100);
+	UASSERTEQ(u64, entries[dignode].total_us, 100);
+	UASSERTEQ(u64, costs.getAccountedTime(), 200);
+
+	// The per-mod times add up to the time spent
+	Profiler p;
+	costs.report(&p);
+	UASSERT(fabs(p.getValue("Lua: mod_a avg ms") - 0.1f) < 0.0001f);
+	UASSERT(fabs(p.getValue("Lua: mod_b avg ms") - 0.1f) < 0.0001f);
+
+	// Sites remember their slot for every mod
+	ScriptCallbackSite site("entity on_step");
+	u32 step_a = costs.getSlot(site, "mod_a");
+	u32 step_b = costs.getSlot(site, "mod_b");
+	UASSERT(step_a != step_b);
+	UASSERTEQ(u32, costs.getSlot(site, "mod_a"), step_a);
+	UASSERTEQ(u32, costs.getSlot("mod_a", "entity on_step"), step_a);
+	UASSERTEQ(size_t, entries.size(), 4);
+
+	costs.clear();
+	UASSERTEQ(u32, entries[dig].calls, 0);
+	UASSERTEQ(u32, costs.getSlot(site, "mod_b"), step_b);
+}
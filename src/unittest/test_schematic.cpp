@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "test.h"
 
 #include "mg_schematic.h"
+#include "map.h"
 #include "gamedef.h"
 #include "nodedef.h"
 
@@ -33,6 +34,7 @@ class TestSchematic : public TestBase {
 	void testMtsSerializeDeserialize(INodeDefManager *ndef);
 	void testLuaTableSerialize(INodeDefManager *ndef);
 	void testFileSerializeDeserialize(INodeDefManager *ndef);
+	void testRotatedPlacement(INodeDefManager *ndef);
 
 	static const content_t test_schem1_data[7 * 6 * 4];
 	static const content_t test_schem2_data[3 * 3 * 3];
@@ -52,6 +54,7 @@ void TestSchematic::runTests(IGameDef *gamedef)
 	TEST(testMtsSerializeDeserialize, ndef);
 	TEST(testLuaTableSerialize, ndef);
 	TEST(testFileSerializeDeserialize, ndef);
+	TEST(testRotatedPlacement, ndef);
 
 	ndef->resetNodeResolveState();
 }
@@ -101,6 +104,14 @@ void TestSchematic::testMtsSerializeDeserialize(INodeDefManager *ndef)
 		UASSERT(schem2.schemdata[i] == schem.schemdata[i]);
 	for (s16 y = 0; y != size.Y; y++)
 		UASSERTEQ(u8, schem2.slice_probs[y], schem.slice_probs[y]);
+
+	// Truncated names or node data are rejected
+	std::string data = ss.str();
+	Schematic schem3;
+	names.clear();
+	UASSERT(!schem3.deserializeFromMts(data.substr(0, 24), &names));
+	names.clear();
+	UASSERT(!schem3.deserializeFromMts(data.substr(0, data.size() - 4), &names));
 }
 
 
@@ -181,6 +192,67 @@ void TestSchematic::testFileSerializeDeserialize(INodeDefManager *ndef)
 }
 
 
+void TestSchematic::testRotatedPlacement(INodeDefManager *ndef)
+{
+	static const v3s16 size(2, 1, 3);
+	static const content_t content_map[] = {
+		t_CONTENT_STONE,
+		t_CONTENT_GRASS,
+		t_CONTENT_WATER,
+		t_CONTENT_LAVA,
+		t_CONTENT_TORCH,
+		t_CONTENT_BRICK,
+	};
+	// Rows of nodes along x for each z, as indexes into content_map
+	static const u8 expected_90[]  = { 1, 3, 5,  0, 2, 4 };
+	static const u8 expected_180[] = { 5, 4,  3, 2,  1, 0 };
+
+	Schematic schem1, schem2;
+	schem1.flags       = 0;
+	schem1.size        = size;
+	schem1.schemdata   = new MapNode[6];
+	schem1.slice_probs = new u8[1];
+	schem1.slice_probs[0] = MTSCHEM_PROB_ALWAYS;
+	for (size_t i = 0; i != 6; i++)
+		schem1.schemdata[i] = MapNode(content_map[i], MTSCHEM_PROB_ALWAYS, 0);
+
+	std::string temp_file = getTestTempFile();
+	UASSERT(schem1.saveSchematicToFile(temp_file, ndef));
+	UASSERT(schem2.loadSchematicFromFile(temp_file, ndef));
+	size_t memory = schem2.getMemoryUsage();
+
+	// Placing twice uses the rotated data built the first time
+	for (int n = 0; n != 2; n++) {
+		MMVManip vm(NULL);
+		for (s16 z = 0; z != 3; z++)
+		for (s16 x = 0; x != 3; x++)
+			vm.setNodeNoRef(v3s16(x, 0, z), MapNode(CONTENT_AIR));
+
+		schem2.blitToVManip(&vm, v3s16(0, 0, 0), ROTATE_90, false);
+		for (s16 z = 0; z != 2; z++)
+		for (s16 x = 0; x != 3; x++) {
+			UASSERTEQ(content_t, vm.getNodeNoExNoEmerge(v3s16(x, 0, z)).getContent(),
+				content_map[expected_90[z * 3 + x]]);
+		}
+		UASSERTEQ(content_t, vm.getNodeNoExNoEmerge(v3s16(0, 0, 2)).getContent(),
+			CONTENT_AIR);
+	}
+
+	MMVManip vm(NULL);
+	for (s16 z = 0; z != 3; z++)
+	for (s16 x = 0; x != 2; x++)
+		vm.setNodeNoRef(v3s16(x, 0, z), MapNode(CONTENT_AIR));
+	schem2.blitToVManip(&vm, v3s16(0, 0, 0), ROTATE_180, false);
+	for (s16 z = 0; z != 3; z++)
+	for (s16 x = 0; x != 2; x++) {
+		UASSERTEQ(content_t, vm.getNodeNoExNoEmerge(v3s16(x, 0, z)).getContent(),
+			content_map[expected_180[z * 2 + x]]);
+	}
+
+	UASSERTEQ(size_t, schem2.getMemoryUsage(), memory + 2 * 6 * sizeof(MapNode));
+}
+
+
 // Should form a cross-shaped-thing...?
 const content_t TestSchematic::test_schem1_data[7 * 6 * 4] = {
 	3, 3, 1, 1, 1, 3, 3, // Y=0, Z=0
@@ -0,0 +1,418 @@
+/*
+MultiCraft
+Copyright (C) 2026 MultiCraft Development Team
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include "serverenvironment.h"
+#include "serverobject.h"
+#include "noise.h"
+
+class TestServerEnvironment : public TestBase
+{
+public:
+	TestServerEnvironment() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestServerEnvironment"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testLBMBatching(IGameDef *gamedef);
+	void testLBMIntroductionTimes(IGameDef *gamedef);
+	void testLBMChangedNodes(IGameDef *gamedef);
+	void testActiveBlockList();
+	void testObjectPhysicsStepper();
+};
+
+static TestServerEnvironment g_test_instance;
+
+void TestServerEnvironment::runTests(IGameDef *gamedef)
+{
+	TEST(testLBMBatching, gamedef);
+	TEST(testLBMIntroductionTimes, gamedef);
+	TEST(testLBMChangedNodes, gamedef);
+	TEST(testActiveBlockList);
+	TEST(testObjectPhysicsStepper);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Records every call, the LBMManager deletes its definitions
+struct TestLBMCalls
+{
+	u32 blocks;
+	std::vector<v3s16> positions;
+};
+
+struct TestLBM : public LoadingBlockModifierDef
+{
+	TestLBMCalls *calls;
+
+	TestLBM(const std::string &a_name, const std::string &content,
+			bool every_load, TestLBMCalls *a_calls) :
+		calls(a_calls)
+	{
+		name = a_name;
+		trigger_contents.insert(content);
+		run_at_every_load = every_load;
+		calls->blocks = 0;
+	}
+
+	void trigger(ServerEnvironment *env, v3s16 p, MapNode n)
+	{
+		calls->positions.push_back(p);
+	}
+
+	void triggerBlock(ServerEnvironment *env, MapBlock *block,
+		const std::vector<v3s16> &positions, const std::vector<MapNode> &nodes)
+	{
+		calls->blocks++;
+		LoadingBlockModifierDef::triggerBlock(env, block, positions, nodes);
+	}
+};
+
+// Replaces the nodes it triggers on with stone
+struct TestReplacingLBM : public TestLBM
+{
+	MapBlock *block;
+
+	TestReplacingLBM(const std::string &a_name, const std::string &content,
+			TestLBMCalls *a_calls, MapBlock *a_block) :
+		TestLBM(a_name, content, false, a_calls),
+		block(a_block)
+	{}
+
+	void trigger(ServerEnvironment *env, v3s16 p, MapNode n)
+	{
+		TestLBM::trigger(env, p, n);
+		MapNode stone(t_CONTENT_STONE);
+		block->setNode(p - block->getPosRelative(), stone);
+	}
+};
+
+static void set_node(MapBlock *block, s16 x, s16 y, s16 z, content_t c)
+{
+	MapNode n(c);
+	block->setNodeNoCheck(x, y, z, n);
+}
+
+static void fill_block(MapBlock *block, content_t c)
+{
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+	for (s16 y = 0; y < MAP_BLOCKSIZE; y++)
+	for (s16 x = 0; x < MAP_BLOCKSIZE; x++)
+		set_node(block, x, y, z, c);
+}
+
+void TestServerEnvironment::testLBMBatching(IGameDef *gamedef)
+{
+	TestLBMCalls torch_calls, water_calls;
+	LBMManager mgr;
+	mgr.addLBMDef(new TestLBM("test:torch", "default:torch", false,
+		&torch_calls));
+	mgr.addLBMDef(new TestLBM("test:water", "default:water", false,
+		&water_calls));
+	mgr.loadIntroductionTimes("", gamedef, 10);
+
+	MapBlock block(NULL, v3s16(1, -1, 0), gamedef);
+	fill_block(&block, CONTENT_AIR);
+
+	// Nothing to match
+	mgr.applyLBMs(NULL, &block, 0);
+	UASSERTEQ(u32, torch_calls.blocks, 0);
+	UASSERTEQ(u32, water_calls.blocks, 0);
+
+	// All matching nodes are passed at once, in block order
+	set_node(&block, 3, 4, 5, t_CONTENT_TORCH);
+	set_node(&block, 0, 0, 1, t_CONTENT_TORCH);
+	set_node(&block, 0, 15, 0, t_CONTENT_STONE);
+	mgr.applyLBMs(NULL, &block, 0);
+	UASSERTEQ(u32, torch_calls.blocks, 1);
+	UASSERTEQ(u32, water_calls.blocks, 0);
+	UASSERTEQ(size_t, torch_calls.positions.size(), 2);
+	UASSERT(torch_calls.positions[0] == v3s16(16, -16, 1));
+	UASSERT(torch_calls.positions[1] == v3s16(19, -12, 5));
+
+	fill_block(&block, t_CONTENT_WATER);
+	mgr.applyLBMs(NULL, &block, 0);
+	UASSERTEQ(u32, torch_calls.blocks, 1);
+	UASSERTEQ(u32, water_calls.blocks, 1);
+	UASSERTEQ(size_t, water_calls.positions.size(), MAP_BLOCKSIZE *
+		MAP_BLOCKSIZE * MAP_BLOCKSIZE);
+}
+
+void TestServerEnvironment::testLBMIntroductionTimes(IGameDef *gamedef)
+{
+	TestLBMCalls old_calls, new_calls, always_calls;
+	LBMManager mgr;
+	mgr.addLBMDef(new TestLBM("test:old", "default:torch", false,
+		&old_calls));
+	mgr.addLBMDef(new TestLBM("test:new", "default:torch", false,
+		&new_calls));
+	mgr.addLBMDef(new TestLBM("test:always", "default:torch", true,
+		&always_calls));
+	mgr.loadIntroductionTimes("test:old~5;", gamedef, 10);
+
+	MapBlock block(NULL, v3s16(0, 0, 0), gamedef);
+	fill_block(&block, CONTENT_AIR);
+	set_node(&block, 1, 2, 3, t_CONTENT_TORCH);
+
+	// Blocks last active after an LBM was introduced skip it
+	mgr.applyLBMs(NULL, &block, 7);
+	UASSERTEQ(u32, old_calls.blocks, 0);
+	UASSERTEQ(u32, new_calls.blocks, 1);
+	UASSERTEQ(u32, always_calls.blocks, 1);
+
+	mgr.applyLBMs(NULL, &block, 3);
+	UASSERTEQ(u32, old_calls.blocks, 1);
+	UASSERTEQ(u32, new_calls.blocks, 2);
+	UASSERTEQ(u32, always_calls.blocks, 2);
+
+	mgr.applyLBMs(NULL, &block, 20);
+	UASSERTEQ(u32, old_calls.blocks, 1);
+	UASSERTEQ(u32, new_calls.blocks, 2);
+	UASSERTEQ(u32, always_calls.blocks, 3);
+}
+
+void TestServerEnvironment::testLBMChangedNodes(IGameDef *gamedef)
+{
+	TestLBMCalls replace_calls, other_calls;
+	MapBlock block(NULL, v3s16(0, 0, 0), gamedef);
+	fill_block(&block, CONTENT_AIR);
+	set_node(&block, 1, 2, 3, t_CONTENT_TORCH);
+	set_node(&block, 4, 5, 6, t_CONTENT_TORCH);
+	set_node(&block, 7, 8, 9, t_CONTENT_WATER);
+	block.compact();
+
+	// LBMs run in the order of their names
+	LBMManager mgr;
+	mgr.addLBMDef(new TestReplacingLBM("test:a_replace", "default:torch",
+		&replace_calls, &block));
+	mgr.addLBMDef(new TestLBM("test:b_other", "default:torch", false,
+		&other_calls));
+	mgr.loadIntroductionTimes("", gamedef, 10);
+
+	// Nodes replaced by an earlier LBM are skipped
+	mgr.applyLBMs(NULL, &block, 0);
+	UASSERTEQ(size_t, replace_calls.positions.size(), 2);
+	UASSERTEQ(u32, other_calls.blocks, 1);
+	UASSERTEQ(size_t, other_calls.positions.size(), 0);
+	UASSERTEQ(content_t, block.getNodeNoEx(v3s16(1, 2, 3)).getContent(),
+		t_CONTENT_STONE);
+
+	// Nothing left to trigger on
+	mgr.applyLBMs(NULL, &block, 0);
+	UASSERTEQ(u32, replace_calls.blocks, 1);
+	UASSERTEQ(u32, other_calls.blocks, 1);
+}
+
+static void fill_sphere(v3s16 p0, s16 r, std::set<v3s16> &blocks)
+{
+	v3s16 p;
+	for (p.X = p0.X - r; p.X <= p0.X + r; p.X++)
+	for (p.Y = p0.Y - r; p.Y <= p0.Y + r; p.Y++)
+	for (p.Z = p0.Z - r; p.Z <= p0.Z + r; p.Z++) {
+		if (p.getDistanceFrom(p0) <= r)
+			blocks.insert(p);
+	}
+}
+
+void TestServerEnvironment::testActiveBlockList()
+{
+	ActiveBlockList list;
+	PseudoRandom pr(42);
+	std::vector<v3s16> players;
+	std::set<v3s16> expected;
+
+	// Random walks, joins, leaves and forceloads are compared with the
+	// blocks around the current positions
+	for (int step = 0; step < 200; step++) {
+		s16 radius = step < 150 ? 3 : 2;
+		if (players.size() < 3 && pr.range(0, 9) == 0)
+			players.push_back(v3s16(pr.range(-20, 20), 0, pr.range(-20, 20)));
+		if (!players.empty() && pr.range(0, 29) == 0)
+			players.erase(players.begin() + pr.range(0, players.size() - 1));
+		for (size_t i = 0; i < players.size(); i++) {
+			players[i].X += pr.range(-1, 1);
+			players[i].Y += pr.range(-1, 1);
+			players[i].Z += pr.range(-1, 1) * pr.range(0, 10);
+		}
+		if (pr.range(0, 9) == 0)
+			list.m_forceloaded_list.insert(v3s16(pr.range(-30, 30), 0, 0));
+		if (!list.m_forceloaded_list.empty() && pr.range(0, 19) == 0)
+			list.m_forceloaded_list.erase(list.m_forceloaded_list.begin());
+
+		std::set<v3s16> now = list.m_forceloaded_list;
+		for (size_t i = 0; i < players.size(); i++)
+			fill_sphere(players[i], radius, now);
+
+		std::vector<v3s16> removed, added;
+		list.update(players, radius, removed, added);
+
+		std::set<v3s16> removed_set(removed.begin(), removed.end());
+		std::set<v3s16> added_set(added.begin(), added.end());
+		UASSERTEQ(size_t, removed_set.size(), removed.size());
+		UASSERTEQ(size_t, added_set.size(), added.size());
+		for (std::set<v3s16>::iterator i = expected.begin();
+				i != expected.end(); ++i)
+			UASSERT((now.count(*i) == 0) == (removed_set.count(*i) == 1));
+		for (std::set<v3s16>::iterator i = now.begin(); i != now.end(); ++i)
+			UASSERT((expected.count(*i) == 0) == (added_set.count(*i) == 1));
+
+		expected = now;
+		UASSERT(std::set<v3s16>(list.m_list.begin(), list.m_list.end()) ==
+			expected);
+		UASSERTEQ(size_t, list.m_list.size(), expected.size());
+	}
+
+	// Blocks that failed to load are added again while they are in range
+	UASSERT(!players.empty() || !expected.empty());
+	std::vector<v3s16> failed(1, *expected.begin());
+	list.remove(failed);
+	UASSERT(!list.contains(failed[0]));
+	std::vector<v3s16> removed, added;
+	list.update(players, 2, removed, added);
+	UASSERT(removed.empty());
+	UASSERTEQ(size_t, added.size(), 1);
+	UASSERT(added[0] == failed[0]);
+	UASSERT(list.contains(failed[0]));
+}
+
+// Falls onto a floor at y = 0 and is pushed away by the other objects
+class TestPhysicsSAO : public ServerActiveObject
+{
+public:
+	TestPhysicsSAO(v3f pos, const std::vector<ServerActiveObject *> *others) :
+		ServerActiveObject(NULL, pos),
+		m_steps(0),
+		m_others(others)
+	{}
+
+	ActiveObjectType getType() const { return ACTIVEOBJECT_TYPE_TEST; }
+	bool getCollisionBox(aabb3f *toset) const { return false; }
+	bool collideWithObjects() const { return false; }
+
+	// The movement of the serial path
+	void step(float dtime, bool send_recommended)
+	{
+		m_base_position = move(dtime);
+	}
+
+	bool stepPhysics(float dtime)
+	{
+		m_next_position = move(dtime);
+		m_steps++;
+		return true;
+	}
+
+	void finishPhysics()
+	{
+		m_base_position = m_next_position;
+	}
+
+	u32 m_steps;
+
+private:
+	v3f move(float dtime)
+	{
+		v3f push(0, 0, 0);
+		for (size_t i = 0; i < m_others->size(); i++) {
+			v3f d = m_base_position - (*m_others)[i]->getBasePosition();
+			float dist_sq = d.getLengthSQ();
+			if (dist_sq > 0 && dist_sq < 4)
+				push += d / dist_sq;
+		}
+		v3f pos = m_base_position + (push + v3f(0, -10, 0)) * dtime;
+		pos.Y = MYMAX(pos.Y, 0);
+		return pos;
+	}
+
+	const std::vector<ServerActiveObject *> *m_others;
+	v3f m_next_position;
+};
+
+static void create_physics_objects(std::vector<ServerActiveObject *> &objects)
+{
+	PseudoRandom pr(13);
+	for (int i = 0; i < 200; i++) {
+		v3f pos(pr.range(0, 1000) / 100.0f, pr.range(0, 500) / 100.0f,
+			pr.range(0, 1000) / 100.0f);
+		objects.push_back(new TestPhysicsSAO(pos, &objects));
+	}
+}
+
+static void delete_physics_objects(std::vector<ServerActiveObject *> &objects)
+{
+	for (size_t i = 0; i < objects.size(); i++)
+		delete objects[i];
+	objects.clear();
+}
+
+void TestServerEnvironment::testObjectPhysicsStepper()
+{
+	const float dtime = 0.05f;
+	const int steps = 20;
+
+	// Objects that do not affect each other move the same way as on the
+	// serial path
+	std::vector<ServerActiveObject *> serial, parallel, none;
+	for (int i = 0; i < 50; i++) {
+		v3f pos(i * 3, i % 7, 0);
+		serial.push_back(new TestPhysicsSAO(pos, &none));
+		parallel.push_back(new TestPhysicsSAO(pos, &none));
+	}
+	{
+		ObjectPhysicsStepper stepper(3);
+		for (int s = 0; s < steps; s++) {
+			for (size_t i = 0; i < serial.size(); i++)
+				serial[i]->step(dtime, false);
+			stepper.run(parallel, dtime);
+			for (size_t i = 0; i < parallel.size(); i++)
+				parallel[i]->finishPhysics();
+		}
+	}
+	for (size_t i = 0; i < serial.size(); i++)
+		UASSERT(serial[i]->getBasePosition() == parallel[i]->getBasePosition());
+	delete_physics_objects(serial);
+	delete_physics_objects(parallel);
+
+	// Otherwise, every object sees the positions of the previous step, no
+	// matter how many threads there are
+	std::vector<v3f> expected;
+	u16 thread_counts[] = { 0, 1, 3 };
+	for (size_t t = 0; t < ARRLEN(thread_counts); t++) {
+		std::vector<ServerActiveObject *> objects;
+		create_physics_objects(objects);
+		{
+			ObjectPhysicsStepper stepper(thread_counts[t]);
+			for (int s = 0; s < steps; s++) {
+				stepper.run(objects, dtime);
+				for (size_t i = 0; i < objects.size(); i++)
+					objects[i]->finishPhysics();
+			}
+		}
+		if (t == 0) {
+			for (size_t i = 0; i < objects.size(); i++)
+				expected.push_back(objects[i]->getBasePosition());
+		}
+		for (size_t i = 0; i < objects.size(); i++) {
+			UASSERT(objects[i]->getBasePosition() == expected[i]);
+			UASSERTEQ(u32, ((TestPhysicsSAO *)objects[i])->m_steps, steps);
+		}
+		delete_physics_objects(objects);
+	}
+}
@@ -20,6 +20,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "test.h"
 
 #include "gamedef.h"
+#include "log.h"
+#include "map.h"
+#include "mapblock.h"
+#include "mapsector.h"
 #include "voxelalgorithms.h"
 #include "util/numeric.h"
 
@@ -33,6 +37,8 @@ class TestVoxelAlgorithms : public TestBase {
 	void testPropogateSunlight(INodeDefManager *ndef);
 	void testClearLightAndCollectSources(INodeDefManager *ndef);
 	void testVoxelLineIterator(INodeDefManager *ndef);
+	void testComputeVManipLight(INodeDefManager *ndef);
+	void testComputedLightMatchesBlitBack(IGameDef *gamedef);
 };
 
 static TestVoxelAlgorithms g_test_instance;
@@ -44,6 +50,8 @@ void TestVoxelAlgorithms::runTests(IGameDef *gamedef)
 	TEST(testPropogateSunlight, ndef);
 	TEST(testClearLightAndCollectSources, ndef);
 	TEST(testVoxelLineIterator, ndef);
+	TEST(testComputeVManipLight, ndef);
+	TEST(testComputedLightMatchesBlitBack, gamedef);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -261,3 +269,114 @@ void TestVoxelAlgorithms::testVoxelLineIterator(INodeDefManager *ndef)
 		UASSERTEQ(int, actual_nodecount, nodecount);
 	}
 }
+
+void TestVoxelAlgorithms::testComputeVManipLight(INodeDefManager *ndef)
+{
+	MMVManip vm(NULL);
+	// A roof at y = 10 with a hole at (8, 8) and a torch below it
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+	for (s16 y = 0; y < MAP_BLOCKSIZE; y++)
+	for (s16 x = 0; x < MAP_BLOCKSIZE; x++) {
+		bool roof = y == 10 && (x != 8 || z != 8);
+		vm.setNodeNoRef(v3s16(x, y, z),
+			MapNode(roof ? t_CONTENT_STONE : CONTENT_AIR));
+	}
+	vm.setNodeNoRef(v3s16(2, 3, 2), MapNode(t_CONTENT_TORCH));
+
+	std::vector<bool> sunlight(MAP_BLOCKSIZE * MAP_BLOCKSIZE, true);
+	voxalgo::compute_vmanip_light(&vm, ndef, &sunlight);
+
+	UASSERTEQ(int, vm.getNodeNoEx(v3s16(3, 12, 3)).getLight(LIGHTBANK_DAY, ndef),
+		LIGHT_SUN);
+	UASSERTEQ(int, vm.getNodeNoEx(v3s16(8, 0, 8)).getLight(LIGHTBANK_DAY, ndef),
+		LIGHT_SUN);
+	UASSERTEQ(int, vm.getNodeNoEx(v3s16(4, 5, 8)).getLight(LIGHTBANK_DAY, ndef),
+		LIGHT_SUN - 4);
+	UASSERTEQ(int, vm.getNodeNoEx(v3s16(0, 0, 15)).getLight(LIGHTBANK_DAY, ndef),
+		0);
+	UASSERTEQ(int, vm.getNodeNoEx(v3s16(2, 3, 5)).getLight(LIGHTBANK_NIGHT, ndef),
+		LIGHT_MAX - 4);
+	UASSERTEQ(int, vm.getNodeNoEx(v3s16(2, 12, 2)).getLight(LIGHTBANK_NIGHT, ndef),
+		0);
+
+	// Only the hole lets sunlight out of the bottom
+	UASSERT(sunlight[8 * MAP_BLOCKSIZE + 8]);
+	UASSERT(!sunlight[0]);
+	UASSERT(!sunlight[2 * MAP_BLOCKSIZE + 2]);
+}
+
+// 3x3x3 blocks around the origin, stone below y = -8 and air above, lit
+static void make_lit_map(Map &map, IGameDef *gamedef)
+{
+	for (s16 bz = -1; bz <= 1; bz++)
+	for (s16 bx = -1; bx <= 1; bx++) {
+		v2s16 p2d(bx, bz);
+		MapSector *sector = new ServerMapSector(&map, p2d, gamedef);
+		(*map.getSectorsPtr())[p2d] = sector;
+		for (s16 by = -1; by <= 1; by++) {
+			MapBlock *block = sector->createBlankBlock(by);
+			for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+			for (s16 y = 0; y < MAP_BLOCKSIZE; y++)
+			for (s16 x = 0; x < MAP_BLOCKSIZE; x++) {
+				bool ground = by * MAP_BLOCKSIZE + y < -8;
+				MapNode n(ground ? t_CONTENT_STONE : CONTENT_AIR);
+				block->setNodeNoCheck(x, y, z, n);
+			}
+		}
+	}
+
+	std::map<v3s16, MapBlock *> modified_blocks;
+	MMVManip vm(&map);
+	vm.initialEmerge(v3s16(-1, -1, -1), v3s16(1, 1, 1));
+	voxalgo::blit_back_with_light(&map, &vm, &modified_blocks);
+}
+
+// A roof with a hole over the block at the origin and a torch at its border
+static void edit_origin_block(MMVManip *vm)
+{
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+	for (s16 x = 0; x < MAP_BLOCKSIZE; x++) {
+		if (x != 8 || z != 8)
+			vm->setNodeNoEmerge(v3s16(x, 10, z), MapNode(t_CONTENT_STONE));
+	}
+	vm->setNodeNoEmerge(v3s16(0, 3, 5), MapNode(t_CONTENT_TORCH));
+}
+
+void TestVoxelAlgorithms::testComputedLightMatchesBlitBack(IGameDef *gamedef)
+{
+	INodeDefManager *ndef = gamedef->getNodeDefManager();
+	std::map<v3s16, MapBlock *> modified_blocks;
+
+	// Like place_schematic()
+	Map map1(dout_server, gamedef);
+	make_lit_map(map1, gamedef);
+	MMVManip vm1(&map1);
+	vm1.initialEmerge(v3s16(0, 0, 0), v3s16(0, 0, 0));
+	edit_origin_block(&vm1);
+	voxalgo::blit_back_with_light(&map1, &vm1, &modified_blocks);
+
+	// Like place_schematic_async()
+	Map map2(dout_server, gamedef);
+	make_lit_map(map2, gamedef);
+	std::vector<bool> sunlight;
+	MMVManip vm2(&map2);
+	vm2.initialEmerge(v3s16(0, 0, 0), v3s16(0, 0, 0));
+	voxalgo::get_vmanip_sunlight(&map2, &vm2, &sunlight);
+	edit_origin_block(&vm2);
+	voxalgo::compute_vmanip_light(&vm2, ndef, &sunlight);
+	voxalgo::blit_back_with_computed_light(&map2, &vm2, sunlight,
+		&modified_blocks);
+
+	// The edit changed the light outside of its block
+	UASSERT(map1.getNodeNoEx(v3s16(-2, 3, 5)).getLight(LIGHTBANK_NIGHT, ndef)
+		== LIGHT_MAX - 3);
+	UASSERT(map1.getNodeNoEx(v3s16(3, -4, 3)).getLight(LIGHTBANK_DAY, ndef)
+		< LIGHT_SUN);
+
+	for (s16 z = -MAP_BLOCKSIZE; z < 2 * MAP_BLOCKSIZE; z++)
+	for (s16 y = -MAP_BLOCKSIZE; y < 2 * MAP_BLOCKSIZE; y++)
+	for (s16 x = -MAP_BLOCKSIZE; x < 2 * MAP_BLOCKSIZE; x++) {
+		v3s16 p(x, y, z);
+		UASSERT(map1.getNodeNoEx(p) == map2.getNodeNoEx(p));
+	}
+}
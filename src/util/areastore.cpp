@@ -20,6 +20,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/areastore.h"
 #include "util/serialize.h"
 #include "util/container.h"
+#include <algorithm>
+#include <cmath>
 
 #if USE_SPATIAL
 	#include <spatialindex/SpatialIndex.h>
@@ -50,7 +52,7 @@ AreaStore *AreaStore::getOptimalImplementation()
 #if USE_SPATIAL
 	return new SpatialAreaStore();
 #else
-	return new VectorAreaStore();
+	return new RTreeAreaStore();
 #endif
 }
 
@@ -86,17 +88,24 @@ void AreaStore::deserialize(std::istream &is)
 				"serialization version!");
 
 	u16 num_areas = readU16(is);
+	std::vector<Area> areas(num_areas);
 	for (u32 i = 0; i < num_areas; ++i) {
-		Area a;
+		Area &a = areas[i];
 		a.minedge = readV3S16(is);
 		a.maxedge = readV3S16(is);
 		u16 data_len = readU16(is);
 		char *data = new char[data_len];
 		is.read(data, data_len);
 		a.data = std::string(data, data_len);
-		insertArea(&a);
 		delete [] data;
 	}
+	insertAreas(areas);
+}
+
+void AreaStore::insertAreas(std::vector<Area> &areas)
+{
+	for (size_t i = 0; i < areas.size(); i++)
+		insertArea(&areas[i]);
 }
 
 void AreaStore::invalidateCache()
@@ -213,6 +222,499 @@ void VectorAreaStore::getAreasInArea(std::vector<Area *> *result,
 	}
 }
 
+
+////
+// RTreeAreaStore
+////
+
+// Nodes with fewer entries are dissolved when areas are removed
+#define RTREE_MIN_ENTRIES 4
+// Entries per node when building the tree from the bottom up
+#define RTREE_BULK_FILL 12
+
+#define RTREE_NO_NODE U32_MAX
+
+static inline s16 get_axis(const v3s16 &v, int axis)
+{
+	return axis == 0 ? v.X : axis == 1 ? v.Y : v.Z;
+}
+
+template <typename T>
+static inline void extend_box(T &box, const T &b)
+{
+	box.minedge.X = MYMIN(box.minedge.X, b.minedge.X);
+	box.minedge.Y = MYMIN(box.minedge.Y, b.minedge.Y);
+	box.minedge.Z = MYMIN(box.minedge.Z, b.minedge.Z);
+	box.maxedge.X = MYMAX(box.maxedge.X, b.maxedge.X);
+	box.maxedge.Y = MYMAX(box.maxedge.Y, b.maxedge.Y);
+	box.maxedge.Z = MYMAX(box.maxedge.Z, b.maxedge.Z);
+}
+
+template <typename T>
+static inline s64 box_volume(const T &box)
+{
+	return (s64)(box.maxedge.X - box.minedge.X + 1) *
+		(box.maxedge.Y - box.minedge.Y + 1) *
+		(box.maxedge.Z - box.minedge.Z + 1);
+}
+
+template <typename T>
+static inline s64 box_margin(const T &box)
+{
+	return (s64)(box.maxedge.X - box.minedge.X) +
+		(box.maxedge.Y - box.minedge.Y) + (box.maxedge.Z - box.minedge.Z);
+}
+
+template <typename T>
+static inline s64 overlap_volume(const T &a, const T &b)
+{
+	s64 v = 1;
+	for (int axis = 0; axis < 3; axis++) {
+		s32 lo = MYMAX(get_axis(a.minedge, axis), get_axis(b.minedge, axis));
+		s32 hi = MYMIN(get_axis(a.maxedge, axis), get_axis(b.maxedge, axis));
+		if (hi < lo)
+			return 0;
+		v *= hi - lo + 1;
+	}
+	return v;
+}
+
+template <typename T>
+struct BoxCenterLess {
+	BoxCenterLess(int axis) : axis(axis) {}
+
+	bool operator()(const T &a, const T &b) const
+	{
+		return (s32)get_axis(a.minedge, axis) + get_axis(a.maxedge, axis) <
+			(s32)get_axis(b.minedge, axis) + get_axis(b.maxedge, axis);
+	}
+
+	int axis;
+};
+
+
+const u32 RTreeAreaStore::NODE_CAPACITY;
+
+RTreeAreaStore::RTreeAreaStore()
+{
+	m_root = allocNode(true);
+}
+
+void RTreeAreaStore::reserve(size_t count)
+{
+	m_nodes.reserve(count / RTREE_MIN_ENTRIES + 1);
+}
+
+u32 RTreeAreaStore::allocNode(bool leaf)
+{
+	u32 n;
+	if (!m_free_nodes.empty()) {
+		n = m_free_nodes.back();
+		m_free_nodes.pop_back();
+	} else {
+		n = m_nodes.size();
+		m_nodes.push_back(Node());
+	}
+	Node &node = m_nodes[n];
+	node.parent = RTREE_NO_NODE;
+	node.count = 0;
+	node.leaf = leaf;
+	return n;
+}
+
+RTreeAreaStore::Entry RTreeAreaStore::getNodeBox(u32 n) const
+{
+	const Node &node = m_nodes[n];
+	Entry box = node.entries[0];
+	for (u32 i = 1; i < node.count; i++)
+		extend_box(box, node.entries[i]);
+	box.child = n;
+	box.area = NULL;
+	return box;
+}
+
+void RTreeAreaStore::updateBox(u32 n)
+{
+	while (n != m_root) {
+		Node &parent = m_nodes[m_nodes[n].parent];
+		u32 i = 0;
+		while (parent.entries[i].child != n)
+			i++;
+		Entry box = getNodeBox(n);
+		Entry &e = parent.entries[i];
+		if (e.minedge == box.minedge && e.maxedge == box.maxedge)
+			break;
+		e = box;
+		n = m_nodes[n].parent;
+	}
+}
+
+bool RTreeAreaStore::insertArea(Area *a)
+{
+	if (a->id == U32_MAX)
+		a->id = getNextId();
+	std::pair<AreaMap::iterator, bool> res =
+			areas_map.insert(std::make_pair(a->id, *a));
+	if (!res.second)
+		// ID is not unique
+		return false;
+
+	Entry e;
+	e.minedge = a->minedge;
+	e.maxedge = a->maxedge;
+	e.child = RTREE_NO_NODE;
+	e.area = &res.first->second;
+	insertEntry(e);
+	invalidateCache();
+	return true;
+}
+
+void RTreeAreaStore::insertEntry(const Entry &e)
+{
+	// Go down to the leaf that needs to grow the least
+	u32 n = m_root;
+	while (!m_nodes[n].leaf) {
+		const Node &node = m_nodes[n];
+		u32 best = 0;
+		s64 best_growth = 0, best_volume = 0;
+		for (u32 i = 0; i < node.count; i++) {
+			Entry box = node.entries[i];
+			s64 volume = box_volume(box);
+			extend_box(box, e);
+			s64 growth = box_volume(box) - volume;
+			if (i == 0 || growth < best_growth ||
+					(growth == best_growth && volume < best_volume)) {
+				best = i;
+				best_growth = growth;
+				best_volume = volume;
+			}
+		}
+		n = node.entries[best].child;
+	}
+	addEntry(n, e);
+}
+
+void RTreeAreaStore::addEntry(u32 n, const Entry &e)
+{
+	Node &node = m_nodes[n];
+	if (node.count == NODE_CAPACITY) {
+		splitNode(n, e);
+		return;
+	}
+	node.entries[node.count++] = e;
+	if (!node.leaf)
+		m_nodes[e.child].parent = n;
+	updateBox(n);
+}
+
+void RTreeAreaStore::splitNode(u32 n, const Entry &e)
+{
+	Entry all[NODE_CAPACITY + 1];
+	const u32 count = NODE_CAPACITY + 1;
+	std::copy(m_nodes[n].entries, m_nodes[n].entries + NODE_CAPACITY, all);
+	all[NODE_CAPACITY] = e;
+
+	/*
+		R*-tree split: take the axis where the groups have the smallest
+		margins, then the split with the least overlap of the groups
+	*/
+	Entry low[count], high[count];
+	int best_axis = 0;
+	s64 best_margin = -1;
+	for (int axis = 0; axis < 3; axis++) {
+		std::sort(all, all + count, BoxCenterLess<Entry>(axis));
+		low[0] = all[0];
+		for (u32 i = 1; i < count; i++) {
+			low[i] = low[i - 1];
+			extend_box(low[i], all[i]);
+		}
+		high[count - 1] = all[count - 1];
+		for (u32 i = count - 1; i-- > 0;) {
+			high[i] = high[i + 1];
+			extend_box(high[i], all[i]);
+		}
+		s64 margin = 0;
+		for (u32 k = RTREE_MIN_ENTRIES; k <= count - RTREE_MIN_ENTRIES; k++)
+			margin += box_margin(low[k - 1]) + box_margin(high[k]);
+		if (best_margin < 0 || margin < best_margin) {
+			best_margin = margin;
+			best_axis = axis;
+		}
+	}
+
+	std::sort(all, all + count, BoxCenterLess<Entry>(best_axis));
+	low[0] = all[0];
+	for (u32 i = 1; i < count; i++) {
+		low[i] = low[i - 1];
+		extend_box(low[i], all[i]);
+	}
+	high[count - 1] = all[count - 1];
+	for (u32 i = count - 1; i-- > 0;) {
+		high[i] = high[i + 1];
+		extend_box(high[i], all[i]);
+	}
+	u32 split = RTREE_MIN_ENTRIES;
+	s64 best_overlap = -1, best_volume = 0;
+	for (u32 k = RTREE_MIN_ENTRIES; k <= count - RTREE_MIN_ENTRIES; k++) {
+		s64 overlap = overlap_volume(low[k - 1], high[k]);
+		s64 volume = box_volume(low[k - 1]) + box_volume(high[k]);
+		if (best_overlap < 0 || overlap < best_overlap ||
+				(overlap == best_overlap && volume < best_volume)) {
+			split = k;
+			best_overlap = overlap;
+			best_volume = volume;
+		}
+	}
+
+	// Allocating may move the nodes
+	u32 sibling = allocNode(m_nodes[n].leaf);
+	Node &node = m_nodes[n];
+	Node &other = m_nodes[sibling];
+	node.count = split;
+	std::copy(all, all + split, node.entries);
+	other.count = count - split;
+	std::copy(all + split, all + count, other.entries);
+	if (!node.leaf) {
+		for (u32 i = 0; i < node.count; i++)
+			m_nodes[node.entries[i].child].parent = n;
+		for (u32 i = 0; i < other.count; i++)
+			m_nodes[other.entries[i].child].parent = sibling;
+	}
+
+	if (n == m_root) {
+		u32 root = allocNode(false);
+		Node &r = m_nodes[root];
+		r.count = 2;
+		r.entries[0] = getNodeBox(n);
+		r.entries[1] = getNodeBox(sibling);
+		m_nodes[n].parent = root;
+		m_nodes[sibling].parent = root;
+		m_root = root;
+		return;
+	}
+
+	// The node only shrank, the parent takes the sibling
+	u32 parent = m_nodes[n].parent;
+	Node &p = m_nodes[parent];
+	for (u32 i = 0; i < p.count; i++) {
+		if (p.entries[i].child == n) {
+			p.entries[i] = getNodeBox(n);
+			break;
+		}
+	}
+	addEntry(parent, getNodeBox(sibling));
+}
+
+bool RTreeAreaStore::removeArea(u32 id)
+{
+	AreaMap::iterator it = areas_map.find(id);
+	if (it == areas_map.end())
+		return false;
+	Area *a = &it->second;
+
+	// Find the leaf, going down all nodes that contain the area
+	m_stack.clear();
+	m_stack.push_back(m_root);
+	while (!m_stack.empty()) {
+		u32 n = m_stack.back();
+		m_stack.pop_back();
+		const Node &node = m_nodes[n];
+		for (u32 i = 0; i < node.count; i++) {
+			const Entry &e = node.entries[i];
+			if (!AST_CONTAINS_AREA(e.minedge, e.maxedge, a))
+				continue;
+			if (!node.leaf) {
+				m_stack.push_back(e.child);
+			} else if (e.area == a) {
+				removeEntry(n, i);
+				m_stack.clear();
+				break;
+			}
+		}
+	}
+
+	areas_map.erase(it);
+	invalidateCache();
+	return true;
+}
+
+void RTreeAreaStore::removeEntry(u32 n, u32 i)
+{
+	Node &leaf = m_nodes[n];
+	leaf.entries[i] = leaf.entries[--leaf.count];
+
+	m_orphans.clear();
+	while (n != m_root && m_nodes[n].count < RTREE_MIN_ENTRIES) {
+		u32 parent = m_nodes[n].parent;
+		collectAreas(n);
+		Node &p = m_nodes[parent];
+		for (u32 k = 0; k < p.count; k++) {
+			if (p.entries[k].child == n) {
+				p.entries[k] = p.entries[--p.count];
+				break;
+			}
+		}
+		n = parent;
+	}
+	if (m_nodes[n].count > 0)
+		updateBox(n);
+
+	// Remove roots with a single child
+	Node &root = m_nodes[m_root];
+	if (!root.leaf && root.count == 0)
+		root.leaf = true;
+	while (!m_nodes[m_root].leaf && m_nodes[m_root].count == 1) {
+		u32 child = m_nodes[m_root].entries[0].child;
+		m_free_nodes.push_back(m_root);
+		m_root = child;
+		m_nodes[m_root].parent = RTREE_NO_NODE;
+	}
+
+	for (size_t k = 0; k < m_orphans.size(); k++) {
+		Area *a = m_orphans[k];
+		Entry e;
+		e.minedge = a->minedge;
+		e.maxedge = a->maxedge;
+		e.child = RTREE_NO_NODE;
+		e.area = a;
+		insertEntry(e);
+	}
+}
+
+void RTreeAreaStore::collectAreas(u32 n)
+{
+	const Node &node = m_nodes[n];
+	for (u32 i = 0; i < node.count; i++) {
+		if (node.leaf)
+			m_orphans.push_back(node.entries[i].area);
+		else
+			collectAreas(node.entries[i].child);
+	}
+	m_free_nodes.push_back(n);
+}
+
+void RTreeAreaStore::insertAreas(std::vector<Area> &areas)
+{
+	// Adding a few areas to many is faster one by one
+	if (areas.size() < size()) {
+		AreaStore::insertAreas(areas);
+		return;
+	}
+
+	for (size_t i = 0; i < areas.size(); i++) {
+		Area &a = areas[i];
+		if (a.id == U32_MAX)
+			a.id = getNextId();
+		areas_map.insert(std::make_pair(a.id, a));
+	}
+	bulkLoad();
+	invalidateCache();
+}
+
+void RTreeAreaStore::sortTiles(std::vector<Entry>::iterator begin,
+		std::vector<Entry>::iterator end, int axis, size_t fill)
+{
+	std::sort(begin, end, BoxCenterLess<Entry>(axis));
+	size_t count = end - begin;
+	if (axis == 2 || count <= fill)
+		return;
+
+	// Sort-tile-recursive: slabs along this axis, each one holding
+	// about the same number of nodes
+	size_t nodes = (count + fill - 1) / fill;
+	size_t slabs = ceil(pow((double)nodes, 1.0 / (3 - axis)));
+	size_t slab_size = fill * ((nodes + slabs - 1) / slabs);
+	for (size_t i = 0; i < count; i += slab_size)
+		sortTiles(begin + i, begin + MYMIN(i + slab_size, count),
+			axis + 1, fill);
+}
+
+void RTreeAreaStore::bulkLoad()
+{
+	m_nodes.clear();
+	m_free_nodes.clear();
+
+	std::vector<Entry> entries;
+	entries.reserve(areas_map.size());
+	for (AreaMap::iterator it = areas_map.begin();
+			it != areas_map.end(); ++it) {
+		Entry e;
+		e.minedge = it->second.minedge;
+		e.maxedge = it->second.maxedge;
+		e.child = RTREE_NO_NODE;
+		e.area = &it->second;
+		entries.push_back(e);
+	}
+
+	bool leaf = true;
+	while (entries.size() > NODE_CAPACITY) {
+		sortTiles(entries.begin(), entries.end(), 0, RTREE_BULK_FILL);
+		std::vector<Entry> parents;
+		for (size_t i = 0; i < entries.size(); i += RTREE_BULK_FILL) {
+			u32 n = allocNode(leaf);
+			Node &node = m_nodes[n];
+			node.count = MYMIN(entries.size() - i, (size_t)RTREE_BULK_FILL);
+			std::copy(entries.begin() + i, entries.begin() + i + node.count,
+				node.entries);
+			if (!leaf) {
+				for (u32 k = 0; k < node.count; k++)
+					m_nodes[node.entries[k].child].parent = n;
+			}
+			parents.push_back(getNodeBox(n));
+		}
+		entries.swap(parents);
+		leaf = false;
+	}
+
+	m_root = allocNode(leaf);
+	Node &root = m_nodes[m_root];
+	root.count = entries.size();
+	std::copy(entries.begin(), entries.end(), root.entries);
+	if (!leaf) {
+		for (u32 k = 0; k < root.count; k++)
+			m_nodes[root.entries[k].child].parent = m_root;
+	}
+}
+
+void RTreeAreaStore::getAreasForPosImpl(std::vector<Area *> *result, v3s16 pos)
+{
+	m_stack.clear();
+	m_stack.push_back(m_root);
+	while (!m_stack.empty()) {
+		const Node &node = m_nodes[m_stack.back()];
+		m_stack.pop_back();
+		for (u32 i = 0; i < node.count; i++) {
+			const Entry *e = &node.entries[i];
+			if (!AST_CONTAINS_PT(e, pos))
+				continue;
+			if (node.leaf)
+				result->push_back(e->area);
+			else
+				m_stack.push_back(e->child);
+		}
+	}
+}
+
+void RTreeAreaStore::getAreasInArea(std::vector<Area *> *result,
+		v3s16 minedge, v3s16 maxedge, bool accept_overlap)
+{
+	m_stack.clear();
+	m_stack.push_back(m_root);
+	while (!m_stack.empty()) {
+		const Node &node = m_nodes[m_stack.back()];
+		m_stack.pop_back();
+		for (u32 i = 0; i < node.count; i++) {
+			const Entry *e = &node.entries[i];
+			if (!AST_AREAS_OVERLAP(minedge, maxedge, e))
+				continue;
+			if (!node.leaf)
+				m_stack.push_back(e->child);
+			else if (accept_overlap || AST_CONTAINS_AREA(minedge, maxedge, e))
+				result->push_back(e->area);
+		}
+	}
+}
+
 #if USE_SPATIAL
 
 static inline SpatialIndex::Region get_spatial_region(const v3s16 minedge,
@@ -76,6 +76,10 @@ class AreaStore {
 	/// @return Whether the area was in the store and removed.
 	virtual bool removeArea(u32 id) = 0;
 
+	/// Adds many areas at once, like insertArea does for each of them.
+	/// Implementations may build their index faster this way.
+	virtual void insertAreas(std::vector<Area> &areas);
+
 	/// Finds areas that the passed position is contained in.
 	/// Stores output in passed vector.
 	void getAreasForPos(std::vector<Area *> *result, v3s16 pos);
@@ -149,6 +153,63 @@ class VectorAreaStore : public AreaStore {
 };
 
 
+class RTreeAreaStore : public AreaStore {
+public:
+	RTreeAreaStore();
+
+	virtual void reserve(size_t count);
+	virtual bool insertArea(Area *a);
+	virtual bool removeArea(u32 id);
+	virtual void insertAreas(std::vector<Area> &areas);
+	virtual void getAreasInArea(std::vector<Area *> *result,
+		v3s16 minedge, v3s16 maxedge, bool accept_overlap);
+
+protected:
+	virtual void getAreasForPosImpl(std::vector<Area *> *result, v3s16 pos);
+
+private:
+	static const u32 NODE_CAPACITY = 16;
+
+	/// Bounding box of a child node, or an area in a leaf.
+	struct Entry {
+		v3s16 minedge, maxedge;
+		u32 child;
+		Area *area;
+	};
+
+	struct Node {
+		u32 parent;
+		u32 count;
+		bool leaf;
+		Entry entries[NODE_CAPACITY];
+	};
+
+	u32 allocNode(bool leaf);
+	Entry getNodeBox(u32 n) const;
+	/// Updates the boxes of a node and its parents.
+	void updateBox(u32 n);
+	void insertEntry(const Entry &e);
+	void addEntry(u32 n, const Entry &e);
+	void splitNode(u32 n, const Entry &e);
+	/// Removes an entry of a leaf, reinserting the areas of the nodes
+	/// that become too small.
+	void removeEntry(u32 n, u32 i);
+	/// Frees a node and its children, adding their areas to m_orphans.
+	void collectAreas(u32 n);
+	/// Builds the tree of all areas from the bottom up.
+	void bulkLoad();
+
+	static void sortTiles(std::vector<Entry>::iterator begin,
+		std::vector<Entry>::iterator end, int axis, size_t fill);
+
+	std::vector<Node> m_nodes;
+	std::vector<u32> m_free_nodes;
+	u32 m_root;
+	std::vector<u32> m_stack;
+	std::vector<Area *> m_orphans;
+};
+
+
 #if USE_SPATIAL
 
 class SpatialAreaStore : public AreaStore {
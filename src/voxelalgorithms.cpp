@@ -966,7 +966,7 @@ void fill_with_sunlight(MMVManip *vm, INodeDefManager *ndef, v2s16 offset,
  * is sunlight above the block at the given z-x relative
  * node coordinates.
  */
-void is_sunlight_above_block(ServerMap *map, mapblock_v3 pos,
+void is_sunlight_above_block(Map *map, mapblock_v3 pos,
 	INodeDefManager *ndef, bool light[MAP_BLOCKSIZE][MAP_BLOCKSIZE])
 {
 	mapblock_v3 source_block_pos = pos + v3s16(0, 1, 0);
@@ -1094,6 +1094,42 @@ const VoxelArea block_pad[] = {
 	VoxelArea(v3s16(0, 0, 0), v3s16(0, 15, 15))    //X-
 };
 
+/*!
+ * Sets the light of the nodes in the given queues and spreads it.
+ * Sunlight must already be set in the map.
+ *
+ * \param relight the first queue is for day light, the second is for
+ * night light.
+ * \param modified_blocks the procedure adds all modified blocks to
+ * this map
+ */
+void spread_queued_light(Map *map, INodeDefManager *ndef,
+	ReLightQueue relight[2], std::map<v3s16, MapBlock*> *modified_blocks)
+{
+	// dummy boolean
+	bool is_valid;
+
+	// For each light bank:
+	for (size_t b = 0; b < 2; b++) {
+		LightBank bank = banks[b];
+		// Sunlight is already initialized.
+		u8 maxlight = (b == 0) ? LIGHT_MAX : LIGHT_SUN;
+		// Initialize light values for light spreading.
+		for (u8 i = 0; i <= maxlight; i++) {
+			const std::vector<ChangingLight> &lights = relight[b].lights[i];
+			for (std::vector<ChangingLight>::const_iterator it = lights.begin();
+					it < lights.end(); ++it) {
+				MapNode n = it->block->getNodeNoCheck(it->rel_position,
+					&is_valid);
+				n.setLight(bank, i, ndef);
+				it->block->setNodeNoCheck(it->rel_position, n);
+			}
+		}
+		// Spread lights.
+		spread_light(map, ndef, bank, relight[b], *modified_blocks);
+	}
+}
+
 /*!
  * The common part of bulk light updates - it is always executed.
  * The procedure takes the nodes that should be unlit, and the
@@ -1162,28 +1198,10 @@ void finish_bulk_light_update(Map *map, mapblock_v3 minblock,
 
 	// --- STEP 3: do light spreading
 
-	// For each light bank:
-	for (size_t b = 0; b < 2; b++) {
-		LightBank bank = banks[b];
-		// Sunlight is already initialized.
-		u8 maxlight = (b == 0) ? LIGHT_MAX : LIGHT_SUN;
-		// Initialize light values for light spreading.
-		for (u8 i = 0; i <= maxlight; i++) {
-			const std::vector<ChangingLight> &lights = relight[b].lights[i];
-			for (std::vector<ChangingLight>::const_iterator it = lights.begin();
-					it < lights.end(); ++it) {
-				MapNode n = it->block->getNodeNoCheck(it->rel_position,
-					&is_valid);
-				n.setLight(bank, i, ndef);
-				it->block->setNodeNoCheck(it->rel_position, n);
-			}
-		}
-		// Spread lights.
-		spread_light(map, ndef, bank, relight[b], *modified_blocks);
-	}
+	spread_queued_light(map, ndef, relight, modified_blocks);
 }
 
-void blit_back_with_light(ServerMap *map, MMVManip *vm,
+void blit_back_with_light(Map *map, MMVManip *vm,
 	std::map<v3s16, MapBlock*> *modified_blocks)
 {
 	INodeDefManager *ndef = map->getNodeDefManager();
@@ -1282,6 +1300,271 @@ void blit_back_with_light(ServerMap *map, MMVManip *vm,
 		modified_blocks);
 }
 
+void get_vmanip_sunlight(Map *map, MMVManip *vm,
+	std::vector<bool> *sunlight)
+{
+	INodeDefManager *ndef = map->getNodeDefManager();
+	const VoxelArea &area = vm->m_area;
+	v3s16 em = area.getExtent();
+	mapblock_v3 minblock = getNodeBlockPos(area.MinEdge);
+	mapblock_v3 maxblock = getNodeBlockPos(area.MaxEdge);
+	bool lights[MAP_BLOCKSIZE][MAP_BLOCKSIZE];
+
+	sunlight->resize(em.X * em.Z);
+	for (s16 x = minblock.X; x <= maxblock.X; x++)
+	for (s16 z = minblock.Z; z <= maxblock.Z; z++) {
+		is_sunlight_above_block(map, v3s16(x, maxblock.Y, z), ndef, lights);
+		v3s16 offset = v3s16(x, 0, z) * MAP_BLOCKSIZE - area.MinEdge;
+		for (s16 rz = 0; rz < MAP_BLOCKSIZE; rz++)
+		for (s16 rx = 0; rx < MAP_BLOCKSIZE; rx++)
+			(*sunlight)[(offset.Z + rz) * em.X + offset.X + rx] = lights[rz][rx];
+	}
+}
+
+void compute_vmanip_light(MMVManip *vm, INodeDefManager *ndef,
+	std::vector<bool> *sunlight)
+{
+	const VoxelArea &area = vm->m_area;
+	v3s16 em = area.getExtent();
+	mapblock_v3 minblock = getNodeBlockPos(area.MinEdge);
+	mapblock_v3 maxblock = getNodeBlockPos(area.MaxEdge);
+	bool lights[MAP_BLOCKSIZE][MAP_BLOCKSIZE];
+
+	// --- STEP 1: reset everything to sunlight
+
+	for (s16 x = minblock.X; x <= maxblock.X; x++)
+	for (s16 z = minblock.Z; z <= maxblock.Z; z++) {
+		v2s16 offset(x, z);
+		offset *= MAP_BLOCKSIZE;
+		u32 column = (offset.Y - area.MinEdge.Z) * em.X +
+			offset.X - area.MinEdge.X;
+		for (s16 rz = 0; rz < MAP_BLOCKSIZE; rz++)
+		for (s16 rx = 0; rx < MAP_BLOCKSIZE; rx++)
+			lights[rz][rx] = (*sunlight)[column + rz * em.X + rx];
+		fill_with_sunlight(vm, ndef, offset, lights);
+		// Keep the outgoing light for blit_back_with_computed_light()
+		for (s16 rz = 0; rz < MAP_BLOCKSIZE; rz++)
+		for (s16 rx = 0; rx < MAP_BLOCKSIZE; rx++)
+			(*sunlight)[column + rz * em.X + rx] = lights[rz][rx];
+	}
+
+	// --- STEP 2: spread light inside the voxel manipulator
+
+	const s32 ystride = em.X;
+	const s32 zstride = em.X * em.Y;
+	const u32 volume = area.getVolume();
+	// Indices of the nodes to spread light from, by light level
+	std::vector<u32> queue[LIGHT_SUN + 1];
+	for (size_t b = 0; b < 2; b++) {
+		LightBank bank = banks[b];
+		for (u32 i = 0; i < volume; i++) {
+			if (vm->m_flags[i] & VOXELFLAG_NO_DATA)
+				continue;
+			MapNode &n = vm->m_data[i];
+			if (n.getContent() == CONTENT_IGNORE)
+				continue;
+			const ContentFeatures &f = ndef->get(n);
+			u8 light = f.light_source;
+			if (f.param_type == CPT_LIGHT) {
+				light = MYMAX(light, n.getLightRaw(bank, f));
+				n.setLight(bank, light, f);
+			}
+			if (light > 1)
+				queue[light].push_back(i);
+		}
+		// Brightest first, so every node is final when it is spread from
+		for (u8 light = LIGHT_SUN; light > 1; light--) {
+			const u8 spreading_light = light - 1;
+			for (size_t k = 0; k < queue[light].size(); k++) {
+				u32 i = queue[light][k];
+				s32 rx = i % em.X;
+				s32 ry = (i / ystride) % em.Y;
+				s32 rz = i / zstride;
+				s32 neighbors[6];
+				u8 count = 0;
+				if (rx + 1 < em.X) neighbors[count++] = i + 1;
+				if (rx > 0)        neighbors[count++] = i - 1;
+				if (ry + 1 < em.Y) neighbors[count++] = i + ystride;
+				if (ry > 0)        neighbors[count++] = i - ystride;
+				if (rz + 1 < em.Z) neighbors[count++] = i + zstride;
+				if (rz > 0)        neighbors[count++] = i - zstride;
+				for (u8 j = 0; j < count; j++) {
+					u32 ni = neighbors[j];
+					if (vm->m_flags[ni] & VOXELFLAG_NO_DATA)
+						continue;
+					MapNode &n = vm->m_data[ni];
+					if (n.getContent() == CONTENT_IGNORE)
+						continue;
+					const ContentFeatures &f = ndef->get(n);
+					if (f.light_propagates &&
+							n.getLightRaw(bank, f) < spreading_light) {
+						n.setLight(bank, spreading_light, f);
+						queue[spreading_light].push_back(ni);
+					}
+				}
+			}
+			queue[light].clear();
+		}
+		queue[1].clear();
+	}
+}
+
+/*!
+ * Returns the light of a node in the map for both banks,
+ * false if its block is not loaded.
+ */
+bool get_map_node_light(Map *map, INodeDefManager *ndef, v3s16 p,
+	ChangingLight *data, u8 light[2])
+{
+	getNodeBlockPosWithOffset(p, data->block_position, data->rel_position);
+	data->block = map->getBlockNoCreateNoEx(data->block_position);
+	if (!data->block || data->block->isDummy())
+		return false;
+	bool is_valid;
+	MapNode node = data->block->getNodeNoCheck(data->rel_position, &is_valid);
+	const ContentFeatures &f = ndef->get(node);
+	for (size_t b = 0; b < 2; b++) {
+		light[b] = f.param_type == CPT_LIGHT ?
+			node.getLightNoChecks(banks[b], &f) :
+			f.light_source;
+	}
+	return true;
+}
+
+void blit_back_with_computed_light(Map *map, MMVManip *vm,
+	const std::vector<bool> &sunlight,
+	std::map<v3s16, MapBlock*> *modified_blocks)
+{
+	INodeDefManager *ndef = map->getNodeDefManager();
+	const VoxelArea area = vm->m_area;
+	v3s16 em = area.getExtent();
+	mapblock_v3 minblock = getNodeBlockPos(area.MinEdge);
+	mapblock_v3 maxblock = getNodeBlockPos(area.MaxEdge);
+	// First queue is for day light, second is for night light.
+	UnlightQueue unlight[] = { UnlightQueue(256), UnlightQueue(256) };
+	ReLightQueue relight[] = { ReLightQueue(256), ReLightQueue(256) };
+	SunlightPropagationData data;
+	// Dummy boolean.
+	bool is_valid;
+
+	// --- STEP 1: propagate sunlight and shadow below the voxel manipulator
+
+	for (s16 x = minblock.X; x <= maxblock.X; x++)
+	for (s16 z = minblock.Z; z <= maxblock.Z; z++) {
+		u32 column = (z * MAP_BLOCKSIZE - area.MinEdge.Z) * em.X +
+			x * MAP_BLOCKSIZE - area.MinEdge.X;
+		data.target_block = v3s16(x, minblock.Y - 1, z);
+		for (s16 rz = 0; rz < MAP_BLOCKSIZE; rz++)
+		for (s16 rx = 0; rx < MAP_BLOCKSIZE; rx++)
+			data.data.push_back(SunlightPropagationUnit(v2s16(rx, rz),
+				sunlight[column + rz * em.X + rx]));
+		while (!data.data.empty()) {
+			if (propagate_block_sunlight(map, ndef, &data, &unlight[0],
+					&relight[0]))
+				(*modified_blocks)[data.target_block] =
+					map->getBlockNoCreateNoEx(data.target_block);
+			// Step downwards.
+			data.target_block.Y--;
+		}
+	}
+
+	// --- STEP 2: Get nodes from borders to unlight
+
+	// Nodes whose light decreased are unlit from their old light, so
+	// that light which reached the surroundings through them is removed.
+	// Only the borders next to blocks that are not written back matter.
+	for (s16 b_x = minblock.X; b_x <= maxblock.X; b_x++)
+	for (s16 b_y = minblock.Y; b_y <= maxblock.Y; b_y++)
+	for (s16 b_z = minblock.Z; b_z <= maxblock.Z; b_z++) {
+		v3s16 blockpos(b_x, b_y, b_z);
+		MapBlock *block = map->getBlockNoCreateNoEx(blockpos);
+		if (!block || block->isDummy())
+			continue;
+		v3s16 offset = block->getPosRelative();
+		// The block is not written back if it had no data
+		if (vm->m_flags[area.index(offset)] & VOXELFLAG_NO_DATA)
+			continue;
+		for (direction d = 0; d < 6; d++) {
+			v3s16 neighbor = offset + neighbor_dirs[d] * MAP_BLOCKSIZE;
+			if (area.contains(neighbor) &&
+					!(vm->m_flags[area.index(neighbor)] & VOXELFLAG_NO_DATA))
+				continue;
+			VoxelArea a = block_pad[d];
+			for (s32 x = a.MinEdge.X; x <= a.MaxEdge.X; x++)
+			for (s32 z = a.MinEdge.Z; z <= a.MaxEdge.Z; z++)
+			for (s32 y = a.MinEdge.Y; y <= a.MaxEdge.Y; y++) {
+				v3s16 relpos(x, y, z);
+				MapNode oldnode = block->getNodeNoCheck(x, y, z, &is_valid);
+				MapNode &newnode = vm->m_data[area.index(relpos + offset)];
+				const ContentFeatures &oldf = ndef->get(oldnode);
+				// Without light information only a replaced node matters
+				if (oldf.param_type != CPT_LIGHT &&
+						oldnode.getContent() == newnode.getContent())
+					continue;
+				const ContentFeatures &newf = ndef->get(newnode);
+				for (size_t b = 0; b < 2; b++) {
+					LightBank bank = banks[b];
+					u8 oldlight = oldf.param_type == CPT_LIGHT ?
+						oldnode.getLightNoChecks(bank, &oldf):
+						LIGHT_SUN; // no light information, force unlighting
+					u8 newlight = newf.param_type == CPT_LIGHT ?
+						newnode.getLightNoChecks(bank, &newf):
+						newf.light_source;
+					if (oldlight > newlight) {
+						// Unlit nodes must have zero light
+						newnode.setLight(bank, 0, newf);
+						unlight[b].push(
+							oldlight, relpos, blockpos, block, 6);
+					}
+				} // end of banks
+			} // end of nodes
+		} // end of borders
+	} // end of blocks
+
+	// --- STEP 3: All information extracted, overwrite
+
+	vm->blitBackAll(modified_blocks, true);
+
+	// --- STEP 4: Finish light update
+
+	for (size_t b = 0; b < 2; b++) {
+		unspread_light(map, ndef, banks[b], unlight[b], relight[b],
+			*modified_blocks);
+	}
+
+	// The inside is lit already, only light crossing the
+	// borders of the voxel manipulator has to be spread.
+	ChangingLight inside, outside;
+	u8 inside_light[2], outside_light[2];
+	for (direction d = 0; d < 6; d++) {
+		v3s16 dir = neighbor_dirs[d];
+		VoxelArea face = area;
+		if (dir.X > 0 || dir.Y > 0 || dir.Z > 0)
+			face.MinEdge += dir * (em - v3s16(1, 1, 1));
+		else
+			face.MaxEdge += dir * (em - v3s16(1, 1, 1));
+		for (s32 x = face.MinEdge.X; x <= face.MaxEdge.X; x++)
+		for (s32 z = face.MinEdge.Z; z <= face.MaxEdge.Z; z++)
+		for (s32 y = face.MinEdge.Y; y <= face.MaxEdge.Y; y++) {
+			v3s16 p(x, y, z);
+			if (!get_map_node_light(map, ndef, p, &inside, inside_light) ||
+					!get_map_node_light(map, ndef, p + dir, &outside,
+						outside_light))
+				continue;
+			for (size_t b = 0; b < 2; b++) {
+				if (inside_light[b] > outside_light[b] + 1)
+					relight[b].push(inside_light[b], inside.rel_position,
+						inside.block_position, inside.block, 6);
+				else if (outside_light[b] > inside_light[b] + 1)
+					relight[b].push(outside_light[b], outside.rel_position,
+						outside.block_position, outside.block, 6);
+			}
+		}
+	}
+
+	spread_queued_light(map, ndef, relight, modified_blocks);
+}
+
 /*!
  * Resets the lighting of the given map block to
  * complete darkness and full sunlight.
@@ -94,7 +94,28 @@ void update_block_border_lighting(Map *map, MapBlock *block,
  * \param modified_blocks output, contains all map blocks that
  * the function modified
  */
-void blit_back_with_light(ServerMap *map, MMVManip *vm,
+void blit_back_with_light(Map *map, MMVManip *vm,
+	std::map<v3s16, MapBlock*> *modified_blocks);
+
+/*!
+ * blit_back_with_light() in three steps, so that the light inside the
+ * voxel manipulator can be computed without holding the map.
+ *
+ * get_vmanip_sunlight() reads the sunlight entering the voxel manipulator
+ * from above, one value per column. compute_vmanip_light() lights the
+ * voxel manipulator as if it was surrounded by darkness, without touching
+ * the map, and leaves the sunlight leaving the bottom in \p sunlight.
+ * blit_back_with_computed_light() copies back the nodes and corrects the
+ * light that crosses the borders.
+ */
+void get_vmanip_sunlight(Map *map, MMVManip *vm,
+	std::vector<bool> *sunlight);
+
+void compute_vmanip_light(MMVManip *vm, INodeDefManager *ndef,
+	std::vector<bool> *sunlight);
+
+void blit_back_with_computed_light(Map *map, MMVManip *vm,
+	const std::vector<bool> &sunlight,
 	std::map<v3s16, MapBlock*> *modified_blocks);
 
 /*!